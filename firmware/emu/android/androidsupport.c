@@ -151,6 +151,7 @@ void QMA6981_poll(accel_t* currentAccel)
 	currentAccel->x = accy * 256 / 9.81f;
 	currentAccel->y = accx * 256 / 9.81f * -1;
 	currentAccel->z = accz * 256 / 9.81f;
+	emuTraceAccel( currentAccel );
 	// printf("%s (%5d, %5d, %5d)", __func__, currentAccel->x, currentAccel->y, currentAccel->z);
 }
 
@@ -211,8 +212,6 @@ int main()
 		system_os_check_tasks();
 		ets_timer_check_timers();
 
-		updateOLED(0);
-
 		CNFGHandleInput();
 		AccCheck();
 
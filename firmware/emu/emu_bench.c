@@ -0,0 +1,1636 @@
+// Host benchmarks for the drawing code, run with `./swadgemu --bench [suite]`
+//
+// Each benchmark times a reference implementation of the old code path
+// against the current one, draws the same thing with both, and checks that
+// the framebuffers match.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "swadgemu.h"
+
+#include "../user/display/oled.h"
+#include "../user/display/cndraw.h"
+#include "../user/display/font.h"
+#include "../user/utils/assets.h"
+#include "../user/utils/fastlz.h"
+#include "../user/utils/goertzel.h"
+#include "../user/modes/colorchord/DFT32.h"
+#include "../user/modes/colorchord/embeddednf.h"
+
+extern uint8_t currentFb[];
+
+#define BENCH_MIN_TIME 0.25
+
+typedef void (*benchFn_t)(uint32_t iteration);
+
+/*============================================================================
+ * Helpers
+ *==========================================================================*/
+
+/**
+ * @brief Run a function repeatedly for at least BENCH_MIN_TIME seconds
+ *
+ * @param fn The function to run
+ * @param pixelsPerCall The number of pixels touched by each call
+ * @return The throughput, in pixels per microsecond
+ */
+static double benchRun( benchFn_t fn, uint32_t pixelsPerCall )
+{
+    uint32_t iterations = 0;
+    double start = emuGetPerfTime();
+    double elapsed;
+    do
+    {
+        for( uint32_t i = 0; i < 1000; i++ )
+        {
+            fn( iterations++ );
+        }
+        elapsed = emuGetPerfTime() - start;
+    } while( elapsed < BENCH_MIN_TIME );
+
+    return ( (double)iterations * pixelsPerCall ) / ( elapsed * 1000000.0 );
+}
+
+/**
+ * @brief Time an old and a new code path, make sure they draw the same thing,
+ * and print the results
+ *
+ * @param name The name of the benchmark
+ * @param oldFn The reference, pre-optimization code path
+ * @param newFn The current code path
+ * @param pixelsPerCall The number of pixels touched by each call
+ * @return true if both paths drew the same framebuffer
+ */
+static bool benchCompare( const char* name, benchFn_t oldFn, benchFn_t newFn, uint32_t pixelsPerCall )
+{
+    static uint8_t oldFb[OLED_WIDTH * (OLED_HEIGHT / 8)];
+
+    // Check the outputs match over a range of iterations
+    bool match = true;
+    for( uint32_t i = 0; i < 256; i++ )
+    {
+        srand( i );
+        clearDisplay();
+        oldFn( i );
+        memcpy( oldFb, currentFb, sizeof( oldFb ) );
+
+        srand( i );
+        clearDisplay();
+        newFn( i );
+        if( 0 != memcmp( oldFb, currentFb, sizeof( oldFb ) ) )
+        {
+            match = false;
+            break;
+        }
+    }
+
+    double oldRate = benchRun( oldFn, pixelsPerCall );
+    double newRate = benchRun( newFn, pixelsPerCall );
+
+    printf( "%-36s %9.1f px/us -> %9.1f px/us (x%.1f) %s\n", name, oldRate, newRate,
+            newRate / oldRate, match ? "" : "OUTPUT MISMATCH" );
+    return match;
+}
+
+/*============================================================================
+ * Reference implementations
+ *==========================================================================*/
+
+static void refFillDisplayArea( int16_t x1, int16_t y1, int16_t x2, int16_t y2, color c )
+{
+    for( int16_t x = x1; x <= x2; x++ )
+    {
+        for( int16_t y = y1; y <= y2; y++ )
+        {
+            drawPixel( x, y, c );
+        }
+    }
+}
+
+static void refShadeDisplayArea( int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint8_t shadeLevel )
+{
+    for( int16_t dy = y1; dy < y2; dy++ )
+    {
+        for( int16_t dx = x1; dx < x2; dx++ )
+        {
+            bool draw = false;
+            switch( shadeLevel )
+            {
+                case 0:
+                    draw = ( dy % 2 == 0 && dx % 2 == 0 );
+                    break;
+                case 1:
+                    draw = ( dy % 2 == 0 && dx % 2 == 0 ) || ( dx % 4 == 0 );
+                    break;
+                case 2:
+                    draw = ( ( dy % 2 ) == ( dx % 2 ) );
+                    break;
+                case 3:
+                    draw = ( dy % 2 == 0 && dx % 2 == 0 ) || ( dx % 4 < 3 );
+                    break;
+                case 4:
+                    draw = ( dy % 2 == 0 || dx % 2 == 0 );
+                    break;
+                default:
+                    return;
+            }
+            if( draw )
+            {
+                drawPixel( dx, dy, BLACK );
+            }
+        }
+    }
+}
+
+static int16_t refPlotSprite( int16_t x, int16_t y, const sprite_t* p_sprite, color col )
+{
+    color foreground, background;
+    switch( col )
+    {
+        default:
+        case WHITE:
+            foreground = WHITE;
+            background = BLACK;
+            break;
+        case BLACK:
+            foreground = BLACK;
+            background = WHITE;
+            break;
+        case INVERSE:
+            foreground = INVERSE;
+            background = TRANSPARENT_COLOR;
+            break;
+        case TRANSPARENT_COLOR:
+        case WHITE_F_TRANSPARENT_B:
+            foreground = WHITE;
+            background = TRANSPARENT_COLOR;
+            break;
+    }
+
+    for( uint8_t xIdx = 0; xIdx < p_sprite->width; xIdx++ )
+    {
+        for( uint8_t yIdx = 0; yIdx < p_sprite->height; yIdx++ )
+        {
+            int16_t xPx = x + ( p_sprite->width - xIdx ) - 1;
+            int16_t yPx = y + yIdx;
+            drawPixel( xPx, yPx, ( p_sprite->data[yIdx] & ( 1 << xIdx ) ) ? foreground : background );
+        }
+    }
+    return x + p_sprite->width + 1;
+}
+
+static int16_t refPlotText( int16_t x, int16_t y, const char* text, fonts font, color col )
+{
+    const sprite_t* table = ( TOM_THUMB == font ) ? font_TomThumb :
+                            ( IBM_VGA_8 == font ) ? font_IbmVga8 : font_Radiostars;
+    for( ; *text; text++ )
+    {
+        char character = *text;
+        if( character < ' ' )
+        {
+            continue;
+        }
+        if( 'a' <= character && character <= 'z' )
+        {
+            character = character - 'a' + 'A';
+        }
+        else if( character >= '{' )
+        {
+            character = '`' + 1 + ( character - '{' );
+        }
+        x = refPlotSprite( x, y, &table[character - ' '], col );
+    }
+    return x;
+}
+
+// The old per-character font switch and flash width reads, drawing with the
+// current plotSprite() so only the text layer is compared
+static const sprite_t* refFontTable( fonts font )
+{
+    switch( font )
+    {
+        case TOM_THUMB:
+            return font_TomThumb;
+        case IBM_VGA_8:
+            return font_IbmVga8;
+        case RADIOSTARS:
+        default:
+            return font_Radiostars;
+    }
+}
+
+static char refFoldChar( char character )
+{
+    if( 'a' <= character && character <= 'z' )
+    {
+        return character - 'a' + 'A';
+    }
+    else if( character >= '{' )
+    {
+        return '`' + 1 + ( character - '{' );
+    }
+    return character;
+}
+
+static int16_t refTextWidth( const char* text, fonts font )
+{
+    int16_t width = 0;
+    for( ; *text; text++ )
+    {
+        if( *text >= ' ' )
+        {
+            sprite_t sprite_ram;
+            memcpy( &sprite_ram, &refFontTable( font )[refFoldChar( *text ) - ' '], sizeof( sprite_t ) );
+            width += sprite_ram.width + 1;
+        }
+    }
+    return width;
+}
+
+static int16_t refPlotTextSprites( int16_t x, int16_t y, const char* text, fonts font, color col )
+{
+    for( ; *text; text++ )
+    {
+        if( *text >= ' ' )
+        {
+            x = plotSprite( x, y, &refFontTable( font )[refFoldChar( *text ) - ' '], col );
+        }
+    }
+    return x;
+}
+
+/*============================================================================
+ * Drawing benchmarks
+ *==========================================================================*/
+
+static void oldFullFill( uint32_t i )
+{
+    refFillDisplayArea( 0, 0, OLED_WIDTH - 1, OLED_HEIGHT - 1, ( i & 1 ) ? WHITE : INVERSE );
+}
+
+static void newFullFill( uint32_t i )
+{
+    fillDisplayArea( 0, 0, OLED_WIDTH - 1, OLED_HEIGHT - 1, ( i & 1 ) ? WHITE : INVERSE );
+}
+
+static void oldRandomFill( uint32_t i )
+{
+    int16_t x = ( rand() % ( OLED_WIDTH + 16 ) ) - 8;
+    int16_t y = ( rand() % ( OLED_HEIGHT + 16 ) ) - 8;
+    refFillDisplayArea( x, y, x + 31, y + 15, i % 3 );
+}
+
+static void newRandomFill( uint32_t i )
+{
+    int16_t x = ( rand() % ( OLED_WIDTH + 16 ) ) - 8;
+    int16_t y = ( rand() % ( OLED_HEIGHT + 16 ) ) - 8;
+    fillDisplayArea( x, y, x + 31, y + 15, i % 3 );
+}
+
+static void oldHLine( uint32_t i )
+{
+    refFillDisplayArea( 0, i % OLED_HEIGHT, OLED_WIDTH - 1, i % OLED_HEIGHT, WHITE );
+}
+
+static void newHLine( uint32_t i )
+{
+    drawHLine( 0, OLED_WIDTH - 1, i % OLED_HEIGHT, WHITE );
+}
+
+static void oldVLine( uint32_t i )
+{
+    refFillDisplayArea( i % OLED_WIDTH, 3, i % OLED_WIDTH, OLED_HEIGHT - 4, WHITE );
+}
+
+static void newVLine( uint32_t i )
+{
+    drawVLine( i % OLED_WIDTH, 3, OLED_HEIGHT - 4, WHITE );
+}
+
+static void oldShade( uint32_t i )
+{
+    refShadeDisplayArea( 0, 0, OLED_WIDTH, OLED_HEIGHT, i % 5 );
+}
+
+static void newShade( uint32_t i )
+{
+    shadeDisplayArea( 0, 0, OLED_WIDTH, OLED_HEIGHT, i % 5 );
+}
+
+static void oldShadeRandom( uint32_t i )
+{
+    int16_t x = rand() % OLED_WIDTH;
+    int16_t y = rand() % OLED_HEIGHT;
+    refShadeDisplayArea( x, y, x + 24, y + 12, i % 5 );
+}
+
+static void newShadeRandom( uint32_t i )
+{
+    int16_t x = rand() % OLED_WIDTH;
+    int16_t y = rand() % OLED_HEIGHT;
+    shadeDisplayArea( x, y, x + 24, y + 12, i % 5 );
+}
+
+static bool benchDraw( void )
+{
+    bool ok = true;
+    printf( "Drawing primitives:\n" );
+    ok &= benchCompare( "fill full screen", oldFullFill, newFullFill, OLED_WIDTH * OLED_HEIGHT );
+    ok &= benchCompare( "fill 32x16, clipped", oldRandomFill, newRandomFill, 32 * 16 );
+    ok &= benchCompare( "horizontal line", oldHLine, newHLine, OLED_WIDTH );
+    ok &= benchCompare( "vertical line", oldVLine, newVLine, OLED_HEIGHT - 6 );
+    ok &= benchCompare( "shade full screen", oldShade, newShade, OLED_WIDTH * OLED_HEIGHT );
+    ok &= benchCompare( "shade 24x12, clipped", oldShadeRandom, newShadeRandom, 24 * 12 );
+    return ok;
+}
+
+/*============================================================================
+ * Text benchmarks
+ *==========================================================================*/
+
+static const char benchString[] = "The quick brown fox jumps over the lazy dog 0123456789 {|}~!?";
+static const color benchColors[] = { WHITE, BLACK, INVERSE, WHITE_F_TRANSPARENT_B };
+static fonts benchFont;
+
+// Several lines of text, some clipped by the edges of the display
+static void benchText( uint32_t i, int16_t ( *plot )( int16_t, int16_t, const char*, fonts, color ) )
+{
+    int16_t xOff = ( i % 8 ) - 4;
+    int16_t yOff = ( ( i / 8 ) % 8 ) - 4;
+    color col = benchColors[i % ( sizeof( benchColors ) / sizeof( benchColors[0] ) )];
+    for( int16_t y = yOff; y < OLED_HEIGHT; y += 13 )
+    {
+        plot( xOff - y, y, benchString, benchFont, col );
+    }
+}
+
+static void oldText( uint32_t i )
+{
+    benchText( i, refPlotText );
+}
+
+static void newText( uint32_t i )
+{
+    benchText( i, plotText );
+}
+
+// A menu title and a column of score strings, centered every frame
+static const char* benchLabels[] =
+{
+    "SWADGE", "1. 004200 (1:23)", "2. 001337 (0:59)", "3. 000100 (0:07)",
+};
+#define NUM_BENCH_LABELS ( sizeof( benchLabels ) / sizeof( benchLabels[0] ) )
+
+static void oldLabels( uint32_t i )
+{
+    for( uint8_t l = 0; l < NUM_BENCH_LABELS; l++ )
+    {
+        fonts font = ( 0 == l ) ? RADIOSTARS : TOM_THUMB;
+        int16_t width = refTextWidth( benchLabels[l], font );
+        refPlotTextSprites( ( OLED_WIDTH - width ) / 2, l * 14, benchLabels[l], font, WHITE );
+    }
+}
+
+static void newAlignedLabels( uint32_t i )
+{
+    for( uint8_t l = 0; l < NUM_BENCH_LABELS; l++ )
+    {
+        fonts font = ( 0 == l ) ? RADIOSTARS : TOM_THUMB;
+        plotTextAligned( OLED_WIDTH / 2, l * 14, benchLabels[l], font, ALIGN_CENTER, WHITE );
+    }
+}
+
+static void oldMeasure( uint32_t i )
+{
+    int16_t width = refTextWidth( benchString, i % NUM_FONTS );
+    drawPixel( width % OLED_WIDTH, 0, WHITE );
+}
+
+static void newMeasure( uint32_t i )
+{
+    int16_t width = textWidth( benchString, i % NUM_FONTS );
+    drawPixel( width % OLED_WIDTH, 0, WHITE );
+}
+
+static bool benchTextFonts( void )
+{
+    static const struct
+    {
+        const char* name;
+        fonts font;
+        uint8_t height;
+    } benchFonts[] =
+    {
+        { "text, tom thumb", TOM_THUMB, FONT_HEIGHT_TOMTHUMB },
+        { "text, ibm vga 8", IBM_VGA_8, FONT_HEIGHT_IBMVGA8 },
+        { "text, radiostars", RADIOSTARS, FONT_HEIGHT_RADIOSTARS },
+    };
+
+    bool ok = true;
+    printf( "Text:\n" );
+    for( uint8_t f = 0; f < sizeof( benchFonts ) / sizeof( benchFonts[0] ); f++ )
+    {
+        benchFont = benchFonts[f].font;
+        uint32_t lines = ( OLED_HEIGHT + 12 ) / 13;
+        uint32_t pixels = lines * textWidth( benchString, benchFont ) * benchFonts[f].height;
+        ok &= benchCompare( benchFonts[f].name, oldText, newText, pixels );
+    }
+
+    uint32_t labelPixels = 0;
+    for( uint8_t l = 0; l < NUM_BENCH_LABELS; l++ )
+    {
+        fonts font = ( 0 == l ) ? RADIOSTARS : TOM_THUMB;
+        labelPixels += textWidth( benchLabels[l], font ) * ( ( 0 == l ) ? FONT_HEIGHT_RADIOSTARS : FONT_HEIGHT_TOMTHUMB );
+    }
+    ok &= benchCompare( "centered labels, plotTextAligned", oldLabels, newAlignedLabels, labelPixels );
+    ok &= benchCompare( "measure string (chars)", oldMeasure, newMeasure, strlen( benchString ) );
+    return ok;
+}
+
+/*============================================================================
+ * PNG benchmarks
+ *==========================================================================*/
+
+static pngHandle benchPngCoded;
+static pngHandle benchPngPacked;
+static bool benchPngFlipLR;
+static bool benchPngFlipUD;
+static int16_t benchPngRotate;
+
+static void benchPng( pngHandle* handle, uint32_t i )
+{
+    int16_t x = ( rand() % ( OLED_WIDTH + 32 ) ) - 16;
+    int16_t y = ( rand() % ( OLED_HEIGHT + 32 ) ) - 16;
+    drawPngInv( handle, x, y, benchPngFlipLR, benchPngFlipUD, benchPngRotate, i & 1 );
+}
+
+static void oldPng( uint32_t i )
+{
+    benchPng( &benchPngCoded, i );
+}
+
+static void newPng( uint32_t i )
+{
+    benchPng( &benchPngPacked, i );
+}
+
+static bool benchPngs( void )
+{
+    static const char* names[] = { "heart.png", "mt-pu.png", "gtr1.png", "pd-1-norm.png", "wof.png" };
+    static const struct
+    {
+        const char* name;
+        bool flipLR;
+        bool flipUD;
+        int16_t rotateDeg;
+    } transforms[] =
+    {
+        { "none", false, false, 0 },
+        { "flipLR", true, false, 0 },
+        { "flipUD", false, true, 0 },
+        { "rot90", false, false, 90 },
+        { "rot180", false, false, 180 },
+        { "rot270+flipLR", true, false, 270 },
+        { "rot30 (shear)", false, false, 30 },
+        { "rot135+LR (shear)", true, false, 135 },
+        { "rot201+UD (shear)", false, true, 201 },
+    };
+
+    bool ok = true;
+    printf( "PNG:\n" );
+    for( uint8_t n = 0; n < sizeof( names ) / sizeof( names[0] ); n++ )
+    {
+        if( !allocPngAsset( names[n], &benchPngCoded ) || !allocPngAsset( names[n], &benchPngPacked ) ||
+                !decodePngAsset( &benchPngPacked ) )
+        {
+            printf( "  %s not found, skipping\n", names[n] );
+            continue;
+        }
+
+        for( uint8_t t = 0; t < sizeof( transforms ) / sizeof( transforms[0] ); t++ )
+        {
+            char name[64];
+            snprintf( name, sizeof( name ), "%s %dx%d %s", names[n], benchPngCoded.width, benchPngCoded.height,
+                      transforms[t].name );
+            benchPngFlipLR = transforms[t].flipLR;
+            benchPngFlipUD = transforms[t].flipUD;
+            benchPngRotate = transforms[t].rotateDeg;
+            ok &= benchCompare( name, oldPng, newPng, benchPngCoded.width * benchPngCoded.height );
+        }
+
+        freePngAsset( &benchPngCoded );
+        freePngAsset( &benchPngPacked );
+    }
+    return ok;
+}
+
+/*============================================================================
+ * Asset lookup benchmarks
+ *==========================================================================*/
+
+extern uint32_t* assets;
+
+// The linear scan getAsset() used before the name hash table
+static uint32_t* refGetAsset( const char* name, uint32_t* retLen )
+{
+    uint32_t idx = 0;
+    uint32_t numIndexItems = assets[idx++];
+    for( uint32_t ni = 0; ni < numIndexItems; ni++ )
+    {
+        char assetName[16] = {0};
+        memcpy( assetName, &assets[idx], sizeof( uint32_t ) * 4 );
+        idx += 4;
+        uint32_t assetAddress = assets[idx++];
+        uint32_t assetLen = assets[idx++];
+        if( 0 == strcmp( name, assetName ) )
+        {
+            *retLen = assetLen;
+            return &assets[assetAddress / sizeof( uint32_t )];
+        }
+    }
+    *retLen = 0;
+    return NULL;
+}
+
+static double benchLookups( uint32_t* ( *lookup )( const char*, uint32_t* ), char ( *names )[17], uint32_t numNames )
+{
+    uint32_t iterations = 0;
+    double start = emuGetPerfTime();
+    double elapsed;
+    do
+    {
+        for( uint32_t i = 0; i < numNames; i++ )
+        {
+            uint32_t len;
+            lookup( names[i], &len );
+        }
+        iterations += numNames;
+        elapsed = emuGetPerfTime() - start;
+    } while( elapsed < BENCH_MIN_TIME );
+    return ( elapsed * 1000000000.0 ) / iterations;
+}
+
+static bool benchAssets( void )
+{
+    uint32_t len;
+    printf( "Asset lookup:\n" );
+    // Load assets.bin and build the index
+    getAsset( "", &len );
+    if( NULL == assets )
+    {
+        printf( "  assets.bin not loaded, skipping\n" );
+        return true;
+    }
+
+    // Look up every asset in the index, plus one which doesn't exist
+    uint32_t numNames = assets[0] + 1;
+    char ( *names )[17] = calloc( numNames, sizeof( *names ) );
+    for( uint32_t i = 0; i + 1 < numNames; i++ )
+    {
+        memcpy( names[i], &assets[1 + ( i * 6 )], 16 );
+    }
+    strcpy( names[numNames - 1], "missing.png" );
+
+    bool match = true;
+    for( uint32_t i = 0; i < numNames; i++ )
+    {
+        uint32_t oldLen, newLen;
+        if( refGetAsset( names[i], &oldLen ) != getAsset( names[i], &newLen ) || oldLen != newLen )
+        {
+            match = false;
+        }
+    }
+
+    double oldNs = benchLookups( refGetAsset, names, numNames );
+    double newNs = benchLookups( getAsset, names, numNames );
+    printf( "%-36s %9.1f ns -> %9.1f ns (x%.1f) %s\n", "lookup, all assets", oldNs, newNs,
+            oldNs / newNs, match ? "" : "OUTPUT MISMATCH" );
+    printf( "  %u assets\n", numNames - 1 );
+    free( names );
+    return match;
+}
+
+/*============================================================================
+ * GIF benchmarks
+ *==========================================================================*/
+
+// The gif decoder before it decoded straight into the framebuffer's layout
+typedef struct
+{
+    uint32_t* assetPtr;
+    uint32_t idx;
+    uint8_t* compressed;
+    uint8_t* decompressed;
+    uint8_t* frame;
+    uint32_t allocedSize;
+    uint16_t width;
+    uint16_t height;
+    uint16_t nFrames;
+    uint16_t cFrame;
+} refGifHandle;
+
+void transformPixel( int16_t* x, int16_t* y, int16_t transX, int16_t transY, bool flipLR, bool flipUD,
+                     int16_t rotateDeg, int16_t width, int16_t height );
+
+static void refLoadGif( const char* name, refGifHandle* handle )
+{
+    uint32_t assetLen;
+    memset( handle, 0, sizeof( *handle ) );
+    handle->assetPtr = getAsset( name, &assetLen );
+    if( NULL == handle->assetPtr )
+    {
+        return;
+    }
+    handle->width = handle->assetPtr[handle->idx++];
+    handle->height = handle->assetPtr[handle->idx++];
+    handle->nFrames = handle->assetPtr[handle->idx++];
+    handle->idx++;
+    handle->allocedSize = ( ( handle->width * handle->height ) + 8 ) / 8;
+    // The original only allocated allocedSize, which incompressible frames overflow
+    handle->compressed = malloc( handle->allocedSize * 2 );
+    handle->decompressed = malloc( handle->allocedSize );
+    handle->frame = malloc( handle->allocedSize );
+}
+
+static void refFreeGif( refGifHandle* handle )
+{
+    free( handle->compressed );
+    free( handle->decompressed );
+    free( handle->frame );
+}
+
+static void refDrawNextGifFrame( refGifHandle* handle, int16_t xp, int16_t yp, bool flipLR, bool flipUD,
+                                 int16_t rotateDeg )
+{
+    uint32_t compressedLen = handle->assetPtr[handle->idx++];
+    uint32_t paddedLen = ( compressedLen + 3 ) & ~3;
+    memcpy( handle->compressed, &handle->assetPtr[handle->idx], paddedLen );
+    handle->idx += ( paddedLen / 4 );
+    if( handle->cFrame == 0 )
+    {
+        fastlz_decompress( handle->compressed, compressedLen, handle->frame, handle->allocedSize );
+    }
+    else
+    {
+        fastlz_decompress( handle->compressed, compressedLen, handle->decompressed, handle->allocedSize );
+        for( uint32_t i = 0; i < handle->allocedSize; i++ )
+        {
+            handle->frame[i] ^= handle->decompressed[i];
+        }
+    }
+    handle->cFrame = ( handle->cFrame + 1 ) % handle->nFrames;
+    if( handle->cFrame == 0 )
+    {
+        handle->idx = 4;
+    }
+
+    for( int16_t h = 0; h < handle->height; h++ )
+    {
+        for( int16_t w = 0; w < handle->width; w++ )
+        {
+            int16_t x = w;
+            int16_t y = h;
+            transformPixel( &x, &y, xp, yp, flipLR, flipUD, rotateDeg, handle->width, handle->height );
+            if( 0 <= x && x < OLED_WIDTH )
+            {
+                int16_t byteIdx = ( w + ( h * handle->width ) ) / 8;
+                int16_t bitIdx = ( w + ( h * handle->width ) ) % 8;
+                drawPixel( x, y, ( handle->frame[byteIdx] & ( 0x80 >> bitIdx ) ) ? WHITE : BLACK );
+            }
+        }
+    }
+}
+
+static refGifHandle benchGifRef;
+static gifHandle benchGifNew;
+
+// Pan across the screen like the menu, sometimes flipped or rotated
+static void benchGifTransform( uint32_t i, int16_t* xp, bool* flipLR, int16_t* rotateDeg )
+{
+    *xp = ( ( i * 4 ) % ( 2 * OLED_WIDTH ) ) - OLED_WIDTH;
+    *flipLR = ( 1 == ( i % 4 ) );
+    *rotateDeg = ( 3 == ( i % 8 ) ) ? 180 : ( ( 7 == ( i % 8 ) ) ? 90 : 0 );
+}
+
+static void oldGif( uint32_t i )
+{
+    int16_t xp, rotateDeg;
+    bool flipLR;
+    benchGifTransform( i, &xp, &flipLR, &rotateDeg );
+    refDrawNextGifFrame( &benchGifRef, xp, 0, flipLR, false, rotateDeg );
+}
+
+static void newGif( uint32_t i )
+{
+    int16_t xp, rotateDeg;
+    bool flipLR;
+    benchGifTransform( i, &xp, &flipLR, &rotateDeg );
+    drawGifFromAsset( &benchGifNew, xp, 0, flipLR, false, rotateDeg, true );
+}
+
+static void benchGifReload( const char* name )
+{
+    refFreeGif( &benchGifRef );
+    refLoadGif( name, &benchGifRef );
+    freeGifAsset( &benchGifNew );
+    memset( &benchGifNew, 0, sizeof( benchGifNew ) );
+    loadGifFromAsset( name, &benchGifNew );
+}
+
+static bool benchGifs( void )
+{
+    static const char* names[] = { "ddr-menu.gif", "flight-menu.gif", "anim1.gif", "anim2.gif", "anim3.gif" };
+
+    bool ok = true;
+    printf( "GIF:\n" );
+    for( uint8_t n = 0; n < sizeof( names ) / sizeof( names[0] ); n++ )
+    {
+        benchGifReload( names[n] );
+        if( NULL == benchGifRef.assetPtr )
+        {
+            printf( "  %s not found, skipping\n", names[n] );
+            continue;
+        }
+
+        char name[64];
+        uint32_t pixels = benchGifRef.width * benchGifRef.height;
+        snprintf( name, sizeof( name ), "%s %dx%d x%d, panned", names[n], benchGifRef.width,
+                  benchGifRef.height, benchGifRef.nFrames );
+        ok &= benchCompare( name, oldGif, newGif, pixels );
+    }
+    refFreeGif( &benchGifRef );
+    freeGifAsset( &benchGifNew );
+    return ok;
+}
+
+/*============================================================================
+ * Window presentation
+ *==========================================================================*/
+
+#ifndef EMU_HEADLESS
+
+#define BENCH_PRESENT_FRAMES 64
+#define BENCH_VIDMEM_PIXELS( scale ) ( OLED_WIDTH * ( scale ) * ( HEADER_PIXELS + OLED_HEIGHT + FOOTER_PIXELS ) * ( scale ) )
+
+static uint8_t benchPresentFbs[BENCH_PRESENT_FRAMES][OLED_WIDTH * ( OLED_HEIGHT / 8 )];
+
+/// The old emuSendOLEDData(), which redrew every pixel it was given
+static void refSendOLEDData( int disp, uint8_t* fb )
+{
+    int yStart = ( 0 == disp ) ? 0 : ( ( 1 == disp ) ? HEADER_PIXELS : HEADER_PIXELS + OLED_HEIGHT );
+    int yHeight = ( 0 == disp ) ? HEADER_PIXELS : ( ( 1 == disp ) ? OLED_HEIGHT : FOOTER_PIXELS );
+    for( int y = 0; y < yHeight; y++ )
+    {
+        for( int x = 0; x < OLED_WIDTH; x++ )
+        {
+            uint32_t pxcol;
+            if( disp == 1 )
+            {
+                uint8_t col = fb[( y + x * OLED_HEIGHT ) / 8] & ( 1 << ( y & 7 ) );
+                pxcol = col ? 0xFFFFFF : 0x000000;
+            }
+            else
+            {
+                pxcol = ( (uint32_t*)fb )[x + y * OLED_WIDTH];
+            }
+            uint32_t* pxloc = rawvidmem + ( x + ( ( y + yStart ) ) * OLED_WIDTH * px_scale ) * px_scale;
+            for( int ly = 0; ly < px_scale; ly++ )
+            {
+                for( int lx = 0; lx < px_scale; lx++ )
+                {
+                    pxloc[lx] = pxcol;
+                }
+                pxloc += OLED_WIDTH * px_scale;
+            }
+        }
+    }
+}
+
+/// One pass of the old main loop, which redrew the OLED, header and footer
+static void oldPresent( uint32_t i )
+{
+    refSendOLEDData( 1, benchPresentFbs[i % BENCH_PRESENT_FRAMES] );
+    refSendOLEDData( 0, (uint8_t*)headerpix );
+    refSendOLEDData( 2, (uint8_t*)footerpix );
+}
+
+/// One pass of the current main loop
+static void newPresent( uint32_t i )
+{
+    emuSendOLEDData( 1, benchPresentFbs[i % BENCH_PRESENT_FRAMES] );
+    emuHeader();
+    emuFooter();
+}
+
+/**
+ * @brief Fill benchPresentFbs with a noisy background and, optionally, a
+ * 12x12 box moving across it
+ *
+ * @param moving true to draw the box, false for identical frames
+ */
+static void benchPresentFrames( bool moving )
+{
+    srand( 0 );
+    for( uint32_t i = 0; i < sizeof( benchPresentFbs[0] ); i++ )
+    {
+        benchPresentFbs[0][i] = rand() & 0x11;
+    }
+    for( uint32_t f = 1; f < BENCH_PRESENT_FRAMES; f++ )
+    {
+        memcpy( benchPresentFbs[f], benchPresentFbs[0], sizeof( benchPresentFbs[0] ) );
+    }
+    for( uint32_t f = 0; moving && f < BENCH_PRESENT_FRAMES; f++ )
+    {
+        memcpy( currentFb, benchPresentFbs[f], sizeof( benchPresentFbs[f] ) );
+        fillDisplayArea( f * 2, 20, f * 2 + 11, 31, WHITE );
+        memcpy( benchPresentFbs[f], currentFb, sizeof( benchPresentFbs[f] ) );
+    }
+}
+
+static bool benchPresent( void )
+{
+    static const int scales[] = { 1, 2, 4, 5 };
+    int oldScale = px_scale;
+    uint32_t* oldVidmem = rawvidmem;
+
+    bool ok = true;
+    printf( "Window presentation:\n" );
+    for( uint8_t m = 0; m < 2; m++ )
+    {
+        benchPresentFrames( 0 == m );
+        for( uint8_t s = 0; s < sizeof( scales ) / sizeof( scales[0] ); s++ )
+        {
+            px_scale = scales[s];
+            uint32_t* refVid = calloc( BENCH_VIDMEM_PIXELS( px_scale ), sizeof( uint32_t ) );
+            uint32_t* newVid = calloc( BENCH_VIDMEM_PIXELS( px_scale ), sizeof( uint32_t ) );
+
+            // Draw the header and footer at this scale, which also fills in
+            // the pixels the old path draws from
+            rawvidmem = newVid;
+            emuHeader();
+            emuFooter();
+
+            // Presenting only what changed relies on the last frame being left
+            // in rawvidmem, so check it against full redraws frame by frame
+            bool match = true;
+            for( uint32_t i = 0; i < BENCH_PRESENT_FRAMES; i++ )
+            {
+                rawvidmem = refVid;
+                oldPresent( i );
+                rawvidmem = newVid;
+                newPresent( i );
+                match &= ( 0 == memcmp( refVid, newVid, BENCH_VIDMEM_PIXELS( px_scale ) * sizeof( uint32_t ) ) );
+            }
+
+            rawvidmem = refVid;
+            double oldRate = benchRun( oldPresent, OLED_WIDTH * OLED_HEIGHT );
+            rawvidmem = newVid;
+            double newRate = benchRun( newPresent, OLED_WIDTH * OLED_HEIGHT );
+
+            char name[64];
+            snprintf( name, sizeof( name ), "%s, x%d", ( 0 == m ) ? "12x12 box moving" : "nothing changing",
+                      px_scale );
+            printf( "%-36s %9.1f px/us -> %9.1f px/us (x%.1f) %s\n", name, oldRate, newRate,
+                    newRate / oldRate, match ? "" : "OUTPUT MISMATCH" );
+            ok &= match;
+
+            free( refVid );
+            free( newVid );
+        }
+    }
+
+    px_scale = oldScale;
+    rawvidmem = oldVidmem;
+    return ok;
+}
+
+#endif
+
+/*============================================================================
+ * Audio benchmarks
+ *==========================================================================*/
+
+#define BENCH_AUDIO_FRAME 128
+// Each call processes a sixteenth of a second
+#define BENCH_AUDIO_CALL ( DFREQ / 16 )
+
+extern uint16_t Sdatspace32A[FIXBINS * 2];
+extern int32_t Sdatspace32B[FIXBINS * 2];
+extern int32_t Sdatspace32BOut[FIXBINS * 2];
+
+// A second of ADC samples, a chord over some noise
+static uint8_t benchAdc[DFREQ];
+static uint16_t benchDftA[FIXBINS * 2];
+static uint32_t benchSamplesProcessed;
+
+// What procTask() did with each sample before samples were passed in blocks
+static void refAudioSample( int32_t samp )
+{
+    PushSample32( samp );
+    benchSamplesProcessed++;
+    if( benchSamplesProcessed >= BENCH_AUDIO_FRAME )
+    {
+        HandleFrameInfo();
+        benchSamplesProcessed = 0;
+    }
+}
+
+static void ( *volatile refAudioCallback )( int32_t ) = refAudioSample;
+
+static void oldAudio( uint32_t i )
+{
+    static uint32_t samp_iir = 0;
+    uint32_t end = ( ( i % 16 ) + 1 ) * BENCH_AUDIO_CALL;
+    for( uint32_t s = ( i % 16 ) * BENCH_AUDIO_CALL; s < end; s++ )
+    {
+        int32_t samp = benchAdc[s];
+        samp_iir = samp_iir - ( samp_iir >> 10 ) + samp;
+        samp = ( samp - ( samp_iir >> 10 ) ) * 16;
+        samp = ( samp * CCS.gINITIAL_AMP ) >> 4;
+        refAudioCallback( samp );
+    }
+    emuCostAdd( EMU_COST_AUDIO_SAMPLE, BENCH_AUDIO_CALL );
+    emuCostAdd( EMU_COST_AUDIO_CALL, BENCH_AUDIO_CALL );
+}
+
+// What colorchord's fnAudioBlockCallback does
+static void newAudioBlock( const int16_t* samples, uint16_t numSamples )
+{
+    while( numSamples > 0 )
+    {
+        uint16_t toPush = BENCH_AUDIO_FRAME - benchSamplesProcessed;
+        toPush = ( toPush < numSamples ) ? toPush : numSamples;
+        PushSamples32( samples, toPush );
+        samples += toPush;
+        numSamples -= toPush;
+        benchSamplesProcessed += toPush;
+        if( benchSamplesProcessed >= BENCH_AUDIO_FRAME )
+        {
+            HandleFrameInfo();
+            benchSamplesProcessed = 0;
+        }
+    }
+}
+
+static void ( *volatile newAudioCallback )( const int16_t*, uint16_t ) = newAudioBlock;
+
+// What procTask() does now
+static void newAudio( uint32_t i )
+{
+    static uint32_t samp_iir = 0;
+    uint32_t end = ( ( i % 16 ) + 1 ) * BENCH_AUDIO_CALL;
+    for( uint32_t s = ( i % 16 ) * BENCH_AUDIO_CALL; s < end; )
+    {
+        int16_t block[AUDIO_BLOCK_LEN];
+        uint16_t blockLen = 0;
+        while( blockLen < AUDIO_BLOCK_LEN && s < end )
+        {
+            int32_t samp = benchAdc[s++];
+            samp_iir = samp_iir - ( samp_iir >> 10 ) + samp;
+            samp = ( samp - ( samp_iir >> 10 ) ) * 16;
+            samp = ( samp * CCS.gINITIAL_AMP ) >> 4;
+            block[blockLen++] = samp;
+        }
+        emuCostAdd( EMU_COST_AUDIO_SAMPLE, blockLen );
+        emuCostAdd( EMU_COST_AUDIO_CALL, 1 );
+        newAudioCallback( block, blockLen );
+    }
+}
+
+/**
+ * @brief Put colorchord back the way it was after the first reset
+ */
+static void benchAudioReset( void )
+{
+    static bool saved = false;
+    InitColorChord();
+    // A cycle of silence processes every octave, leaving nothing accumulated
+    static const int16_t silence[BINCYCLE / 2] = {0};
+    PushSamples32( silence, BINCYCLE / 2 );
+    if( !saved )
+    {
+        memcpy( benchDftA, Sdatspace32A, sizeof( benchDftA ) );
+        saved = true;
+    }
+    memcpy( Sdatspace32A, benchDftA, sizeof( benchDftA ) );
+    memset( Sdatspace32B, 0, sizeof( Sdatspace32B ) );
+    memset( Sdatspace32BOut, 0, sizeof( Sdatspace32BOut ) );
+    benchSamplesProcessed = 0;
+}
+
+/**
+ * @brief Run a second of audio through colorchord, a sample at a time and a
+ * block at a time, and check that it hears the same notes
+ *
+ * @return true if both found the same notes
+ */
+static bool benchAudio( void )
+{
+    printf( "Audio, a second of colorchord:\n" );
+    srand( 0 );
+    for( uint32_t s = 0; s < DFREQ; s++ )
+    {
+        // 220Hz and 330Hz, centered on the ADC's range
+        double t = (double)s / DFREQ;
+        benchAdc[s] = 128 + 40 * sin( 2 * M_PI * 220 * t ) + 30 * sin( 2 * M_PI * 330 * t ) + ( rand() % 9 ) - 4;
+    }
+
+    // The second run both ways is also counted by the cost model. The DFT and
+    // note tracking are the same both ways, the filter and the calls aren't
+    uint16_t oldBins[FIXBINS];
+    uint8_t oldNotes[MAXNOTES];
+    benchAudioReset();
+    emuCostDiscard();
+    for( uint32_t i = 0; i < 16; i++ )
+    {
+        oldAudio( i );
+    }
+    double oldModelUs = emuCostPendingNs() / 1000.0;
+    memcpy( oldBins, fuzzed_bins, sizeof( oldBins ) );
+    memcpy( oldNotes, note_peak_freqs, sizeof( oldNotes ) );
+
+    benchAudioReset();
+    emuCostDiscard();
+    for( uint32_t i = 0; i < 16; i++ )
+    {
+        newAudio( i );
+    }
+    double newModelUs = emuCostPendingNs() / 1000.0;
+    bool match = ( 0 == memcmp( oldBins, fuzzed_bins, sizeof( oldBins ) ) ) &&
+                 ( 0 == memcmp( oldNotes, note_peak_freqs, sizeof( oldNotes ) ) );
+
+    // Samples per microsecond, turned into microseconds of CPU per second of
+    // audio. The difference is small, so take the best of a few alternating runs
+    double oldUs = 0, newUs = 0;
+    for( uint32_t r = 0; r < 4; r++ )
+    {
+        double us = DFREQ / benchRun( oldAudio, BENCH_AUDIO_CALL );
+        oldUs = ( 0 == r || us < oldUs ) ? us : oldUs;
+        us = DFREQ / benchRun( newAudio, BENCH_AUDIO_CALL );
+        newUs = ( 0 == r || us < newUs ) ? us : newUs;
+    }
+    printf( "%-36s %9.1f us/s -> %9.1f us/s (x%.2f) %s\n", "per sample -> blocks", oldUs, newUs,
+            oldUs / newUs, match ? "" : "OUTPUT MISMATCH" );
+    printf( "  %.1f us of host CPU saved per second of audio\n", oldUs - newUs );
+    printf( "%-36s %9.1f us/s -> %9.1f us/s (x%.2f)\n", "  swadge, modeled", oldModelUs,
+            newModelUs, oldModelUs / newModelUs );
+    printf( "  %.1f us of swadge CPU saved per second of audio, %.2f%% of the CPU\n",
+            oldModelUs - newModelUs, ( oldModelUs - newModelUs ) / 1e4 );
+    emuCostDiscard();
+    return match;
+}
+
+/*============================================================================
+ * DFT benchmarks
+ *==========================================================================*/
+
+#ifdef DFT32_SIMD
+
+#define BENCH_DFT_LEN DFREQ
+// How often DFT32 decays its bins, in samples
+#define BENCH_DFT_DECAY_SAMPLES ( BINCYCLE / 2 )
+
+static int16_t* benchDftIn;
+static uint32_t benchDftLen;
+
+static void benchDftPush( uint32_t i )
+{
+    uint32_t chunk = benchDftLen / 16;
+    PushSamples32( &benchDftIn[( i % 16 ) * chunk], chunk );
+}
+
+static void oldDft( uint32_t i )
+{
+    DFT32UseSimd = 0;
+    benchDftPush( i );
+}
+
+static void newDft( uint32_t i )
+{
+    DFT32UseSimd = 1;
+    benchDftPush( i );
+}
+
+/**
+ * @brief Run the input through a floating point DFT with the same bins and
+ * decay as DFT32, at the full sample rate, for reference
+ *
+ * @param mags Returns the magnitude of each bin
+ */
+static void benchFloatDft( float* mags )
+{
+    double s[FIXBINS] = {0}, c[FIXBINS] = {0}, step[FIXBINS];
+    for( uint32_t b = 0; b < FIXBINS; b++ )
+    {
+        // Each octave's bins advance once per 2^(OCTAVES - 1 - octave) samples
+        uint32_t octave = b / FIXBPERO;
+        step[b] = 2 * M_PI * ( Sdatspace32A[b * 2] / 65536.0 ) / ( 1 << ( OCTAVES - 1 - octave ) );
+    }
+    for( uint32_t n = 0; n < benchDftLen; n++ )
+    {
+        for( uint32_t b = 0; b < FIXBINS; b++ )
+        {
+            s[b] += sin( step[b] * n ) * benchDftIn[n];
+            c[b] += cos( step[b] * n ) * benchDftIn[n];
+            if( BENCH_DFT_DECAY_SAMPLES - 1 == n % BENCH_DFT_DECAY_SAMPLES )
+            {
+                s[b] -= s[b] / ( 1 << DFTIIR );
+                c[b] -= c[b] / ( 1 << DFTIIR );
+            }
+        }
+    }
+    for( uint32_t b = 0; b < FIXBINS; b++ )
+    {
+        mags[b] = sqrt( s[b] * s[b] + c[b] * c[b] );
+    }
+}
+
+/**
+ * @brief Run the input through the scalar and vector DFT32, check they're
+ * identical, time them and compare their output to a floating point DFT
+ *
+ * @param name What the input is
+ * @return true if the scalar and vector code gave identical results
+ */
+static bool benchDftInput( const char* name )
+{
+    static int32_t scalarB[FIXBINS * 2];
+    static uint16_t scalarBins[FIXBINS];
+
+    benchAudioReset();
+    DFT32UseSimd = 0;
+    PushSamples32( benchDftIn, benchDftLen );
+    UpdateOutputBins32();
+    memcpy( scalarB, Sdatspace32B, sizeof( scalarB ) );
+    memcpy( scalarBins, embeddedbins32, sizeof( scalarBins ) );
+
+    benchAudioReset();
+    DFT32UseSimd = 1;
+    PushSamples32( benchDftIn, benchDftLen );
+    UpdateOutputBins32();
+    bool match = ( 0 == memcmp( scalarB, Sdatspace32B, sizeof( scalarB ) ) ) &&
+                 ( 0 == memcmp( scalarBins, embeddedbins32, sizeof( scalarBins ) ) );
+
+    // Compare the shapes of the spectra, each scaled to its peak
+    float ref[FIXBINS];
+    benchFloatDft( ref );
+    float refPeak = 0, dftPeak = 0;
+    uint32_t refPeakBin = 0, dftPeakBin = 0;
+    for( uint32_t b = 0; b < FIXBINS; b++ )
+    {
+        if( ref[b] > refPeak )
+        {
+            refPeak = ref[b];
+            refPeakBin = b;
+        }
+        if( embeddedbins32[b] > dftPeak )
+        {
+            dftPeak = embeddedbins32[b];
+            dftPeakBin = b;
+        }
+    }
+    double errSum = 0, errMax = 0;
+    for( uint32_t b = 0; b < FIXBINS; b++ )
+    {
+        double err = fabs( ( dftPeak > 0 ? embeddedbins32[b] / dftPeak : 0 ) - ( refPeak > 0 ? ref[b] / refPeak : 0 ) );
+        errSum += err;
+        errMax = ( err > errMax ) ? err : errMax;
+    }
+
+    double oldRate = benchRun( oldDft, benchDftLen / 16 );
+    double newRate = benchRun( newDft, benchDftLen / 16 );
+    DFT32UseSimd = 1;
+    printf( "%-36s %9.1f Msps -> %9.1f Msps (x%.1f) %s\n", name, oldRate, newRate, newRate / oldRate,
+            match ? "" : "OUTPUT MISMATCH" );
+    printf( "  vs float DFT: error %.1f%% mean, %.1f%% max of peak, peak bin %u, float %u\n",
+            100 * errSum / FIXBINS, 100 * errMax, dftPeakBin, refPeakBin );
+    return match;
+}
+
+/**
+ * @brief Benchmark the scalar and vector DFT32 with tones, and a recording if
+ * one was given with --mic
+ *
+ * @return true if the scalar and vector code gave identical results
+ */
+static bool benchDft( void )
+{
+#ifdef __AVX2__
+    printf( "DFT32, scalar -> AVX2:\n" );
+#else
+    printf( "DFT32, scalar -> SSE2:\n" );
+#endif
+    bool ok = true;
+    benchDftIn = malloc( BENCH_DFT_LEN * sizeof( int16_t ) );
+    benchDftLen = BENCH_DFT_LEN;
+
+    // Tones in the range DFT32 takes, -4095 to 4095
+    static const float tones[][2] = { { 220, 0 }, { 440, 0 }, { 261.63, 392 }, { 1000, 1500 } };
+    srand( 0 );
+    for( uint32_t t = 0; t < sizeof( tones ) / sizeof( tones[0] ); t++ )
+    {
+        for( uint32_t n = 0; n < BENCH_DFT_LEN; n++ )
+        {
+            double v = sin( 2 * M_PI * tones[t][0] * n / DFREQ );
+            if( 0 != tones[t][1] )
+            {
+                v = ( v + sin( 2 * M_PI * tones[t][1] * n / DFREQ ) ) / 2;
+            }
+            benchDftIn[n] = 2000 * v + ( rand() % 65 ) - 32;
+        }
+        char name[64];
+        if( 0 == tones[t][1] )
+        {
+            snprintf( name, sizeof( name ), "%gHz", tones[t][0] );
+        }
+        else
+        {
+            snprintf( name, sizeof( name ), "%gHz + %gHz", tones[t][0], tones[t][1] );
+        }
+        ok &= benchDftInput( name );
+    }
+
+    // The recording, scaled from 16 to 13 bits
+    uint32_t recLen;
+    const int16_t* rec = emuMicRecording( &recLen );
+    if( NULL != rec && recLen >= 16 )
+    {
+        free( benchDftIn );
+        benchDftIn = malloc( recLen * sizeof( int16_t ) );
+        benchDftLen = recLen;
+        for( uint32_t n = 0; n < recLen; n++ )
+        {
+            benchDftIn[n] = rec[n] >> 3;
+        }
+        ok &= benchDftInput( "recording" );
+    }
+    else
+    {
+        printf( "  no recording, give one with --mic FILE\n" );
+    }
+
+    free( benchDftIn );
+    return ok;
+}
+
+#endif
+
+/*============================================================================
+ * Tuner benchmarks
+ *==========================================================================*/
+
+// These match mode_tunernome.c
+#define BENCH_TUNER_STRINGS 6
+#define BENCH_TUNER_BLOCK_LEN 2048
+#define BENCH_TUNER_IIR_SHIFT 1
+#define BENCH_TUNER_IN_TUNE_CENTS 3
+#define BENCH_TUNER_IN_TUNE 10
+#define BENCH_TUNER_SENSITIVITY 5
+
+#define BENCH_TUNER_LEN ( DFREQ * 2 )
+
+typedef enum
+{
+    BENCH_TUNER_NONE,
+    BENCH_TUNER_FLAT,
+    BENCH_TUNER_IN_TUNE_READING,
+    BENCH_TUNER_SHARP,
+} benchTunerReading_t;
+
+static const char* benchTunerReadingNames[] = { "none", "flat", "in tune", "sharp" };
+
+// The guitar's bins in fuzzed_bins[], the low E string is read an octave up
+static const uint16_t benchGuitarBins[BENCH_TUNER_STRINGS] = { 38, 24, 34, 44, 52, 62 };
+static const char* benchGuitarNames[BENCH_TUNER_STRINGS] = { "E2", "A2", "D3", "G3", "B3", "E4" };
+
+static int16_t* benchTunerIn;
+static uint32_t benchTunerLen;
+static goertzel_t benchGoertzel;
+static uint32_t benchTunerIntensities[BENCH_TUNER_STRINGS];
+static int32_t benchTunerDiffs[BENCH_TUNER_STRINGS];
+
+/**
+ * @param intensity The intensity of a string, 0 to 255
+ * @param tonalDiff How far it is out of tune
+ * @return What the tuner's LED for the string shows
+ */
+static benchTunerReading_t benchTunerRead( int16_t intensity, int32_t tonalDiff )
+{
+    if( intensity < 8 )
+    {
+        // Too dim to light the LED
+        return BENCH_TUNER_NONE;
+    }
+    else if( abs( tonalDiff ) < BENCH_TUNER_IN_TUNE )
+    {
+        return BENCH_TUNER_IN_TUNE_READING;
+    }
+    return ( tonalDiff > 0 ) ? BENCH_TUNER_SHARP : BENCH_TUNER_FLAT;
+}
+
+/**
+ * @return The frequency of a bin in fuzzed_bins[]
+ */
+static float benchBinFreq( uint16_t bin )
+{
+    return BASE_FREQ * pow( 2, (double)bin / FIXBPERO );
+}
+
+// What instrumentTunerMagic() did with colorchord's bins
+static benchTunerReading_t oldTunerMagic( uint32_t string )
+{
+    uint16_t bin = benchGuitarBins[string];
+    benchTunerIntensities[string] = ( fuzzed_bins[bin] + benchTunerIntensities[string] ) -
+                                    ( benchTunerIntensities[string] >> 5 );
+    benchTunerDiffs[string] = ( ( fuzzed_bins[bin + 1] - fuzzed_bins[bin - 1] ) + benchTunerDiffs[string] ) -
+                              ( benchTunerDiffs[string] >> 5 );
+    int16_t intensity = ( benchTunerIntensities[string] >> BENCH_TUNER_SENSITIVITY ) - 40;
+    intensity = ( intensity < 0 ) ? 0 : ( ( intensity > 255 ) ? 255 : intensity );
+    int16_t tonalDiff = ( benchTunerDiffs[string] >> BENCH_TUNER_SENSITIVITY ) * 200 / ( intensity + 1 );
+    return benchTunerRead( intensity, tonalDiff );
+}
+
+// What instrumentTunerMagic() does with the Goertzel filters
+static benchTunerReading_t newTunerMagic( uint32_t string )
+{
+    benchTunerIntensities[string] = ( benchGoertzel.mags[GOERTZEL_STRING( string )] + benchTunerIntensities[string] ) -
+                                    ( benchTunerIntensities[string] >> BENCH_TUNER_IIR_SHIFT );
+    benchTunerDiffs[string] = ( ( benchGoertzel.mags[GOERTZEL_STRING_HIGH( string )] -
+                                  benchGoertzel.mags[GOERTZEL_STRING_LOW( string )] ) + benchTunerDiffs[string] ) -
+                              ( benchTunerDiffs[string] >> BENCH_TUNER_IIR_SHIFT );
+    int16_t intensity = ( benchTunerIntensities[string] >> BENCH_TUNER_IIR_SHIFT ) - 40;
+    intensity = ( intensity < 0 ) ? 0 : ( ( intensity > 255 ) ? 255 : intensity );
+    int32_t cents = goertzelCents( &benchGoertzel, string, benchTunerIntensities[string], benchTunerDiffs[string] );
+    return benchTunerRead( intensity, cents * BENCH_TUNER_IN_TUNE / BENCH_TUNER_IN_TUNE_CENTS );
+}
+
+/**
+ * @brief Start both tuners over
+ */
+static void benchTunerReset( void )
+{
+    float freqs[BENCH_TUNER_STRINGS];
+    for( uint32_t s = 0; s < BENCH_TUNER_STRINGS; s++ )
+    {
+        freqs[s] = benchBinFreq( benchGuitarBins[s] );
+    }
+    benchAudioReset();
+#ifdef DFT32_SIMD
+    // Compare against the code the ESP runs
+    DFT32UseSimd = 0;
+#endif
+    goertzelInitStrings( &benchGoertzel, freqs, BENCH_TUNER_STRINGS, BENCH_TUNER_BLOCK_LEN );
+    memset( benchTunerIntensities, 0, sizeof( benchTunerIntensities ) );
+    memset( benchTunerDiffs, 0, sizeof( benchTunerDiffs ) );
+}
+
+static void oldTuner( uint32_t i )
+{
+    uint32_t chunk = benchTunerLen / 16;
+    const int16_t* in = &benchTunerIn[( i % 16 ) * chunk];
+    for( uint32_t n = 0; n + BENCH_AUDIO_FRAME <= chunk; n += BENCH_AUDIO_FRAME )
+    {
+        PushSamples32( &in[n], BENCH_AUDIO_FRAME );
+        HandleFrameInfo();
+        for( uint32_t s = 0; s < BENCH_TUNER_STRINGS; s++ )
+        {
+            oldTunerMagic( s );
+        }
+    }
+}
+
+static void newTuner( uint32_t i )
+{
+    uint32_t chunk = benchTunerLen / 16;
+    const int16_t* in = &benchTunerIn[( i % 16 ) * chunk];
+    for( uint32_t n = 0; n < chunk; )
+    {
+        n += goertzelPush( &benchGoertzel, &in[n], chunk - n );
+        if( benchGoertzel.blockDone )
+        {
+            for( uint32_t s = 0; s < BENCH_TUNER_STRINGS; s++ )
+            {
+                newTunerMagic( s );
+            }
+        }
+    }
+}
+
+/**
+ * @brief Run the input through one of the tuners, and find when its reading
+ * for a string settled, the last time it changed while the LED was lit
+ *
+ * @param useGoertzel true for the Goertzel filters, false for colorchord
+ * @param string      The string to watch
+ * @param settledMs   Returns when the reading last changed, in milliseconds
+ * @return The reading it settled on
+ */
+static benchTunerReading_t benchTunerSettle( bool useGoertzel, uint32_t string, uint32_t* settledMs )
+{
+    benchTunerReset();
+    benchTunerReading_t reading = BENCH_TUNER_NONE;
+    uint32_t settled = 0;
+    for( uint32_t n = 0; n < benchTunerLen; )
+    {
+        bool done = false;
+        if( useGoertzel )
+        {
+            n += goertzelPush( &benchGoertzel, &benchTunerIn[n], benchTunerLen - n );
+            done = benchGoertzel.blockDone;
+        }
+        else if( n + BENCH_AUDIO_FRAME <= benchTunerLen )
+        {
+            PushSamples32( &benchTunerIn[n], BENCH_AUDIO_FRAME );
+            HandleFrameInfo();
+            n += BENCH_AUDIO_FRAME;
+            done = true;
+        }
+        else
+        {
+            break;
+        }
+
+        if( done )
+        {
+            // Going dark as the string dies away doesn't count
+            benchTunerReading_t r = useGoertzel ? newTunerMagic( string ) : oldTunerMagic( string );
+            if( BENCH_TUNER_NONE != r && r != reading )
+            {
+                reading = r;
+                settled = n;
+            }
+        }
+    }
+    *settledMs = ( settled * 1000ULL ) / DFREQ;
+    return reading;
+}
+
+/**
+ * @brief Compare how long each tuner takes to settle on a string, and whether
+ * it's right
+ *
+ * @param name     What the input is
+ * @param string   The string to watch
+ * @param expected The right reading, or BENCH_TUNER_NONE if it isn't known
+ */
+static void benchTunerCompare( const char* name, uint32_t string, benchTunerReading_t expected )
+{
+    uint32_t oldMs, newMs;
+    benchTunerReading_t oldReading = benchTunerSettle( false, string, &oldMs );
+    benchTunerReading_t newReading = benchTunerSettle( true, string, &newMs );
+    printf( "%-24s %-7s at %4u ms %-5s -> %-7s at %4u ms %s\n", name, benchTunerReadingNames[oldReading], oldMs,
+            ( BENCH_TUNER_NONE == expected ) ? "" : ( oldReading == expected ) ? "(ok)" : "(bad)",
+            benchTunerReadingNames[newReading], newMs,
+            ( BENCH_TUNER_NONE == expected ) ? "" : ( newReading == expected ) ? "(ok)" : "(bad)" );
+}
+
+/**
+ * @brief Benchmark colorchord against the Goertzel filters for tuning a
+ * guitar, with plucked strings in and out of tune, and a recording if one
+ * was given with --mic
+ *
+ * @return true, since the tuners aren't expected to match
+ */
+static bool benchTuner( void )
+{
+    printf( "Tuner, guitar strings, colorchord -> goertzel, settled reading:\n" );
+    benchTunerIn = malloc( BENCH_TUNER_LEN * sizeof( int16_t ) );
+    benchTunerLen = BENCH_TUNER_LEN;
+
+    static const int32_t detunes[] = { 0, 5, -5, 20, -20 };
+    srand( 0 );
+    for( uint32_t s = 0; s < BENCH_TUNER_STRINGS; s++ )
+    {
+        for( uint32_t d = 0; d < sizeof( detunes ) / sizeof( detunes[0] ); d++ )
+        {
+            // A plucked string, with its harmonics dying away faster than
+            // its fundamental
+            double f = benchBinFreq( benchGuitarBins[s] ) * pow( 2, detunes[d] / 1200.0 );
+            if( 0 == s )
+            {
+                f /= 2;
+            }
+            for( uint32_t n = 0; n < BENCH_TUNER_LEN; n++ )
+            {
+                double t = (double)n / DFREQ;
+                double v = 0;
+                for( uint32_t h = 1; h <= 6 && h * f < DFREQ / 2; h++ )
+                {
+                    v += sin( 2 * M_PI * h * f * t ) * exp( -t * h / 1.5 ) / h;
+                }
+                benchTunerIn[n] = 1200 * v + ( rand() % 65 ) - 32;
+            }
+
+            char name[32];
+            snprintf( name, sizeof( name ), "%s %+d cents", benchGuitarNames[s], detunes[d] );
+            benchTunerCompare( name, s, ( 0 == detunes[d] ) ? BENCH_TUNER_IN_TUNE_READING :
+                               ( detunes[d] > 0 ) ? BENCH_TUNER_SHARP : BENCH_TUNER_FLAT );
+        }
+    }
+
+    // Time both with every string being watched, as the mode does, taking
+    // the best of a few alternating runs
+    double oldUs = 0, newUs = 0;
+    for( uint32_t r = 0; r < 4; r++ )
+    {
+        double us = DFREQ / benchRun( oldTuner, benchTunerLen / 16 );
+        oldUs = ( 0 == r || us < oldUs ) ? us : oldUs;
+        us = DFREQ / benchRun( newTuner, benchTunerLen / 16 );
+        newUs = ( 0 == r || us < newUs ) ? us : newUs;
+    }
+    printf( "%-36s %9.1f us/s -> %9.1f us/s (x%.1f)\n", "CPU per second of audio", oldUs, newUs, oldUs / newUs );
+
+    // The recording, scaled from 16 to 13 bits, on whichever string it's
+    // loudest at
+    uint32_t recLen;
+    const int16_t* rec = emuMicRecording( &recLen );
+    if( NULL != rec && recLen >= BENCH_AUDIO_FRAME )
+    {
+        free( benchTunerIn );
+        benchTunerIn = malloc( recLen * sizeof( int16_t ) );
+        benchTunerLen = recLen;
+        for( uint32_t n = 0; n < recLen; n++ )
+        {
+            benchTunerIn[n] = rec[n] >> 3;
+        }
+
+        uint32_t loudest = 0;
+        benchTunerReset();
+        newTuner( 0 );
+        for( uint32_t s = 1; s < BENCH_TUNER_STRINGS; s++ )
+        {
+            if( benchTunerIntensities[s] > benchTunerIntensities[loudest] )
+            {
+                loudest = s;
+            }
+        }
+        char name[32];
+        snprintf( name, sizeof( name ), "recording, %s", benchGuitarNames[loudest] );
+        benchTunerCompare( name, loudest, BENCH_TUNER_NONE );
+    }
+    else
+    {
+        printf( "  no recording, give one with --mic FILE\n" );
+    }
+
+    free( benchTunerIn );
+    return true;
+}
+
+/*============================================================================
+ * Entry point
+ *==========================================================================*/
+
+/**
+ * @brief Run the host benchmarks
+ *
+ * @param suite The name of a suite to run, or NULL to run all of them
+ * @return 0 if all benchmarks drew matching output, 1 otherwise
+ */
+int emuRunBenchmarks( const char* suite )
+{
+    bool ok = true;
+    if( NULL == suite || 0 == strcmp( suite, "draw" ) )
+    {
+        ok &= benchDraw();
+    }
+    if( NULL == suite || 0 == strcmp( suite, "text" ) )
+    {
+        ok &= benchTextFonts();
+    }
+    if( NULL == suite || 0 == strcmp( suite, "png" ) )
+    {
+        ok &= benchPngs();
+    }
+    if( NULL == suite || 0 == strcmp( suite, "assets" ) )
+    {
+        ok &= benchAssets();
+    }
+    if( NULL == suite || 0 == strcmp( suite, "gif" ) )
+    {
+        ok &= benchGifs();
+    }
+    if( NULL == suite || 0 == strcmp( suite, "audio" ) )
+    {
+        ok &= benchAudio();
+    }
+    if( NULL == suite || 0 == strcmp( suite, "tuner" ) )
+    {
+        ok &= benchTuner();
+    }
+#ifdef DFT32_SIMD
+    if( NULL == suite || 0 == strcmp( suite, "dft" ) )
+    {
+        ok &= benchDft();
+    }
+#endif
+#ifndef EMU_HEADLESS
+    if( NULL == suite || 0 == strcmp( suite, "present" ) )
+    {
+        ok &= benchPresent();
+    }
+#endif
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,412 @@
+// Estimated cost of each frame on a real swadge
+//
+// The host is far faster than an ESP8266, so a mode which runs smoothly in the
+// emulator can still overrun the 33ms render window on hardware. The firmware
+// and the emulated hardware count the work which dominates a frame on the
+// device: bytes bit-banged to the OLED over I2C, pixel and framebuffer byte
+// writes, asset decoding, asset reads from mapped flash and SPI flash
+// operations. Each count has a weight, in LX106 cycles or bus time, and every
+// frame's total is turned into an estimated frame time at the configured CPU
+// clock when procTask() finishes drawing it.
+//
+// Frame times are kept in a histogram per swadge mode, printed with the rest
+// of emuReportModeStats(), and any frame which would have overrun is flagged as
+// it happens. Only the counted work is estimated, so these are lower bounds.
+//
+// Code can count its own work with emuCostCount(), and the weight of that, or
+// of any built in counter, can be set from the command line, see
+// emuCostParseArg()
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "swadgemu.h"
+
+/// The time procTask() allows between frames
+#define EMU_COST_FRAME_US 33333
+/// How many overrunning frames to describe per mode before only counting them
+#define EMU_COST_MAX_FLAGGED 5
+/// How many names can be counted with emuCostCount()
+#define EMU_COST_MAX_NAMED 16
+
+/// I2C clocks per byte, eight data bits and an ACK
+#define EMU_COST_I2C_BITS_PER_BYTE 9
+/// The bit-banged I2C clock at 160MHz. my_i2c_delay() is a run of nops, so
+/// this scales with the CPU clock unless --i2c-khz is given
+#define EMU_COST_I2C_KHZ_AT_160MHZ 800
+
+/// A counter and its weight in cycles
+typedef struct
+{
+    const char* name;
+    uint32_t cycles;
+    uint64_t count;
+} emuCostCounter_t;
+
+static uint32_t cpuMhz = 160;
+static uint32_t i2cKhz = 0;
+
+// The built in counters, in the order of emuCost_t. The weights are rough
+// instruction counts of the firmware's inner loops, plus a little for cache
+// misses, since most of it runs from flash
+static emuCostCounter_t counters[EMU_COST_MAX_NAMED] =
+{
+    { "i2c-byte", 0, 0 },      // Timed from the I2C clock instead
+    { "pixel", 30, 0 },        // drawPixel(), bounds checks, dirty mark and read-modify-write
+    { "png-pixel", 12, 0 },    // decodePngAsset() walking the prefix code, or drawPackedPng() gathering a row
+    { "gif-byte", 20, 0 },     // decodeGifFrame() and applyGifDelta()
+    { "fb-column", 20, 0 },    // Clipping and shifting a column's masks in fillAreaMasked(), plotSprite() and blitPngLine()
+    { "fb-byte", 8, 0 },       // Each framebuffer read-modify-write in those columns
+    { "flash-word", 40, 0 },   // A 32 byte cache line filled over quad SPI at 40MHz, spread over its eight words
+    { "audio-sample", 16, 0 }, // getSample() from the ring buffer, the DC-removal IIR and gain
+    { "audio-call", 40, 0 },   // callx8 through swadgeModes into flash, window spill and bookkeeping
+    { "dft-bin", 12, 0 },      // HandleInt()'s sin/cos lookup, multiply and accumulate, or a decay or norm
+    { "frame-unit", 16, 0 },   // A unit of StepFrameInfo()'s budget, about a bin or a note compared
+};
+
+// Which part of the frame time each built in counter is, in the order of emuCost_t
+static const emuCostKind_t builtinKinds[EMU_COST_NUM_BUILTIN] =
+{
+    EMU_COST_KIND_I2C,
+    EMU_COST_KIND_PIXEL,
+    EMU_COST_KIND_DECODE,
+    EMU_COST_KIND_DECODE,
+    EMU_COST_KIND_PIXEL,
+    EMU_COST_KIND_PIXEL,
+    EMU_COST_KIND_FLASH,
+    EMU_COST_KIND_AUDIO,
+    EMU_COST_KIND_AUDIO,
+    EMU_COST_KIND_AUDIO,
+    EMU_COST_KIND_AUDIO,
+};
+
+static uint32_t numCounters = EMU_COST_NUM_BUILTIN;
+
+// Time accounted directly, like SPI flash operations, this frame
+static uint64_t frameBusyNs = 0;
+// The estimated time of all the work counted before the last frame ended or
+// was discarded, a device clock for timing OS tasks
+static uint64_t doneNs = 0;
+// The number of overrunning frames flagged for this mode so far
+static uint32_t flagged = 0;
+
+static const uint32_t histEdgesUs[EMU_COST_HIST_BUCKETS - 1] =
+{
+    1000, 2000, 4000, 8000, 16000, EMU_COST_FRAME_US
+};
+
+/*============================================================================
+ * Configuration
+ *==========================================================================*/
+
+/**
+ * @return The I2C clock, in kHz, which OLED data is sent at
+ */
+static uint32_t emuCostI2cKhz( void )
+{
+    if( 0 != i2cKhz )
+    {
+        return i2cKhz;
+    }
+    return ( EMU_COST_I2C_KHZ_AT_160MHZ * cpuMhz ) / 160;
+}
+
+/**
+ * @brief Find a counter by name, adding it if there's room
+ *
+ * @param name The counter's name
+ * @return The counter, or NULL if the table is full
+ */
+static emuCostCounter_t* emuCostFind( const char* name )
+{
+    for( uint32_t i = 0; i < numCounters; i++ )
+    {
+        if( 0 == strcmp( counters[i].name, name ) )
+        {
+            return &counters[i];
+        }
+    }
+
+    if( numCounters == EMU_COST_MAX_NAMED )
+    {
+        return NULL;
+    }
+    counters[numCounters].name = name;
+    counters[numCounters].cycles = 0;
+    counters[numCounters].count = 0;
+    return &counters[numCounters++];
+}
+
+/**
+ * @brief Parse a cost model command line option, if this is one
+ *
+ *     --cpu-mhz N               Estimate for an 80 or 160MHz CPU clock (default 160)
+ *     --i2c-khz N               Send OLED data at N kHz (default 800 at 160MHz)
+ *     --cost-weight NAME=CYCLES Weigh each count of NAME as CYCLES cycles
+ *
+ * @param argc The argument count from main()
+ * @param argv The arguments from main()
+ * @param idx  The index of the argument to parse. If the option takes a value,
+ *             this is advanced past it
+ * @return true if this was a cost model option, false if it wasn't
+ */
+bool emuCostParseArg( int argc, char** argv, int* idx )
+{
+    if( *idx + 1 >= argc )
+    {
+        return false;
+    }
+
+    const char* opt = argv[*idx];
+    const char* val = argv[*idx + 1];
+    if( 0 == strcmp( opt, "--cpu-mhz" ) )
+    {
+        cpuMhz = strtoul( val, NULL, 10 );
+        if( 0 == cpuMhz )
+        {
+            cpuMhz = 160;
+        }
+    }
+    else if( 0 == strcmp( opt, "--i2c-khz" ) )
+    {
+        i2cKhz = strtoul( val, NULL, 10 );
+    }
+    else if( 0 == strcmp( opt, "--cost-weight" ) )
+    {
+        const char* eq = strchr( val, '=' );
+        emuCostCounter_t* counter = NULL;
+        if( NULL != eq )
+        {
+            // The name has to outlive argv's parsing
+            char* name = strndup( val, eq - val );
+            counter = emuCostFind( name );
+            if( NULL == counter || counter->name != name )
+            {
+                free( name );
+            }
+        }
+        if( NULL == counter )
+        {
+            fprintf( stderr, "EMU Error: Expected --cost-weight NAME=CYCLES, at most %d names\n",
+                     EMU_COST_MAX_NAMED );
+            return false;
+        }
+        counter->cycles = strtoul( eq + 1, NULL, 10 );
+    }
+    else
+    {
+        return false;
+    }
+
+    ( *idx )++;
+    return true;
+}
+
+/*============================================================================
+ * Counting
+ *==========================================================================*/
+
+/**
+ * @brief Count work done by one of the built in counters
+ *
+ * @param which The counter
+ * @param n     How many to count
+ */
+void emuCostAdd( emuCost_t which, uint32_t n )
+{
+    counters[which].count += n;
+}
+
+/**
+ * @brief Count work by name, for code which isn't covered by a built in
+ * counter. Each count is weighed by --cost-weight NAME=CYCLES, or nothing if
+ * that isn't given
+ *
+ * @param name The counter's name, which must be a string constant
+ * @param n    How many to count
+ */
+void emuCostCount( const char* name, uint32_t n )
+{
+    emuCostCounter_t* counter = emuCostFind( name );
+    if( NULL != counter )
+    {
+        counter->count += n;
+    }
+}
+
+/**
+ * @brief Account for time the CPU waits on the hardware, like an SPI flash
+ * operation
+ *
+ * @param ns The time, in nanoseconds
+ */
+void emuCostAddNs( uint64_t ns )
+{
+    frameBusyNs += ns;
+}
+
+/*============================================================================
+ * Frames
+ *==========================================================================*/
+
+/**
+ * @brief Forget the work counted since the last frame. Called when the OLED is
+ * initialized, since starting a mode isn't part of any frame. The work still
+ * counts towards the time of the OS task which did it
+ */
+void emuCostDiscard( void )
+{
+    doneNs += emuCostPendingNs();
+    for( uint32_t i = 0; i < numCounters; i++ )
+    {
+        counters[i].count = 0;
+    }
+    frameBusyNs = 0;
+}
+
+/**
+ * @brief Estimate how long the work counted since the last frame would take
+ * on hardware, split by kind of work
+ *
+ * @param kindNs Filled with the estimated time of each kind, in nanoseconds
+ */
+static void emuCostEstimate( uint64_t kindNs[EMU_COST_KINDS] )
+{
+    memset( kindNs, 0, EMU_COST_KINDS * sizeof( uint64_t ) );
+
+    // Bit-banging keeps the CPU busy for the whole transfer
+    kindNs[EMU_COST_KIND_I2C] = ( counters[EMU_COST_I2C_BYTE].count * EMU_COST_I2C_BITS_PER_BYTE * 1000000ULL ) /
+                                emuCostI2cKhz();
+    kindNs[EMU_COST_KIND_FLASH] = frameBusyNs;
+    for( uint32_t i = EMU_COST_I2C_BYTE + 1; i < numCounters; i++ )
+    {
+        uint64_t ns = ( counters[i].count * counters[i].cycles * 1000ULL ) / cpuMhz;
+        kindNs[( i < EMU_COST_NUM_BUILTIN ) ? builtinKinds[i] : EMU_COST_KIND_NAMED] += ns;
+    }
+}
+
+/**
+ * @brief Estimate how long the work counted since the last frame would take
+ * on hardware, without ending the frame. Used by the benchmarks to compare the
+ * modeled cost of two ways of doing the same work
+ *
+ * @return The estimated time, in nanoseconds
+ */
+uint64_t emuCostPendingNs( void )
+{
+    uint64_t kindNs[EMU_COST_KINDS];
+    emuCostEstimate( kindNs );
+
+    uint64_t totalNs = 0;
+    for( uint32_t k = 0; k < EMU_COST_KINDS; k++ )
+    {
+        totalNs += kindNs[k];
+    }
+    return totalNs;
+}
+
+/**
+ * @brief Estimate how long all the work counted so far would take on
+ * hardware, including frames which were discarded. Only differences between
+ * two calls mean anything, like the time of one OS task
+ *
+ * @return The estimated time, in nanoseconds
+ */
+uint64_t emuCostElapsedNs( void )
+{
+    return doneNs + emuCostPendingNs();
+}
+
+/**
+ * @brief Estimate how long the work counted since the last frame would take
+ * on hardware, add it to this mode's histogram and flag it if it overruns.
+ * Called by procTask() after each frame is sent to the OLED, through
+ * emuEndFrame()
+ *
+ * @return The frame's estimated time on hardware, in microseconds
+ */
+uint32_t emuCostEndFrame( void )
+{
+    uint64_t kindNs[EMU_COST_KINDS];
+    emuCostEstimate( kindNs );
+    emuCostDiscard();
+
+    uint64_t frameNs = 0;
+    for( uint32_t k = 0; k < EMU_COST_KINDS; k++ )
+    {
+        emuStats.costNs[k] += kindNs[k];
+        frameNs += kindNs[k];
+    }
+    uint32_t frameUs = frameNs / 1000;
+
+    uint32_t bucket = 0;
+    while( bucket < EMU_COST_HIST_BUCKETS - 1 && frameUs >= histEdgesUs[bucket] )
+    {
+        bucket++;
+    }
+    emuStats.costHist[bucket]++;
+    emuStats.costFrames++;
+    if( frameUs > emuStats.costWorstUs )
+    {
+        emuStats.costWorstUs = frameUs;
+    }
+
+    if( frameUs >= EMU_COST_FRAME_US )
+    {
+        emuStats.costOverruns++;
+        if( 1 == emuStats.costOverruns )
+        {
+            flagged = 0;
+        }
+        if( flagged < EMU_COST_MAX_FLAGGED )
+        {
+            flagged++;
+            fprintf( stderr, "EMU Cost: frame %u would take %.1f ms at %uMHz (I2C %.1f, pixels %.1f, "
+                     "decode %.1f, flash %.1f, audio %.1f, named %.1f)\n", emuStats.costFrames, frameUs / 1000.0,
+                     cpuMhz, kindNs[EMU_COST_KIND_I2C] / 1e6, kindNs[EMU_COST_KIND_PIXEL] / 1e6,
+                     kindNs[EMU_COST_KIND_DECODE] / 1e6, kindNs[EMU_COST_KIND_FLASH] / 1e6,
+                     kindNs[EMU_COST_KIND_AUDIO] / 1e6, kindNs[EMU_COST_KIND_NAMED] / 1e6 );
+        }
+    }
+    return frameUs;
+}
+
+/**
+ * @brief Print this mode's estimated frame times. Called by
+ * emuReportModeStats(), which clears them afterwards
+ */
+void emuCostReport( void )
+{
+    if( 0 == emuStats.costFrames )
+    {
+        return;
+    }
+
+    uint64_t totalNs = 0;
+    for( uint32_t k = 0; k < EMU_COST_KINDS; k++ )
+    {
+        totalNs += emuStats.costNs[k];
+    }
+    printf( "  Cost: %u frames at %uMHz, I2C at %ukHz, %.2f ms/frame, worst %.2f ms, %u over %.1f ms\n",
+            emuStats.costFrames, cpuMhz, emuCostI2cKhz(), totalNs / 1e6 / emuStats.costFrames,
+            emuStats.costWorstUs / 1000.0, emuStats.costOverruns, EMU_COST_FRAME_US / 1000.0 );
+    printf( "  Cost: ms/frame in I2C %.2f, pixels %.2f, decode %.2f, flash %.2f, audio %.2f, named %.2f\n",
+            emuStats.costNs[EMU_COST_KIND_I2C] / 1e6 / emuStats.costFrames,
+            emuStats.costNs[EMU_COST_KIND_PIXEL] / 1e6 / emuStats.costFrames,
+            emuStats.costNs[EMU_COST_KIND_DECODE] / 1e6 / emuStats.costFrames,
+            emuStats.costNs[EMU_COST_KIND_FLASH] / 1e6 / emuStats.costFrames,
+            emuStats.costNs[EMU_COST_KIND_AUDIO] / 1e6 / emuStats.costFrames,
+            emuStats.costNs[EMU_COST_KIND_NAMED] / 1e6 / emuStats.costFrames );
+    printf( "  Cost: frames in ms" );
+    for( uint32_t b = 0; b < EMU_COST_HIST_BUCKETS; b++ )
+    {
+        if( b < EMU_COST_HIST_BUCKETS - 1 )
+        {
+            printf( " <%g:%u", histEdgesUs[b] / 1000.0, emuStats.costHist[b] );
+        }
+        else
+        {
+            printf( " >=%g:%u\n", histEdgesUs[b - 1] / 1000.0, emuStats.costHist[b] );
+        }
+    }
+}
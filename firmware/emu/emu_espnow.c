@@ -0,0 +1,444 @@
+// Emulated ESP-NOW, broadcast between emulators on one machine over UDP
+//
+// Every frame sent with espNowSend() is multicast to the loopback interface,
+// tagged with the sender's emulated MAC address, so every other emulator on
+// the machine hears it. Each receiver decides for itself whether the frame is
+// lost and how long it takes to arrive, then hands it to the swadge mode
+// through swadgeModeEspNowRecvCb() with a synthetic RSSI. Send status comes
+// back through swadgeModeEspNowSendCb() on the next task pass, like the
+// SDK's callback after a transmission.
+//
+// Loss, latency, jitter, RSSI and the MAC address are set from the command
+// line, see emuEspNowParseArg()
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include "swadgemu.h"
+#include "user_interface.h"
+
+#include "../user/user_main.h"
+#include "../user/utils/wireless/espNowUtils.h"
+
+#if !defined(WINDOWS) && !defined(ANDROID)
+    #define LINUX
+#endif
+
+#ifdef LINUX
+    #include <unistd.h>
+    #include <sys/types.h>
+    #include <sys/socket.h>
+    #include <netinet/in.h>
+    #include <arpa/inet.h>
+#endif
+
+#define ESPNOW_GROUP "239.255.83.87"
+#define ESPNOW_PORT 5483
+#define ESPNOW_MAGIC 0x574E5345 // "ESNW"
+#define ESPNOW_MAX_LEN 250
+#define ESPNOW_RX_QUEUE_LEN 64
+#define ESPNOW_TX_QUEUE_LEN 16
+
+/// How much the synthetic RSSI wanders either side of the --espnow-rssi value
+#define ESPNOW_RSSI_WANDER 4
+
+/// One frame on the wire
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;
+    uint8_t src[6];
+    uint8_t dst[6];
+    uint8_t len;
+    uint8_t data[ESPNOW_MAX_LEN];
+} emuEspNowFrame_t;
+
+/// A received frame waiting out its latency
+typedef struct
+{
+    uint32_t deliverAtUs;
+    emuEspNowFrame_t frame;
+} emuEspNowRx_t;
+
+// Link settings
+static float lossPct = 0;
+static uint32_t latencyUs = 0;
+static uint32_t jitterUs = 0;
+static uint8_t baseRssi = 70;
+
+static uint8_t emuMac[6] = {0};
+static bool macSet = false;
+static const uint8_t broadcastMac[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+/// Loss and jitter use their own generator, so they don't disturb rand()
+static uint32_t linkRandState = 1;
+
+static int sock = -1;
+static uint32_t initTimeUs = 0;
+// Started, with frames from a replayed trace instead of the network
+static bool replayUp = false;
+
+static emuEspNowRx_t rxQueue[ESPNOW_RX_QUEUE_LEN];
+static uint8_t rxQueued = 0;
+
+static mt_tx_status txStatus[ESPNOW_TX_QUEUE_LEN];
+static uint8_t txHead = 0;
+static uint8_t txQueued = 0;
+
+/*============================================================================
+ * Addresses and options
+ *==========================================================================*/
+
+/**
+ * @brief Get this emulator's MAC address. Unless it was set with --espnow-id,
+ * it is made from the process ID so that every emulator on the machine is
+ * different. The first byte marks it as locally administered
+ *
+ * @param mac Returns the six byte MAC address
+ */
+void emuEspNowGetMac( uint8_t* mac )
+{
+    if( !macSet )
+    {
+#ifdef LINUX
+        uint32_t id = getpid();
+#else
+        uint32_t id = 1;
+#endif
+        emuMac[0] = 0x5E;
+        emuMac[1] = 0x5A;
+        emuMac[2] = 0xD6;
+        emuMac[3] = id >> 16;
+        emuMac[4] = id >> 8;
+        emuMac[5] = id;
+        macSet = true;
+    }
+    memcpy( mac, emuMac, sizeof( emuMac ) );
+}
+
+/**
+ * @brief Parse an ESP-NOW command line option, if this is one
+ *
+ *     --espnow-loss PCT     Drop this percent of received frames (default 0)
+ *     --espnow-latency MS   Delay received frames by this long (default 0)
+ *     --espnow-jitter MS    Delay received frames by up to this much more (default 0)
+ *     --espnow-rssi N       Report this RSSI, 1 to 91, give or take a little (default 70)
+ *     --espnow-id N         Use N for the last three bytes of the MAC address
+ *
+ * @param argc The argument count from main()
+ * @param argv The arguments from main()
+ * @param idx  The index of the argument to parse. If the option takes a value,
+ *             this is advanced past it
+ * @return true if this was an ESP-NOW option, false if it wasn't
+ */
+bool emuEspNowParseArg( int argc, char** argv, int* idx )
+{
+    if( *idx + 1 >= argc || 0 != strncmp( argv[*idx], "--espnow-", 9 ) )
+    {
+        return false;
+    }
+
+    const char* opt = &argv[*idx][9];
+    const char* val = argv[*idx + 1];
+    if( 0 == strcmp( opt, "loss" ) )
+    {
+        lossPct = atof( val );
+    }
+    else if( 0 == strcmp( opt, "latency" ) )
+    {
+        latencyUs = atof( val ) * 1000;
+    }
+    else if( 0 == strcmp( opt, "jitter" ) )
+    {
+        jitterUs = atof( val ) * 1000;
+    }
+    else if( 0 == strcmp( opt, "rssi" ) )
+    {
+        int rssi = atoi( val );
+        baseRssi = ( rssi < 1 ) ? 1 : ( ( rssi > 91 ) ? 91 : rssi );
+    }
+    else if( 0 == strcmp( opt, "id" ) )
+    {
+        uint32_t id = strtoul( val, NULL, 0 );
+        uint8_t mac[6];
+        emuEspNowGetMac( mac );
+        emuMac[3] = id >> 16;
+        emuMac[4] = id >> 8;
+        emuMac[5] = id;
+    }
+    else
+    {
+        return false;
+    }
+
+    ( *idx )++;
+    return true;
+}
+
+/**
+ * @return A pseudo-random number for the link model, xorshift32
+ */
+static uint32_t emuLinkRand( void )
+{
+    linkRandState ^= linkRandState << 13;
+    linkRandState ^= linkRandState >> 17;
+    linkRandState ^= linkRandState << 5;
+    return linkRandState;
+}
+
+/*============================================================================
+ * ESP-NOW functions
+ *==========================================================================*/
+
+/**
+ * Join the ESP-NOW multicast group on the loopback interface
+ */
+void ICACHE_FLASH_ATTR espNowInit(void)
+{
+    if( emuTraceReplaying() )
+    {
+        replayUp = true;
+        rxQueued = 0;
+        txQueued = 0;
+        initTimeUs = system_get_time();
+        return;
+    }
+
+#ifdef LINUX
+    if( sock >= 0 )
+    {
+        return;
+    }
+
+    uint8_t mac[6];
+    emuEspNowGetMac( mac );
+    linkRandState = ( ( mac[3] << 16 ) | ( mac[4] << 8 ) | mac[5] ) ^ 0x9E3779B9;
+
+    sock = socket( AF_INET, SOCK_DGRAM, 0 );
+    if( sock < 0 )
+    {
+        fprintf( stderr, "EMU Error: Could not open an ESP-NOW socket\n" );
+        return;
+    }
+
+    // Every emulator on the machine listens on the same port
+    int one = 1;
+    setsockopt( sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof( one ) );
+    setsockopt( sock, SOL_SOCKET, SO_REUSEPORT, &one, sizeof( one ) );
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl( INADDR_ANY );
+    addr.sin_port = htons( ESPNOW_PORT );
+
+    // Keep the frames on this machine, and hear our own so they can be ignored
+    struct ip_mreq mreq;
+    mreq.imr_multiaddr.s_addr = inet_addr( ESPNOW_GROUP );
+    mreq.imr_interface.s_addr = htonl( INADDR_LOOPBACK );
+    struct in_addr loopback = { .s_addr = htonl( INADDR_LOOPBACK ) };
+    uint8_t ttl = 0;
+    uint8_t loop = 1;
+
+    if( bind( sock, (struct sockaddr*)&addr, sizeof( addr ) ) < 0 ||
+            setsockopt( sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof( mreq ) ) < 0 ||
+            setsockopt( sock, IPPROTO_IP, IP_MULTICAST_IF, &loopback, sizeof( loopback ) ) < 0 ||
+            setsockopt( sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof( ttl ) ) < 0 ||
+            setsockopt( sock, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof( loop ) ) < 0 )
+    {
+        fprintf( stderr, "EMU Error: Could not join ESP-NOW multicast group %s:%d\n", ESPNOW_GROUP, ESPNOW_PORT );
+        close( sock );
+        sock = -1;
+        return;
+    }
+
+    rxQueued = 0;
+    txQueued = 0;
+    initTimeUs = system_get_time();
+#else
+    fprintf( stderr, "EMU Warning: ESP-NOW is only emulated on Linux\n" );
+#endif
+}
+
+/**
+ * Leave the ESP-NOW multicast group. Frames which haven't been delivered yet
+ * are dropped
+ */
+void ICACHE_FLASH_ATTR espNowDeinit(void)
+{
+#ifdef LINUX
+    if( sock >= 0 )
+    {
+        close( sock );
+        sock = -1;
+    }
+#endif
+    replayUp = false;
+    rxQueued = 0;
+    txQueued = 0;
+}
+
+/**
+ * Broadcast a frame to every other emulator. The send status is reported
+ * through swadgeModeEspNowSendCb() by emuEspNowPoll()
+ *
+ * @param data The data to broadcast
+ * @param len  The length of the data to broadcast
+ */
+void ICACHE_FLASH_ATTR espNowSend(const uint8_t* data, uint8_t len)
+{
+    mt_tx_status status = MT_TX_STATUS_FAILED;
+#ifdef LINUX
+    if( sock >= 0 && len <= ESPNOW_MAX_LEN )
+    {
+        emuEspNowFrame_t frame;
+        frame.magic = ESPNOW_MAGIC;
+        emuEspNowGetMac( frame.src );
+        memcpy( frame.dst, broadcastMac, sizeof( frame.dst ) );
+        frame.len = len;
+        memcpy( frame.data, data, len );
+
+        struct sockaddr_in addr = {0};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = inet_addr( ESPNOW_GROUP );
+        addr.sin_port = htons( ESPNOW_PORT );
+
+        size_t frameLen = offsetof( emuEspNowFrame_t, data ) + len;
+        if( (ssize_t)frameLen == sendto( sock, &frame, frameLen, 0, (struct sockaddr*)&addr, sizeof( addr ) ) )
+        {
+            status = MT_TX_STATUS_OK;
+            emuStats.espNowSent++;
+            emuStats.espNowSentBytes += len;
+        }
+    }
+#endif
+
+    // A replayed trace has the status the network gave
+    status = emuTraceEspNowSent( status );
+    if( replayUp && MT_TX_STATUS_OK == status )
+    {
+        emuStats.espNowSent++;
+        emuStats.espNowSentBytes += len;
+    }
+
+    if( txQueued < ESPNOW_TX_QUEUE_LEN )
+    {
+        txStatus[( txHead + txQueued ) % ESPNOW_TX_QUEUE_LEN] = status;
+        txQueued++;
+    }
+}
+
+/*============================================================================
+ * Delivery
+ *==========================================================================*/
+
+/**
+ * @brief Report the status of frames sent since the last poll
+ */
+static void emuEspNowReportSent( void )
+{
+    // Every frame is broadcast
+    while( txQueued > 0 )
+    {
+        mt_tx_status status = txStatus[txHead];
+        txHead = ( txHead + 1 ) % ESPNOW_TX_QUEUE_LEN;
+        txQueued--;
+
+        uint8_t dst[6];
+        memcpy( dst, broadcastMac, sizeof( dst ) );
+        swadgeModeEspNowSendCb( dst, status );
+    }
+}
+
+/**
+ * @brief Receive frames from other emulators and deliver the ones whose
+ * latency has passed, then report the status of frames sent since the last
+ * poll. Called every time the OS tasks are checked
+ */
+void emuEspNowPoll( void )
+{
+    // A replayed trace has the frames which were delivered
+    if( replayUp )
+    {
+        emuTraceReplayEspNow( initTimeUs );
+        emuEspNowReportSent();
+        return;
+    }
+
+#ifdef LINUX
+    if( sock < 0 )
+    {
+        return;
+    }
+
+    uint8_t mac[6];
+    emuEspNowGetMac( mac );
+    uint32_t nowUs = system_get_time();
+
+    // Drain the socket into the receive queue
+    emuEspNowFrame_t frame;
+    ssize_t got;
+    while( 0 < ( got = recv( sock, &frame, sizeof( frame ), MSG_DONTWAIT ) ) )
+    {
+        if( got < (ssize_t)offsetof( emuEspNowFrame_t, data ) || ESPNOW_MAGIC != frame.magic ||
+                got != (ssize_t)offsetof( emuEspNowFrame_t, data ) + frame.len )
+        {
+            continue;
+        }
+        // Ignore our own frames and frames for someone else
+        if( 0 == memcmp( frame.src, mac, sizeof( mac ) ) ||
+                ( 0 != memcmp( frame.dst, broadcastMac, sizeof( mac ) ) &&
+                  0 != memcmp( frame.dst, mac, sizeof( mac ) ) ) )
+        {
+            continue;
+        }
+
+        if( ( emuLinkRand() % 10000 ) < lossPct * 100 || rxQueued == ESPNOW_RX_QUEUE_LEN )
+        {
+            emuStats.espNowDropped++;
+            continue;
+        }
+
+        emuEspNowRx_t* rx = &rxQueue[rxQueued++];
+        rx->deliverAtUs = nowUs + latencyUs + ( jitterUs ? ( emuLinkRand() % ( jitterUs + 1 ) ) : 0 );
+        rx->frame = frame;
+    }
+
+    // Deliver due frames, earliest first. The queue is kept in the order the
+    // frames arrived, so frames due at the same time are delivered in that
+    // order, like they would be without latency. The mode may send or deinit
+    // from its callback, so check the queue every time
+    while( sock >= 0 && rxQueued > 0 )
+    {
+        uint8_t next = 0;
+        for( uint8_t i = 1; i < rxQueued; i++ )
+        {
+            if( (int32_t)( rxQueue[i].deliverAtUs - rxQueue[next].deliverAtUs ) < 0 )
+            {
+                next = i;
+            }
+        }
+        if( (int32_t)( rxQueue[next].deliverAtUs - nowUs ) > 0 )
+        {
+            break;
+        }
+
+        frame = rxQueue[next].frame;
+        rxQueued--;
+        memmove( &rxQueue[next], &rxQueue[next + 1], ( rxQueued - next ) * sizeof( rxQueue[0] ) );
+
+        if( 0 == emuStats.espNowReceived )
+        {
+            emuStats.espNowFirstRxUs = nowUs - initTimeUs;
+        }
+        emuStats.espNowReceived++;
+        emuStats.espNowReceivedBytes += frame.len;
+
+        int rssi = baseRssi + (int)( emuLinkRand() % ( 2 * ESPNOW_RSSI_WANDER + 1 ) ) - ESPNOW_RSSI_WANDER;
+        rssi = ( rssi < 1 ) ? 1 : ( ( rssi > 91 ) ? 91 : rssi );
+        emuTraceEspNowRecv( frame.src, frame.data, frame.len, rssi );
+        swadgeModeEspNowRecvCb( frame.src, frame.data, frame.len, rssi );
+    }
+#endif
+
+    emuEspNowReportSent();
+}
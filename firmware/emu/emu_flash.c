@@ -0,0 +1,357 @@
+// Emulated SPI flash, backed by flash.dat in the working directory
+//
+// The whole chip is kept in one image which is mapped into memory once, on
+// Linux, or loaded once and written back after every change elsewhere. Like
+// the real part, erasing a sector sets it to 0xFF and programming can only
+// clear bits, so writing to flash which wasn't erased ANDs the data in.
+//
+// Every erase, program and read is counted in emuStats and costs a modeled
+// amount of busy time, based on typical datasheet figures for the 25Q-series
+// parts on ESP8266 modules. With --flash-latency the caller is also stalled
+// for that long, so the effect of e.g. SaveSettings() on procTask() shows up.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "swadgemu.h"
+#include "spi_flash.h"
+#include "rawdraw/os_generic.h"
+
+#if !defined(WINDOWS) && !defined(ANDROID)
+    #define LINUX
+#endif
+
+#ifdef LINUX
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+#define EMU_FLASH_FILE "flash.dat"
+#define EMU_FLASH_SECTORS (EMU_FLASH_SIZE / SPI_FLASH_SEC_SIZE)
+#define EMU_FLASH_PAGE_SIZE 256
+
+/// Typical time to erase one 4KB sector
+#define EMU_FLASH_ERASE_US 45000
+/// Typical time to program one 256 byte page, or part of one
+#define EMU_FLASH_PAGE_PROGRAM_US 700
+/// Time to send a command and address before any data
+#define EMU_FLASH_CMD_NS 1000
+/// Time per byte read, with a 40MHz dual I/O bus
+#define EMU_FLASH_READ_NS_PER_BYTE 100
+
+bool emuFlashLatency = false;
+
+static uint8_t* flashMem = NULL;
+// Set when running from a copy which isn't backed by flash.dat
+static bool flashScratch = false;
+static uint32_t sectorErases[EMU_FLASH_SECTORS];
+
+/*============================================================================
+ * Backing file
+ *==========================================================================*/
+
+/**
+ * @brief Map or load flash.dat, creating it, or growing it to the size of the
+ * chip, if needed. New flash is erased, all 0xFF
+ *
+ * @return true if the flash is ready, false if it couldn't be opened
+ */
+static bool emuFlashOpen( void )
+{
+    if( NULL != flashMem )
+    {
+        return true;
+    }
+
+#ifdef LINUX
+    int fd = open( EMU_FLASH_FILE, O_RDWR | O_CREAT, 0644 );
+    struct stat st;
+    if( fd < 0 || fstat( fd, &st ) < 0 )
+    {
+        fprintf( stderr, "EMU Error: Could not open %s for reading/writing\n", EMU_FLASH_FILE );
+        if( fd >= 0 )
+        {
+            close( fd );
+        }
+        return false;
+    }
+
+    if( st.st_size != EMU_FLASH_SIZE && ftruncate( fd, EMU_FLASH_SIZE ) < 0 )
+    {
+        fprintf( stderr, "EMU Error: Could not resize %s\n", EMU_FLASH_FILE );
+        close( fd );
+        return false;
+    }
+
+    void* mapped = mmap( NULL, EMU_FLASH_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    // The mapping keeps the file open
+    close( fd );
+    if( MAP_FAILED == mapped )
+    {
+        fprintf( stderr, "EMU Error: Could not map %s\n", EMU_FLASH_FILE );
+        return false;
+    }
+    flashMem = mapped;
+
+    // ftruncate() grows the file with zeros, erase them instead
+    if( st.st_size < EMU_FLASH_SIZE )
+    {
+        memset( &flashMem[st.st_size], 0xFF, EMU_FLASH_SIZE - st.st_size );
+    }
+#else
+    flashMem = malloc( EMU_FLASH_SIZE );
+    memset( flashMem, 0xFF, EMU_FLASH_SIZE );
+    FILE* f = fopen( EMU_FLASH_FILE, "rb" );
+    if( f )
+    {
+        size_t loaded = fread( flashMem, 1, EMU_FLASH_SIZE, f );
+        fclose( f );
+        if( EMU_FLASH_SIZE == loaded )
+        {
+            return true;
+        }
+    }
+
+    // Create the file, or fill out a short one
+    f = fopen( EMU_FLASH_FILE, "wb" );
+    if( !f || 1 != fwrite( flashMem, EMU_FLASH_SIZE, 1, f ) )
+    {
+        fprintf( stderr, "EMU Error: Could not open %s for reading/writing\n", EMU_FLASH_FILE );
+    }
+    if( f )
+    {
+        fclose( f );
+    }
+#endif
+    return true;
+}
+
+/**
+ * @brief Make sure a changed range of flash ends up in flash.dat. This only
+ * has to do something when the file isn't mapped
+ *
+ * @param addr The address of the first changed byte
+ * @param size The number of bytes changed
+ */
+static void emuFlashSync( uint32_t addr, uint32_t size )
+{
+#ifndef LINUX
+    if( flashScratch )
+    {
+        return;
+    }
+    FILE* f = fopen( EMU_FLASH_FILE, "rb+" );
+    if( !f )
+    {
+        fprintf( stderr, "EMU Error: Could not open %s for reading/writing\n", EMU_FLASH_FILE );
+        return;
+    }
+    fseek( f, addr, SEEK_SET );
+    fwrite( &flashMem[addr], size, 1, f );
+    fclose( f );
+#endif
+}
+
+/**
+ * @brief Account for the time a flash operation keeps the chip busy, and with
+ * --flash-latency, stall the caller for that long
+ *
+ * @param ns The modeled busy time, in nanoseconds
+ */
+static void emuFlashBusy( uint64_t ns )
+{
+    emuStats.flashBusyNs += ns;
+    if( ns > emuStats.flashLongestNs )
+    {
+        emuStats.flashLongestNs = ns;
+    }
+    // The CPU can't run from flash while it's busy
+    emuCostAddNs( ns );
+
+    if( emuFlashLatency )
+    {
+#ifdef EMU_HEADLESS
+        emuVirtualTimeUs += ns / 1000;
+#else
+        OGUSleep( ns / 1000 );
+#endif
+    }
+}
+
+/**
+ * @brief Check that an access is inside the chip and 4 byte aligned, which
+ * the SDK requires
+ *
+ * @param op   The name of the operation, for the error message
+ * @param addr The flash address
+ * @param size The number of bytes
+ * @return true if the access is OK, false if it isn't
+ */
+static bool emuFlashCheck( const char* op, uint32_t addr, uint32_t size )
+{
+    if( addr >= EMU_FLASH_SIZE || size > EMU_FLASH_SIZE - addr )
+    {
+        fprintf( stderr, "EMU Error: %s of %u bytes at 0x%X is past the end of flash\n", op, size, addr );
+        return false;
+    }
+    if( ( addr | size ) & 3 )
+    {
+        fprintf( stderr, "EMU Error: %s of %u bytes at 0x%X isn't 4 byte aligned\n", op, size, addr );
+        return false;
+    }
+    return emuFlashOpen();
+}
+
+/*============================================================================
+ * SDK functions
+ *==========================================================================*/
+
+/**
+ * @brief Erase a 4KB sector of flash, setting every byte to 0xFF
+ *
+ * @param sec The sector number
+ * @return SPI_FLASH_RESULT_OK, or SPI_FLASH_RESULT_ERR if the sector doesn't exist
+ */
+SpiFlashOpResult spi_flash_erase_sector( uint16 sec )
+{
+    if( !emuFlashCheck( "Erase", sec * SPI_FLASH_SEC_SIZE, SPI_FLASH_SEC_SIZE ) )
+    {
+        return SPI_FLASH_RESULT_ERR;
+    }
+
+    memset( &flashMem[sec * SPI_FLASH_SEC_SIZE], 0xFF, SPI_FLASH_SEC_SIZE );
+    emuFlashSync( sec * SPI_FLASH_SEC_SIZE, SPI_FLASH_SEC_SIZE );
+
+    sectorErases[sec]++;
+    emuStats.flashErases++;
+    emuFlashBusy( EMU_FLASH_CMD_NS + EMU_FLASH_ERASE_US * 1000ULL );
+    return SPI_FLASH_RESULT_OK;
+}
+
+/**
+ * @brief Program flash. Programming can only clear bits, so writing over
+ * flash which isn't erased ANDs the data in, like the real part
+ *
+ * @param des_addr The flash address to write to, 4 byte aligned
+ * @param src_addr The data to write
+ * @param size     The number of bytes to write, a multiple of 4
+ * @return SPI_FLASH_RESULT_OK, or SPI_FLASH_RESULT_ERR for a bad address or size
+ */
+SpiFlashOpResult spi_flash_write( uint32 des_addr, uint32* src_addr, uint32 size )
+{
+    if( !emuFlashCheck( "Write", des_addr, size ) )
+    {
+        return SPI_FLASH_RESULT_ERR;
+    }
+
+    const uint8_t* src = (const uint8_t*)src_addr;
+    uint8_t* dst = &flashMem[des_addr];
+    bool unerased = false;
+    for( uint32_t i = 0; i < size; i++ )
+    {
+        // Setting a bit which is clear needs an erase first
+        if( src[i] & ~dst[i] )
+        {
+            unerased = true;
+        }
+        dst[i] &= src[i];
+    }
+    emuFlashSync( des_addr, size );
+
+    if( unerased )
+    {
+        emuStats.flashUnerasedWrites++;
+    }
+    emuStats.flashWrites++;
+    emuStats.flashWriteBytes += size;
+
+    // Each page, or part of one, is programmed separately
+    uint32_t pages = 0;
+    if( size > 0 )
+    {
+        pages = ( des_addr + size - 1 ) / EMU_FLASH_PAGE_SIZE - des_addr / EMU_FLASH_PAGE_SIZE + 1;
+    }
+    emuFlashBusy( pages * ( EMU_FLASH_CMD_NS + EMU_FLASH_PAGE_PROGRAM_US * 1000ULL ) );
+    return SPI_FLASH_RESULT_OK;
+}
+
+/**
+ * @brief Read flash
+ *
+ * @param src_addr The flash address to read from, 4 byte aligned
+ * @param des_addr Where to read to
+ * @param size     The number of bytes to read, a multiple of 4
+ * @return SPI_FLASH_RESULT_OK, or SPI_FLASH_RESULT_ERR for a bad address or size
+ */
+SpiFlashOpResult spi_flash_read( uint32 src_addr, uint32* des_addr, uint32 size )
+{
+    if( !emuFlashCheck( "Read", src_addr, size ) )
+    {
+        return SPI_FLASH_RESULT_ERR;
+    }
+
+    memcpy( des_addr, &flashMem[src_addr], size );
+
+    emuStats.flashReads++;
+    emuStats.flashReadBytes += size;
+    emuFlashBusy( EMU_FLASH_CMD_NS + (uint64_t)size * EMU_FLASH_READ_NS_PER_BYTE );
+    return SPI_FLASH_RESULT_OK;
+}
+
+/*============================================================================
+ * Wear
+ *==========================================================================*/
+
+/**
+ * @brief Get the whole flash image, for recording the flash a trace starts
+ * from
+ *
+ * @return The image, EMU_FLASH_SIZE bytes, or NULL if flash.dat couldn't be
+ *         opened
+ */
+const uint8_t* emuFlashImage( void )
+{
+    return emuFlashOpen() ? flashMem : NULL;
+}
+
+/**
+ * @brief Run from an erased copy of flash instead of flash.dat, which is then
+ * never read or written. For replaying a trace from the flash it was recorded
+ * with. Must be called before anything uses the flash
+ *
+ * @return The image, EMU_FLASH_SIZE bytes, to be filled in by the caller
+ */
+uint8_t* emuFlashScratch( void )
+{
+    if( !flashScratch )
+    {
+        flashMem = malloc( EMU_FLASH_SIZE );
+        flashScratch = true;
+    }
+    memset( flashMem, 0xFF, EMU_FLASH_SIZE );
+    return flashMem;
+}
+
+/**
+ * @brief Find the sector which has been erased the most since the emulator
+ * started
+ *
+ * @param sector Returns the sector number
+ * @return The number of times it was erased, 0 if nothing was
+ */
+uint32_t emuFlashMostErased( uint16_t* sector )
+{
+    uint32_t most = 0;
+    *sector = 0;
+    for( uint16_t i = 0; i < EMU_FLASH_SECTORS; i++ )
+    {
+        if( sectorErases[i] > most )
+        {
+            most = sectorErases[i];
+            *sector = i;
+        }
+    }
+    return most;
+}
@@ -0,0 +1,475 @@
+// Headless, fast-forward emulator, built with `make headless`
+//
+// There is no window and no sound. system_get_time() and the ets timers run
+// from a virtual clock which is advanced one millisecond at a time, as fast as
+// the host allows, so a 30 second game takes as long as its code takes to run.
+// Button presses come from a script file and the frames sent to the OLED can
+// be written out as PBM images.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include "swadgemu.h"
+
+#include "../user/user_main.h"
+#include "../user/hdw/buttons.h"
+#include "../user/utils/assets.h"
+
+#define HEADLESS_DEFAULT_DURATION_MS 10000
+#define HEADLESS_PRESS_MS 50
+
+typedef struct
+{
+    uint32_t timeMs;
+    uint32_t seq;  ///< The order it was read from the script in
+    int8_t button; ///< -1 to stop the emulator
+    bool down;
+} emuInputEvent_t;
+
+uint64_t emuVirtualTimeUs = 0;
+
+static const char* dumpDir = NULL;
+static uint32_t framesDumped = 0;
+
+void HandleButtonStatus( int button, int bDown );
+void system_os_check_tasks( void );
+void ets_timer_check_timers( void );
+void user_init( void );
+
+/*============================================================================
+ * Input scripts
+ *==========================================================================*/
+
+/**
+ * @brief Parse a button name or number
+ *
+ * @param name The name, left, down, right, up or action, or the button number
+ * @return The button number, or -1 if it isn't a button
+ */
+static int8_t emuParseButton( const char* name )
+{
+    static const char* buttonNames[] = { "left", "down", "right", "up", "action" };
+    for( int8_t i = 0; i < (int8_t)( sizeof( buttonNames ) / sizeof( buttonNames[0] ) ); i++ )
+    {
+        if( 0 == strcasecmp( name, buttonNames[i] ) )
+        {
+            return i;
+        }
+    }
+
+    char* end;
+    long button = strtol( name, &end, 10 );
+    if( end != name && '\0' == *end && button >= LEFT && button <= ACTION )
+    {
+        return button;
+    }
+    return -1;
+}
+
+static int emuCompareEvents( const void* a, const void* b )
+{
+    const emuInputEvent_t* ea = a;
+    const emuInputEvent_t* eb = b;
+    if( ea->timeMs != eb->timeMs )
+    {
+        return ( ea->timeMs < eb->timeMs ) ? -1 : 1;
+    }
+    // Keep the file order for events at the same time
+    return ( ea->seq < eb->seq ) ? -1 : ( ( ea->seq > eb->seq ) ? 1 : 0 );
+}
+
+/**
+ * @brief Load a script of button events. Each line is a time in milliseconds
+ * since boot, a button, and a state:
+ *
+ *     # Start the second menu item
+ *     1000 right press
+ *     1500 action down
+ *     1550 action up
+ *     30000 quit
+ *
+ * Buttons are left, down, right, up, action or 0-4. States are down, up, or
+ * press, which is a down then an up HEADLESS_PRESS_MS later. quit stops the
+ * emulator. Blank lines and lines starting with '#' are ignored.
+ *
+ * @param fname The script to load
+ * @param eventsOut Returns the events, sorted by time. Free with free()
+ * @param numEvents Returns the number of events loaded
+ * @return true if the script was loaded, false on error
+ */
+static bool emuLoadInputScript( const char* fname, emuInputEvent_t** eventsOut, uint32_t* numEvents )
+{
+    FILE* f = fopen( fname, "r" );
+    if( !f )
+    {
+        fprintf( stderr, "EMU Error: Could not open input script %s\n", fname );
+        return false;
+    }
+
+    emuInputEvent_t* events = NULL;
+    uint32_t allocated = 0;
+    *numEvents = 0;
+
+    char line[128];
+    uint32_t lineNum = 0;
+    while( fgets( line, sizeof( line ), f ) )
+    {
+        lineNum++;
+        char* hash = strchr( line, '#' );
+        if( hash )
+        {
+            *hash = '\0';
+        }
+
+        unsigned int timeMs;
+        char button[16];
+        char state[16] = "press";
+        int fields = sscanf( line, "%u %15s %15s", &timeMs, button, state );
+        if( fields <= 0 )
+        {
+            continue;
+        }
+
+        emuInputEvent_t event = { .timeMs = timeMs };
+        bool isPress = false;
+        if( 2 <= fields && 0 == strcasecmp( button, "quit" ) )
+        {
+            event.button = -1;
+        }
+        else if( 2 <= fields && 0 <= ( event.button = emuParseButton( button ) ) )
+        {
+            if( 0 == strcasecmp( state, "down" ) )
+            {
+                event.down = true;
+            }
+            else if( 0 == strcasecmp( state, "press" ) )
+            {
+                event.down = true;
+                isPress = true;
+            }
+            else if( 0 != strcasecmp( state, "up" ) )
+            {
+                fields = 0;
+            }
+        }
+        else
+        {
+            fields = 0;
+        }
+
+        if( 0 == fields )
+        {
+            fprintf( stderr, "EMU Error: %s:%u: expected \"<ms> <button> [down|up|press]\" or \"<ms> quit\"\n",
+                     fname, lineNum );
+            free( events );
+            fclose( f );
+            return false;
+        }
+
+        // Make room for a press's release too
+        if( *numEvents + 2 > allocated )
+        {
+            allocated = allocated ? allocated * 2 : 64;
+            emuInputEvent_t* grown = realloc( events, allocated * sizeof( emuInputEvent_t ) );
+            if( NULL == grown )
+            {
+                fprintf( stderr, "EMU Error: Out of memory loading input script %s\n", fname );
+                free( events );
+                fclose( f );
+                return false;
+            }
+            events = grown;
+        }
+        event.seq = *numEvents;
+        events[( *numEvents )++] = event;
+        if( isPress )
+        {
+            event.timeMs += HEADLESS_PRESS_MS;
+            event.seq = *numEvents;
+            event.down = false;
+            events[( *numEvents )++] = event;
+        }
+    }
+    fclose( f );
+
+    if( *numEvents )
+    {
+        qsort( events, *numEvents, sizeof( emuInputEvent_t ), emuCompareEvents );
+    }
+    *eventsOut = events;
+    return true;
+}
+
+/*============================================================================
+ * Framebuffer dumps
+ *==========================================================================*/
+
+/**
+ * @brief Called whenever a frame is sent to the OLED. If dumping is enabled,
+ * write the frame as a PBM image named for its number and the virtual time,
+ * in milliseconds, it was sent
+ *
+ * @param fb The column-major framebuffer which was sent
+ */
+void emuHeadlessFrame( const uint8_t* fb )
+{
+    if( NULL == dumpDir )
+    {
+        return;
+    }
+
+    char fname[512];
+    snprintf( fname, sizeof( fname ), "%s/frame_%06u_%08ums.pbm", dumpDir, framesDumped,
+              (unsigned)( emuVirtualTimeUs / 1000 ) );
+    FILE* f = fopen( fname, "wb" );
+    if( !f )
+    {
+        fprintf( stderr, "EMU Error: Could not write %s, not dumping frames\n", fname );
+        dumpDir = NULL;
+        return;
+    }
+
+    // PBM is row-major, MSB first, 1 is black. The OLED is lit where bits are set
+    fprintf( f, "P4\n%d %d\n", OLED_WIDTH, OLED_HEIGHT );
+    for( int y = 0; y < OLED_HEIGHT; y++ )
+    {
+        uint8_t row[OLED_WIDTH / 8] = {0};
+        for( int x = 0; x < OLED_WIDTH; x++ )
+        {
+            if( !( fb[( x * OLED_HEIGHT + y ) / 8] & ( 1 << ( y & 7 ) ) ) )
+            {
+                row[x / 8] |= 0x80 >> ( x & 7 );
+            }
+        }
+        fwrite( row, sizeof( row ), 1, f );
+    }
+    fclose( f );
+    framesDumped++;
+}
+
+/*============================================================================
+ * Main loop
+ *==========================================================================*/
+
+/**
+ * @brief Find a swadge mode by index or by name
+ *
+ * @param arg The mode's index, or its name, ignoring case
+ * @return The mode's index, or -1 if there is no such mode
+ */
+static int emuFindMode( const char* arg )
+{
+    swadgeMode** modes;
+    uint8_t numModes = getSwadgeModes( &modes );
+
+    char* end;
+    long idx = strtol( arg, &end, 10 );
+    if( end != arg && '\0' == *end && idx >= 0 && idx < numModes )
+    {
+        return idx;
+    }
+
+    for( uint8_t i = 0; i < numModes; i++ )
+    {
+        if( NULL != modes[i]->modeName && 0 == strcasecmp( arg, modes[i]->modeName ) )
+        {
+            return i;
+        }
+    }
+
+    fprintf( stderr, "EMU Error: No swadge mode \"%s\", choose one of:\n", arg );
+    for( uint8_t i = 0; i < numModes; i++ )
+    {
+        fprintf( stderr, "  %d: %s\n", i, ( NULL != modes[i]->modeName ) ? modes[i]->modeName : "No Name" );
+    }
+    return -1;
+}
+
+static void emuHeadlessUsage( const char* argv0 )
+{
+    fprintf( stderr, "Usage: %s [--mode N] [--input SCRIPT] [--duration MS] [--dump DIR] [--seed N] [--flash-latency]\n"
+             "       [--realtime] [--espnow-loss PCT] [--espnow-latency MS] [--espnow-jitter MS]\n"
+             "       [--espnow-rssi N] [--espnow-id N] [--cpu-mhz N] [--i2c-khz N] [--cost-weight NAME=CYCLES]\n"
+             "       [--heap-limit BYTES] [--heap-enforce] [--mic-rate N] [--mic FILE] [--mic-loop]\n"
+             "       [--record FILE] [--replay FILE] [--frame-log FILE]\n", argv0 );
+    fprintf( stderr, "  --mode N        Switch to swadge mode N, an index or a name, after boot\n" );
+    fprintf( stderr, "  --input SCRIPT  Read button events from SCRIPT, see emu/README.md\n" );
+    fprintf( stderr, "  --duration MS   Stop after MS milliseconds of virtual time (default %d)\n",
+             HEADLESS_DEFAULT_DURATION_MS );
+    fprintf( stderr, "  --dump DIR      Write every frame sent to the OLED to DIR as PBM\n" );
+    fprintf( stderr, "  --seed N        Seed for rand(), so runs are repeatable (default 0)\n" );
+    fprintf( stderr, "  --flash-latency Advance the clock by the modeled time of each SPI flash operation\n" );
+    fprintf( stderr, "  --realtime      Don't let the virtual clock run ahead of the host's, for ESP-NOW\n" );
+    fprintf( stderr, "                  between emulators\n" );
+    fprintf( stderr, "  --espnow-*      ESP-NOW link options, see emu/README.md\n" );
+    fprintf( stderr, "  --cpu-mhz, --i2c-khz, --cost-weight\n" );
+    fprintf( stderr, "                  Hardware cost model options, see emu/README.md\n" );
+    fprintf( stderr, "  --heap-limit BYTES\n" );
+    fprintf( stderr, "                  The device heap available to modes (default 40960)\n" );
+    fprintf( stderr, "  --heap-enforce  Fail allocations which wouldn't fit in the device heap\n" );
+    fprintf( stderr, "  --mic FILE      Replay a WAV, or raw signed 16 bit mono PCM, file through the mic\n" );
+    fprintf( stderr, "  --mic-rate N    The sample rate of a raw file, before --mic (default %d)\n", DFREQ );
+    fprintf( stderr, "  --mic-loop      Start the recording again when it ends\n" );
+    fprintf( stderr, "  --record FILE   Record buttons, mic, accelerometer and ESP-NOW to a trace\n" );
+    fprintf( stderr, "  --replay FILE   Replay a trace, with its seed, mode and duration unless given\n" );
+    fprintf( stderr, "  --frame-log FILE\n" );
+    fprintf( stderr, "                  Write the time, estimated cost and hash of every frame to FILE\n" );
+}
+
+/**
+ * @brief Run the firmware without a window, as fast as possible, on a
+ * virtual clock
+ *
+ * @param argc The argument count from main()
+ * @param argv The arguments from main()
+ * @return 0 on success, 1 on bad arguments or input
+ */
+int emuRunHeadless( int argc, char** argv )
+{
+    const char* modeArg = NULL;
+    const char* inputFile = NULL;
+    uint32_t durationMs = HEADLESS_DEFAULT_DURATION_MS;
+    bool durationSet = false;
+    unsigned int seed = 0;
+    bool realtime = false;
+
+    for( int i = 1; i < argc; i++ )
+    {
+        bool hasValue = ( i + 1 < argc );
+        if( hasValue && 0 == strcmp( argv[i], "--mode" ) )
+        {
+            modeArg = argv[++i];
+        }
+        else if( hasValue && 0 == strcmp( argv[i], "--input" ) )
+        {
+            inputFile = argv[++i];
+        }
+        else if( hasValue && 0 == strcmp( argv[i], "--duration" ) )
+        {
+            durationMs = strtoul( argv[++i], NULL, 10 );
+            durationSet = true;
+        }
+        else if( hasValue && 0 == strcmp( argv[i], "--dump" ) )
+        {
+            dumpDir = argv[++i];
+        }
+        else if( hasValue && 0 == strcmp( argv[i], "--seed" ) )
+        {
+            seed = strtoul( argv[++i], NULL, 10 );
+        }
+        else if( 0 == strcmp( argv[i], "--flash-latency" ) )
+        {
+            emuFlashLatency = true;
+        }
+        else if( 0 == strcmp( argv[i], "--realtime" ) )
+        {
+            realtime = true;
+        }
+        else if( !emuEspNowParseArg( argc, argv, &i ) && !emuCostParseArg( argc, argv, &i ) &&
+                 !emuHeapParseArg( argc, argv, &i ) && !emuMicParseArg( argc, argv, &i ) &&
+                 !emuTraceParseArg( argc, argv, &i ) )
+        {
+            emuHeadlessUsage( argv[0] );
+            return 1;
+        }
+    }
+
+    // A trace brings its own mode and input, and stops where recording did
+    int32_t mode = -1;
+    if( emuTraceReplaying() )
+    {
+        if( NULL != inputFile )
+        {
+            fprintf( stderr, "EMU Error: --input can't be used with --replay\n" );
+            return 1;
+        }
+        uint32_t endMs;
+        emuTraceReplayInfo( &mode, &endMs );
+        if( !durationSet )
+        {
+            durationMs = endMs;
+        }
+    }
+    if( NULL != modeArg )
+    {
+        mode = emuFindMode( modeArg );
+        if( mode < 0 )
+        {
+            return 1;
+        }
+    }
+
+    emuInputEvent_t* events = NULL;
+    uint32_t numEvents = 0;
+    if( NULL != inputFile )
+    {
+        if( !emuLoadInputScript( inputFile, &events, &numEvents ) )
+        {
+            return 1;
+        }
+        // A script which quits runs until it quits
+        for( uint32_t i = 0; i < numEvents && !durationSet; i++ )
+        {
+            if( events[i].button < 0 )
+            {
+                durationMs = UINT32_MAX;
+            }
+        }
+    }
+
+    emuVirtualTimeUs = 0;
+    emuTraceBegin( seed, mode );
+    double hostStart = emuGetPerfTime();
+
+    initOLED( 0 );
+    user_init();
+    if( mode >= 0 )
+    {
+        switchToSwadgeMode( mode );
+    }
+
+    uint32_t nextEvent = 0;
+    bool quit = false;
+    while( !quit && emuVirtualTimeUs < (uint64_t)durationMs * 1000 )
+    {
+        // Apply the script's, or the trace's, button events for this millisecond
+        emuTraceReplayButtons();
+        while( nextEvent < numEvents && (uint64_t)events[nextEvent].timeMs * 1000 <= emuVirtualTimeUs )
+        {
+            if( events[nextEvent].button < 0 )
+            {
+                quit = true;
+                break;
+            }
+            HandleButtonStatus( events[nextEvent].button, events[nextEvent].down );
+            nextEvent++;
+        }
+
+        ets_timer_check_timers();
+        system_os_check_tasks();
+
+        emuVirtualTimeUs += 1000;
+
+        // Wait for the host to catch up, a millisecond at a time
+        if( realtime )
+        {
+            double ahead = emuVirtualTimeUs / 1000000.0 - ( emuGetPerfTime() - hostStart );
+            if( ahead > 0 )
+            {
+                usleep( ahead * 1000000 );
+            }
+        }
+    }
+
+    exitCurrentSwadgeMode();
+    freeAssets();
+    free( events );
+
+    double hostTime = emuGetPerfTime() - hostStart;
+    double virtualTime = emuVirtualTimeUs / 1000000.0;
+    printf( "EMU Headless: %.3f s emulated in %.3f s (x%.1f realtime), %u frames dumped\n",
+            virtualTime, hostTime, ( hostTime > 0 ) ? ( virtualTime / hostTime ) : 0.0, framesDumped );
+    return 0;
+}
@@ -0,0 +1,251 @@
+// Emulated heap, os_malloc() and friends with the ESP8266's limits
+//
+// Allocations still come from libc, but each one is charged what it would
+// take from the swadge's heap: the SDK's allocator hands out 8 byte blocks
+// with a 4 byte header. The total is held against a device heap limit, about
+// what is left after the SDK starts up by default, and drives
+// system_get_free_heap_size(), so heap checks in the firmware see the same
+// numbers as they would on hardware.
+//
+// An allocation which wouldn't fit on hardware is reported, and with
+// --heap-enforce it fails like it would on hardware, so a mode's handling of
+// os_malloc() returning NULL can be tested. Structures with pointers are
+// bigger on a 64 bit host, so the emulator overestimates a little there.
+//
+// Each mode's allocations, peak use and allocations per frame are printed
+// with the rest of emuReportModeStats()
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "swadgemu.h"
+
+/// Roughly the free heap after the SDK starts, with wifi running
+#define EMU_HEAP_DEFAULT_LIMIT (40 * 1024)
+/// The SDK allocator's block size
+#define EMU_HEAP_BLOCK 8
+/// The SDK allocator's header in each allocation
+#define EMU_HEAP_HEADER 4
+/// How many allocations which wouldn't fit to describe per mode
+#define EMU_HEAP_MAX_REPORTED 5
+
+/// Kept in front of every allocation, to find its size when it's freed. The
+/// size keeps the allocation aligned for anything
+typedef struct
+{
+    uint32_t deviceBytes;
+    uint32_t magic;
+    uint64_t pad;
+} emuHeapHeader_t;
+
+#define EMU_HEAP_MAGIC 0x48454150 // "HEAP"
+
+static bool heapEnforce = false;
+static uint32_t heapLimit = EMU_HEAP_DEFAULT_LIMIT;
+static uint32_t heapUsed = 0;
+static uint32_t frameAllocs = 0;
+static uint32_t reported = 0;
+
+/*============================================================================
+ * Configuration
+ *==========================================================================*/
+
+/**
+ * @brief Parse a heap command line option, if this is one
+ *
+ *     --heap-limit BYTES  The device heap available to modes (default 40KB)
+ *     --heap-enforce      Fail allocations which wouldn't fit on hardware
+ *
+ * @param argc The argument count from main()
+ * @param argv The arguments from main()
+ * @param idx  The index of the argument to parse. If the option takes a value,
+ *             this is advanced past it
+ * @return true if this was a heap option, false if it wasn't
+ */
+bool emuHeapParseArg( int argc, char** argv, int* idx )
+{
+    if( 0 == strcmp( argv[*idx], "--heap-enforce" ) )
+    {
+        heapEnforce = true;
+        return true;
+    }
+    else if( *idx + 1 < argc && 0 == strcmp( argv[*idx], "--heap-limit" ) )
+    {
+        heapLimit = strtoul( argv[++( *idx )], NULL, 0 );
+        return true;
+    }
+    return false;
+}
+
+/*============================================================================
+ * Allocation
+ *==========================================================================*/
+
+/**
+ * @brief Allocate memory, charging the device heap for it
+ *
+ * @param size The number of bytes to allocate
+ * @return The memory, or NULL if the host is out or the device would be
+ */
+static void* emuHeapAlloc( int size )
+{
+    if( size < 0 )
+    {
+        return NULL;
+    }
+
+    uint32_t deviceBytes = ( ( size + EMU_HEAP_HEADER + EMU_HEAP_BLOCK - 1 ) / EMU_HEAP_BLOCK ) * EMU_HEAP_BLOCK;
+    emuStats.heapAllocs++;
+    frameAllocs++;
+
+    if( heapUsed + deviceBytes > heapLimit )
+    {
+        emuStats.heapOverLimit++;
+        if( 1 == emuStats.heapOverLimit )
+        {
+            reported = 0;
+        }
+        if( reported < EMU_HEAP_MAX_REPORTED )
+        {
+            reported++;
+            fprintf( stderr, "EMU Heap: os_malloc(%d) %s, %u of %u bytes in use\n", size,
+                     heapEnforce ? "failed" : "would fail on hardware", heapUsed, heapLimit );
+        }
+        if( heapEnforce )
+        {
+            return NULL;
+        }
+    }
+
+    emuHeapHeader_t* hdr = malloc( sizeof( emuHeapHeader_t ) + size );
+    if( NULL == hdr )
+    {
+        return NULL;
+    }
+    hdr->deviceBytes = deviceBytes;
+    hdr->magic = EMU_HEAP_MAGIC;
+
+    heapUsed += deviceBytes;
+    if( heapUsed > emuStats.heapPeak )
+    {
+        emuStats.heapPeak = heapUsed;
+    }
+    return &hdr[1];
+}
+
+/**
+ * @brief Allocate memory, filled with garbage like the ESP's
+ *
+ * @param x The number of bytes to allocate
+ * @return The memory, or NULL if there isn't enough
+ */
+void* os_malloc( int x )
+{
+    // Allocate some space
+    void* ptr = emuHeapAlloc( x );
+    // Fill the pointer with garbage, ESP-style
+    if(NULL != ptr)
+    {
+        for( int i = 0; i < x; i++ )
+        {
+            ((uint8_t*)ptr)[i] = rand() & 0xff;
+        }
+    }
+    // Return the space
+    return ptr;
+}
+
+/**
+ * @brief Allocate zeroed memory
+ *
+ * @param x The number of bytes to allocate
+ * @return The memory, or NULL if there isn't enough
+ */
+void* os_zalloc( int x )
+{
+    void* ptr = emuHeapAlloc( x );
+    if(NULL != ptr)
+    {
+        memset(ptr, 0, x);
+    }
+    return ptr;
+}
+
+/**
+ * @brief Free memory from os_malloc() or os_zalloc(). Freeing NULL does nothing
+ *
+ * @param x The memory to free
+ */
+void os_free( void* x )
+{
+    if( NULL == x )
+    {
+        return;
+    }
+
+    emuHeapHeader_t* hdr = &( (emuHeapHeader_t*)x )[-1];
+    if( EMU_HEAP_MAGIC != hdr->magic )
+    {
+        fprintf( stderr, "EMU Error: os_free(%p) wasn't allocated by os_malloc(), or was freed twice\n", x );
+        abort();
+    }
+    hdr->magic = 0;
+    heapUsed -= hdr->deviceBytes;
+    emuStats.heapFrees++;
+    free( hdr );
+}
+
+/**
+ * @return The bytes left on the device heap
+ */
+uint32 system_get_free_heap_size( void )
+{
+    return ( heapUsed < heapLimit ) ? ( heapLimit - heapUsed ) : 0;
+}
+
+/*============================================================================
+ * Frames
+ *==========================================================================*/
+
+/**
+ * @brief Count the allocations made since the last frame. Called by procTask()
+ * after each frame is sent to the OLED, through emuEndFrame()
+ */
+void emuHeapEndFrame( void )
+{
+    // The first frame also has the mode's setup
+    if( 0 == emuStats.heapFrames )
+    {
+        emuStats.heapEntryAllocs = frameAllocs;
+    }
+    else
+    {
+        emuStats.heapFrameAllocs += frameAllocs;
+        if( frameAllocs > emuStats.heapFrameAllocsMax )
+        {
+            emuStats.heapFrameAllocsMax = frameAllocs;
+        }
+    }
+    emuStats.heapFrames++;
+    frameAllocs = 0;
+}
+
+/**
+ * @brief Print this mode's heap use and restart the per-frame count. Called by
+ * emuReportModeStats(), which clears the other counts afterwards
+ */
+void emuHeapReport( void )
+{
+    // The peak can't be less than what's in use, even if nothing was allocated
+    uint32_t peak = ( emuStats.heapPeak > heapUsed ) ? emuStats.heapPeak : heapUsed;
+    printf( "  Heap: %u allocations, %u frees, %u of %u bytes in use, peak %u, %u wouldn't fit\n",
+            emuStats.heapAllocs, emuStats.heapFrees, heapUsed, heapLimit, peak, emuStats.heapOverLimit );
+    if( emuStats.heapFrames > 1 )
+    {
+        printf( "  Heap: %u allocations by the first frame, then %.2f/frame, at most %u\n",
+                emuStats.heapEntryAllocs, (double)emuStats.heapFrameAllocs / ( emuStats.heapFrames - 1 ),
+                emuStats.heapFrameAllocsMax );
+    }
+    // The next mode starts counting from its own setup
+    frameAllocs = 0;
+}
@@ -0,0 +1,347 @@
+// Microphone replay from a WAV or raw PCM file
+//
+// The emulator's mic is normally fed by the host's sound card, which makes
+// audio modes impossible to test or benchmark repeatably. With --mic FILE the
+// recording is converted to DFREQ once, when it's loaded, and then fed to
+// getSample() at exactly DFREQ samples per second of system_get_time(). In the
+// headless build that is the virtual clock, so every run of a recording
+// gives the same samples at the same times, and the same output.
+//
+// Replay starts from the beginning each time initMic() is called, when a mode
+// which listens to the mic starts, and stops at the end of the recording,
+// unless --mic-loop is given.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "swadgemu.h"
+#include "user_interface.h"
+
+#define WAV_FORMAT_PCM 1
+#define WAV_FORMAT_FLOAT 3
+#define WAV_FORMAT_EXTENSIBLE 0xFFFE
+
+static int16_t* micData = NULL;
+static uint32_t micLen = 0;
+static uint32_t rawRate = DFREQ;
+static bool micLoop = false;
+
+static bool micOn = false;
+static bool micStarted = false;
+static uint32_t micStartUs = 0;
+static uint64_t micFed = 0;
+
+/*============================================================================
+ * Loading
+ *==========================================================================*/
+
+/**
+ * @brief Read a little endian integer
+ *
+ * @param p     The bytes
+ * @param bytes How many bytes, 1 to 4
+ * @return The integer
+ */
+static uint32_t emuMicLe( const uint8_t* p, int bytes )
+{
+    uint32_t v = 0;
+    for( int i = bytes - 1; i >= 0; i-- )
+    {
+        v = ( v << 8 ) | p[i];
+    }
+    return v;
+}
+
+/**
+ * @brief Convert one sample of a WAV file to 16 bits
+ *
+ * @param p      The sample
+ * @param bits   The bits per sample, 8, 16, 24 or 32
+ * @param format WAV_FORMAT_PCM or WAV_FORMAT_FLOAT
+ * @return The sample, as a signed 16 bit value
+ */
+static int32_t emuMicWavSample( const uint8_t* p, int bits, int format )
+{
+    if( WAV_FORMAT_FLOAT == format )
+    {
+        float f;
+        memcpy( &f, p, sizeof( f ) );
+        f = ( f > 1.0f ) ? 1.0f : ( ( f < -1.0f ) ? -1.0f : f );
+        return f * 32767;
+    }
+    else if( 8 == bits )
+    {
+        // 8 bit WAV is unsigned
+        return ( p[0] - 128 ) * 256;
+    }
+    // Wider samples are signed, keep the top 16 bits
+    return (int16_t)emuMicLe( &p[bits / 8 - 2], 2 );
+}
+
+/**
+ * @brief Parse a WAV file, mixing it down to mono
+ *
+ * @param file The file's contents
+ * @param size The file's size
+ * @param rate Returns the sample rate
+ * @param len  Returns the number of samples
+ * @return The samples, to be freed by the caller, or NULL if it couldn't be parsed
+ */
+static int16_t* emuMicParseWav( const uint8_t* file, size_t size, uint32_t* rate, uint32_t* len )
+{
+    int format = 0, channels = 0, bits = 0;
+    size_t pos = 12;
+    while( pos + 8 <= size )
+    {
+        const uint8_t* chunk = &file[pos];
+        uint32_t chunkLen = emuMicLe( &chunk[4], 4 );
+        if( chunkLen > size - pos - 8 )
+        {
+            // Some writers leave the length of the last chunk unset
+            chunkLen = size - pos - 8;
+        }
+
+        if( 0 == memcmp( chunk, "fmt ", 4 ) && chunkLen >= 16 )
+        {
+            format = emuMicLe( &chunk[8], 2 );
+            channels = emuMicLe( &chunk[10], 2 );
+            *rate = emuMicLe( &chunk[12], 4 );
+            bits = emuMicLe( &chunk[22], 2 );
+            if( WAV_FORMAT_EXTENSIBLE == format && chunkLen >= 26 )
+            {
+                // The subformat GUID starts with the format
+                format = emuMicLe( &chunk[32], 2 );
+            }
+        }
+        else if( 0 == memcmp( chunk, "data", 4 ) )
+        {
+            bool supported = ( WAV_FORMAT_PCM == format && ( 8 == bits || 16 == bits || 24 == bits || 32 == bits ) ) ||
+                             ( WAV_FORMAT_FLOAT == format && 32 == bits );
+            if( !supported || channels < 1 || 0 == *rate )
+            {
+                fprintf( stderr, "EMU Error: Only 8 to 32 bit PCM and 32 bit float WAV files can be replayed\n" );
+                return NULL;
+            }
+
+            uint32_t frameBytes = channels * bits / 8;
+            *len = chunkLen / frameBytes;
+            int16_t* samples = malloc( ( *len ? *len : 1 ) * sizeof( int16_t ) );
+            for( uint32_t i = 0; i < *len; i++ )
+            {
+                int32_t sum = 0;
+                for( int c = 0; c < channels; c++ )
+                {
+                    sum += emuMicWavSample( &chunk[8 + i * frameBytes + c * bits / 8], bits, format );
+                }
+                samples[i] = sum / channels;
+            }
+            return samples;
+        }
+
+        // Chunks are padded to an even length
+        pos += 8 + chunkLen + ( chunkLen & 1 );
+    }
+
+    fprintf( stderr, "EMU Error: No audio found in the WAV file\n" );
+    return NULL;
+}
+
+/**
+ * @brief Convert samples to DFREQ by linear interpolation
+ *
+ * @param in   The samples
+ * @param len  The number of samples, returns the number after conversion
+ * @param rate The sample rate of the samples
+ * @return The converted samples, to be freed by the caller
+ */
+static int16_t* emuMicResample( const int16_t* in, uint32_t* len, uint32_t rate )
+{
+    uint32_t outLen = ( (uint64_t)*len * DFREQ ) / rate;
+    int16_t* out = malloc( ( outLen ? outLen : 1 ) * sizeof( int16_t ) );
+
+    // Step through the input in 32.32 fixed point
+    uint64_t step = ( (uint64_t)rate << 32 ) / DFREQ;
+    uint64_t pos = 0;
+    for( uint32_t i = 0; i < outLen; i++, pos += step )
+    {
+        uint32_t idx = pos >> 32;
+        int64_t frac = ( pos >> 16 ) & 0xFFFF;
+        int32_t a = in[idx];
+        int32_t b = ( idx + 1 < *len ) ? in[idx + 1] : a;
+        out[i] = a + ( ( ( b - a ) * frac ) >> 16 );
+    }
+    *len = outLen;
+    return out;
+}
+
+/**
+ * @brief Load a recording to replay through the mic, converting it to DFREQ
+ *
+ * @param fname A WAV file, or a raw file of signed 16 bit little endian mono
+ *              samples at --mic-rate
+ * @return true if it was loaded, false if it wasn't
+ */
+static bool emuMicLoad( const char* fname )
+{
+    FILE* f = fopen( fname, "rb" );
+    if( !f )
+    {
+        fprintf( stderr, "EMU Error: Could not open %s\n", fname );
+        return false;
+    }
+    fseek( f, 0, SEEK_END );
+    long size = ftell( f );
+    fseek( f, 0, SEEK_SET );
+    uint8_t* file = malloc( size > 0 ? size : 1 );
+    if( size < 0 || (size_t)size != fread( file, 1, size, f ) )
+    {
+        fprintf( stderr, "EMU Error: Could not read %s\n", fname );
+        fclose( f );
+        free( file );
+        return false;
+    }
+    fclose( f );
+
+    uint32_t rate = rawRate;
+    uint32_t len = 0;
+    int16_t* samples = NULL;
+    if( size >= 12 && 0 == memcmp( file, "RIFF", 4 ) && 0 == memcmp( &file[8], "WAVE", 4 ) )
+    {
+        samples = emuMicParseWav( file, size, &rate, &len );
+    }
+    else
+    {
+        len = size / sizeof( int16_t );
+        samples = malloc( ( len ? len : 1 ) * sizeof( int16_t ) );
+        for( uint32_t i = 0; i < len; i++ )
+        {
+            samples[i] = emuMicLe( &file[i * 2], 2 );
+        }
+    }
+    free( file );
+    if( NULL == samples )
+    {
+        return false;
+    }
+
+    if( DFREQ != rate )
+    {
+        int16_t* resampled = emuMicResample( samples, &len, rate );
+        free( samples );
+        samples = resampled;
+    }
+
+    free( micData );
+    micData = samples;
+    micLen = len;
+    printf( "EMU Mic: replaying %s, %.2f s at %u Hz, converted from %u Hz\n", fname, (double)len / DFREQ,
+            DFREQ, rate );
+    return true;
+}
+
+/**
+ * @brief Parse a mic replay command line option, if this is one
+ *
+ *     --mic FILE    Replay FILE, a WAV or raw PCM file, through the mic
+ *     --mic-rate N  The sample rate of a raw file (default DFREQ)
+ *     --mic-loop    Start the recording again when it ends
+ *
+ * --mic-rate must come before --mic
+ *
+ * @param argc The argument count from main()
+ * @param argv The arguments from main()
+ * @param idx  The index of the argument to parse. If the option takes a value,
+ *             this is advanced past it
+ * @return true if this was a mic option, false if it wasn't or the file
+ *         couldn't be loaded
+ */
+bool emuMicParseArg( int argc, char** argv, int* idx )
+{
+    if( 0 == strcmp( argv[*idx], "--mic-loop" ) )
+    {
+        micLoop = true;
+        return true;
+    }
+    else if( *idx + 1 >= argc )
+    {
+        return false;
+    }
+    else if( 0 == strcmp( argv[*idx], "--mic-rate" ) )
+    {
+        rawRate = strtoul( argv[++( *idx )], NULL, 10 );
+        if( 0 == rawRate )
+        {
+            rawRate = DFREQ;
+        }
+        return true;
+    }
+    else if( 0 == strcmp( argv[*idx], "--mic" ) )
+    {
+        return emuMicLoad( argv[++( *idx )] );
+    }
+    return false;
+}
+
+/*============================================================================
+ * Replay
+ *==========================================================================*/
+
+/**
+ * @return true if a recording is replacing the host's mic
+ */
+bool emuMicReplaying( void )
+{
+    return NULL != micData;
+}
+
+/**
+ * @brief Get the recording, for benchmarks
+ *
+ * @param len Returns the number of samples
+ * @return The samples at DFREQ, or NULL if there's no recording
+ */
+const int16_t* emuMicRecording( uint32_t* len )
+{
+    *len = micLen;
+    return micData;
+}
+
+/**
+ * @brief Start the recording over. Called by initMic()
+ */
+void emuMicStart( void )
+{
+    micOn = true;
+    micStarted = false;
+    micFed = 0;
+}
+
+/**
+ * @brief Feed the samples which are due by now. Called every time the OS tasks
+ * are dispatched
+ */
+void emuMicPoll( void )
+{
+    if( NULL == micData || 0 == micLen || !micOn )
+    {
+        return;
+    }
+
+    uint32_t now = system_get_time();
+    if( !micStarted )
+    {
+        micStartUs = now;
+        micStarted = true;
+    }
+
+    uint64_t due = ( (uint64_t)( now - micStartUs ) * DFREQ ) / 1000000;
+    if( !micLoop && due > micLen )
+    {
+        due = micLen;
+    }
+    for( ; micFed < due; micFed++ )
+    {
+        emuMicPush( micData[micFed % micLen] );
+        emuStats.micReplayed++;
+    }
+}
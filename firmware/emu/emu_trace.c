@@ -0,0 +1,669 @@
+// Recording and replay of everything from outside the firmware
+//
+// With --record FILE every stimulus the firmware gets from the outside world
+// is written to a trace with the time it arrived: button edges, accelerometer
+// readings, mic samples as getSample() returns them, ESP-NOW frames as they are
+// delivered and the status of each one sent, and the seed for rand(), which
+// os_random() and os_malloc() use. The headless emulator's --replay FILE feeds
+// the same stimuli back at the same times on its virtual clock, instead of
+// the script, the mic and the network, so a session runs the same way every
+// time. Each kind of stimulus is replayed from the same place it was recorded,
+// so a trace recorded by the headless emulator replays bit-exactly.
+//
+// Settings, high scores and the mode to boot into live in flash.dat and
+// rtc.dat, so a trace also starts with a copy of both. A replay runs from
+// scratch copies of them made from the trace, and leaves the files alone.
+//
+// A trace file is a header followed by records, each a time, a type and a
+// length, then that many bytes of data. Fields are in the host's byte order.
+//
+// --frame-log FILE writes a line for each frame, with its time, estimated cost
+// on hardware and a hash of the framebuffer, so runs of a trace on different
+// builds can be compared with diff.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "swadgemu.h"
+#include "user_interface.h"
+#include "spi_flash.h"
+#include "../user/user_main.h"
+
+#define TRACE_MAGIC 0x52545753 // "SWTR"
+#define TRACE_VERSION 2
+/// Mic samples recorded at the same time are kept together, up to this many
+#define TRACE_MIC_BLOCK 1024
+
+/// The first thing in a trace file
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t seed;  ///< What rand() was seeded with
+    int32_t mode;   ///< The swadge mode started after boot, or -1 for the menu
+} emuTraceHeader_t;
+
+/// The start of each record in a trace file
+typedef struct __attribute__((packed))
+{
+    uint32_t timeUs;
+    uint8_t type;
+    uint16_t len;
+} emuTraceRecord_t;
+
+typedef enum
+{
+    TRACE_BUTTON,      ///< Button number and 1 for down, 0 for up
+    TRACE_ACCEL,       ///< x, y and z as int16_t
+    TRACE_MIC,         ///< Samples returned by getSample()
+    TRACE_ESPNOW_RX,   ///< Sender's MAC, RSSI, then the frame
+    TRACE_ESPNOW_TX,   ///< The status of a frame sent
+    TRACE_END,         ///< When recording stopped
+    TRACE_FLASH,       ///< A sector's address, then its contents, if it isn't erased
+    TRACE_RTC,         ///< The RTC memory
+} emuTraceType_t;
+
+// Recording
+static FILE* recordFile = NULL;
+static uint32_t micBlockUs = 0;
+static uint16_t micBlockLen = 0;
+static uint8_t micBlock[TRACE_MIC_BLOCK];
+static accel_t lastAccel = {0};
+static bool accelRecorded = false;
+
+// Replay
+static uint8_t* replay = NULL;
+static size_t replaySize = 0;
+static emuTraceHeader_t replayHeader;
+static uint32_t replayEndUs = 0;
+
+/// A position in the replay for one kind of record
+typedef struct
+{
+    size_t pos;   ///< Offset of the next record of this type
+    uint16_t used; ///< How much of that record's data was used, for the mic
+} emuTraceCursor_t;
+
+static emuTraceCursor_t buttonCursor, accelCursor, micCursor, rxCursor, txCursor;
+static accel_t replayAccel = {0};
+
+static FILE* frameLog = NULL;
+static uint32_t frameNum = 0;
+
+void HandleButtonStatus( int button, int bDown );
+static void emuTraceRestoreState( void );
+extern uint8_t currentFb[];
+
+/*============================================================================
+ * Recording
+ *==========================================================================*/
+
+/**
+ * @brief Write a record to the trace being recorded
+ *
+ * @param timeUs When it happened
+ * @param type   What happened
+ * @param data   The record's data
+ * @param len    The length of the data
+ */
+static void emuTraceWrite( uint32_t timeUs, emuTraceType_t type, const void* data, uint16_t len )
+{
+    emuTraceRecord_t rec = { .timeUs = timeUs, .type = type, .len = len };
+    fwrite( &rec, sizeof( rec ), 1, recordFile );
+    if( len > 0 )
+    {
+        fwrite( data, len, 1, recordFile );
+    }
+}
+
+/**
+ * @brief Write out the mic samples waiting to be recorded
+ */
+static void emuTraceFlushMic( void )
+{
+    if( micBlockLen > 0 )
+    {
+        emuTraceWrite( micBlockUs, TRACE_MIC, micBlock, micBlockLen );
+        micBlockLen = 0;
+    }
+}
+
+/**
+ * @brief Write a record, after any mic samples from before it
+ *
+ * @param type The record's type
+ * @param data The record's data
+ * @param len  The length of the data
+ */
+static void emuTraceRecord( emuTraceType_t type, const void* data, uint16_t len )
+{
+    emuTraceFlushMic();
+    emuTraceWrite( system_get_time(), type, data, len );
+}
+
+/**
+ * @brief Finish the trace being recorded, and the frame log. Registered with
+ * atexit(), so the windowed emulator's trace is finished however it exits
+ */
+static void emuTraceClose( void )
+{
+    if( NULL != recordFile )
+    {
+        emuTraceRecord( TRACE_END, NULL, 0 );
+        fclose( recordFile );
+        recordFile = NULL;
+    }
+    if( NULL != frameLog )
+    {
+        fclose( frameLog );
+        frameLog = NULL;
+    }
+}
+
+/**
+ * @brief Record the flash and RTC memory the firmware starts with
+ */
+static void emuTraceSaveState( void )
+{
+    const uint8_t* flash = emuFlashImage();
+    for( uint32_t addr = 0; NULL != flash && addr < EMU_FLASH_SIZE; addr += SPI_FLASH_SEC_SIZE )
+    {
+        // Most of the flash is erased, so leave that out
+        uint32_t i = 0;
+        while( i < SPI_FLASH_SEC_SIZE && 0xFF == flash[addr + i] )
+        {
+            i++;
+        }
+        if( i < SPI_FLASH_SEC_SIZE )
+        {
+            uint8_t data[sizeof( uint32_t ) + SPI_FLASH_SEC_SIZE];
+            memcpy( data, &addr, sizeof( addr ) );
+            memcpy( &data[sizeof( addr )], &flash[addr], SPI_FLASH_SEC_SIZE );
+            emuTraceWrite( 0, TRACE_FLASH, data, sizeof( data ) );
+        }
+    }
+
+    uint8_t rtc[EMU_RTC_SIZE] = {0};
+    system_rtc_mem_read( 0, rtc, sizeof( rtc ) );
+    emuTraceWrite( 0, TRACE_RTC, rtc, sizeof( rtc ) );
+}
+
+/**
+ * @brief Start recording, once rand() is seeded and before anything happens.
+ * When replaying, this seeds rand() from the trace instead
+ *
+ * @param seed What rand() is seeded with, unless a trace is being replayed
+ * @param mode The swadge mode started after boot, or -1 for the menu
+ */
+void emuTraceBegin( uint32_t seed, int32_t mode )
+{
+    if( NULL != replay )
+    {
+        seed = replayHeader.seed;
+        emuTraceRestoreState();
+    }
+    srand( seed );
+
+    if( NULL != recordFile )
+    {
+        emuTraceHeader_t hdr = { .magic = TRACE_MAGIC, .version = TRACE_VERSION, .seed = seed, .mode = mode };
+        fwrite( &hdr, sizeof( hdr ), 1, recordFile );
+        emuTraceSaveState();
+    }
+}
+
+/**
+ * @brief Record a button edge. Called by HandleButtonStatus()
+ *
+ * @param button The button
+ * @param down   true if it was pressed, false if it was released
+ */
+void emuTraceButton( int button, bool down )
+{
+    if( NULL != recordFile )
+    {
+        uint8_t data[2] = { button, down };
+        emuTraceRecord( TRACE_BUTTON, data, sizeof( data ) );
+    }
+}
+
+/**
+ * @brief Record an ESP-NOW frame as it's delivered to the mode
+ *
+ * @param mac  The sender's MAC address
+ * @param data The frame
+ * @param len  The length of the frame
+ * @param rssi The RSSI it was delivered with
+ */
+void emuTraceEspNowRecv( const uint8_t* mac, const uint8_t* data, uint8_t len, uint8_t rssi )
+{
+    if( NULL != recordFile )
+    {
+        uint8_t rec[6 + 1 + 255];
+        memcpy( rec, mac, 6 );
+        rec[6] = rssi;
+        memcpy( &rec[7], data, len );
+        emuTraceRecord( TRACE_ESPNOW_RX, rec, 7 + len );
+    }
+}
+
+/*============================================================================
+ * Replay
+ *==========================================================================*/
+
+/**
+ * @brief Find the next record of a type
+ *
+ * @param cursor Where to look from, moved to the record
+ * @param type   The type to find
+ * @return The record, or NULL if there are no more
+ */
+static const emuTraceRecord_t* emuTraceNext( emuTraceCursor_t* cursor, emuTraceType_t type )
+{
+    while( cursor->pos + sizeof( emuTraceRecord_t ) <= replaySize )
+    {
+        const emuTraceRecord_t* rec = (const emuTraceRecord_t*)&replay[cursor->pos];
+        if( rec->type == type )
+        {
+            return rec;
+        }
+        cursor->pos += sizeof( emuTraceRecord_t ) + rec->len;
+        cursor->used = 0;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Move a cursor past the record it's on
+ *
+ * @param cursor The cursor
+ */
+static void emuTraceSkip( emuTraceCursor_t* cursor )
+{
+    const emuTraceRecord_t* rec = (const emuTraceRecord_t*)&replay[cursor->pos];
+    cursor->pos += sizeof( emuTraceRecord_t ) + rec->len;
+    cursor->used = 0;
+}
+
+/**
+ * @brief Check if a record is due
+ *
+ * @param rec The record, or NULL
+ * @return true if rec isn't NULL and its time has come
+ */
+static bool emuTraceDue( const emuTraceRecord_t* rec )
+{
+    return NULL != rec && (int32_t)( rec->timeUs - system_get_time() ) <= 0;
+}
+
+/**
+ * @brief Replace the flash and RTC memory with scratch copies of what the
+ * replayed trace started with
+ */
+static void emuTraceRestoreState( void )
+{
+    uint8_t* flash = emuFlashScratch();
+    uint8_t* rtc = emuRtcScratch();
+
+    emuTraceCursor_t cursor = {0};
+    const emuTraceRecord_t* rec;
+    while( NULL != ( rec = emuTraceNext( &cursor, TRACE_FLASH ) ) )
+    {
+        uint32_t addr;
+        memcpy( &addr, &rec[1], sizeof( addr ) );
+        if( rec->len == sizeof( addr ) + SPI_FLASH_SEC_SIZE && addr <= EMU_FLASH_SIZE - SPI_FLASH_SEC_SIZE )
+        {
+            memcpy( &flash[addr], (const uint8_t*)&rec[1] + sizeof( addr ), SPI_FLASH_SEC_SIZE );
+        }
+        emuTraceSkip( &cursor );
+    }
+
+    cursor.pos = 0;
+    rec = emuTraceNext( &cursor, TRACE_RTC );
+    if( NULL != rec && EMU_RTC_SIZE == rec->len )
+    {
+        memcpy( rtc, &rec[1], EMU_RTC_SIZE );
+    }
+}
+
+/**
+ * @brief Load a trace to replay, checking every record fits in the file
+ *
+ * @param fname The trace file
+ * @return true if it was loaded, false if it wasn't
+ */
+static bool emuTraceLoad( const char* fname )
+{
+    FILE* f = fopen( fname, "rb" );
+    if( !f )
+    {
+        fprintf( stderr, "EMU Error: Could not open trace %s\n", fname );
+        return false;
+    }
+    fseek( f, 0, SEEK_END );
+    long size = ftell( f );
+    fseek( f, 0, SEEK_SET );
+    if( size < (long)sizeof( emuTraceHeader_t ) || 1 != fread( &replayHeader, sizeof( replayHeader ), 1, f ) ||
+            TRACE_MAGIC != replayHeader.magic || TRACE_VERSION != replayHeader.version )
+    {
+        fprintf( stderr, "EMU Error: %s isn't a version %d trace\n", fname, TRACE_VERSION );
+        fclose( f );
+        return false;
+    }
+
+    replaySize = size - sizeof( emuTraceHeader_t );
+    replay = malloc( replaySize ? replaySize : 1 );
+    if( replaySize != fread( replay, 1, replaySize, f ) )
+    {
+        fprintf( stderr, "EMU Error: Could not read trace %s\n", fname );
+        fclose( f );
+        free( replay );
+        replay = NULL;
+        return false;
+    }
+    fclose( f );
+
+    // A trace cut short replays up to the last whole record
+    size_t pos = 0;
+    while( pos + sizeof( emuTraceRecord_t ) <= replaySize )
+    {
+        const emuTraceRecord_t* rec = (const emuTraceRecord_t*)&replay[pos];
+        if( pos + sizeof( emuTraceRecord_t ) + rec->len > replaySize )
+        {
+            break;
+        }
+        replayEndUs = rec->timeUs;
+        pos += sizeof( emuTraceRecord_t ) + rec->len;
+    }
+    replaySize = pos;
+    return true;
+}
+
+/**
+ * @return true if a trace is being replayed
+ */
+bool emuTraceReplaying( void )
+{
+    return NULL != replay;
+}
+
+/**
+ * @brief Get what a replayed trace was recorded with
+ *
+ * @param mode  Returns the swadge mode started after boot, or -1 for the menu
+ * @param endMs Returns when recording stopped, in milliseconds
+ */
+void emuTraceReplayInfo( int32_t* mode, uint32_t* endMs )
+{
+    *mode = replayHeader.mode;
+    *endMs = ( replayEndUs + 999 ) / 1000;
+}
+
+/**
+ * @brief Press and release buttons as they were when recorded. Called where
+ * the headless emulator applies its script
+ */
+void emuTraceReplayButtons( void )
+{
+    const emuTraceRecord_t* rec;
+    while( emuTraceDue( rec = emuTraceNext( &buttonCursor, TRACE_BUTTON ) ) )
+    {
+        const uint8_t* data = (const uint8_t*)&rec[1];
+        emuTraceSkip( &buttonCursor );
+        HandleButtonStatus( data[0], data[1] );
+    }
+}
+
+/**
+ * @brief Replay or record an accelerometer reading. Called by QMA6981_poll()
+ *
+ * @param accel The reading. When replaying this is replaced by the last
+ *              reading recorded by now
+ */
+void emuTraceAccel( accel_t* accel )
+{
+    if( NULL != replay )
+    {
+        const emuTraceRecord_t* rec;
+        while( emuTraceDue( rec = emuTraceNext( &accelCursor, TRACE_ACCEL ) ) )
+        {
+            memcpy( &replayAccel, &rec[1], sizeof( replayAccel ) );
+            emuTraceSkip( &accelCursor );
+        }
+        *accel = replayAccel;
+    }
+
+    // Only changes are recorded
+    if( NULL != recordFile && ( !accelRecorded || 0 != memcmp( accel, &lastAccel, sizeof( lastAccel ) ) ) )
+    {
+        lastAccel = *accel;
+        accelRecorded = true;
+        emuTraceRecord( TRACE_ACCEL, accel, sizeof( *accel ) );
+    }
+}
+
+/**
+ * @return true if there are replayed mic samples due. Called by
+ * sampleAvailable() when replaying
+ */
+bool emuTraceMicAvailable( void )
+{
+    const emuTraceRecord_t* rec = emuTraceNext( &micCursor, TRACE_MIC );
+    if( NULL != rec && micCursor.used == rec->len )
+    {
+        emuTraceSkip( &micCursor );
+        rec = emuTraceNext( &micCursor, TRACE_MIC );
+    }
+    return emuTraceDue( rec );
+}
+
+/**
+ * @return How many replayed mic samples are due. Called by samplesQueued()
+ * when replaying
+ */
+uint32_t emuTraceMicQueued( void )
+{
+    emuTraceCursor_t cursor = micCursor;
+    const emuTraceRecord_t* rec;
+    uint32_t queued = 0;
+    while( emuTraceDue( rec = emuTraceNext( &cursor, TRACE_MIC ) ) )
+    {
+        queued += rec->len - cursor.used;
+        emuTraceSkip( &cursor );
+    }
+    return queued;
+}
+
+/**
+ * @brief Replay or record a mic sample. Called by getSample()
+ *
+ * @param sample The sample from the mic
+ * @return The sample, or when replaying, the next sample recorded
+ */
+uint8_t emuTraceMic( uint8_t sample )
+{
+    if( NULL != replay )
+    {
+        sample = 0;
+        if( emuTraceMicAvailable() )
+        {
+            const emuTraceRecord_t* rec = (const emuTraceRecord_t*)&replay[micCursor.pos];
+            sample = ( (const uint8_t*)&rec[1] )[micCursor.used++];
+        }
+    }
+
+    if( NULL != recordFile )
+    {
+        uint32_t now = system_get_time();
+        if( micBlockLen == TRACE_MIC_BLOCK || ( micBlockLen > 0 && now != micBlockUs ) )
+        {
+            emuTraceFlushMic();
+        }
+        micBlockUs = now;
+        micBlock[micBlockLen++] = sample;
+    }
+    return sample;
+}
+
+/**
+ * @brief Deliver the ESP-NOW frames recorded by now. Called by emuEspNowPoll()
+ * when replaying, instead of receiving from the network
+ *
+ * @param initTimeUs When ESP-NOW was started, for the stats
+ */
+void emuTraceReplayEspNow( uint32_t initTimeUs )
+{
+    const emuTraceRecord_t* rec;
+    while( emuTraceDue( rec = emuTraceNext( &rxCursor, TRACE_ESPNOW_RX ) ) )
+    {
+        uint8_t data[255];
+        uint8_t mac[6];
+        if( rec->len < 7 || rec->len > 7 + sizeof( data ) )
+        {
+            // A corrupt record, there's no frame to replay
+            emuTraceSkip( &rxCursor );
+            continue;
+        }
+        const uint8_t* recData = (const uint8_t*)&rec[1];
+        uint8_t len = rec->len - 7;
+        memcpy( mac, recData, sizeof( mac ) );
+        memcpy( data, &recData[7], len );
+        uint8_t rssi = recData[6];
+        emuTraceSkip( &rxCursor );
+
+        if( 0 == emuStats.espNowReceived )
+        {
+            emuStats.espNowFirstRxUs = system_get_time() - initTimeUs;
+        }
+        emuStats.espNowReceived++;
+        emuStats.espNowReceivedBytes += len;
+        emuTraceEspNowRecv( mac, data, len, rssi );
+        swadgeModeEspNowRecvCb( mac, data, len, rssi );
+    }
+}
+
+/**
+ * @brief Replay or record the status of an ESP-NOW frame sent. Called by
+ * espNowSend()
+ *
+ * @param status The status from the network
+ * @return The status, or when replaying, the next status recorded
+ */
+mt_tx_status emuTraceEspNowSent( mt_tx_status status )
+{
+    if( NULL != replay )
+    {
+        const emuTraceRecord_t* rec = emuTraceNext( &txCursor, TRACE_ESPNOW_TX );
+        status = MT_TX_STATUS_OK;
+        if( NULL != rec )
+        {
+            status = *(const uint8_t*)&rec[1];
+            emuTraceSkip( &txCursor );
+        }
+    }
+
+    if( NULL != recordFile )
+    {
+        uint8_t data = status;
+        emuTraceRecord( TRACE_ESPNOW_TX, &data, sizeof( data ) );
+    }
+    return status;
+}
+
+/*============================================================================
+ * Frame log
+ *==========================================================================*/
+
+/**
+ * @brief Log a frame's time, estimated cost and a hash of the framebuffer.
+ * Called by procTask() after each frame is sent to the OLED, through
+ * emuEndFrame()
+ *
+ * @param costUs The frame's estimated time on hardware
+ */
+void emuTraceFrame( uint32_t costUs )
+{
+    // Keep what's recorded if the emulator is killed instead of exiting
+    if( NULL != recordFile )
+    {
+        fflush( recordFile );
+    }
+    if( NULL == frameLog )
+    {
+        return;
+    }
+
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for( uint32_t i = 0; i < OLED_WIDTH * OLED_HEIGHT / 8; i++ )
+    {
+        hash = ( hash ^ currentFb[i] ) * 16777619u;
+    }
+    fprintf( frameLog, "%u %u %u %08x\n", frameNum++, system_get_time(), costUs, hash );
+    fflush( frameLog );
+}
+
+/*============================================================================
+ * Configuration
+ *==========================================================================*/
+
+/**
+ * @brief Parse a trace command line option, if this is one
+ *
+ *     --record FILE     Record everything from outside the firmware to FILE
+ *     --replay FILE     Replay a trace, headless only
+ *     --frame-log FILE  Log each frame's time, estimated cost and hash to FILE
+ *
+ * @param argc The argument count from main()
+ * @param argv The arguments from main()
+ * @param idx  The index of the argument to parse. If the option takes a value,
+ *             this is advanced past it
+ * @return true if this was a trace option, false if it wasn't or the file
+ *         couldn't be opened
+ */
+bool emuTraceParseArg( int argc, char** argv, int* idx )
+{
+    if( *idx + 1 >= argc )
+    {
+        return false;
+    }
+
+    const char* opt = argv[*idx];
+    const char* fname = argv[*idx + 1];
+    FILE** out = NULL;
+    if( 0 == strcmp( opt, "--record" ) )
+    {
+        out = &recordFile;
+    }
+    else if( 0 == strcmp( opt, "--frame-log" ) )
+    {
+        out = &frameLog;
+    }
+    else if( 0 == strcmp( opt, "--replay" ) )
+    {
+#ifdef EMU_HEADLESS
+        ( *idx )++;
+        return emuTraceLoad( fname );
+#else
+        fprintf( stderr, "EMU Error: Traces can only be replayed by swadgemu-headless\n" );
+        return false;
+#endif
+    }
+    else
+    {
+        return false;
+    }
+
+    if( NULL == *out )
+    {
+        *out = fopen( fname, ( &recordFile == out ) ? "wb" : "w" );
+        if( NULL == *out )
+        {
+            fprintf( stderr, "EMU Error: Could not open %s for writing\n", fname );
+            return false;
+        }
+        atexit( emuTraceClose );
+    }
+    ( *idx )++;
+    return true;
+}
@@ -1,12 +1,13 @@
 #include <display/oled.h>
+#include <display/oled_dirty.h>
 #include "swadgemu.h"
 
 #define SSD1306_NUM_PAGES 8
 #define SSD1306_NUM_COLS 128
 
 #define OLEDMEM ((OLED_WIDTH * (OLED_HEIGHT / 8)))
-uint8_t currentFb[OLEDMEM] = {0};
-uint8_t priorFb[OLEDMEM] = {0};
+uint8_t currentFb[OLEDMEM] __attribute__((aligned(4))) = {0};
+uint8_t priorFb[OLEDMEM] __attribute__((aligned(4))) = {0};
 uint8_t mBarLen = 0;
 bool fbChanges = false;
 bool fbOnline = false;
@@ -21,6 +22,7 @@ bool initOLED(bool reset)
     }
     fbChanges = 1;
     updateOLED(0);
+    emuCostDiscard();
     return true;
 }
 
@@ -31,6 +33,8 @@ void drawPixel(int16_t x, int16_t y, color c)
             (0 <= y) && (y < OLED_HEIGHT))
     {
         fbChanges = true;
+        OLED_MARK_DIRTY(x, y);
+        emuCostAdd( EMU_COST_PIXEL, 1 );
         uint8_t * addy = &currentFb[(y + x * OLED_HEIGHT)/8];
         uint8_t mask = 1<<(y&7);
         switch (c)
@@ -61,6 +65,8 @@ void drawPixelUnsafe( int x, int y )
 		fprintf( stderr, "ERROR: PIXEL OUT OF RANGE in drawPixelUnsafe %d %d\n", x, y );
 		return;
 	}
+    OLED_MARK_DIRTY(x, y);
+    emuCostAdd( EMU_COST_PIXEL, 1 );
     uint8_t* addy = &currentFb[(y + x * OLED_HEIGHT) / 8];
     uint8_t mask = 1 << (y & 7);
     *addy |= mask;
@@ -73,6 +79,8 @@ void drawPixelUnsafeBlack( int x, int y )
 		fprintf( stderr, "ERROR: PIXEL OUT OF RANGE in drawPixelUnsafe %d %d\n", x, y );
 		return;
 	}
+    OLED_MARK_DIRTY(x, y);
+    emuCostAdd( EMU_COST_PIXEL, 1 );
     uint8_t* addy = &currentFb[(y + x * OLED_HEIGHT) / 8];
     uint8_t mask = ~(1 << (y & 7));
     *addy &= mask;
@@ -85,6 +93,8 @@ void drawPixelUnsafeC( int x, int y, color c )
 		fprintf( stderr, "ERROR: PIXEL OUT OF RANGE in drawPixelUnsafeC %d %d\n", x, y );
 		return;
 	}
+    OLED_MARK_DIRTY(x, y);
+    emuCostAdd( EMU_COST_PIXEL, 1 );
 	//Ugh, I know this looks weird, but it's faster than saying
 	//addy = &currentFb[(y+x*OLED_HEIGHT)/8], and produces smaller code.
 	//Found by looking at image.lst.
@@ -127,18 +137,48 @@ bool ICACHE_FLASH_ATTR setOLEDparams(bool turnOnOff)
 
 oledResult_t updateOLED(bool drawDifference)
 {
-    if( fbChanges )
+    if(true == drawDifference && false == fbChanges && false == isOledDirty())
     {
-        emuSendOLEDData( 1, currentFb );
-        //For the emulator, we don't care about differences.
-        ets_memcpy(priorFb, currentFb, sizeof(currentFb));
-        return FRAME_DRAWN;
+        return NOTHING_TO_DO;
     }
-    return FRAME_NOT_DRAWN;
+    fbChanges = false;
+
+    // Account for the bytes the real OLED driver would push over I2C
+    if( drawDifference )
+    {
+        oledSpan_t spans[OLED_MAX_DIRTY_SPANS];
+        double scanStart = emuGetPerfTime();
+        uint8_t numSpans = findOledDirtySpans(currentFb, priorFb, spans, OLED_MAX_DIRTY_SPANS);
+        emuStats.oledScanTime += emuGetPerfTime() - scanStart;
+        emuStats.oledScans++;
+        if(0 == numSpans)
+        {
+            return NOTHING_TO_DO;
+        }
+        for(uint8_t i = 0; i < numSpans; i++)
+        {
+            uint16_t spanBytes = oledSpanBytes(&spans[i]);
+            emuStats.oledDataBytes += spanBytes;
+            emuCostAdd( EMU_COST_I2C_BYTE, OLED_SPAN_OVERHEAD_BYTES + spanBytes );
+        }
+        emuStats.oledSpans += numSpans;
+    }
+    else
+    {
+        clearOledDirty();
+        emuStats.oledDataBytes += OLEDMEM;
+        emuStats.oledSpans++;
+        emuCostAdd( EMU_COST_I2C_BYTE, OLED_SPAN_OVERHEAD_BYTES + OLEDMEM );
+    }
+    emuStats.oledFrames++;
+
+    emuSendOLEDData( 1, currentFb );
+    ets_memcpy(priorFb, currentFb, sizeof(currentFb));
+    return FRAME_DRAWN;
 }
 
 void clearDisplay(void)
 {
-    ets_memset(currentFb, 0, sizeof(currentFb));
+    clearOledFramebuffer(currentFb);
     fbChanges = true;
 }
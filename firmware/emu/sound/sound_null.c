@@ -1,45 +1,44 @@
 //Copyright 2015 <>< Charles Lohr under the ColorChord License.
 
+//A sound driver which neither records nor plays anything. It's the last resort
+//when no other driver starts, and is used by the headless emulator.
+
 #include "sound.h"
-#include "os_generic.h"
 #include <stdlib.h>
-#include "parameters.h"
 
 struct SoundDriverNull
 {
-	void (*CloseFn)( struct SoundDriverNull * object );
-	int (*SoundStateFn)( struct SoundDriverNull * object );
-	SoundCBType soundcb;
-	int channelsPlay;
-	int spsPlay;
-	int channelsRec;
-	int spsRec;
+	void (*CloseFn)( void * object );
+	int (*SoundStateFn)( void * object );
+	SoundCBType callback;
+	short channelsPlay;
+	short channelsRec;
+	int sps;
+	void * opaque;
 };
 
-void CloseSoundNull( struct SoundDriverNull * object )
+void CloseSoundNull( void * object )
 {
 	free( object );
 }
 
-int SoundStateNull( struct SoundDriverNull * object )
+int SoundStateNull( void * object )
 {
 	return 0;
 }
 
-
-void * InitSoundNull( SoundCBType cb )
+void * InitSoundNull( SoundCBType cb, int reqSPS, int reqChannelsRec, int reqChannelsPlay, int sugBufferSize,
+	const char * inputSelect, const char * outputSelect )
 {
 	struct SoundDriverNull * r = malloc( sizeof( struct SoundDriverNull ) );
 	r->CloseFn = CloseSoundNull;
 	r->SoundStateFn = SoundStateNull;
-	r->soundcb = cb;
-	r->spsPlay = GetParameterI( "samplerate", 44100 );
-	r->channelsPlay = GetParameterI( "channels", 2 );
-	r->spsRec = r->spsPlay;
-	r->channelsRec = r->channelsRec;
+	r->callback = cb;
+	r->channelsPlay = reqChannelsPlay;
+	r->channelsRec = reqChannelsRec;
+	r->sps = reqSPS;
+	r->opaque = 0;
 	return r;
 }
 
-
 REGISTER_SOUND( NullSound, 1, "NULL", InitSoundNull );
-
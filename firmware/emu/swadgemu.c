@@ -6,7 +6,9 @@
 #include <math.h>
 #define _GNU_SOURCE /* for tm_gmtoff and tm_zone */
 #include <time.h>
-#include "rawdraw/CNFG.h"
+#ifndef EMU_HEADLESS
+    #include "rawdraw/CNFG.h"
+#endif
 #include "rawdraw/os_generic.h"
 #include "swadgemu.h"
 #include "ip_addr.h"
@@ -19,6 +21,7 @@
 #include "../user/hdw/QMA6981.h"
 #include "../user/hdw/buzzer.h"
 #include "../user/hdw/buttons.h"
+#include "../user/hdw/hpatimer.h"
 #include "../user/utils/assets.h"
 #include "spi_flash.h"
 
@@ -59,12 +62,22 @@ uint32_t headerpix[HEADER_PIXELS * OLED_WIDTH];
 uint32_t footerpix[FOOTER_PIXELS * OLED_WIDTH];
 uint32_t ws2812s[NR_WS2812];
 double boottime;
+emuStats_t emuStats;
 
 uint8_t gpio_status;
+extern uint8_t currentFb[];
+bool emuPresentDirty = true;
+
+/// How often the window is redrawn when nothing on it changed, in seconds
+#define EMU_REFRESH_S 0.5
 
 void HandleButtonStatus( int button, int bDown );
 void system_os_check_tasks(void);
 void ets_timer_check_timers(void);
+uint32_t emuDrainOsTasks(double budgetS);
+
+/// How long, in host seconds, drain mode runs tasks and timers between frames
+#define EMU_DRAIN_BUDGET_S 0.010
 
 //Really, this function is currently only used on Android.  TODO: Make the mouse actually do this.
 void emuCheckFooterMouse( int x, int y, int finger, int bDown )
@@ -119,6 +132,16 @@ void emuCheckFooterMouse( int x, int y, int finger, int bDown )
 
 void emuHeader()
 {
+    // Only redraw when the LEDs change, or after a resize
+    static uint32_t drawnLeds[NR_WS2812];
+    static int drawnScale = 0;
+    if( drawnScale == px_scale && 0 == memcmp( drawnLeds, ws2812s, sizeof( ws2812s ) ) )
+    {
+        return;
+    }
+    drawnScale = px_scale;
+    memcpy( drawnLeds, ws2812s, sizeof( ws2812s ) );
+
     // Draw background color first
     for(int i = 0; i < HEADER_PIXELS * OLED_WIDTH; i++)
     {
@@ -168,6 +191,16 @@ void emuFooter()
     int x, y, lx;
     int btn;
 
+    // Only redraw when the buttons change, or after a resize
+    static uint8_t drawnGpio = 0;
+    static int drawnScale = 0;
+    if( drawnScale == px_scale && drawnGpio == gpio_status )
+    {
+        return;
+    }
+    drawnScale = px_scale;
+    drawnGpio = gpio_status;
+
     lx = 0;
     for( btn = 0; btn < NR_BUTTONS; btn++ )
     {
@@ -201,71 +234,174 @@ void emuFooter()
 }
 
 
-void emuSendOLEDData( int disp, uint8_t* currentFb )
+/**
+ * @brief Write part of one row of the header, OLED or footer into rawvidmem,
+ * scaled up by px_scale in both directions. The first scaled row is written
+ * pixel by pixel, with loops for the common scales, and the rest are copies
+ * of it
+ *
+ * @param y      The row, in unscaled pixels from the top of the header
+ * @param x0     The first column to write
+ * @param x1     The last column to write
+ * @param colors The colors of the row, indexed by column
+ */
+static void emuPresentRow( int y, int x0, int x1, const uint32_t* colors )
 {
-    int x, y;
-    int yStart, yHeight;
-    switch(disp)
+#ifdef ANDROID
+    uint32_t swizzled[OLED_WIDTH];
+    for( int x = x0; x <= x1; x++ )
     {
-        case 0:
+        uint32_t pxcol = colors[x];
+        swizzled[x] = 0xff000000 | ( (pxcol & 0xff) << 16 ) | ( pxcol & 0xff00 ) | ( (pxcol & 0xff0000) >> 16 );
+    }
+    colors = swizzled;
+#endif
+
+    int stride = OLED_WIDTH * px_scale;
+    uint32_t* row = rawvidmem + ( y * stride + x0 ) * px_scale;
+    uint32_t* dst = row;
+    switch( px_scale )
+    {
+        case 1:
         {
-            // Header
-            yStart = 0;
-            yHeight = HEADER_PIXELS;
+            memcpy( dst, &colors[x0], ( x1 - x0 + 1 ) * sizeof( uint32_t ) );
             break;
         }
-        case 1:
+        case 2:
         {
-            // OLED
-            yStart = HEADER_PIXELS;
-            yHeight = OLED_HEIGHT;
+            for( int x = x0; x <= x1; x++, dst += 2 )
+            {
+                dst[0] = dst[1] = colors[x];
+            }
             break;
         }
-        case 2:
+        case 3:
         {
-            // Footer
-            yStart = HEADER_PIXELS + OLED_HEIGHT;
-            yHeight = FOOTER_PIXELS;
+            for( int x = x0; x <= x1; x++, dst += 3 )
+            {
+                dst[0] = dst[1] = dst[2] = colors[x];
+            }
+            break;
+        }
+        case 4:
+        {
+            for( int x = x0; x <= x1; x++, dst += 4 )
+            {
+                dst[0] = dst[1] = dst[2] = dst[3] = colors[x];
+            }
             break;
         }
         default:
         {
-            return;
+            for( int x = x0; x <= x1; x++ )
+            {
+                for( int lx = 0; lx < px_scale; lx++ )
+                {
+                    *dst++ = colors[x];
+                }
+            }
+            break;
         }
     }
 
-    for( y = 0; y < yHeight; y++ )
+    size_t rowBytes = ( x1 - x0 + 1 ) * px_scale * sizeof( uint32_t );
+    for( int ly = 1; ly < px_scale; ly++ )
     {
-        for( x = 0; x < OLED_WIDTH; x++ )
-        {
+        memcpy( row + ly * stride, row, rowBytes );
+    }
+    emuPresentDirty = true;
+}
 
-            uint32_t pxcol;
-            if( disp == 1 )
-            {
-                uint8_t col = currentFb[(y + x * OLED_HEIGHT) / 8] & (1 << (y & 7));
-                pxcol = col ? OLED_ON_COLOR : BACKGROUND_COLOR;
-            }
-            else
+/// What is on the emulated OLED, to find what changes each frame
+static uint8_t presentedFb[OLED_WIDTH * (OLED_HEIGHT / 8)];
+
+/**
+ * @brief Draw the header, OLED or footer into rawvidmem. The header and footer
+ * are always drawn in full. Only the rows and columns of the OLED which
+ * changed since it was last drawn are redrawn, unless px_scale changed
+ *
+ * @param disp       0 for the header, 1 for the OLED, 2 for the footer
+ * @param currentFb  The header or footer pixels, or the OLED framebuffer
+ */
+void emuSendOLEDData( int disp, uint8_t* currentFb )
+{
+#ifdef EMU_HEADLESS
+    // Nothing to draw to, just give the frame to whatever is recording it
+    if( 1 == disp )
+    {
+        emuHeadlessFrame( currentFb );
+    }
+    return;
+#endif
+
+    switch(disp)
+    {
+        case 0:
+        case 2:
+        {
+            // Header or footer
+            int yStart = ( 0 == disp ) ? 0 : ( HEADER_PIXELS + OLED_HEIGHT );
+            int yHeight = ( 0 == disp ) ? HEADER_PIXELS : FOOTER_PIXELS;
+            const uint32_t* pix = (const uint32_t*)currentFb;
+            for( int y = 0; y < yHeight; y++ )
             {
-                pxcol = ((uint32_t*)currentFb)[x + y * OLED_WIDTH];
+                emuPresentRow( yStart + y, 0, OLED_WIDTH - 1, &pix[y * OLED_WIDTH] );
             }
-#ifdef ANDROID
-            pxcol = 0xff000000 | ( (pxcol & 0xff) << 16 ) | ( pxcol & 0xff00 ) | ( (pxcol & 0xff0000) >> 16 );
-#endif
-            int lx, ly;
-            uint32_t* pxloc = rawvidmem + ( x +  ( ( y + yStart ) ) * OLED_WIDTH * px_scale ) * px_scale;
-            for( ly = 0; ly < px_scale; ly++ )
+            break;
+        }
+        case 1:
+        {
+            // OLED. Everything has to be redrawn after a resize
+            static int presentedScale = 0;
+            bool redrawAll = ( presentedScale != px_scale );
+            presentedScale = px_scale;
+
+            uint32_t colors[OLED_WIDTH];
+            for( int page = 0; page < OLED_HEIGHT / 8; page++ )
             {
-                for( lx = 0; lx < px_scale; lx++ )
+                // Find the columns which changed in this page
+                int x0 = 0;
+                int x1 = OLED_WIDTH - 1;
+                if( !redrawAll )
+                {
+                    while( x0 < OLED_WIDTH && currentFb[x0 * 8 + page] == presentedFb[x0 * 8 + page] )
+                    {
+                        x0++;
+                    }
+                    if( x0 == OLED_WIDTH )
+                    {
+                        continue;
+                    }
+                    while( currentFb[x1 * 8 + page] == presentedFb[x1 * 8 + page] )
+                    {
+                        x1--;
+                    }
+                }
+
+                // Redraw the page's eight rows across those columns
+                for( int bit = 0; bit < 8; bit++ )
+                {
+                    for( int x = x0; x <= x1; x++ )
+                    {
+                        colors[x] = ( currentFb[x * 8 + page] & ( 1 << bit ) ) ? OLED_ON_COLOR : BACKGROUND_COLOR;
+                    }
+                    emuPresentRow( HEADER_PIXELS + page * 8 + bit, x0, x1, colors );
+                }
+                for( int x = x0; x <= x1; x++ )
                 {
-                    pxloc[lx] = pxcol;
+                    presentedFb[x * 8 + page] = currentFb[x * 8 + page];
                 }
-                pxloc += OLED_WIDTH * px_scale;
             }
+            break;
+        }
+        default:
+        {
+            return;
         }
     }
 }
 
+#ifndef EMU_HEADLESS
 void emuCheckResize()
 {
     CNFGGetDimensions( &screenx, &screeny );
@@ -298,9 +434,104 @@ void emuCheckResize()
         rawvidmem = realloc( rawvidmem, px_scale * OLED_WIDTH * px_scale * (HEADER_PIXELS + OLED_HEIGHT + FOOTER_PIXELS) *
                              px_scale * 4 );
 #endif
-        updateOLED( false );
+        emuSendOLEDData( 1, presentedFb );
     }
 }
+#endif
+
+/**
+ * @brief Get a high resolution host timestamp for measuring emulator code
+ *
+ * @return A monotonic time, in seconds
+ */
+double emuGetPerfTime( void )
+{
+#ifdef LINUX
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ( ts.tv_nsec / 1000000000.0 );
+#else
+    return OGGetAbsoluteTime();
+#endif
+}
+
+/**
+ * @brief Close the per-frame counters. Called by procTask() after each frame
+ * is sent to the OLED
+ */
+void emuEndFrame( void )
+{
+    emuTraceFrame( emuCostEndFrame() );
+    emuHeapEndFrame();
+}
+
+/**
+ * @brief Print the counters accumulated while a swadge mode ran, then clear them
+ *
+ * @param modeName The name of the mode which is exiting
+ */
+void emuReportModeStats( const char* modeName )
+{
+    printf( "EMU Stats for %s:\n", (NULL != modeName) ? modeName : "No Name" );
+    printf( "  OLED: %u frames, %u windows, %u data bytes (%u bytes/frame)\n",
+            emuStats.oledFrames, emuStats.oledSpans, emuStats.oledDataBytes,
+            emuStats.oledFrames ? (emuStats.oledDataBytes / emuStats.oledFrames) : 0 );
+    printf( "  OLED: %u difference scans, %.3f us/scan\n", emuStats.oledScans,
+            emuStats.oledScans ? (emuStats.oledScanTime * 1000000.0 / emuStats.oledScans) : 0.0 );
+    printf( "  PNG: %u bytes loaded to heap, %u bytes left in flash (heap saved)\n",
+            emuStats.pngRamBytes, emuStats.pngFlashBytes );
+    if( emuStats.flashErases || emuStats.flashWrites )
+    {
+        uint16_t sector;
+        uint32_t erases = emuFlashMostErased( &sector );
+        printf( "  Flash: %u sector erases, %u writes (%u bytes, %u not erased first), %u reads (%u bytes)\n",
+                emuStats.flashErases, emuStats.flashWrites, emuStats.flashWriteBytes,
+                emuStats.flashUnerasedWrites, emuStats.flashReads, emuStats.flashReadBytes );
+        printf( "  Flash: %.1f ms busy, longest operation %.1f ms, sector 0x%03X erased %u times since boot\n",
+                emuStats.flashBusyNs / 1000000.0, emuStats.flashLongestNs / 1000000.0, sector, erases );
+    }
+    if( emuStats.espNowSent || emuStats.espNowReceived || emuStats.espNowDropped )
+    {
+        printf( "  ESP-NOW: %u frames sent (%u bytes), %u received (%u bytes), %u lost, first received after %.1f ms\n",
+                emuStats.espNowSent, emuStats.espNowSentBytes, emuStats.espNowReceived,
+                emuStats.espNowReceivedBytes, emuStats.espNowDropped, emuStats.espNowFirstRxUs / 1000.0 );
+    }
+    if( emuStats.micReplayed || emuStats.micDropped )
+    {
+        printf( "  Mic: %u samples replayed, %u dropped with the queue full, at most %u queued (%.1f ms)\n",
+                emuStats.micReplayed, emuStats.micDropped, emuStats.micMaxQueued,
+                emuStats.micMaxQueued * 1000.0 / DFREQ );
+    }
+    if( emuStats.micMaxQueued || emuStats.micUnderruns || emuStats.micDrains )
+    {
+        printf( "  Mic: %u samples over the swadge's %d sample buffer, %u underruns, %u passes drained without drawing\n",
+                emuStats.micOverHw, HPABUFFSIZE - 1, emuStats.micUnderruns, emuStats.micDrains );
+    }
+    if( emuStats.taskRuns )
+    {
+        printf( "  Tasks: %u runs, %.2f us mean, worst %.1f us, worst without a frame %.1f us (host time)\n",
+                emuStats.taskRuns, emuStats.taskTime * 1000000.0 / emuStats.taskRuns,
+                emuStats.taskWorst * 1000000.0, emuStats.taskWorstNoFrame * 1000000.0 );
+        printf( "  Tasks: runs in us" );
+        for( uint32_t b = 0; b < EMU_TASK_HIST_BUCKETS; b++ )
+        {
+            if( b < EMU_TASK_HIST_BUCKETS - 1 )
+            {
+                printf( " <%u:%u", 1 << b, emuStats.taskHist[b] );
+            }
+            else
+            {
+                printf( " >=%u:%u\n", 1 << ( b - 1 ), emuStats.taskHist[b] );
+            }
+        }
+        printf( "  Tasks: %.1f us mean, worst %u us, worst without a frame %u us (estimated on the swadge)\n",
+                emuStats.taskCostNs / 1000.0 / emuStats.taskRuns, emuStats.taskCostWorstUs,
+                emuStats.taskCostWorstNoFrameUs );
+    }
+    emuHeapReport();
+    emuCostReport();
+    memset( &emuStats, 0, sizeof(emuStats) );
+}
 
 // void exitMode(void)
 // {
@@ -309,16 +540,63 @@ void emuCheckResize()
 // }
 
 #ifndef ANDROID
-    int main()
+    int main( int argc, char** argv )
 #else
     int emumain()
 #endif
 {
+#ifndef ANDROID
+    if( argc > 1 && 0 == strcmp( argv[1], "--bench" ) )
+    {
+        // The audio suites can also run a recording given with --mic
+        for( int arg = 3; arg < argc; arg++ )
+        {
+            if( !emuMicParseArg( argc, argv, &arg ) )
+            {
+                fprintf( stderr, "Usage: %s --bench [suite] [--mic-rate N] [--mic FILE]\n", argv[0] );
+                return 1;
+            }
+        }
+        return emuRunBenchmarks( ( argc > 2 ) ? argv[2] : NULL );
+    }
+#endif
+
+#ifdef EMU_HEADLESS
+    return emuRunHeadless( argc, argv );
+#else
+
+    // --drain runs OS tasks for as long as they have events between frames,
+    // rather than one event per task per frame
+    bool drainTasks = false;
+#ifndef ANDROID
+    for( int arg = 1; arg < argc; arg++ )
+    {
+        if( 0 == strcmp( argv[arg], "--drain" ) )
+        {
+            drainTasks = true;
+        }
+        else if( 0 == strcmp( argv[arg], "--flash-latency" ) )
+        {
+            emuFlashLatency = true;
+        }
+        else if( arg + 1 < argc && 0 == strcmp( argv[arg], "--sound" ) )
+        {
+            emuSoundDriver = argv[++arg];
+        }
+        else if( !emuCostParseArg( argc, argv, &arg ) && !emuHeapParseArg( argc, argv, &arg ) &&
+                 !emuMicParseArg( argc, argv, &arg ) && !emuTraceParseArg( argc, argv, &arg ) )
+        {
+            emuEspNowParseArg( argc, argv, &arg );
+        }
+    }
+#endif
+
     unsigned frames = 0;
     int i, x, y;
     double ThisTime;
     double LastFPSTime = OGGetAbsoluteTime();
     double LastFrameTime = OGGetAbsoluteTime();
+    double LastRefreshTime = 0;
     double SecToWait;
     int linesegs = 0;
 
@@ -357,7 +635,7 @@ void emuCheckResize()
 
     boottime = OGGetAbsoluteTime();
 
-    srand(time(NULL));
+    emuTraceBegin( time( NULL ), -1 );
 
     initOLED(0);
 
@@ -369,11 +647,18 @@ void emuCheckResize()
         int i, pos;
         float f;
 
-        system_os_check_tasks();
-        ets_timer_check_timers();
-
-        updateOLED(0);
+        if( drainTasks )
+        {
+            emuDrainOsTasks( EMU_DRAIN_BUDGET_S );
+        }
+        else
+        {
+            system_os_check_tasks();
+            ets_timer_check_timers();
+        }
 
+        // The OLED is drawn when procTask() calls updateOLED(), so the window
+        // shows exactly the frames the real OLED would
         CNFGHandleInput();
 #ifdef LINUX
         //Handle input from SHM.
@@ -386,18 +671,25 @@ void emuCheckResize()
         }
 #endif
 
-        CNFGClearFrame();
-        CNFGColor( 0xFFFFFF );
         emuCheckResize();
-
         emuHeader();
         emuFooter();
-        CNFGUpdateScreenWithBitmap( rawvidmem, OLED_WIDTH * px_scale, (HEADER_PIXELS + OLED_HEIGHT + FOOTER_PIXELS)*px_scale  );
+
+        // Only push the bitmap to the window when something on it changed, and
+        // now and then in case the window was covered up
+        ThisTime = OGGetAbsoluteTime();
+        if( emuPresentDirty || ThisTime > LastRefreshTime + EMU_REFRESH_S )
+        {
+            CNFGClearFrame();
+            CNFGColor( 0xFFFFFF );
+            CNFGUpdateScreenWithBitmap( rawvidmem, OLED_WIDTH * px_scale, (HEADER_PIXELS + OLED_HEIGHT + FOOTER_PIXELS)*px_scale  );
+            emuPresentDirty = false;
+            LastRefreshTime = ThisTime;
+        }
 
         frames++;
         //CNFGSwapBuffers();
 
-        ThisTime = OGGetAbsoluteTime();
         if( ThisTime > LastFPSTime + 1 )
         {
             // printf( "FPS: %d\n", frames );
@@ -415,6 +707,7 @@ void emuCheckResize()
     }
 
     return(0);
+#endif
 }
 
 
@@ -497,9 +790,25 @@ int os_sprintf(char* str, const char* format, ...)
     return 0;
 };
 void LoadDefaultPartitionMap(void) {}
-uint32 system_get_time(void)
+
+/**
+ * @brief Get the emulated time since boot. Headless builds run on a virtual
+ * clock instead of the host's clock
+ *
+ * @return The time since boot, in microseconds
+ */
+static uint64_t emuGetTimeUs( void )
 {
+#ifdef EMU_HEADLESS
+    return emuVirtualTimeUs;
+#else
     return (OGGetAbsoluteTime() - boottime) * 1000000;
+#endif
+}
+
+uint32 system_get_time(void)
+{
+    return emuGetTimeUs();
 }
 
 struct rst_info srst =
@@ -523,14 +832,34 @@ struct rst_info* system_get_rst_info(void)
     return &srst;
 }
 
+// When set, RTC memory is kept here instead of in rtc.dat
+static uint8_t* rtcScratch = NULL;
+
+/**
+ * @brief Keep RTC memory in a cleared copy instead of rtc.dat, which is then
+ * never read or written. For replaying a trace from the RTC memory it was
+ * recorded with. Must be called before anything uses RTC memory
+ *
+ * @return The copy, EMU_RTC_SIZE bytes, to be filled in by the caller
+ */
+uint8_t* emuRtcScratch( void )
+{
+    if( NULL == rtcScratch )
+    {
+        rtcScratch = malloc( EMU_RTC_SIZE );
+    }
+    memset( rtcScratch, 0, EMU_RTC_SIZE );
+    return rtcScratch;
+}
+
 static void system_rtc_init()
 {
     FILE* f = fopen( "rtc.dat", "wb" );
     if( f )
     {
-        uint8_t* raw = malloc(512);
-        memset( raw, 0, 512 );
-        fwrite( raw, 512, 1, f );
+        uint8_t* raw = malloc(EMU_RTC_SIZE);
+        memset( raw, 0, EMU_RTC_SIZE );
+        fwrite( raw, EMU_RTC_SIZE, 1, f );
         fclose( f );
         free( raw );
     }
@@ -543,13 +872,29 @@ static void system_rtc_init()
 
 bool system_rtc_mem_write(uint8 des_addr, const void* src_addr, uint16 save_size)
 {
-    FILE* f = fopen( "rtc.dat", "wb+" );
+    if( NULL != rtcScratch )
+    {
+        if( des_addr + save_size > EMU_RTC_SIZE )
+        {
+            return false;
+        }
+        memcpy( &rtcScratch[des_addr], src_addr, save_size );
+        return true;
+    }
+
+    // Open for update, "wb+" would truncate everything else in the file
+    FILE* f = fopen( "rtc.dat", "rb+" );
+    if( !f )
+    {
+        system_rtc_init();
+        f = fopen( "rtc.dat", "rb+" );
+    }
     if( !f )
     {
         fprintf( stderr, "EMU Error: Could not open rtc.dat for reading/writing\n" );
         return false;
     }
-    fseek( f, SEEK_SET, des_addr );
+    fseek( f, des_addr, SEEK_SET );
     fwrite( src_addr, save_size, 1, f );
     fclose( f );
     return true;
@@ -557,6 +902,16 @@ bool system_rtc_mem_write(uint8 des_addr, const void* src_addr, uint16 save_size
 
 bool system_rtc_mem_read(uint8 src_addr, void* des_addr, uint16 load_size)
 {
+    if( NULL != rtcScratch )
+    {
+        if( src_addr + load_size > EMU_RTC_SIZE )
+        {
+            return false;
+        }
+        memcpy( des_addr, &rtcScratch[src_addr], load_size );
+        return true;
+    }
+
     FILE* f = fopen( "rtc.dat", "rb" );
     if( !f )
     {
@@ -567,7 +922,7 @@ bool system_rtc_mem_read(uint8 src_addr, void* des_addr, uint16 load_size)
     {
         return false;
     }
-    fseek( f, SEEK_SET, src_addr );
+    fseek( f, src_addr, SEEK_SET );
     if( fread( des_addr, load_size, 1, f ) != 1 )
     {
         fprintf( stderr, "EMU Error: Could not load data out of rtc.dat\n" );
@@ -610,7 +965,7 @@ void ws2812_push( uint8_t* buffer, uint16_t buffersize )
         col |= (buffer[led * 3 + 0] * 240 / 255 + 15) << 8; // g
         col |= (buffer[led * 3 + 2] * 240 / 255 + 15) << 0; // b
         ws2812s[led] = col;
-#ifdef LINUX
+#if defined(LINUX) && !defined(EMU_HEADLESS)
         swadgeshm_video_data[4 + led] = col;
 #endif
     }
@@ -618,39 +973,13 @@ void ws2812_push( uint8_t* buffer, uint16_t buffersize )
 
 ///////////////////////////////////////////////////////////////////////////////////////
 
-void* os_malloc( int x )
-{
-    // Allocate some space
-    void* ptr = malloc( x );
-    // Fill the pointer with garbage, ESP-style
-    if(NULL != ptr)
-    {
-        for( int i = 0; i < x; i++ )
-        {
-            ((uint8_t*)ptr)[i] = rand() & 0xff;
-        }
-    }
-    // Return the space
-    return ptr;
-}
-void* os_zalloc( int x )
-{
-    void* ptr = malloc( x );
-    if(NULL != ptr)
-    {
-        memset(ptr, 0, x);
-    }
-    return ptr;
-}
-void os_free( void* x )
-{
-    free( x );
-}
+// os_malloc(), os_zalloc() and os_free() are in emu_heap.c
 
 ////////////////////////////////////////////////////////////////////////////////////////
 // Sound system (need to write)
 #include "sound/sound.h"
 struct SoundDriver* sounddriver;
+const char* emuSoundDriver = NULL;
 #define SSBUF 8192
 uint8_t ssamples[SSBUF];
 int sshead;
@@ -679,30 +1008,56 @@ int getIsMutedOption();
     #define BZR_PRINTF LOGI
 #endif
 
+/**
+ * @brief Queue a sample from the mic for getSample(), like the ADC does
+ *
+ * @param v The sample, signed 16 bit
+ * @return true if it was queued, false if the queue was full
+ */
+bool emuMicPush( int16_t v )
+{
+    if( sstail == (( sshead + 1 ) % SSBUF) )
+    {
+        emuStats.micDropped++;
+        return false;
+    }
+    ssamples[sshead] = (v / 256) + 128;
+    sshead = ( sshead + 1 ) % SSBUF;
+
+    uint32_t queued = ( sshead + SSBUF - sstail ) % SSBUF;
+    if( queued > emuStats.micMaxQueued )
+    {
+        emuStats.micMaxQueued = queued;
+    }
+    // The queue is bigger than the swadge's, which drops samples once it's full
+    if( queued > HPABUFFSIZE - 1 )
+    {
+        emuStats.micOverHw++;
+    }
+    return true;
+}
+
 void EMUSoundCBType( struct SoundDriver* sd, short* in, short* out, int samplesr, int samplesp )
 {
     int i;
-    if( samplesr )
+    // A recording replaces the host's mic, see emu_mic.c
+    if( samplesr && !emuMicReplaying() )
     {
         for( i = 0; i < samplesr; i++ )
         {
-            if( sstail != (( sshead + 1 ) % SSBUF) )
-            {
-                int v = in[i];
+            int v = in[i];
 #ifdef ANDROID
-                v *= 5;
-                if( v > 32767 )
-                {
-                    v = 32767;
-                }
-                else if( v < -32768 )
-                {
-                    v = -32768;
-                }
-#endif
-                ssamples[sshead] = (v / 256) + 128;
-                sshead = ( sshead + 1 ) % SSBUF;
+            v *= 5;
+            if( v > 32767 )
+            {
+                v = 32767;
+            }
+            else if( v < -32768 )
+            {
+                v = -32768;
             }
+#endif
+            emuMicPush( v );
         }
     }
 
@@ -736,35 +1091,58 @@ void initMic(void)
     }
     if( !sounddriver )
     {
-        sounddriver = InitSound( 0, EMUSoundCBType, 16000, 1, 1, 256, 0, 0 );
+        sounddriver = InitSound( emuSoundDriver, EMUSoundCBType, 16000, 1, 1, 256, 0, 0 );
     }
+    emuMicStart();
 }
 
 uint8_t getSample(void)
 {
-    if( sshead != sstail )
+    uint8_t r = 0;
+    if( !sampleAvailable() )
     {
-        uint8_t r = ssamples[sstail];
-        sstail = (sstail + 1) % SSBUF;
-        return r;
+        emuStats.micUnderruns++;
     }
-    else
+    // A replayed trace has its own samples, see emu_trace.c
+    if( !emuTraceReplaying() && sshead != sstail )
     {
-        return 0;
+        r = ssamples[sstail];
+        sstail = (sstail + 1) % SSBUF;
     }
+    return emuTraceMic( r );
 }
 
 bool sampleAvailable(void)
 {
+    if( emuTraceReplaying() )
+    {
+        return emuTraceMicAvailable();
+    }
     return sstail != sshead;
 }
 
+uint16_t samplesQueued(void)
+{
+    if( emuTraceReplaying() )
+    {
+        return emuTraceMicQueued();
+    }
+    return ( sshead + SSBUF - sstail ) % SSBUF;
+}
+
+void getMicStats(micStats_t* stats)
+{
+    stats->overruns = emuStats.micDropped + emuStats.micOverHw;
+    stats->underruns = emuStats.micUnderruns;
+    stats->highWater = emuStats.micMaxQueued;
+}
+
 void initBuzzer(void)
 {
     stopBuzzerSong();
     if( !sounddriver )
     {
-        sounddriver = InitSound( 0, EMUSoundCBType, 16000, 1, 1, 256, 0, 0 );
+        sounddriver = InitSound( emuSoundDriver, EMUSoundCBType, 16000, 1, 1, 256, 0, 0 );
     }
 
     // Keep it high in the idle state
@@ -925,6 +1303,7 @@ void setGpiosForBoot(void)
 #ifndef ANDROID
 void QMA6981_poll(accel_t* currentAccel)
 {
+    emuTraceAccel( currentAccel );
 }
 
 bool QMA6981_setup(void)
@@ -935,49 +1314,134 @@ bool QMA6981_setup(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-ETSTimer* etsTimerList = NULL;
+/*
+ * Armed timers are kept in a binary min-heap ordered by the absolute time, in
+ * milliseconds, they next expire. Arming and disarming are O(log n) and
+ * checking the timers only looks at the ones which are due, so long gaps
+ * between checks cost nothing when nothing expires.
+ *
+ * Timers which expire in the same millisecond fire in the order they were
+ * first armed, like the linked list this replaced. Re-arming an armed timer
+ * keeps its place in that order.
+ */
+static ETSTimer** timerHeap = NULL;
+static uint32_t timerHeapLen = 0;
+static uint32_t timerHeapCap = 0;
+static uint32_t timerSeq = 0;
+
+/// The time, in milliseconds, up to which timers have been processed
+static uint32_t timerNowMs = 0;
+static bool timerClockStarted = false;
 
 /**
- * Disarm the timer
- *
- * @param ptimer timer structure.
+ * @return The time which timers are armed relative to. This is the current
+ * time outside of callbacks, and the callback's deadline inside of them
  */
-void ets_timer_disarm(ETSTimer* ptimer)
+static uint32_t emuTimerNowMs(void)
 {
-    ptimer->timer_expire = 0;
-    ptimer->timer_period = 0;
+    if(!timerClockStarted)
+    {
+        timerNowMs = emuGetTimeUs() / 1000;
+        timerClockStarted = true;
+    }
+    return timerNowMs;
+}
 
-    // Unlink timer. Check if it's the head of the list
-    if(NULL == etsTimerList)
+/**
+ * @return true if timer a should fire before timer b. Deadlines are compared
+ * with wraparound so the clock can run for more than 49 days
+ */
+static bool emuTimerBefore(const ETSTimer* a, const ETSTimer* b)
+{
+    int32_t diff = (int32_t)(a->timer_expire - b->timer_expire);
+    if(diff != 0)
     {
-        // Nothing to unlink
-        return;
+        return diff < 0;
     }
-    else if(etsTimerList == ptimer)
+    return a->timer_seq < b->timer_seq;
+}
+
+/**
+ * Put a timer at a heap position and record the position in the timer
+ */
+static void emuTimerPlace(ETSTimer* tmr, uint32_t idx)
+{
+    timerHeap[idx] = tmr;
+    tmr->timer_heap_idx = idx + 1;
+}
+
+/**
+ * Move the timer at a heap position towards the root or the leaves until the
+ * heap is ordered again
+ */
+static void emuTimerSift(uint32_t idx)
+{
+    ETSTimer* tmr = timerHeap[idx];
+
+    // Towards the root
+    while(idx > 0 && emuTimerBefore(tmr, timerHeap[(idx - 1) / 2]))
     {
-        // Timer is at the head, simple to remove
-        etsTimerList = etsTimerList->timer_next;
+        emuTimerPlace(timerHeap[(idx - 1) / 2], idx);
+        idx = (idx - 1) / 2;
     }
-    else
+
+    // Towards the leaves
+    while(true)
     {
-        // Timer is not at the head.
-        // Iterate through the list, looking for a timer to remove
-        ETSTimer* tmr = etsTimerList;
-        while(NULL != tmr)
+        uint32_t child = 2 * idx + 1;
+        if(child >= timerHeapLen)
         {
-            if(ptimer == tmr->timer_next)
-            {
-                // Timer is next, so unlink it
-                tmr->timer_next = tmr->timer_next->timer_next;
-                return;
-            }
-            else
-            {
-                // Iterate to the next
-                tmr = tmr->timer_next;
-            }
+            break;
+        }
+        if(child + 1 < timerHeapLen && emuTimerBefore(timerHeap[child + 1], timerHeap[child]))
+        {
+            child++;
+        }
+        if(!emuTimerBefore(timerHeap[child], tmr))
+        {
+            break;
+        }
+        emuTimerPlace(timerHeap[child], idx);
+        idx = child;
+    }
+
+    emuTimerPlace(tmr, idx);
+}
+
+/**
+ * @return true if the timer is in the heap. The index is checked against the
+ * heap because timers may live in uninitialized or reused memory
+ */
+static bool emuTimerIsArmed(const ETSTimer* ptimer)
+{
+    return ptimer->timer_heap_idx > 0 &&
+           ptimer->timer_heap_idx <= timerHeapLen &&
+           timerHeap[ptimer->timer_heap_idx - 1] == ptimer;
+}
+
+/**
+ * Disarm the timer
+ *
+ * @param ptimer timer structure.
+ */
+void ets_timer_disarm(ETSTimer* ptimer)
+{
+    if(emuTimerIsArmed(ptimer))
+    {
+        // Move the last timer into this one's place and reorder it
+        uint32_t idx = ptimer->timer_heap_idx - 1;
+        timerHeapLen--;
+        if(idx != timerHeapLen)
+        {
+            emuTimerPlace(timerHeap[timerHeapLen], idx);
+            emuTimerSift(idx);
         }
     }
+
+    ptimer->timer_expire = 0;
+    ptimer->timer_period = 0;
+    ptimer->timer_heap_idx = 0;
+    ptimer->timer_seq = 0;
 }
 
 /**
@@ -1014,130 +1478,92 @@ void ets_timer_arm_new(ETSTimer* ptimer, int milliseconds, int repeat_flag,
         return;
     }
 
-    if(NULL == etsTimerList)
-    {
-        // List is empty, set this timer as the head
-        etsTimerList = ptimer;
-        ptimer->timer_next = NULL;
-    }
-    else if (ptimer == etsTimerList)
+    ptimer->timer_expire = emuTimerNowMs() + milliseconds;
+    if(repeat_flag)
     {
-        // The first element of the list is the timer, don't add it twice
+        ptimer->timer_period = milliseconds;
     }
     else
     {
-        // List isn't empty and the head isn't this timer
-        ETSTimer* tmr = etsTimerList;
-        // Also check if the timer is already linked
-        bool alreadyExists = false;
-        // Iterate to the last element
-        while(NULL != tmr->timer_next)
-        {
-            if(tmr->timer_next == ptimer)
-            {
-                // This timer is already linked in the list!
-                alreadyExists = true;
-                break;
-            }
-            else
-            {
-                tmr = tmr->timer_next;
-            }
-        }
-
-        // If the timer wasn't in the list, link it
-        if(false == alreadyExists)
-        {
-            tmr->timer_next = ptimer;
-            ptimer->timer_next = NULL;
-        }
+        ptimer->timer_period = 0;
     }
 
-    // Timer was linked, now set up the params
-    ptimer->timer_expire = milliseconds;
-    if(repeat_flag)
+    if(emuTimerIsArmed(ptimer))
     {
-        ptimer->timer_period = milliseconds;
+        // Already armed, keep its sequence and move it to the new deadline
+        emuTimerSift(ptimer->timer_heap_idx - 1);
+        return;
     }
-    else
+
+    if(timerHeapLen == timerHeapCap)
     {
-        ptimer->timer_period = 0;
+        timerHeapCap = timerHeapCap ? timerHeapCap * 2 : 16;
+        timerHeap = realloc(timerHeap, timerHeapCap * sizeof(ETSTimer*));
     }
+    ptimer->timer_seq = ++timerSeq;
+    emuTimerPlace(ptimer, timerHeapLen++);
+    emuTimerSift(timerHeapLen - 1);
 }
 
 /**
- * Check if timers have expired and call them. This will reset periodic
- * timers and unlink non-periodic timers when they expire.
+ * Call every timer which has expired since the last check, in deadline order.
+ * Periodic timers are re-armed for their next period and one-shot timers are
+ * disarmed before their callbacks are called.
  */
 void ets_timer_check_timers(void)
 {
-    // Keep the last time this function was called
-    static long long timeMs = -1;
+    uint32_t currTimeMs = emuGetTimeUs() / 1000;
 
-    // Get the current time in milliseconds
-    long long currTimeMs = (OGGetAbsoluteTime() - boottime) * 1000;
-
-    // If time hasn't been initialized yet
-    if(timeMs == -1)
+    // The first call only starts the clock
+    if(!timerClockStarted)
     {
-        // Initialize it
-        timeMs = currTimeMs;
+        emuTimerNowMs();
+        return;
     }
-    else
+
+    // Jump straight from deadline to deadline
+    while(timerHeapLen > 0 && (int32_t)(timerHeap[0]->timer_expire - currTimeMs) <= 0)
     {
-        // While at least 1ms has elapsed
-        while(timeMs != currTimeMs)
-        {
-            // Increment the static time
-            timeMs++;
+        ETSTimer* tmr = timerHeap[0];
 
-            // Iterate through all the timers
-            ETSTimer* tmr = etsTimerList;
-            while(NULL != tmr)
-            {
-                // If this timer is active
-                if(tmr->timer_expire > 0)
-                {
-                    // Decrement the count
-                    tmr->timer_expire--;
-                    // If the timer expired
-                    if(tmr->timer_expire == 0)
-                    {
-                        // Save the timer function and args
-                        ETSTimerFunc* pfunction = tmr->timer_func;
-                        void* parg = tmr->timer_arg;
-
-                        // If the timer should repeat
-                        if(tmr->timer_period)
-                        {
-                            // Reset the count
-                            tmr->timer_expire = tmr->timer_period;
-                        }
-                        else
-                        {
-                            // Disarm non-repeating timers
-                            ets_timer_disarm(tmr);
-                        }
-
-                        // Call the timer function
-                        pfunction(parg);
-                    }
-                }
+        // Anything the callback arms is relative to when this timer expired
+        timerNowMs = tmr->timer_expire;
 
-                // Iterate to the next
-                tmr = tmr->timer_next;
-            }
+        // Save the timer function and args
+        ETSTimerFunc* pfunction = tmr->timer_func;
+        void* parg = tmr->timer_arg;
+
+        if(tmr->timer_period)
+        {
+            // Reset the deadline, keeping the timer's sequence
+            tmr->timer_expire += tmr->timer_period;
+            emuTimerSift(0);
+        }
+        else
+        {
+            // Disarm non-repeating timers
+            ets_timer_disarm(tmr);
         }
+
+        // Call the timer function
+        pfunction(parg);
     }
+
+    timerNowMs = currTimeMs;
 }
 
 #define NUM_OS_TASKS 3
 
+/**
+ * Each task's queue is a ring buffer. Events are read from qHead and written
+ * qElems after it, so posting and dispatching never move the queue around
+ */
 struct taskAndQueue
 {
     os_task_t task;
     os_event_t* queue;
     uint8 qlen;
+    uint8 qHead;
     uint8 qElems;
 } os_tasks[NUM_OS_TASKS] = {{0}};
 
@@ -1160,6 +1586,14 @@ bool system_os_task(os_task_t task, uint8 prio, os_event_t* queue, uint8 qlen)
         return false;
     }
 
+    // A different queue starts empty. Re-registering the same queue keeps
+    // whatever is pending in it
+    if(os_tasks[prio].queue != queue || os_tasks[prio].qlen != qlen)
+    {
+        os_tasks[prio].qHead = 0;
+        os_tasks[prio].qElems = 0;
+    }
+
     // Save the task, overwriting anything that exists
     os_tasks[prio].task = task;
     os_tasks[prio].queue = queue;
@@ -1171,12 +1605,11 @@ bool system_os_task(os_task_t task, uint8 prio, os_event_t* queue, uint8 qlen)
 /**
  * @brief Post a signal & parameter to a system OS task
  *
- * @param task  task function
  * @param prio  task priority. Three priorities are supported: 0/1/2; 0 is the
- *              lowest priority. This means only 3 tasks are allowed to be set up.
- * @param queue message queue pointer
- * @param qlen  message queue depth
- * @return true if the task was registered, false if it was not
+ *              lowest priority.
+ * @param sig   the signal for the event
+ * @param par   the parameter for the event
+ * @return true if the event was queued, false if the queue is full
  */
 bool system_os_post(uint8 prio, os_signal_t sig, os_param_t par)
 {
@@ -1187,69 +1620,144 @@ bool system_os_post(uint8 prio, os_signal_t sig, os_param_t par)
         return false;
     }
 
-    // Add this signal and parameter to the end of the task's queue
-    os_tasks[prio].queue[os_tasks[prio].qElems].par = par;
-    os_tasks[prio].queue[os_tasks[prio].qElems].sig = sig;
-    os_tasks[prio].qElems++;
+    // Add this signal and parameter to the tail of the task's queue
+    struct taskAndQueue* tq = &os_tasks[prio];
+    // Wider than the queue's fields, qHead + qElems can pass 255
+    uint16_t tail = tq->qHead + tq->qElems;
+    if(tail >= tq->qlen)
+    {
+        tail -= tq->qlen;
+    }
+    tq->queue[tail].par = par;
+    tq->queue[tail].sig = sig;
+    tq->qElems++;
     return true;
 }
 
 /**
- * @brief Check for and dispatch any events to the OS tasks
+ * @brief Count the host time and estimated hardware time of one OS task run
+ *
+ * @param seconds How long it took
+ * @param costNs  How long the cost model estimates it would take on hardware
+ * @param drew    true if it drew a frame
  */
-void system_os_check_tasks(void)
+static void emuTaskTime( double seconds, uint64_t costNs, bool drew )
+{
+    emuStats.taskRuns++;
+    emuStats.taskTime += seconds;
+    emuStats.taskCostNs += costNs;
+    if( costNs / 1000 > emuStats.taskCostWorstUs )
+    {
+        emuStats.taskCostWorstUs = costNs / 1000;
+    }
+    if( !drew && costNs / 1000 > emuStats.taskCostWorstNoFrameUs )
+    {
+        emuStats.taskCostWorstNoFrameUs = costNs / 1000;
+    }
+    if( seconds > emuStats.taskWorst )
+    {
+        emuStats.taskWorst = seconds;
+    }
+    if( !drew && seconds > emuStats.taskWorstNoFrame )
+    {
+        emuStats.taskWorstNoFrame = seconds;
+    }
+
+    uint32_t bucket = 0;
+    while( bucket < EMU_TASK_HIST_BUCKETS - 1 && seconds * 1000000.0 >= ( 1 << bucket ) )
+    {
+        bucket++;
+    }
+    emuStats.taskHist[bucket]++;
+}
+
+/**
+ * @brief Dispatch the event at the head of each OS task's queue, if there is
+ * one
+ *
+ * @return The number of events dispatched
+ */
+static uint32_t emuDispatchOsTasks(void)
 {
-    // Service all tasks from high priority to low
+    uint32_t dispatched = 0;
+
+    // Mic samples come from the ADC's interrupt on the ESP
+    emuMicPoll();
+
+    // ESP-NOW callbacks come from the SDK's own task on the ESP
+    emuEspNowPoll();
+
+    // Service each task once, lowest priority first
     for(uint8_t i = 0; i < NUM_OS_TASKS; i++)
     {
+        struct taskAndQueue* tq = &os_tasks[i];
+
         // If there is some event in the event queue
-        if(os_tasks[i].qElems > 0)
+        if(tq->qElems > 0)
         {
-            // Create an event with the signal and parameter from the task queue
+            // Pop the event at the head. The task may post to its own queue,
+            // so take it off before dispatching
             ETSEvent evt =
             {
-                .sig = os_tasks[i].queue[0].sig,
-                .par = os_tasks[i].queue[0].par
+                .sig = tq->queue[tq->qHead].sig,
+                .par = tq->queue[tq->qHead].par
             };
-
-            // If the queue has space for more than one element
-            if(os_tasks[i].qlen > 1)
+            tq->qHead++;
+            if(tq->qHead == tq->qlen)
             {
-                // Shift all but the first element up one
-                memmove(&os_tasks[i].queue[0], &os_tasks[i].queue[1], os_tasks[i].qlen - 1);
+                tq->qHead = 0;
             }
-            // Zero out the last element
-            os_tasks[i].queue[os_tasks[i].qlen - 1].sig = 0;
-            os_tasks[i].queue[os_tasks[i].qlen - 1].par = 0;
-            os_tasks[i].qElems--;
-
-            // Dispatch this event
-            os_tasks[i].task(&evt);
+            tq->qElems--;
+
+            // Dispatch this event, timing it. A run which doesn't draw a
+            // frame is mostly the mic's samples and what the mode does with them
+            uint32_t frames = emuStats.costFrames;
+            uint64_t costStart = emuCostElapsedNs();
+            double start = emuGetPerfTime();
+            tq->task(&evt);
+            emuTaskTime( emuGetPerfTime() - start, emuCostElapsedNs() - costStart, frames != emuStats.costFrames );
+            dispatched++;
         }
     }
+    return dispatched;
 }
 
-/** Prints heap size for ESP, does nothing for EMU */
-uint32 system_get_free_heap_size(void)
+/**
+ * @brief Check for and dispatch any events to the OS tasks
+ */
+void system_os_check_tasks(void)
 {
-    return 0;
+    emuDispatchOsTasks();
 }
 
-/////////////////////////////////////////////////////////////////////////////////////////////////
-
-void espNowInit(void)
+/**
+ * @brief Drain mode. Run the timers and dispatch OS task events until the
+ * queues are empty or budgetS host seconds have passed. Tasks which repost
+ * themselves, like procTask(), run as fast as the host allows instead of once
+ * per emulator frame
+ *
+ * @param budgetS The most host time to spend, in seconds
+ * @return The number of events dispatched
+ */
+uint32_t emuDrainOsTasks(double budgetS)
 {
-    fprintf( stderr, "EMU Warning: TODO: need to implement espNow as a broadcast UDP system\n" );
+    double endTime = emuGetPerfTime() + budgetS;
+    uint32_t dispatched = 0;
+    uint32_t round;
+    do
+    {
+        ets_timer_check_timers();
+        round = emuDispatchOsTasks();
+        dispatched += round;
+    } while(round > 0 && emuGetPerfTime() < endTime);
+    return dispatched;
 }
 
-void espNowDeinit()
-{
-}
+// system_get_free_heap_size() is in emu_heap.c
 
-void ICACHE_FLASH_ATTR espNowSend(const uint8_t* data, uint8_t len)
-{
-    fprintf( stderr, "EMU Warning: TODO: need to implement espNow as a broadcast UDP system\n" );
-}
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+// espNowInit(), espNowDeinit() and espNowSend() are in emu_espnow.c
 
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1275,78 +1783,7 @@ bool system_deep_sleep(uint64 time_in_us)
 
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
-//XXX TODO: Handle this more gracefully and test it.
-
-
-static void system_flash_init()
-{
-    FILE* f = fopen( "flash.dat", "wb" );
-    if( f )
-    {
-        uint8_t* raw = malloc(1024 * 1024 * 2);
-        memset( raw, 0, 1024 * 1024 * 2 );
-        fwrite( raw, 1024 * 1024 * 2, 1, f );
-        fclose( f );
-        free( raw );
-    }
-    else
-    {
-        fprintf( stderr, "EMU Error: Could not open rtc.dat for reading/writing\n" );
-    }
-}
-
-
-SpiFlashOpResult spi_flash_erase_sector(uint16 sec)
-{
-    FILE* f = fopen( "flash.dat", "wb+" );
-    if( !f )
-    {
-        fprintf( stderr, "EMU Error: Could not open rtc.dat for reading/writing\n" );
-        return SPI_FLASH_RESULT_ERR;
-    }
-    fseek( f, SEEK_SET, sec *  SPI_FLASH_SEC_SIZE );
-    uint8_t* erased = malloc(  SPI_FLASH_SEC_SIZE );
-    memset( erased, 0xff, SPI_FLASH_SEC_SIZE );
-    fwrite( erased, SPI_FLASH_SEC_SIZE, 1, f );
-    free( erased );
-    fclose( f );
-    return SPI_FLASH_RESULT_OK;
-}
-
-SpiFlashOpResult spi_flash_write(uint32 des_addr, uint32* src_addr, uint32 size)
-{
-    FILE* f = fopen( "flash.dat", "wb+" );
-    if( !f )
-    {
-        fprintf( stderr, "EMU Error: Could not open rtc.dat for reading/writing\n" );
-        return SPI_FLASH_RESULT_ERR;
-    }
-    fseek( f, SEEK_SET, des_addr );
-    fwrite( src_addr, size, 1, f );
-    fclose( f );
-    return SPI_FLASH_RESULT_OK;
-}
-
-SpiFlashOpResult spi_flash_read(uint32 src_addr, uint32* des_addr, uint32 size)
-{
-    FILE* f = fopen( "flash.dat", "rb" );
-    if( !f )
-    {
-        system_flash_init();
-        f = fopen( "flash.dat", "rb" );
-    }
-
-    if( !f )
-    {
-        fprintf( stderr, "EMU Error: Could not open flash.dat for reading/writing\n" );
-        return SPI_FLASH_RESULT_ERR;
-    }
-
-    fseek( f, SEEK_SET, src_addr );
-    int success = fread( des_addr, size, 1, f );
-    fclose( f );
-    return (success == 1) ? SPI_FLASH_RESULT_OK : SPI_FLASH_RESULT_ERR;
-}
+// spi_flash_erase_sector(), spi_flash_write() and spi_flash_read() are in emu_flash.c
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 // Required functions
@@ -1369,6 +1806,7 @@ void HandleButtonStatus( int button, int bDown )
         }
         gpio_status &= ~(1 << button);
     }
+    emuTraceButton( button, bDown );
     HandleButtonEventIRQ( gpio_status, button, (bDown) ? 1 : 0 );
 }
 
@@ -1431,7 +1869,7 @@ void HandleDestroy()
         OGDeleteMutex(buzzernotemutex);
     }
 
-#ifdef LINUX
+#if defined(LINUX) && !defined(EMU_HEADLESS)
     // Unmap old memory
     munmap(swadgeshm_video_data, swadgeshm_video_data_size);
     munmap(swadgeshm_input_data, 10);
@@ -1456,12 +1894,8 @@ void HandleDestroy()
 
 bool wifi_get_macaddr(uint8 if_index, uint8* macaddr)
 {
-    static bool warned = false;
-    if(!warned)
-    {
-        warned = true;
-        fprintf( stderr, "EMU Warning: %s not implemented\n", __func__);
-    }
+    // Both interfaces share the emulated MAC address used for ESP-NOW
+    emuEspNowGetMac(macaddr);
     return true;
 }
 
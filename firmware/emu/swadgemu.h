@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include "c_types.h"
 #include "display/oled.h"
+#include "user_main.h"
 
 //Configuration
 #define WS_HEIGHT 10
@@ -17,11 +18,114 @@
 extern int px_scale;
 extern uint32_t * rawvidmem;
 extern short screenx, screeny;
+extern uint32_t headerpix[HEADER_PIXELS*OLED_WIDTH];
 extern uint32_t footerpix[FOOTER_PIXELS*OLED_WIDTH];
 extern uint32_t ws2812s[NR_WS2812];
 extern double boottime;
 extern uint8_t gpio_status;
 
+/// Counters of work with a fixed cost on hardware, see emu_cost.c
+typedef enum
+{
+    EMU_COST_I2C_BYTE,     ///< Bytes sent to the OLED over I2C
+    EMU_COST_PIXEL,        ///< Pixels written with drawPixel() and friends
+    EMU_COST_PNG_PIXEL,    ///< Pixels decoded by decodePngAsset(), or gathered from a decoded PNG's rows
+    EMU_COST_GIF_BYTE,     ///< Bytes of gif delta decompressed
+    EMU_COST_FB_COLUMN,    ///< Framebuffer columns drawn a byte at a time, by fills, sprites and decoded PNGs
+    EMU_COST_FB_BYTE,      ///< Framebuffer bytes written by those columns
+    EMU_COST_FLASH_WORD,   ///< 32 bit words of assets read straight from mapped flash
+    EMU_COST_AUDIO_SAMPLE, ///< Mic samples filtered by procTask()
+    EMU_COST_AUDIO_CALL,   ///< Calls to a mode's audio hook, or to push samples into the DFT
+    EMU_COST_DFT_BIN,      ///< DFT32 bins updated, decayed or turned into output bins
+    EMU_COST_FRAME_UNIT,   ///< Units of colorchord's note tracking done by StepFrameInfo()
+    EMU_COST_NUM_BUILTIN
+} emuCost_t;
+
+/// Where the estimated frame time goes
+typedef enum
+{
+    EMU_COST_KIND_I2C,
+    EMU_COST_KIND_PIXEL,
+    EMU_COST_KIND_DECODE,
+    EMU_COST_KIND_FLASH,
+    EMU_COST_KIND_AUDIO,
+    EMU_COST_KIND_NAMED, ///< Counted with emuCostCount()
+    EMU_COST_KINDS
+} emuCostKind_t;
+
+/// Estimated frame time buckets, up to 1, 2, 4, 8, 16 and 33.3ms, then overruns
+#define EMU_COST_HIST_BUCKETS 7
+
+/// The emulated SPI flash chip's size, kept in flash.dat
+#define EMU_FLASH_SIZE (2 * 1024 * 1024)
+/// Bytes of RTC memory kept in rtc.dat
+#define EMU_RTC_SIZE 512
+
+/// Host time buckets for each OS task run, up to 1, 2, 4 ... 512us, then more
+#define EMU_TASK_HIST_BUCKETS 11
+
+/**
+ * Counters for work the emulated firmware asks of the hardware. These are
+ * accumulated while a swadge mode runs and are printed and cleared by
+ * emuReportModeStats() when the mode exits
+ */
+typedef struct
+{
+    uint32_t oledFrames;    ///< Number of updateOLED() calls which sent data
+    uint32_t oledSpans;     ///< Number of address windows set on the OLED
+    uint32_t oledDataBytes; ///< Number of bytes pushed through SendByteFast()
+    uint32_t oledScans;     ///< Number of framebuffer difference scans
+    double oledScanTime;    ///< Host seconds spent in difference scans
+    uint32_t pngRamBytes;   ///< Bytes of PNG data loaded to the heap
+    uint32_t pngFlashBytes; ///< Bytes of PNG data drawn in place from flash
+    uint32_t flashErases;   ///< Number of SPI flash sectors erased
+    uint32_t flashWrites;   ///< Number of spi_flash_write() calls
+    uint32_t flashWriteBytes; ///< Bytes programmed to SPI flash
+    uint32_t flashUnerasedWrites; ///< Writes which tried to set bits without an erase
+    uint32_t flashReads;    ///< Number of spi_flash_read() calls
+    uint32_t flashReadBytes; ///< Bytes read from SPI flash
+    uint64_t flashBusyNs;   ///< Modeled time the SPI flash was busy
+    uint64_t flashLongestNs; ///< Modeled time of the longest SPI flash operation
+    uint32_t espNowSent;    ///< ESP-NOW frames broadcast
+    uint32_t espNowSentBytes; ///< ESP-NOW payload bytes broadcast
+    uint32_t espNowReceived; ///< ESP-NOW frames delivered to the mode
+    uint32_t espNowReceivedBytes; ///< ESP-NOW payload bytes delivered to the mode
+    uint32_t espNowDropped; ///< ESP-NOW frames lost by the link model
+    uint32_t espNowFirstRxUs; ///< Time from espNowInit() to the first frame delivered
+    uint32_t costFrames;    ///< Frames with an estimated hardware cost
+    uint32_t costOverruns;  ///< Frames estimated to overrun the render window
+    uint32_t costWorstUs;   ///< Estimated time of the slowest frame
+    uint32_t costHist[EMU_COST_HIST_BUCKETS]; ///< Estimated frame time histogram
+    uint64_t costNs[EMU_COST_KINDS]; ///< Estimated time spent on each kind of work
+    uint32_t heapAllocs;    ///< Calls to os_malloc() and os_zalloc()
+    uint32_t heapFrees;     ///< Calls to os_free()
+    uint32_t heapPeak;      ///< Most device heap in use at once, in bytes
+    uint32_t heapOverLimit; ///< Allocations which wouldn't fit in the device heap
+    uint32_t heapFrames;    ///< Frames allocations were counted for
+    uint32_t heapEntryAllocs; ///< Allocations up to the end of the first frame
+    uint32_t heapFrameAllocs; ///< Allocations in every later frame
+    uint32_t heapFrameAllocsMax; ///< Most allocations in one later frame
+    uint32_t micReplayed;   ///< Samples fed to the mic from a recording
+    uint32_t micDropped;    ///< Mic samples lost because getSample() fell behind
+    uint32_t micMaxQueued;  ///< Most mic samples waiting for getSample()
+    uint32_t micOverHw;     ///< Mic samples which would have overrun the swadge's buffer
+    uint32_t micUnderruns;  ///< getSample() calls with no sample waiting
+    uint32_t micDrains;     ///< procTask() passes which skipped drawing to drain the mic
+    uint32_t taskRuns;      ///< OS task events dispatched, each a procTask() pass
+    double taskTime;        ///< Host seconds spent in OS tasks
+    double taskWorst;       ///< Host seconds of the slowest OS task run
+    double taskWorstNoFrame; ///< Host seconds of the slowest run which didn't draw a frame
+    uint64_t taskCostNs;    ///< Estimated nanoseconds on hardware spent in OS tasks
+    uint32_t taskCostWorstUs; ///< Estimated microseconds on hardware of the slowest run
+    uint32_t taskCostWorstNoFrameUs; ///< Estimated microseconds of the slowest run which didn't draw a frame
+    uint32_t taskHist[EMU_TASK_HIST_BUCKETS]; ///< OS task run time histogram
+} emuStats_t;
+
+extern emuStats_t emuStats;
+extern bool emuPresentDirty; ///< Set when rawvidmem changes, cleared when it's sent to the window
+extern bool emuFlashLatency;
+extern const char* emuSoundDriver; ///< The sound driver to use, NULL for the best one
+
 
 
 
@@ -31,6 +135,55 @@ void emuSendOLEDData( int which_display, uint8_t * currentFb );
 void emuHeader();
 void emuFooter();
 void emuCheckResize();
+void emuReportModeStats( const char* modeName );
+double emuGetPerfTime( void );
+uint32_t emuFlashMostErased( uint16_t* sector );
+const uint8_t* emuFlashImage( void );
+uint8_t* emuFlashScratch( void );
+uint8_t* emuRtcScratch( void );
+void emuEspNowGetMac( uint8_t* mac );
+bool emuEspNowParseArg( int argc, char** argv, int* idx );
+void emuEspNowPoll( void );
+int emuRunBenchmarks( const char* suite );
+bool emuCostParseArg( int argc, char** argv, int* idx );
+void emuCostAdd( emuCost_t which, uint32_t n );
+void emuCostCount( const char* name, uint32_t n );
+void emuCostAddNs( uint64_t ns );
+void emuCostDiscard( void );
+uint64_t emuCostPendingNs( void );
+uint64_t emuCostElapsedNs( void );
+uint32_t emuCostEndFrame( void );
+void emuCostReport( void );
+bool emuHeapParseArg( int argc, char** argv, int* idx );
+void emuHeapEndFrame( void );
+void emuHeapReport( void );
+void emuEndFrame( void );
+bool emuMicParseArg( int argc, char** argv, int* idx );
+bool emuMicReplaying( void );
+const int16_t* emuMicRecording( uint32_t* len );
+void emuMicStart( void );
+void emuMicPoll( void );
+bool emuMicPush( int16_t v );
+bool emuTraceParseArg( int argc, char** argv, int* idx );
+void emuTraceBegin( uint32_t seed, int32_t mode );
+bool emuTraceReplaying( void );
+void emuTraceReplayInfo( int32_t* mode, uint32_t* endMs );
+void emuTraceReplayButtons( void );
+void emuTraceButton( int button, bool down );
+void emuTraceAccel( accel_t* accel );
+bool emuTraceMicAvailable( void );
+uint32_t emuTraceMicQueued( void );
+uint8_t emuTraceMic( uint8_t sample );
+void emuTraceEspNowRecv( const uint8_t* mac, const uint8_t* data, uint8_t len, uint8_t rssi );
+void emuTraceReplayEspNow( uint32_t initTimeUs );
+mt_tx_status emuTraceEspNowSent( mt_tx_status status );
+void emuTraceFrame( uint32_t costUs );
+
+#ifdef EMU_HEADLESS
+extern uint64_t emuVirtualTimeUs;
+int emuRunHeadless( int argc, char** argv );
+void emuHeadlessFrame( const uint8_t* fb );
+#endif
 
 
 #endif
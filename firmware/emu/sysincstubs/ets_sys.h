@@ -66,6 +66,9 @@ typedef struct _ETSTIMER_ {
     uint32_t              timer_period;
     ETSTimerFunc         *timer_func;
     void                 *timer_arg;
+    /* Emulator only, the deadline heap's bookkeeping */
+    uint32_t              timer_heap_idx;
+    uint32_t              timer_seq;
 } ETSTimer;
 
 /* interrupt related */
@@ -6,107 +6,197 @@
  */
 
 #include <osapi.h>
+#include "user_main.h"
 #include "oled.h"
+#include "oled_dirty.h"
 #include "cndraw.h"
+#if defined(EMU)
+    #include "swadgemu.h"
+#endif
 
 /**
- * Fill a rectangular display area with a single color
- *
- * @param x1 The X pixel to start at
- * @param y1 The Y pixel to start at
- * @param x2 The X pixel to end at
- * @param y2 The Y pixel to end at
- * @param c  The color to fill
+ * Ordered dithering patterns for shadeDisplayArea(), one per shadeLevel.
+ * Each byte is the column of pixels (LSB at the top of a page) to draw black
+ * in columns where (x % 4) is the byte's index. All patterns repeat every two
+ * rows, so they line up with the eight row pages.
  */
-void ICACHE_FLASH_ATTR fillDisplayArea(int16_t x1, int16_t y1, int16_t x2, int16_t y2, color c)
+static const uint8_t shadeMasks[5][4] =
 {
-    int16_t x, y;
-    for (x = x1; x <= x2; x++)
-    {
-        for (y = y1; y <= y2; y++)
-        {
-            drawPixel(x, y, c);
-        }
-    }
-}
+    {0x55, 0x00, 0x55, 0x00}, // 25% faded
+    {0xFF, 0x00, 0x55, 0x00}, // 37.5% faded
+    {0x55, 0xAA, 0x55, 0xAA}, // 50% faded
+    {0xFF, 0xFF, 0xFF, 0x00}, // 62.5% faded
+    {0xFF, 0x55, 0xFF, 0x55}, // 75% faded
+};
 
 /**
- * 'Shade' an area by drawing black pixels over it in a ordered-dithering way
+ * Draw a rectangle a whole framebuffer byte at a time. The rectangle is
+ * clipped to the display once, then each page in it gets a single mask.
  *
- * @param x1 The X pixel to start at
- * @param y1 The Y pixel to start at
- * @param x2 The X pixel to end at
- * @param y2 The Y pixel to end at
- * @param shadeLevel The level of shading, Higher means more shaded. Must be 0 to 4
+ * @param x1 The X pixel to start at, inclusive
+ * @param y1 The Y pixel to start at, inclusive
+ * @param x2 The X pixel to end at, inclusive
+ * @param y2 The Y pixel to end at, inclusive
+ * @param c  The color to draw, WHITE, BLACK or INVERSE
+ * @param pattern NULL to draw every pixel, or four column masks, indexed by
+ *                (x % 4), of pixels to draw
  */
-void ICACHE_FLASH_ATTR shadeDisplayArea(int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint8_t shadeLevel)
+static void ICACHE_FLASH_ATTR fillAreaMasked(int16_t x1, int16_t y1, int16_t x2, int16_t y2,
+        color c, const uint8_t* pattern)
 {
-    for(int16_t dy = y1; dy < y2; dy++)
+    if(c != WHITE && c != BLACK && c != INVERSE)
+    {
+        // Transparent colors aren't drawn
+        return;
+    }
+
+    // Clip to the display
+    if(x1 < 0)
     {
-        for(int16_t dx = x1; dx < x2; dx++)
+        x1 = 0;
+    }
+    if(y1 < 0)
+    {
+        y1 = 0;
+    }
+    if(x2 > OLED_WIDTH - 1)
+    {
+        x2 = OLED_WIDTH - 1;
+    }
+    if(y2 > OLED_HEIGHT - 1)
+    {
+        y2 = OLED_HEIGHT - 1;
+    }
+    if(x1 > x2 || y1 > y2)
+    {
+        return;
+    }
+
+    uint8_t page1 = y1 >> 3;
+    uint8_t page2 = y2 >> 3;
+
+    // Build the mask for each page, partial at the top and bottom
+    uint8_t pageMasks[OLED_HEIGHT / 8];
+    for(uint8_t page = page1; page <= page2; page++)
+    {
+        pageMasks[page] = 0xFF;
+    }
+    pageMasks[page1] &= (0xFF << (y1 & 7));
+    pageMasks[page2] &= (0xFF >> (7 - (y2 & 7)));
+
+    for(int16_t x = x1; x <= x2; x++)
+    {
+        uint8_t colMask = (NULL == pattern) ? 0xFF : pattern[x & 3];
+        uint8_t* addy = &currentFb[(x * (OLED_HEIGHT / 8)) + page1];
+        for(uint8_t page = page1; page <= page2; page++)
         {
-            switch(shadeLevel)
+            uint8_t mask = pageMasks[page] & colMask;
+            switch(c)
             {
-                case 0:
+                case WHITE:
                 {
-                    // 25% faded
-                    if(dy % 2 == 0 && dx % 2 == 0)
-                    {
-                        drawPixel(dx, dy, BLACK);
-                    }
-                    break;
-                }
-                case 1:
-                {
-                    // 37.5% faded
-                    if(dy % 2 == 0 && dx % 2 == 0)
-                    {
-                        drawPixel(dx, dy, BLACK);
-                    }
-                    else if (dx % 4 == 0)
-                    {
-                        drawPixel(dx, dy, BLACK);
-                    }
+                    *addy |= mask;
                     break;
                 }
-                case 2:
+                case BLACK:
                 {
-                    // 50% faded
-                    if((dy % 2) == (dx % 2))
-                    {
-                        drawPixel(dx, dy, BLACK);
-                    }
+                    *addy &= ~mask;
                     break;
                 }
-                case 3:
-                {
-                    // 62.5% faded
-                    if(dy % 2 == 0 && dx % 2 == 0)
-                    {
-                        drawPixel(dx, dy, BLACK);
-                    }
-                    else if (dx % 4 < 3)
-                    {
-                        drawPixel(dx, dy, BLACK);
-                    }
-                    break;
-                }
-                case 4:
+                case INVERSE:
                 {
-                    // 75% faded
-                    if(dy % 2 == 0 || dx % 2 == 0)
-                    {
-                        drawPixel(dx, dy, BLACK);
-                    }
+                    *addy ^= mask;
                     break;
                 }
+                case TRANSPARENT_COLOR:
+                case WHITE_F_TRANSPARENT_B:
                 default:
                 {
-                    return;
+                    break;
                 }
             }
+            addy++;
         }
     }
+
+#if defined(EMU)
+    emuCostAdd(EMU_COST_FB_COLUMN, x2 - x1 + 1);
+    emuCostAdd(EMU_COST_FB_BYTE, (x2 - x1 + 1) * (page2 - page1 + 1));
+#endif
+
+    markOledDirtyArea(x1, x2, page1, page2);
+    fbChanges = true;
+}
+
+/**
+ * Fill a rectangular display area with a single color
+ *
+ * @param x1 The X pixel to start at
+ * @param y1 The Y pixel to start at
+ * @param x2 The X pixel to end at
+ * @param y2 The Y pixel to end at
+ * @param c  The color to fill
+ */
+void ICACHE_FLASH_ATTR fillDisplayArea(int16_t x1, int16_t y1, int16_t x2, int16_t y2, color c)
+{
+    fillAreaMasked(x1, y1, x2, y2, c, NULL);
+}
+
+/**
+ * Draw a horizontal line. The ends may be given in either order
+ *
+ * @param x1 The X pixel at one end
+ * @param x2 The X pixel at the other end, inclusive
+ * @param y  The row to draw in
+ * @param c  The color to draw
+ */
+void ICACHE_FLASH_ATTR drawHLine(int16_t x1, int16_t x2, int16_t y, color c)
+{
+    if(x1 > x2)
+    {
+        fillAreaMasked(x2, y, x1, y, c, NULL);
+    }
+    else
+    {
+        fillAreaMasked(x1, y, x2, y, c, NULL);
+    }
+}
+
+/**
+ * Draw a vertical line. The ends may be given in either order
+ *
+ * @param x  The column to draw in
+ * @param y1 The Y pixel at one end
+ * @param y2 The Y pixel at the other end, inclusive
+ * @param c  The color to draw
+ */
+void ICACHE_FLASH_ATTR drawVLine(int16_t x, int16_t y1, int16_t y2, color c)
+{
+    if(y1 > y2)
+    {
+        fillAreaMasked(x, y2, x, y1, c, NULL);
+    }
+    else
+    {
+        fillAreaMasked(x, y1, x, y2, c, NULL);
+    }
+}
+
+/**
+ * 'Shade' an area by drawing black pixels over it in a ordered-dithering way
+ *
+ * @param x1 The X pixel to start at
+ * @param y1 The Y pixel to start at
+ * @param x2 The X pixel to end at, exclusive
+ * @param y2 The Y pixel to end at, exclusive
+ * @param shadeLevel The level of shading, Higher means more shaded. Must be 0 to 4
+ */
+void ICACHE_FLASH_ATTR shadeDisplayArea(int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint8_t shadeLevel)
+{
+    if(shadeLevel < lengthof(shadeMasks))
+    {
+        fillAreaMasked(x1, y1, x2 - 1, y2 - 1, BLACK, shadeMasks[shadeLevel]);
+    }
 }
 
 /**
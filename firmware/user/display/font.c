@@ -13,6 +13,94 @@
 
 #if defined(FEATURE_OLED)
 
+//==============================================================================
+// Variables
+//==============================================================================
+
+/// The sprite tables for each font, indexed by fonts
+static const sprite_t* const fontTables[NUM_FONTS] =
+{
+    font_TomThumb,
+    font_IbmVga8,
+    font_Radiostars,
+};
+
+/// Glyph widths for each font, copied out of flash the first time a font is used
+static uint8_t fontWidths[NUM_FONTS][FONT_NUM_GLYPHS];
+static bool fontWidthsLoaded[NUM_FONTS] = {false};
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+/**
+ * @brief Map a character to its index in a font table. Lowercase is folded to
+ *        uppercase, and the characters after lowercase follow '`'
+ *
+ * @param character The character to map
+ * @return The glyph index, or FONT_NUM_GLYPHS if the character isn't drawn
+ */
+static inline uint8_t glyphIndex(char character)
+{
+    uint8_t c = (uint8_t)character;
+    if ('a' <= c && c <= 'z')
+    {
+        return c - 'a' + 'A' - ' ';
+    }
+    else if(c >= '{')
+    {
+        // These usually come after lowercase, but lowercase doesn't exist
+        c = '`' + 1 + (c - '{');
+    }
+    else if(c < ' ')
+    {
+        return FONT_NUM_GLYPHS;
+    }
+    c -= ' ';
+    return (c < FONT_NUM_GLYPHS) ? c : FONT_NUM_GLYPHS;
+}
+
+/**
+ * @brief Get the RAM copy of a font's glyph widths, reading them from flash if
+ *        this is the first time the font is used
+ *
+ * @param font The font to get widths for
+ * @return FONT_NUM_GLYPHS widths, not counting the one pixel gap
+ */
+static const uint8_t* ICACHE_FLASH_ATTR getFontWidths(fonts font)
+{
+    if(!fontWidthsLoaded[font])
+    {
+        // Flash must be read 32 bits at a time, so copy each sprite to RAM
+        sprite_t sprite_ram;
+        for(uint8_t i = 0; i < FONT_NUM_GLYPHS; i++)
+        {
+            ets_memcpy(&sprite_ram, &(fontTables[font][i]), sizeof(sprite_t));
+            fontWidths[font][i] = sprite_ram.width;
+        }
+        fontWidthsLoaded[font] = true;
+    }
+    return fontWidths[font];
+}
+
+/**
+ * @brief Find which font a sprite table belongs to
+ *
+ * @param table A table of character sprites
+ * @return The font, or NUM_FONTS if the table isn't one of the fonts
+ */
+static fonts ICACHE_FLASH_ATTR fontFromTable(const sprite_t* table)
+{
+    for(uint8_t font = 0; font < NUM_FONTS; font++)
+    {
+        if(fontTables[font] == table)
+        {
+            return (fonts)font;
+        }
+    }
+    return NUM_FONTS;
+}
+
 /**
  * @brief Draw a single character to the OLED display
  *        Special characters (< ' ') not drawn
@@ -26,18 +114,10 @@
 int16_t ICACHE_FLASH_ATTR plotChar(int16_t x, int16_t y,
                                    char character, const sprite_t* table, color col)
 {
-    if(character >= ' ')
+    uint8_t glyph = glyphIndex(character);
+    if(glyph < FONT_NUM_GLYPHS)
     {
-        if ('a' <= character && character <= 'z')
-        {
-            character = (char) (character - 'a' + 'A');
-        }
-        else if(character >= '{')
-        {
-            // These usually come after lowercase, but lowercase doesn't exist
-            character = '`' + 1 + (character - '{');
-        }
-        return plotSprite(x, y, &table[character - ' '], col);
+        return plotSprite(x, y, &table[glyph], col);
     }
 
     return x;
@@ -55,29 +135,23 @@ int16_t ICACHE_FLASH_ATTR plotChar(int16_t x, int16_t y,
  */
 int16_t ICACHE_FLASH_ATTR plotText(int16_t x, int16_t y, const char* text, fonts font, color col)
 {
+    if(font >= NUM_FONTS)
+    {
+        return x;
+    }
+
+    const sprite_t* table = fontTables[font];
+    const uint8_t* widths = getFontWidths(font);
     while (0 != *text)
     {
-        switch (font)
+        uint8_t glyph = glyphIndex(*text);
+        if(glyph < FONT_NUM_GLYPHS)
         {
-            case TOM_THUMB:
-            {
-                x = plotChar(x, y, *text, font_TomThumb, col);
-                break;
-            }
-            case IBM_VGA_8:
+            if(x < OLED_WIDTH && x + widths[glyph] > 0)
             {
-                x = plotChar(x, y, *text, font_IbmVga8, col);
-                break;
-            }
-            case RADIOSTARS:
-            {
-                x = plotChar(x, y, *text, font_Radiostars, col);
-                break;
-            }
-            default:
-            {
-                break;
+                plotSprite(x, y, &table[glyph], col);
             }
+            x += widths[glyph] + 1;
         }
         text++;
     }
@@ -85,73 +159,112 @@ int16_t ICACHE_FLASH_ATTR plotText(int16_t x, int16_t y, const char* text, fonts
 }
 
 /**
- * @brief TODO
+ * @brief Get the width of a single character, including the one pixel gap
+ *        after it
  *
- * @param character
- * @param table
- * @return int16_t
+ * @param character The character to measure
+ * @param table A table of character sprites, in ASCII order
+ * @return The width of the character, 0 for special characters (< ' ')
  */
 int16_t ICACHE_FLASH_ATTR charWidth(char character, const sprite_t* table)
 {
-    if(character >= ' ')
+    uint8_t glyph = glyphIndex(character);
+    if(glyph < FONT_NUM_GLYPHS)
     {
-        if ('a' <= character && character <= 'z')
-        {
-            character = (char) (character - 'a' + 'A');
-        }
-        else if(character >= '{')
+        fonts font = fontFromTable(table);
+        if(font < NUM_FONTS)
         {
-            // These usually come after lowercase, but lowercase doesn't exist
-            character = '`' + 1 + (character - '{');
+            return getFontWidths(font)[glyph] + 1;
         }
-#ifdef USE_ESP_GDB // If we use GDB, read these to RAM first to avoid SIGSEV
+
+        // Not a known font, read the width from flash
         sprite_t sprite_ram;
-        ets_memcpy ( &sprite_ram, &(table[character - ' ']), sizeof(sprite_t) );
+        ets_memcpy ( &sprite_ram, &(table[glyph]), sizeof(sprite_t) );
         return sprite_ram.width + 1;
-#else
-        return table[character - ' '].width + 1;
-#endif
     }
     return 0;
 }
 
 /**
- * @brief TODO
+ * @brief Get the width of a string, including the one pixel gap after the
+ *        last character. This is how far plotText() advances x
  *
- * @param text
- * @param font
- * @return int16_t
+ * @param text The string to measure
+ * @param font The font to measure the string in
+ * @return The width of the string
  */
 int16_t ICACHE_FLASH_ATTR textWidth(const char* text, fonts font)
 {
+    if(font >= NUM_FONTS)
+    {
+        return 0;
+    }
+
+    const uint8_t* widths = getFontWidths(font);
     int16_t width = 0;
     while (0 != *text)
     {
-        switch (font)
+        uint8_t glyph = glyphIndex(*text);
+        if(glyph < FONT_NUM_GLYPHS)
         {
-            case TOM_THUMB:
-            {
-                width += charWidth(*text, font_TomThumb);
-                break;
-            }
-            case IBM_VGA_8:
-            {
-                width += charWidth(*text, font_IbmVga8);
-                break;
-            }
-            case RADIOSTARS:
-            {
-                width += charWidth(*text, font_Radiostars);
-                break;
-            }
-            default:
-            {
-                break;
-            }
+            width += widths[glyph] + 1;
         }
         text++;
     }
     return width;
 }
 
+/**
+ * @brief Get the x position to start drawing a string of a given width
+ *
+ * @param x The anchor x position
+ * @param width The width of the string, as from textWidth()
+ * @param align How the string is placed relative to x
+ * @return The x position of the start of the string
+ */
+static int16_t ICACHE_FLASH_ATTR alignText(int16_t x, int16_t width, textAlign_t align)
+{
+    switch(align)
+    {
+        case ALIGN_CENTER:
+        {
+            // Same as (OLED_WIDTH - width) / 2 when x is OLED_WIDTH / 2
+            return x - ((width + 1) / 2);
+        }
+        case ALIGN_RIGHT:
+        {
+            // The trailing gap isn't drawn, so the last pixel lands on x - 1
+            return x - width + 1;
+        }
+        case ALIGN_LEFT:
+        default:
+        {
+            return x;
+        }
+    }
+}
+
+/**
+ * @brief Measure and draw a string in one call, i.e. to center it
+ *
+ * @param x The x position to align the string to. For ALIGN_CENTER this is the
+ *          center, i.e. OLED_WIDTH / 2. For ALIGN_RIGHT this is one past the
+ *          last column drawn, i.e. OLED_WIDTH
+ * @param y The y position where to draw the string
+ * @param text The string to draw
+ * @param font The font to draw the string in
+ * @param align How the string is placed relative to x
+ * @param col WHITE, BLACK or INVERSE
+ * @return The x position of the end of the string drawn
+ */
+int16_t ICACHE_FLASH_ATTR plotTextAligned(int16_t x, int16_t y, const char* text, fonts font,
+        textAlign_t align, color col)
+{
+    if(ALIGN_LEFT != align)
+    {
+        x = alignText(x, textWidth(text, font), align);
+    }
+    return plotText(x, y, text, font, col);
+}
+
 #endif
\ No newline at end of file
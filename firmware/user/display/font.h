@@ -20,9 +20,20 @@ typedef enum
 {
     TOM_THUMB,
     IBM_VGA_8,
-    RADIOSTARS
+    RADIOSTARS,
+    NUM_FONTS
 } fonts;
 
+typedef enum
+{
+    ALIGN_LEFT,
+    ALIGN_CENTER,
+    ALIGN_RIGHT
+} textAlign_t;
+
+/// The number of glyphs in each font table, ' ' through '`' then '{' through '~'
+#define FONT_NUM_GLYPHS 69
+
 #define FONT_HEIGHT_RADIOSTARS 12
 extern const sprite_t font_Radiostars[] RODATA_ATTR;
 
@@ -37,6 +48,7 @@ int16_t charWidth(char character, const sprite_t* table);
 
 int16_t plotText(int16_t x, int16_t y, const char* text, fonts font, color col);
 int16_t textWidth(const char* text, fonts font);
+int16_t plotTextAligned(int16_t x, int16_t y, const char* text, fonts font, textAlign_t align, color col);
 
 #endif
 #endif /* SRC_FONT_H_ */
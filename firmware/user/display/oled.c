@@ -12,6 +12,7 @@
 #include <osapi.h>
 
 #include "oled.h"
+#include "oled_dirty.h"
 #include "cnlohr_i2c.h"
 #include "gpio_user.h"
 #include "user_main.h"
@@ -372,8 +373,9 @@ int ICACHE_FLASH_ATTR processDisplayCommands( const uint8_t* buffer, uint8_t fla
 // Variables
 //==============================================================================
 
-uint8_t currentFb[(OLED_WIDTH * (OLED_HEIGHT / 8))] = {0};
-uint8_t priorFb[(OLED_WIDTH * (OLED_HEIGHT / 8))] = {0};
+// Aligned so the dirty block scan can compare 32 bits at a time
+uint8_t currentFb[(OLED_WIDTH * (OLED_HEIGHT / 8))] __attribute__((aligned(4))) = {0};
+uint8_t priorFb[(OLED_WIDTH * (OLED_HEIGHT / 8))] __attribute__((aligned(4))) = {0};
 
 
 bool fbChanges = false;
@@ -387,7 +389,7 @@ bool fbChanges = false;
  */
 void ICACHE_FLASH_ATTR clearDisplay(void)
 {
-    ets_memset(currentFb, 0, (OLED_WIDTH * (OLED_HEIGHT / 8)) );
+    clearOledFramebuffer(currentFb);
     fbChanges = true;
 }
 
@@ -408,6 +410,7 @@ void drawPixel(int16_t x, int16_t y, color c)
             (0 <= y) && (y < OLED_HEIGHT))
     {
         fbChanges = true;
+        OLED_MARK_DIRTY(x, y);
         uint8_t* addy = &currentFb[(y + x * OLED_HEIGHT) / 8];
         uint8_t mask = 1 << (y & 7);
         switch (c)
@@ -442,6 +445,7 @@ void drawPixel(int16_t x, int16_t y, color c)
  */
 void drawPixelUnsafe( int x, int y )
 {
+    OLED_MARK_DIRTY(x, y);
     uint8_t* addy = &currentFb[(y + x * OLED_HEIGHT) / 8];
     uint8_t mask = 1 << (y & 7);
     *addy |= mask;
@@ -458,6 +462,7 @@ void drawPixelUnsafe( int x, int y )
  */
 void drawPixelUnsafeBlack( int x, int y )
 {
+    OLED_MARK_DIRTY(x, y);
     uint8_t* addy = &currentFb[(y + x * OLED_HEIGHT) / 8];
     uint8_t mask = ~(1 << (y & 7));
     *addy &= mask;
@@ -474,6 +479,7 @@ void drawPixelUnsafeBlack( int x, int y )
  */
 void drawPixelUnsafeC( int x, int y, color c )
 {
+    OLED_MARK_DIRTY(x, y);
     //Ugh, I know this looks weird, but it's faster than saying
     //addy = &currentFb[(y+x*OLED_HEIGHT)/8], and produces smaller code.
     //Found by looking at image.lst.
@@ -647,7 +653,7 @@ oledResult_t ICACHE_FLASH_ATTR updateOLED(bool drawDifference)
         }
     }
 
-    if(true == drawDifference && false == fbChanges)
+    if(true == drawDifference && false == fbChanges && false == isOledDirty())
     {
         // We know nothing happened, just return
         return NOTHING_TO_DO;
@@ -658,58 +664,33 @@ oledResult_t ICACHE_FLASH_ATTR updateOLED(bool drawDifference)
         fbChanges = false;
     }
 
-    uint8_t minX = OLED_WIDTH;
-    uint8_t maxX = 0;
-    uint8_t minPage = SSD1306_NUM_PAGES;
-    uint8_t maxPage = 0;
-
     if( drawDifference )
     {
-        //Right now, we just look for the rect on the screen which encompasses the biggest changed area.
-        //We could, however, update multiple rectangles if we wanted, more similar to the previous system.
+        // Only compare the blocks which were drawn to, then find a few small
+        // windows which cover all the changes, rather than one big window, so
+        // that changes far apart don't resend the whole frame
+        oledSpan_t spans[OLED_MAX_DIRTY_SPANS];
+        uint8_t numSpans = findOledDirtySpans(currentFb, priorFb, spans, OLED_MAX_DIRTY_SPANS);
 
-        uint8_t x, page;
-        uint8_t* pPrev = priorFb;
-        uint8_t* pCur = currentFb;
-        for( x = 0; x < OLED_WIDTH; x++ )
+        if(0 == numSpans)
         {
-            for( page = 0; page < SSD1306_NUM_PAGES; page++ )
-            {
-                if( *pPrev != *pCur )
-                {
-                    if( x < minX )
-                    {
-                        minX = x;
-                    }
-                    if( x > maxX )
-                    {
-                        maxX = x;
-                    }
-                    if( page < minPage )
-                    {
-                        minPage = page;
-                    }
-                    if( page > maxPage )
-                    {
-                        maxPage = page;
-                    }
-                }
-                pPrev++;
-                pCur++;
-            }
+            return NOTHING_TO_DO;
         }
 
-        if( maxX >= minX && maxPage >= minPage )
-        {
-            return updateOLEDScreenRange( minX, maxX, minPage, maxPage );
-        }
-        else
+        oledResult_t result = FRAME_DRAWN;
+        for(uint8_t i = 0; i < numSpans; i++)
         {
-            return NOTHING_TO_DO;
+            if(FRAME_NOT_DRAWN == updateOLEDScreenRange(spans[i].minX, spans[i].maxX,
+                    spans[i].minPage, spans[i].maxPage))
+            {
+                result = FRAME_NOT_DRAWN;
+            }
         }
+        return result;
     }
     else
     {
+        clearOledDirty();
         return updateOLEDScreenRange( 0, OLED_WIDTH - 1, 0, SSD1306_NUM_PAGES - 1 );
     }
 }
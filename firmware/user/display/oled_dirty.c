@@ -0,0 +1,286 @@
+/*
+ * oled_dirty.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+//==============================================================================
+// Includes
+//==============================================================================
+
+#include <osapi.h>
+
+#include "oled_dirty.h"
+
+#if defined(FEATURE_OLED)
+
+//==============================================================================
+// Defines
+//==============================================================================
+
+#define OLED_NUM_PAGES (OLED_HEIGHT / 8)
+
+//==============================================================================
+// Variables
+//==============================================================================
+
+uint16_t oledDirtyBlocks[OLED_NUM_PAGES] = {0};
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+/**
+ * @brief Get the number of data bytes which would be sent for a span
+ *
+ * @param span The span to measure
+ * @return The number of data bytes in the span
+ */
+uint16_t ICACHE_FLASH_ATTR oledSpanBytes(const oledSpan_t* span)
+{
+    return (span->maxX - span->minX + 1) * (span->maxPage - span->minPage + 1);
+}
+
+/**
+ * @brief Mark the whole display as changed. Call this after writing to
+ * currentFb without going through the drawing functions
+ */
+void ICACHE_FLASH_ATTR markOledDirtyAll(void)
+{
+    ets_memset(oledDirtyBlocks, 0xFF, sizeof(oledDirtyBlocks));
+}
+
+/**
+ * @brief Mark a rectangle of the display as changed, i.e. after writing whole
+ * bytes of currentFb directly
+ *
+ * @param x1    The first column, inclusive
+ * @param x2    The last column, inclusive
+ * @param page1 The first page, inclusive
+ * @param page2 The last page, inclusive
+ */
+void ICACHE_FLASH_ATTR markOledDirtyArea(uint8_t x1, uint8_t x2, uint8_t page1, uint8_t page2)
+{
+    uint16_t lastBlockBit = 1 << (x2 >> OLED_DIRTY_BLOCK_SHIFT);
+    uint16_t blocks = (lastBlockBit | (lastBlockBit - 1)) & ~((1 << (x1 >> OLED_DIRTY_BLOCK_SHIFT)) - 1);
+    for(uint8_t page = page1; page <= page2; page++)
+    {
+        oledDirtyBlocks[page] |= blocks;
+    }
+}
+
+/**
+ * @brief Clear a framebuffer, only marking the blocks which had something in
+ * them as changed. Clearing an already blank area then costs no scan time.
+ *
+ * @param fb The framebuffer to clear, 32 bit aligned
+ */
+void ICACHE_FLASH_ATTR clearOledFramebuffer(uint8_t* fb)
+{
+    uint32_t* fb32 = (uint32_t*)fb;
+    for(uint8_t x = 0; x < OLED_WIDTH; x++)
+    {
+        uint16_t blockBit = (1 << (x >> OLED_DIRTY_BLOCK_SHIFT));
+        for(uint8_t half = 0; half < 2; half++)
+        {
+            if(*fb32)
+            {
+                *fb32 = 0;
+                uint16_t* dirty = &oledDirtyBlocks[half * 4];
+                dirty[0] |= blockBit;
+                dirty[1] |= blockBit;
+                dirty[2] |= blockBit;
+                dirty[3] |= blockBit;
+            }
+            fb32++;
+        }
+    }
+}
+
+/**
+ * @brief Forget all changes, i.e. after the whole frame was sent
+ */
+void ICACHE_FLASH_ATTR clearOledDirty(void)
+{
+    ets_memset(oledDirtyBlocks, 0, sizeof(oledDirtyBlocks));
+}
+
+/**
+ * @return true if anything was drawn since the last scan, false otherwise
+ */
+bool ICACHE_FLASH_ATTR isOledDirty(void)
+{
+    uint16_t any = 0;
+    for(uint8_t page = 0; page < OLED_NUM_PAGES; page++)
+    {
+        any |= oledDirtyBlocks[page];
+    }
+    return (0 != any);
+}
+
+/**
+ * @brief Compare the blocks of two framebuffers which were drawn to since the
+ * last scan and find a small set of windows which cover every difference.
+ * This clears the dirty blocks.
+ *
+ * The framebuffer is column-major, eight pages per column, so one 32 bit word
+ * covers four pages of a column. Only words in marked blocks are compared.
+ *
+ * @param cur      The framebuffer which is about to be sent, 32 bit aligned
+ * @param prior    The framebuffer which was last sent, 32 bit aligned
+ * @param spans    An array to write the spans to
+ * @param maxSpans The number of elements in spans, must be at least 1
+ * @return The number of spans written, 0 if there are no differences
+ */
+uint8_t ICACHE_FLASH_ATTR findOledDirtySpans(const uint8_t* cur, const uint8_t* prior,
+        oledSpan_t* spans, uint8_t maxSpans)
+{
+    uint8_t colPageMasks[OLED_WIDTH] = {0};
+    const uint32_t* cur32 = (const uint32_t*)cur;
+    const uint32_t* prior32 = (const uint32_t*)prior;
+
+    // For the top and bottom four pages
+    for(uint8_t half = 0; half < 2; half++)
+    {
+        uint8_t firstPage = half * 4;
+        uint16_t blocks = oledDirtyBlocks[firstPage] | oledDirtyBlocks[firstPage + 1] |
+                          oledDirtyBlocks[firstPage + 2] | oledDirtyBlocks[firstPage + 3];
+
+        // For each marked block of columns
+        while(blocks)
+        {
+            uint8_t block = __builtin_ctz(blocks);
+            blocks &= (blocks - 1);
+
+            uint8_t x = block << OLED_DIRTY_BLOCK_SHIFT;
+            uint8_t xEnd = x + OLED_DIRTY_BLOCK_WIDTH;
+            for(; x < xEnd; x++)
+            {
+                // Two words per column, pick the top or bottom one
+                uint16_t wordIdx = (x * 2) + half;
+                uint32_t diff = cur32[wordIdx] ^ prior32[wordIdx];
+                if(diff)
+                {
+                    // Little endian, so the lowest byte is the lowest page
+                    uint8_t mask = 0;
+                    for(uint8_t b = 0; b < 4; b++)
+                    {
+                        if(diff & (0xFFu << (b * 8)))
+                        {
+                            mask |= (1 << b);
+                        }
+                    }
+                    colPageMasks[x] |= (mask << firstPage);
+                }
+            }
+        }
+    }
+
+    clearOledDirty();
+    return planOledSpans(colPageMasks, spans, maxSpans);
+}
+
+/**
+ * @brief Group changed columns into windows to send to the SSD1306.
+ *
+ * Columns are walked left to right. Each changed column either extends the
+ * last window or opens a new one, whichever sends fewer bytes once the
+ * per-window command overhead (OLED_SPAN_OVERHEAD_BYTES) is counted. Clean
+ * columns and pages inside a window are resent, which is why small changes
+ * far apart get their own windows and dense changes get merged. If all
+ * maxSpans windows are used, the cheapest neighbouring pair is merged.
+ *
+ * @param colPageMasks OLED_WIDTH bitmasks of changed pages, one per column
+ * @param spans        An array to write the spans to
+ * @param maxSpans     The number of elements in spans, must be at least 1
+ * @return The number of spans written, 0 if nothing changed
+ */
+uint8_t ICACHE_FLASH_ATTR planOledSpans(const uint8_t* colPageMasks, oledSpan_t* spans, uint8_t maxSpans)
+{
+    uint8_t numSpans = 0;
+
+    for(uint8_t x = 0; x < OLED_WIDTH; x++)
+    {
+        uint8_t mask = colPageMasks[x];
+        if(0 == mask)
+        {
+            continue;
+        }
+
+        // Find the changed page range in this column
+        uint8_t lo = __builtin_ctz(mask);
+        uint8_t hi = 31 - __builtin_clz(mask);
+
+        if(numSpans > 0)
+        {
+            oledSpan_t* last = &spans[numSpans - 1];
+            uint8_t mergedLo = (lo < last->minPage) ? lo : last->minPage;
+            uint8_t mergedHi = (hi > last->maxPage) ? hi : last->maxPage;
+
+            // Bytes sent if the last window is stretched to cover this column
+            uint16_t mergedCost = (x - last->minX + 1) * (mergedHi - mergedLo + 1);
+            // Bytes sent if this column starts a new window
+            uint16_t splitCost = oledSpanBytes(last) + OLED_SPAN_OVERHEAD_BYTES + (hi - lo + 1);
+
+            if(mergedCost <= splitCost)
+            {
+                last->maxX = x;
+                last->minPage = mergedLo;
+                last->maxPage = mergedHi;
+                continue;
+            }
+
+            if(numSpans == maxSpans)
+            {
+                // Out of windows. Either stretch the last window over this
+                // column or merge the neighbouring pair which grows the least
+                int16_t bestGrowth = mergedCost - splitCost + OLED_SPAN_OVERHEAD_BYTES;
+                int8_t bestPair = -1;
+                for(uint8_t i = 0; i + 1 < numSpans; i++)
+                {
+                    oledSpan_t pair =
+                    {
+                        .minX = spans[i].minX,
+                        .maxX = spans[i + 1].maxX,
+                        .minPage = (spans[i].minPage < spans[i + 1].minPage) ? spans[i].minPage : spans[i + 1].minPage,
+                        .maxPage = (spans[i].maxPage > spans[i + 1].maxPage) ? spans[i].maxPage : spans[i + 1].maxPage,
+                    };
+                    int16_t growth = oledSpanBytes(&pair) - oledSpanBytes(&spans[i]) - oledSpanBytes(&spans[i + 1]);
+                    if(growth < bestGrowth)
+                    {
+                        bestGrowth = growth;
+                        bestPair = i;
+                    }
+                }
+
+                if(-1 == bestPair)
+                {
+                    last->maxX = x;
+                    last->minPage = mergedLo;
+                    last->maxPage = mergedHi;
+                    continue;
+                }
+
+                // Merge the pair and shift the rest down to free a window
+                oledSpan_t* a = &spans[bestPair];
+                oledSpan_t* b = &spans[bestPair + 1];
+                a->maxX = b->maxX;
+                a->minPage = (a->minPage < b->minPage) ? a->minPage : b->minPage;
+                a->maxPage = (a->maxPage > b->maxPage) ? a->maxPage : b->maxPage;
+                ets_memmove(b, b + 1, sizeof(oledSpan_t) * (numSpans - bestPair - 2));
+                numSpans--;
+            }
+        }
+
+        // Open a new window for this column
+        spans[numSpans].minX = x;
+        spans[numSpans].maxX = x;
+        spans[numSpans].minPage = lo;
+        spans[numSpans].maxPage = hi;
+        numSpans++;
+    }
+
+    return numSpans;
+}
+
+#endif
@@ -0,0 +1,86 @@
+/*
+ * oled_dirty.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef OLED_DIRTY_H_
+#define OLED_DIRTY_H_
+
+#include <c_types.h>
+#include "user_config.h"
+#include "oled.h"
+
+#if defined(FEATURE_OLED)
+
+/*==============================================================================
+ * Defines
+ *============================================================================*/
+
+/// The most address windows which will be sent for a single frame
+#define OLED_MAX_DIRTY_SPANS 8
+
+/**
+ * The approximate cost, in byte-times on the I2C bus, of opening a new address
+ * window. This is two three-parameter PCD_CMD2 commands (SSD1306_COLUMNADDR and
+ * SSD1306_PAGEADDR), each framed by a start, the address byte and the command
+ * prefix, plus the start, address and data prefix for the data transfer itself.
+ * Command bytes go through the slower, ACK-checking SendByte(), so round up.
+ */
+#define OLED_SPAN_OVERHEAD_BYTES 14
+
+/// log2 of the width, in columns, of the blocks tracked in oledDirtyBlocks
+#define OLED_DIRTY_BLOCK_SHIFT 3
+#define OLED_DIRTY_BLOCK_WIDTH (1 << OLED_DIRTY_BLOCK_SHIFT)
+
+/**
+ * Mark the page and column block containing a pixel as changed. This must be
+ * called for every write to currentFb, otherwise the change won't be sent
+ */
+#define OLED_MARK_DIRTY(x, y) (oledDirtyBlocks[(y) >> 3] |= (1 << ((x) >> OLED_DIRTY_BLOCK_SHIFT)))
+
+/*==============================================================================
+ * Structs
+ *============================================================================*/
+
+/**
+ * A rectangular window of the SSD1306's RAM, inclusive on all sides, which
+ * can be sent with one call to updateOLEDScreenRange()
+ */
+typedef struct
+{
+    uint8_t minX;
+    uint8_t maxX;
+    uint8_t minPage;
+    uint8_t maxPage;
+} oledSpan_t;
+
+/*==============================================================================
+ * Variables
+ *============================================================================*/
+
+/// One word per page, one bit per OLED_DIRTY_BLOCK_WIDTH columns
+extern uint16_t oledDirtyBlocks[OLED_HEIGHT / 8];
+
+/// The column-major framebuffer, eight pages per column, defined in oled.c
+extern uint8_t currentFb[OLED_WIDTH * (OLED_HEIGHT / 8)];
+extern bool fbChanges;
+
+/*==============================================================================
+ * Functions
+ *============================================================================*/
+
+void ICACHE_FLASH_ATTR markOledDirtyAll(void);
+void ICACHE_FLASH_ATTR markOledDirtyArea(uint8_t x1, uint8_t x2, uint8_t page1, uint8_t page2);
+void ICACHE_FLASH_ATTR clearOledFramebuffer(uint8_t* fb);
+void ICACHE_FLASH_ATTR clearOledDirty(void);
+bool ICACHE_FLASH_ATTR isOledDirty(void);
+
+uint8_t ICACHE_FLASH_ATTR findOledDirtySpans(const uint8_t* cur, const uint8_t* prior,
+        oledSpan_t* spans, uint8_t maxSpans);
+uint8_t ICACHE_FLASH_ATTR planOledSpans(const uint8_t* colPageMasks, oledSpan_t* spans, uint8_t maxSpans);
+uint16_t ICACHE_FLASH_ATTR oledSpanBytes(const oledSpan_t* span);
+
+#endif
+
+#endif /* OLED_DIRTY_H_ */
@@ -1,77 +1,145 @@
 #include <osapi.h>
 #include "oled.h"
+#include "oled_dirty.h"
 #include "sprite.h"
+#if defined(EMU)
+    #include "swadgemu.h"
+#endif
 
 #if defined(FEATURE_OLED)
 
 /**
  * @brief Draw a sprite to the display
  *
+ * Rather than setting one pixel at a time, the sprite is turned sideways into
+ * one bitmask per column, which is then shifted to the right bit and written to
+ * the one to three column-major framebuffer bytes it covers. Clipping is done
+ * once for the whole sprite instead of per pixel.
+ *
  * @param x The x position where to draw the sprite
  * @param y The y position where to draw the sprite
  * @param sprite The sprite to draw
- * @param col WHITE, BLACK or INVERSE
+ * @param col WHITE, BLACK, INVERSE or WHITE_F_TRANSPARENT_B
  * @return The x position of the end of the sprite drawn
  */
 int16_t ICACHE_FLASH_ATTR plotSprite(int16_t x, int16_t y, const sprite_t* p_sprite, color col)
 {
-    uint8_t xIdx, yIdx;
-    color foreground, background;
+    // Used to copy 32 bits of flash contents to RAM where 8 bit accesses are allowed
+    sprite_t sprite_ram;
+    ets_memcpy ( &sprite_ram, p_sprite, sizeof(sprite_t) );
 
-    switch (col)
+    int16_t xEnd = (int16_t) (x + sprite_ram.width);
+    int16_t yEnd = (int16_t) (y + sprite_ram.height);
+
+    // Clip the whole sprite once
+    int16_t xMin = (x < 0) ? 0 : x;
+    int16_t xMax = (xEnd > OLED_WIDTH) ? OLED_WIDTH : xEnd;
+    if (xMin >= xMax || y >= OLED_HEIGHT || yEnd <= 0)
     {
-        default:
-        case WHITE:
+        return (int16_t) (x + sprite_ram.width + 1);
+    }
+
+    // The sprite's rows are right-to-left bitmasks, so rotate them into one
+    // top-to-bottom bitmask per column. Only set bits are visited
+    uint16_t columns[16] = {0};
+    for (uint8_t yIdx = 0; yIdx < sprite_ram.height; yIdx++)
+    {
+        uint16_t row = sprite_ram.data[yIdx];
+        while (row)
         {
-            foreground = WHITE;
-            background = BLACK;
-            break;
+            uint8_t xIdx = __builtin_ctz(row);
+            row &= (row - 1);
+            columns[xIdx] |= (1 << yIdx);
         }
+    }
+
+    // Each framebuffer byte becomes ((byte & ~clear) | set) ^ flip. Opaque
+    // colors clear the sprite's full height first, transparent ones don't
+    bool opaque = true;
+    bool blackForeground = false;
+    bool invertForeground = false;
+    switch (col)
+    {
         case BLACK:
         {
-            foreground = BLACK;
-            background = WHITE;
+            blackForeground = true;
             break;
         }
         case INVERSE:
         {
-            foreground = INVERSE;
-            background = TRANSPARENT_COLOR;
+            opaque = false;
+            invertForeground = true;
             break;
         }
         case TRANSPARENT_COLOR:
+        case WHITE_F_TRANSPARENT_B:
         {
-            foreground = TRANSPARENT_COLOR;
-            background = TRANSPARENT_COLOR;
+            opaque = false;
+            break;
         }
-        case WHITE_F_TRANSPARENT_B:
+        case WHITE:
+        default:
         {
-            foreground = WHITE;
-            background = TRANSPARENT_COLOR;
+            break;
         }
     }
+    uint32_t allRows = (1 << sprite_ram.height) - 1;
 
-    // refactor this code if it works!!!
-    // sprite_t sprite_ram = p_sprite[0]; // Used to copy 32 bits of flash contents to RAM where 8 bit accesses are allowed
-    sprite_t sprite_ram;
-    ets_memcpy ( &sprite_ram, p_sprite, sizeof(sprite_t) );
-    for (xIdx = 0; xIdx < sprite_ram.width; xIdx++)
+    // y may be negative, so use an arithmetic shift for the first page
+    int16_t firstPage = y >> 3;
+    uint8_t shift = y & 7;
+    int16_t lastPage = (yEnd - 1) >> 3;
+    uint8_t pageMin = (firstPage < 0) ? 0 : firstPage;
+    uint8_t pageMax = (lastPage >= (OLED_HEIGHT / 8)) ? ((OLED_HEIGHT / 8) - 1) : lastPage;
+
+    uint8_t drawnColumns = 0;
+    for (int16_t xPx = xMin; xPx < xMax; xPx++)
     {
-        for (yIdx = 0; yIdx < sprite_ram.height; yIdx++)
+        uint32_t fg = columns[sprite_ram.width - 1 - (xPx - x)];
+        uint32_t clear = 0, set = 0, flip = 0;
+        if (opaque)
         {
-            int16_t xPx = (int16_t) (x + (sprite_ram.width - xIdx) - 1);
-            int16_t yPx = (int16_t) (y + yIdx);
-            if (0 != (sprite_ram.data[yIdx] & (1 << xIdx)))
-            {
-                drawPixel(xPx, yPx, foreground);
-            }
-            else
-            {
-                drawPixel(xPx, yPx, background);
-            }
+            clear = allRows;
+            set = blackForeground ? (allRows & ~fg) : fg;
         }
+        else if (0 == fg)
+        {
+            // Nothing to draw in a transparent column
+            continue;
+        }
+        else if (invertForeground)
+        {
+            flip = fg;
+        }
+        else
+        {
+            set = fg;
+        }
+
+        clear <<= shift;
+        set <<= shift;
+        flip <<= shift;
+
+        uint8_t* column = &currentFb[xPx * (OLED_HEIGHT / 8)];
+        for (uint8_t page = pageMin; page <= pageMax; page++)
+        {
+            uint8_t bitOffset = (page - firstPage) * 8;
+            column[page] = (uint8_t) (((column[page] & ~(clear >> bitOffset)) | (set >> bitOffset)) ^ (flip >> bitOffset));
+        }
+        drawnColumns++;
     }
+
+    if (drawnColumns)
+    {
+#if defined(EMU)
+        emuCostAdd(EMU_COST_FB_COLUMN, drawnColumns);
+        emuCostAdd(EMU_COST_FB_BYTE, drawnColumns * (pageMax - pageMin + 1));
+#endif
+        markOledDirtyArea(xMin, xMax - 1, pageMin, pageMax);
+        fbChanges = true;
+    }
+
     return (int16_t) (x + sprite_ram.width + 1);
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -79,6 +79,9 @@ volatile struct
     volatile uint8_t sounddata[HPABUFFSIZE];
     volatile uint16_t soundhead;
     volatile uint16_t soundtail;
+    volatile uint32_t overruns;
+    volatile uint16_t highWater;
+    uint32_t underruns;
 } mic =
 {
     .soundhead = 0,
@@ -122,8 +125,24 @@ static void timerhandle( void* v __attribute__((unused)))
         {
 #if defined(FEATURE_MIC)
             uint16_t r = hs_adc_read();
-            mic.sounddata[mic.soundhead] = r >> 6;
-            mic.soundhead = (mic.soundhead + 1) & (HPABUFFSIZE - 1);
+            uint16_t next = (mic.soundhead + 1) & (HPABUFFSIZE - 1);
+            if(next == mic.soundtail)
+            {
+                // procTask() is too far behind. Drop this sample rather than
+                // wrap onto the tail, which would lose the whole buffer
+                mic.overruns++;
+            }
+            else
+            {
+                mic.sounddata[mic.soundhead] = r >> 6;
+                mic.soundhead = next;
+
+                uint16_t queued = (next - mic.soundtail) & (HPABUFFSIZE - 1);
+                if(queued > mic.highWater)
+                {
+                    mic.highWater = queued;
+                }
+            }
 #endif
             break;
         }
@@ -236,6 +255,9 @@ void ICACHE_FLASH_ATTR initMic(void)
 #if defined(FEATURE_BZR)
     setBuzzerGpio(false);
 #endif
+    mic.overruns = 0;
+    mic.underruns = 0;
+    mic.highWater = 0;
     StartHPATimer();
 }
 
@@ -256,11 +278,37 @@ bool ICACHE_FLASH_ATTR sampleAvailable(void)
  */
 uint8_t ICACHE_FLASH_ATTR getSample(void)
 {
+    if(!sampleAvailable())
+    {
+        // Moving the tail past the head would make the buffer look full
+        mic.underruns++;
+        return mic.sounddata[(mic.soundtail - 1) & (HPABUFFSIZE - 1)];
+    }
     uint8_t samp = mic.sounddata[mic.soundtail];
     mic.soundtail = (mic.soundtail + 1) % (HPABUFFSIZE);
     return samp;
 }
 
+/**
+ * @return The number of samples read from the ADC and queued for processing
+ */
+uint16_t ICACHE_FLASH_ATTR samplesQueued(void)
+{
+    return (mic.soundhead - mic.soundtail) & (HPABUFFSIZE - 1);
+}
+
+/**
+ * Get how well the mic's samples have been kept up with since initMic()
+ *
+ * @param stats Returns the overruns, underruns and high water mark
+ */
+void ICACHE_FLASH_ATTR getMicStats(micStats_t* stats)
+{
+    stats->overruns = mic.overruns;
+    stats->underruns = mic.underruns;
+    stats->highWater = mic.highWater;
+}
+
 #endif
 
 /*============================================================================
@@ -9,6 +9,7 @@
 
 #include "buzzer.h"
 #include "user_config.h"
+#include "ccconfig.h"
 
 void ICACHE_FLASH_ATTR StartHPATimer(void);
 void ContinueHPATimer(void);
@@ -23,9 +24,23 @@ bool ICACHE_FLASH_ATTR isHpaRunning(void);
 #endif
 
 #if defined(FEATURE_MIC)
+    //When more than this many samples are waiting, procTask() drains them
+    //and skips drawing for a pass, since it's fallen behind
+    #define MIC_DRAIN_THRESHOLD (HPABUFFSIZE / 2)
+
+    //How well the mic's samples are being kept up with, since initMic()
+    typedef struct
+    {
+        uint32_t overruns;  //Samples lost because the buffer was full
+        uint32_t underruns; //getSample() calls with no sample waiting
+        uint16_t highWater; //The most samples waiting at once
+    } micStats_t;
+
     void ICACHE_FLASH_ATTR initMic(void);
     uint8_t ICACHE_FLASH_ATTR getSample(void);
     bool ICACHE_FLASH_ATTR sampleAvailable(void);
+    uint16_t ICACHE_FLASH_ATTR samplesQueued(void);
+    void ICACHE_FLASH_ATTR getMicStats(micStats_t* stats);
 #endif
 
 #endif
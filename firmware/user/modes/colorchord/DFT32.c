@@ -3,6 +3,14 @@
 #include "DFT32.h"
 #include <string.h>
 
+#ifdef DFT32_SIMD
+    #include <immintrin.h>
+#endif
+
+#if defined(EMU)
+    #include "swadgemu.h"
+#endif
+
 #ifndef CCEMBEDDED
     #include <stdlib.h>
     #include <stdio.h>
@@ -167,6 +175,9 @@ static uint16_t SquareRootRounded(uint32_t a_nInput)
 void ICACHE_FLASH_ATTR UpdateOutputBins32(void)
 {
     int i;
+#if defined(EMU)
+    emuCostAdd( EMU_COST_DFT_BIN, FIXBINS );
+#endif
     int32_t* ipt = &Sdatspace32BOut[0];
     for( i = 0; i < FIXBINS; i++ )
     {
@@ -207,6 +218,76 @@ void ICACHE_FLASH_ATTR UpdateOutputBins32(void)
     }
 }
 
+#ifdef DFT32_SIMD
+
+uint8_t DFT32UseSimd = 1;
+
+//Each entry is sin in the low 16 bits and cos in the high 16 bits, in the
+//same order as the (isses,icses) pairs in Sdatspace32B.
+static int32_t Ssincostable[256];
+
+static void SetupSinCosTable(void)
+{
+    int i;
+    for( i = 0; i < 256; i++ )
+    {
+        Ssincostable[i] = (uint16_t)Ssinonlytable[i] | ((uint32_t)(uint16_t)Ssinonlytable[(i + 64) & 0xff] << 16);
+    }
+}
+
+//Does the same as the loop at the end of HandleInt() for all FIXBPERO bins of
+//one octave. Each (advance,place) pair is 32 bits, so shifting the advance up
+//a lane adds it to the place, and the place's top 8 bits are the table index.
+//16 bit multiplies of (sin,cos) by the sample, interleaved low and high
+//halves, give the 32 bit products in Sdatspace32B's order.
+static void UpdateOctaveSimd( uint16_t* dsA, int32_t* dsB, int16_t filteredsample )
+{
+    int i;
+#ifdef __AVX2__
+    const __m256i samp = _mm256_set1_epi16( filteredsample );
+    for( i = 0; i < FIXBPERO; i += 8 )
+    {
+        __m256i ap = _mm256_loadu_si256( (const __m256i*)&dsA[i * 2] );
+        __m256i idx = _mm256_srli_epi32( ap, 24 );
+        _mm256_storeu_si256( (__m256i*)&dsA[i * 2], _mm256_add_epi16( ap, _mm256_slli_epi32( ap, 16 ) ) );
+
+        __m256i sc = _mm256_i32gather_epi32( (const int*)Ssincostable, idx, 4 );
+        __m256i lo = _mm256_mullo_epi16( sc, samp );
+        __m256i hi = _mm256_mulhi_epi16( sc, samp );
+        __m256i p0 = _mm256_unpacklo_epi16( lo, hi ); //Bins 0,1 and 4,5
+        __m256i p1 = _mm256_unpackhi_epi16( lo, hi ); //Bins 2,3 and 6,7
+
+        __m256i* b = (__m256i*)&dsB[i * 2];
+        _mm256_storeu_si256( b, _mm256_add_epi32( _mm256_loadu_si256( b ),
+                             _mm256_permute2x128_si256( p0, p1, 0x20 ) ) );
+        _mm256_storeu_si256( b + 1, _mm256_add_epi32( _mm256_loadu_si256( b + 1 ),
+                             _mm256_permute2x128_si256( p0, p1, 0x31 ) ) );
+    }
+#else
+    const __m128i samp = _mm_set1_epi16( filteredsample );
+    for( i = 0; i < FIXBPERO; i += 4 )
+    {
+        __m128i ap = _mm_loadu_si128( (const __m128i*)&dsA[i * 2] );
+        __m128i idx = _mm_srli_epi32( ap, 24 );
+        _mm_storeu_si128( (__m128i*)&dsA[i * 2], _mm_add_epi16( ap, _mm_slli_epi32( ap, 16 ) ) );
+
+        //SSE2 can't gather
+        __m128i sc = _mm_set_epi32( Ssincostable[_mm_cvtsi128_si32( _mm_srli_si128( idx, 12 ) )],
+                                    Ssincostable[_mm_cvtsi128_si32( _mm_srli_si128( idx, 8 ) )],
+                                    Ssincostable[_mm_cvtsi128_si32( _mm_srli_si128( idx, 4 ) )],
+                                    Ssincostable[_mm_cvtsi128_si32( idx )] );
+        __m128i lo = _mm_mullo_epi16( sc, samp );
+        __m128i hi = _mm_mulhi_epi16( sc, samp );
+
+        __m128i* b = (__m128i*)&dsB[i * 2];
+        _mm_storeu_si128( b, _mm_add_epi32( _mm_loadu_si128( b ), _mm_unpacklo_epi16( lo, hi ) ) );
+        _mm_storeu_si128( b + 1, _mm_add_epi32( _mm_loadu_si128( b + 1 ), _mm_unpackhi_epi16( lo, hi ) ) );
+    }
+#endif
+}
+
+#endif
+
 static void ICACHE_FLASH_ATTR HandleInt( int16_t sample )
 {
     int i;
@@ -232,6 +313,9 @@ static void ICACHE_FLASH_ATTR HandleInt( int16_t sample )
         //It should happen at the very first call to HandleInit
         int32_t* bins = &Sdatspace32B[0];
         int32_t* binsOut = &Sdatspace32BOut[0];
+#if defined(EMU)
+        emuCostAdd( EMU_COST_DFT_BIN, FIXBINS );
+#endif
 
         for( i = 0; i < FIXBINS; i++ )
         {
@@ -253,6 +337,18 @@ static void ICACHE_FLASH_ATTR HandleInt( int16_t sample )
 
     filteredsample = Saccum_octavebins[oct] >> (OCTAVES - oct);
     Saccum_octavebins[oct] = 0;
+#if defined(EMU)
+    // The swadge runs the scalar loop, whatever the host uses
+    emuCostAdd( EMU_COST_DFT_BIN, FIXBPERO );
+#endif
+
+#ifdef DFT32_SIMD
+    if( DFT32UseSimd )
+    {
+        UpdateOctaveSimd( dsA, dsB, filteredsample );
+        return;
+    }
+#endif
 
     for( i = 0; i < FIXBPERO; i++ )
     {
@@ -273,6 +369,9 @@ int ICACHE_FLASH_ATTR SetupDFTProgressive32(void)
     int j;
 
     Sdonefirstrun = 1;
+#ifdef DFT32_SIMD
+    SetupSinCosTable();
+#endif
     Sdo_this_octave[0] = 0xff;
     for( i = 0; i < BINCYCLE - 1; i++ )
     {
@@ -320,10 +419,26 @@ void ICACHE_FLASH_ATTR UpdateBins32( const uint16_t* frequencies )
 
 void ICACHE_FLASH_ATTR PushSample32( int16_t dat )
 {
+#if defined(EMU)
+    emuCostAdd( EMU_COST_AUDIO_CALL, 1 );
+#endif
     HandleInt( dat );
     HandleInt( dat );
 }
 
+void ICACHE_FLASH_ATTR PushSamples32( const int16_t* dat, uint16_t n )
+{
+#if defined(EMU)
+    emuCostAdd( EMU_COST_AUDIO_CALL, 1 );
+#endif
+    while( n-- )
+    {
+        int16_t sample = *(dat++);
+        HandleInt( sample );
+        HandleInt( sample );
+    }
+}
+
 
 #ifndef CCEMBEDDED
 
@@ -46,6 +46,16 @@
     #define DFTIIR 6
 #endif
 
+//On x86 hosts, like the emulator and desktop ColorChord, each octave's bins
+//are updated a vector at a time with SSE2, or AVX2 if the compiler targets it.
+//The results are exactly the same as the scalar code, which is always used on
+//the ESP8266. Define DFT32_SCALAR to turn this off.
+#if defined(__SSE2__) && !defined(DFT32_SCALAR) && (FIXBPERO % 8) == 0
+    #define DFT32_SIMD 1
+    //Nonzero to use the vector code, the default. For benchmarks.
+    extern uint8_t DFT32UseSimd;
+#endif
+
 //Everything the integer one buys, except it only calculates 2 octaves worth of
 //notes per audio frame.
 //This is sort of working, but still have some quality issues.
@@ -66,6 +76,10 @@ void UpdateBins32( const uint16_t* frequencies );
 //Any more and you will exceed the accumulators and it will cause an overflow.
 void PushSample32( int16_t dat );
 
+//The same as calling PushSample32() on each of n samples, in order, without
+//a call per sample. Use this with a mode's fnAudioBlockCallback.
+void PushSamples32( const int16_t* dat, uint16_t n );
+
 #ifndef CCEMBEDDED
     //ColorChord regular uses this to pass in floats.
     void UpdateBinsForDFT32( const float* frequencies );  //Update the frequencies
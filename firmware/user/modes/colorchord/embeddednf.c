@@ -3,6 +3,9 @@
 #include "embeddednf.h"
 #include "osapi.h"
 #include "DFT32.h"
+#if defined(EMU)
+    #include "swadgemu.h"
+#endif
 
 uint16_t folded_bins[FIXBPERO];
 uint16_t fuzzed_bins[FIXBINS];
@@ -11,6 +14,34 @@ uint16_t note_peak_amps[MAXNOTES];
 uint16_t note_peak_amps2[MAXNOTES];
 uint8_t  note_jumped_to[MAXNOTES];
 
+//HandleFrameInfo()'s work, split into stages so StepFrameInfo() can do a
+//little of it at a time.
+typedef enum
+{
+    FRAME_IDLE,
+    FRAME_FUZZ,    //Filter the new bins into fuzzed_bins, and taper them
+    FRAME_FOLD,    //Fold fuzzed_bins into one octave
+    FRAME_BLUR,    //Blur folded_bins
+    FRAME_PEAKS,   //Find the peaks, and pull notes towards them
+    FRAME_COMBINE, //Combine notes which are close together
+    FRAME_DECAY,   //Decay the notes which weren't hit
+} frameStage_t;
+
+static struct
+{
+    frameStage_t stage;
+    uint8_t i;
+    uint8_t j;
+    uint8_t hitnotes[MAXNOTES];
+    uint16_t folded_out[FIXBPERO];
+    uint16_t samples;    //Samples pushed towards the next frame
+    uint16_t newSamples; //Samples pushed since the last CatchUpFrameInfo()
+} frame;
+
+//The DFT's bins for the frame being worked on. The DFT keeps filling its own
+//while this is worked on.
+static uint16_t frame_bins[FIXBINS];
+
 
 #ifndef PRECOMPUTE_FREQUENCY_TABLE
 static const float bf_table[24] =
@@ -101,6 +132,9 @@ void ICACHE_FLASH_ATTR InitColorChord(void)
 
     ets_memset( folded_bins, 0, sizeof( folded_bins ) );
     ets_memset( fuzzed_bins, 0, sizeof( fuzzed_bins ) );
+    frame.stage = FRAME_IDLE;
+    frame.samples = 0;
+    frame.newSamples = 0;
 
     //Step 1: Initialize the Integer DFT.
 #ifdef USE_32DFT
@@ -114,362 +148,458 @@ void ICACHE_FLASH_ATTR InitColorChord(void)
     UpdateFreqs();
 }
 
-void ICACHE_FLASH_ATTR HandleFrameInfo(void)
+bool ICACHE_FLASH_ATTR StartFrameInfo(void)
 {
-    int i, j, k;
-    uint8_t hitnotes[MAXNOTES];
-    ets_memset( hitnotes, 0, sizeof( hitnotes ) );
+    //Let the last frame finish rather than doing it all here.  The DFT keeps
+    //its bins, so the next frame still sees these samples.
+    if( frame.stage != FRAME_IDLE )
+    {
+        return false;
+    }
 
 #ifdef USE_32DFT
-    uint16_t* strens;
     UpdateOutputBins32();
-    strens = embeddedbins32;
+    ets_memcpy( frame_bins, embeddedbins32, sizeof( frame_bins ) );
 #else
-    uint16_t* strens = embeddedbins;
+    ets_memcpy( frame_bins, embeddedbins, sizeof( frame_bins ) );
 #endif
 
-    //Copy out the bins from the DFT to our fuzzed bins.
-    for( i = 0; i < FIXBINS; i++ )
+    ets_memset( frame.hitnotes, 0, sizeof( frame.hitnotes ) );
+    frame.stage = FRAME_FUZZ;
+    frame.i = 0;
+    frame.j = 0;
+    return true;
+}
+
+void ICACHE_FLASH_ATTR HandleFrameInfo(void)
+{
+    StepFrameInfo( FRAME_INFO_ALL );
+    StartFrameInfo();
+    StepFrameInfo( FRAME_INFO_ALL );
+}
+
+void ICACHE_FLASH_ATTR PushFrameSamples( const int16_t* samples, uint16_t numSamples, bool startFrames )
+{
+    frame.newSamples = ( numSamples < 0xFFFF - frame.newSamples ) ?
+                       frame.newSamples + numSamples : 0xFFFF;
+
+    while( numSamples > 0 )
     {
-        fuzzed_bins[i] = (fuzzed_bins[i] + (strens[i] >> FUZZ_IIR_BITS) -
-                          (fuzzed_bins[i] >> FUZZ_IIR_BITS));
+        //Push samples up to the end of this frame, or all of them if no
+        //frames are being started
+        uint16_t toPush = numSamples;
+        if( startFrames && toPush > SAMPLES_PER_FRAME - frame.samples )
+        {
+            toPush = SAMPLES_PER_FRAME - frame.samples;
+        }
+        PushSamples32( samples, toPush );
+        samples += toPush;
+        numSamples -= toPush;
+        if( !startFrames )
+        {
+            continue;
+        }
+
+        frame.samples += toPush;
+        if( frame.samples == SAMPLES_PER_FRAME )
+        {
+            //If the last frame is still being worked on, this one is skipped
+            StartFrameInfo();
+            frame.samples = 0;
+        }
     }
+}
 
-    //Taper first octave
-    for( i = 0; i < FIXBPERO; i++ )
+bool ICACHE_FLASH_ATTR CatchUpFrameInfo(void)
+{
+    //Do as much as the new samples need, so frames keep up however far apart
+    //the calls are
+    uint32_t budget = ( (uint32_t)frame.newSamples * FRAME_INFO_WORK ) / SAMPLES_PER_FRAME;
+    frame.newSamples = 0;
+    if( budget < FRAME_INFO_BUDGET )
     {
-        uint32_t taperamt = (65536 / FIXBPERO) * i;
-        fuzzed_bins[i] = (taperamt * fuzzed_bins[i]) >> 16;
+        budget = FRAME_INFO_BUDGET;
     }
+    return StepFrameInfo( ( budget < FRAME_INFO_ALL ) ? budget : FRAME_INFO_ALL );
+}
 
-    //Taper last octave
-    for( i = 0; i < FIXBPERO; i++ )
+//Look for a peak at folded bin i, and if there is one, find the note it
+//belongs to.  Returns the work done.
+static uint16_t ICACHE_FLASH_ATTR FramePeak( int i )
+{
+    int j;
+
+    //Next, we have to find the peaks, this is what "decompose" does in our
+    //normal tool.  As a warning, it expects that the values in foolded_bins
+    //do NOT exceed 32767.
+    uint8_t adjLeft = ( i == 0 ) ? FIXBPERO - 1 : i - 1;
+    uint8_t adjRight = ( i == FIXBPERO - 1 ) ? 0 : i + 1;
+    int16_t prev = folded_bins[adjLeft];
+    int16_t next = folded_bins[adjRight];
+    int16_t this = folded_bins[i];
+    uint8_t thisfreq = i << SEMIBITSPERBIN;
+    int16_t offset;
+    if( this < MIN_AMP_FOR_NOTE )
     {
-        int newi = FIXBINS - i - 1;
-        uint32_t taperamt = (65536 / FIXBPERO) * i;
-        fuzzed_bins[newi] = (taperamt * fuzzed_bins[newi]) >> 16;
+        return 1;
     }
-
-    //Fold the bins from fuzzedbins into one octave.
-    for( i = 0; i < FIXBPERO; i++ )
+    if( prev > this || next > this )
     {
-        folded_bins[i] = 0;
+        return 1;
     }
-    k = 0;
-    for( j = 0; j < OCTAVES; j++ )
+    if( prev == this && next == this )
     {
-        for( i = 0; i < FIXBPERO; i++ )
-        {
-            folded_bins[i] += fuzzed_bins[k++];
-        }
+        return 1;
     }
 
-    //Now, we must blur the folded bins to get a good result.
-    //Sometimes you may notice every other bin being out-of
-    //line, and this fixes that.  We may consider running this
-    //more than once, but in my experience, once is enough.
-    for( j = 0; j < FILTER_BLUR_PASSES; j++ )
+    //i is at a peak...
+    int32_t totaldiff = (( this - prev ) + ( this - next ));
+    int32_t porpdiffP = ((this - prev) << 16) / totaldiff; //close to 0 =
+    //closer to this side, 32768 = in the middle, 65535 away.
+    int32_t porpdiffN = ((this - next) << 16) / totaldiff;
+
+    if( porpdiffP < porpdiffN )
     {
-        //Extra scoping because this is a large on-stack buffer.
-        uint16_t folded_out[FIXBPERO];
-        uint8_t adjLeft = FIXBPERO - 1;
-        uint8_t adjRight = 1;
-        for( i = 0; i < FIXBPERO; i++ )
-        {
-            uint16_t lbin = folded_bins[adjLeft] >> 2;
-            uint16_t rbin = folded_bins[adjRight] >> 2;
-            uint16_t tbin = folded_bins[i] >> 1;
-            folded_out[i] = lbin + rbin + tbin;
-
-            //We do this funny dance to avoid a modulus operation.  On some
-            //processors, a modulus operation is slow.  This is cheap.
-            adjLeft++;
-            if( adjLeft == FIXBPERO )
-            {
-                adjLeft = 0;
-            }
-            adjRight++;
-            if( adjRight == FIXBPERO )
-            {
-                adjRight = 0;
-            }
-        }
+        //Closer to prev.
+        offset = -(32768 - porpdiffP);
+    }
+    else
+    {
+        //Closer to next
+        offset = (32768 - porpdiffN);
+    }
 
-        for( i = 0; i < FIXBPERO; i++ )
-        {
-            folded_bins[i] = folded_out[i];
-        }
+    //Need to round.  That's what that extra +(15.. is in the center.
+    thisfreq += (offset + (1 << (15 - SEMIBITSPERBIN))) >> (16 - SEMIBITSPERBIN);
+
+    //In the event we went 'below zero' need to wrap to the top.
+    if( thisfreq > 255 - (1 << SEMIBITSPERBIN) )
+    {
+        thisfreq = (1 << SEMIBITSPERBIN) * FIXBPERO - (256 - thisfreq);
     }
 
-    //Next, we have to find the peaks, this is what "decompose" does in our
-    //normal tool.  As a warning, it expects that the values in foolded_bins
-    //do NOT exceed 32767.
+    //Okay, we have a peak, and a frequency. Now, we need to search
+    //through the existing notes to see if we have any matches.
+    //If we have a note that's close enough, we will try to pull it
+    //closer to us and boost it.
+    int8_t lowest_found_free_note = -1;
+    int8_t closest_note_id = -1;
+    int16_t closest_note_distance = 32767;
+
+    for( j = 0; j < MAXNOTES; j++ )
     {
-        uint8_t adjLeft = FIXBPERO - 1;
-        uint8_t adjRight = 1;
-        for( i = 0; i < FIXBPERO; i++ )
+        uint8_t nf = note_peak_freqs[j];
+
+        if( nf == 255 )
         {
-            int16_t prev = folded_bins[adjLeft];
-            int16_t next = folded_bins[adjRight];
-            int16_t this = folded_bins[i];
-            uint8_t thisfreq = i << SEMIBITSPERBIN;
-            int16_t offset;
-            adjLeft++;
-            if( adjLeft == FIXBPERO )
-            {
-                adjLeft = 0;
-            }
-            adjRight++;
-            if( adjRight == FIXBPERO )
-            {
-                adjRight = 0;
-            }
-            if( this < MIN_AMP_FOR_NOTE )
-            {
-                continue;
-            }
-            if( prev > this || next > this )
+            if( lowest_found_free_note == -1 )
             {
-                continue;
-            }
-            if( prev == this && next == this )
-            {
-                continue;
+                lowest_found_free_note = j;
             }
+            continue;
+        }
 
-            //i is at a peak...
-            int32_t totaldiff = (( this - prev ) + ( this - next ));
-            int32_t porpdiffP = ((this - prev) << 16) / totaldiff; //close to 0 =
-            //closer to this side, 32768 = in the middle, 65535 away.
-            int32_t porpdiffN = ((this - next) << 16) / totaldiff;
+        int16_t distance = thisfreq - nf;
 
-            if( porpdiffP < porpdiffN )
-            {
-                //Closer to prev.
-                offset = -(32768 - porpdiffP);
-            }
-            else
-            {
-                //Closer to next
-                offset = (32768 - porpdiffN);
-            }
+        if( distance < 0 )
+        {
+            distance = -distance;
+        }
 
-            //Need to round.  That's what that extra +(15.. is in the center.
-            thisfreq += (offset + (1 << (15 - SEMIBITSPERBIN))) >> (16 - SEMIBITSPERBIN);
+        //Make sure that if we've wrapped around the right side of the
+        //array, we can detect it and loop it back.
+        if( distance > ((1 << (SEMIBITSPERBIN - 1))*FIXBPERO) )
+        {
+            distance = ((1 << (SEMIBITSPERBIN)) * FIXBPERO) - distance;
+        }
 
-            //In the event we went 'below zero' need to wrap to the top.
-            if( thisfreq > 255 - (1 << SEMIBITSPERBIN) )
-            {
-                thisfreq = (1 << SEMIBITSPERBIN) * FIXBPERO - (256 - thisfreq);
-            }
+        //If we find a note closer to where we are than any of the
+        //others, we can mark it as our desired note.
+        if( distance < closest_note_distance )
+        {
+            closest_note_id = j;
+            closest_note_distance = distance;
+        }
+    }
 
-            //Okay, we have a peak, and a frequency. Now, we need to search
-            //through the existing notes to see if we have any matches.
-            //If we have a note that's close enough, we will try to pull it
-            //closer to us and boost it.
-            int8_t lowest_found_free_note = -1;
-            int8_t closest_note_id = -1;
-            int16_t closest_note_distance = 32767;
+    int8_t marked_note = -1;
 
-            for( j = 0; j < MAXNOTES; j++ )
-            {
-                uint8_t nf = note_peak_freqs[j];
+    if( closest_note_distance <= MAX_JUMP_DISTANCE )
+    {
+        //We found the note we need to augment.
+        note_peak_freqs[closest_note_id] = thisfreq;
+        marked_note = closest_note_id;
+    }
 
-                if( nf == 255 )
-                {
-                    if( lowest_found_free_note == -1 )
-                    {
-                        lowest_found_free_note = j;
-                    }
-                    continue;
-                }
+    //The note was not found.
+    else if( lowest_found_free_note != -1 )
+    {
+        note_peak_freqs[lowest_found_free_note] = thisfreq;
+        marked_note = lowest_found_free_note;
+    }
 
-                int16_t distance = thisfreq - nf;
+    //If we found a note to attach to, we have to use the IIR to
+    //increase the strength of the note, but we can't exactly snap
+    //it to the new strength.
+    if( marked_note != -1 )
+    {
+        frame.hitnotes[marked_note] = 1;
 
-                if( distance < 0 )
-                {
-                    distance = -distance;
-                }
+        note_peak_amps[marked_note] =
+            note_peak_amps[marked_note] -
+            (note_peak_amps[marked_note] >> AMP_1_IIR_BITS) +
+            (this >> (AMP_1_IIR_BITS - 3));
 
-                //Make sure that if we've wrapped around the right side of the
-                //array, we can detect it and loop it back.
-                if( distance > ((1 << (SEMIBITSPERBIN - 1))*FIXBPERO) )
-                {
-                    distance = ((1 << (SEMIBITSPERBIN)) * FIXBPERO) - distance;
-                }
+        note_peak_amps2[marked_note] =
+            note_peak_amps2[marked_note] -
+            (note_peak_amps2[marked_note] >> AMP_2_IIR_BITS) +
+            ((this << 3) >> (AMP_2_IIR_BITS));
+    }
+    return 1 + MAXNOTES;
+}
 
-                //If we find a note closer to where we are than any of the
-                //others, we can mark it as our desired note.
-                if( distance < closest_note_distance )
-                {
-                    closest_note_id = j;
-                    closest_note_distance = distance;
-                }
-            }
+//Combine note j into note i, or the other way around, if they're close enough.
+static void ICACHE_FLASH_ATTR FrameCombine( int i, int j )
+{
+    //We'd be combining nf2 (j) into nf1 (i) if they're close enough.
+    uint8_t nf1 = note_peak_freqs[i];
+    uint8_t nf2 = note_peak_freqs[j];
+    int16_t distance = nf1 - nf2;
 
-            int8_t marked_note = -1;
+    if( nf1 == 255 || nf2 == 255 )
+    {
+        return;
+    }
 
-            if( closest_note_distance <= MAX_JUMP_DISTANCE )
-            {
-                //We found the note we need to augment.
-                note_peak_freqs[closest_note_id] = thisfreq;
-                marked_note = closest_note_id;
-            }
+    if( distance < 0 )
+    {
+        distance = -distance;
+    }
 
-            //The note was not found.
-            else if( lowest_found_free_note != -1 )
-            {
-                note_peak_freqs[lowest_found_free_note] = thisfreq;
-                marked_note = lowest_found_free_note;
-            }
+    //If it wraps around above the halfway point, then we're closer to it
+    //on the other side.
+    if( distance > ((1 << (SEMIBITSPERBIN - 1))*FIXBPERO) )
+    {
+        distance = ((1 << (SEMIBITSPERBIN)) * FIXBPERO) - distance;
+    }
 
-            //If we found a note to attach to, we have to use the IIR to
-            //increase the strength of the note, but we can't exactly snap
-            //it to the new strength.
-            if( marked_note != -1 )
-            {
-                hitnotes[marked_note] = 1;
+    if( distance > MAX_COMBINE_DISTANCE )
+    {
+        return;
+    }
 
-                note_peak_amps[marked_note] =
-                    note_peak_amps[marked_note] -
-                    (note_peak_amps[marked_note] >> AMP_1_IIR_BITS) +
-                    (this >> (AMP_1_IIR_BITS - 3));
+    int into;
+    int from;
 
-                note_peak_amps2[marked_note] =
-                    note_peak_amps2[marked_note] -
-                    (note_peak_amps2[marked_note] >> AMP_2_IIR_BITS) +
-                    ((this << 3) >> (AMP_2_IIR_BITS));
-            }
-        }
+    if( note_peak_amps[i] > note_peak_amps[j] )
+    {
+        into = i;
+        from = j;
+    }
+    else
+    {
+        into = j;
+        from = i;
     }
 
-#if 0
-    for( i = 0; i < MAXNOTES; i++ )
+    //We need to combine the notes.  We need to move the new note freq
+    //towards the stronger of the two notes.
+    int16_t amp1 = note_peak_amps[into];
+    int16_t amp2 = note_peak_amps[from];
+
+    //0 to 32768 porportional to how much of amp1 we want.
+    uint32_t porp = 0;
+    if(amp1 || amp2)
     {
-        if( note_peak_freqs[i] == 255 )
-        {
-            continue;
-        }
-        printf( "%d / ", note_peak_amps[i] );
+        porp = (amp1 << 15) / (amp1 + amp2);
     }
-    printf( "\n" );
-#endif
+    uint16_t newnote = (nf1 * porp + nf2 * (32768 - porp)) >> 15;
+
+    //When combining notes, we have to use the stronger amplitude note.
+    //trying to average or combine the power of the notes looks awful.
+    note_peak_freqs[into] = newnote;
+    note_peak_amps[into] = (note_peak_amps[into] > note_peak_amps[from]) ?
+                           note_peak_amps[into] : note_peak_amps[j];
+    note_peak_amps2[into] = (note_peak_amps2[into] > note_peak_amps2[from]) ?
+                            note_peak_amps2[into] : note_peak_amps2[j];
+
+    note_peak_freqs[from] = 255;
+    note_peak_amps[from] = 0;
+    note_jumped_to[from] = i;
+}
 
-    //Now we need to handle combining notes.
-    for( i = 0; i < MAXNOTES; i++ )
-        for( j = 0; j < i; j++ )
-        {
-            //We'd be combining nf2 (j) into nf1 (i) if they're close enough.
-            uint8_t nf1 = note_peak_freqs[i];
-            uint8_t nf2 = note_peak_freqs[j];
-            int16_t distance = nf1 - nf2;
+bool ICACHE_FLASH_ATTR StepFrameInfo( uint16_t budget )
+{
+    int i;
+    int32_t work = budget;
 
-            if( nf1 == 255 || nf2 == 255 )
+    while( work > 0 )
+    {
+        switch( frame.stage )
+        {
+            default:
+            case FRAME_IDLE:
             {
-                continue;
+#if defined(EMU)
+                emuCostAdd( EMU_COST_FRAME_UNIT, budget - work );
+#endif
+                return false;
             }
-
-            if( distance < 0 )
+            case FRAME_FUZZ:
             {
-                distance = -distance;
-            }
+                //Copy out the bins from the DFT to our fuzzed bins.
+                int end = ( frame.i + work < FIXBINS ) ? frame.i + work : FIXBINS;
+                for( i = frame.i; i < end; i++ )
+                {
+                    fuzzed_bins[i] = (fuzzed_bins[i] + (frame_bins[i] >> FUZZ_IIR_BITS) -
+                                      (fuzzed_bins[i] >> FUZZ_IIR_BITS));
 
-            //If it wraps around above the halfway point, then we're closer to it
-            //on the other side.
-            if( distance > ((1 << (SEMIBITSPERBIN - 1))*FIXBPERO) )
-            {
-                distance = ((1 << (SEMIBITSPERBIN)) * FIXBPERO) - distance;
-            }
+                    //Taper first octave
+                    if( i < FIXBPERO )
+                    {
+                        uint32_t taperamt = (65536 / FIXBPERO) * i;
+                        fuzzed_bins[i] = (taperamt * fuzzed_bins[i]) >> 16;
+                    }
 
-            if( distance > MAX_COMBINE_DISTANCE )
+                    //Taper last octave
+                    if( i >= FIXBINS - FIXBPERO )
+                    {
+                        uint32_t taperamt = (65536 / FIXBPERO) * (FIXBINS - i - 1);
+                        fuzzed_bins[i] = (taperamt * fuzzed_bins[i]) >> 16;
+                    }
+                }
+                work -= end - frame.i;
+                frame.i = end;
+                if( frame.i == FIXBINS )
+                {
+                    frame.stage = FRAME_FOLD;
+                    frame.i = 0;
+                }
+                break;
+            }
+            case FRAME_FOLD:
             {
-                continue;
+                //Fold the bins from fuzzedbins into one octave.
+                int k;
+                for( ; frame.i < FIXBPERO && work > 0; frame.i++ )
+                {
+                    folded_bins[frame.i] = 0;
+                    for( k = frame.i; k < FIXBINS; k += FIXBPERO )
+                    {
+                        folded_bins[frame.i] += fuzzed_bins[k];
+                    }
+                    work -= OCTAVES;
+                }
+                if( frame.i == FIXBPERO )
+                {
+                    frame.stage = FRAME_BLUR;
+                    frame.i = 0;
+                    frame.j = 0;
+                }
+                break;
             }
-
-            int into;
-            int from;
-
-            if( note_peak_amps[i] > note_peak_amps[j] )
+            case FRAME_BLUR:
             {
-                into = i;
-                from = j;
+                //Now, we must blur the folded bins to get a good result.
+                //Sometimes you may notice every other bin being out-of
+                //line, and this fixes that.  We may consider running this
+                //more than once, but in my experience, once is enough.
+                if( frame.j == FILTER_BLUR_PASSES )
+                {
+                    frame.stage = FRAME_PEAKS;
+                    frame.i = 0;
+                    break;
+                }
+                for( ; frame.i < FIXBPERO && work > 0; frame.i++ )
+                {
+                    uint8_t adjLeft = ( frame.i == 0 ) ? FIXBPERO - 1 : frame.i - 1;
+                    uint8_t adjRight = ( frame.i == FIXBPERO - 1 ) ? 0 : frame.i + 1;
+                    uint16_t lbin = folded_bins[adjLeft] >> 2;
+                    uint16_t rbin = folded_bins[adjRight] >> 2;
+                    uint16_t tbin = folded_bins[frame.i] >> 1;
+                    frame.folded_out[frame.i] = lbin + rbin + tbin;
+                    work--;
+                }
+                if( frame.i == FIXBPERO )
+                {
+                    ets_memcpy( folded_bins, frame.folded_out, sizeof( folded_bins ) );
+                    frame.i = 0;
+                    frame.j++;
+                }
+                break;
             }
-            else
+            case FRAME_PEAKS:
             {
-                into = j;
-                from = i;
+                for( ; frame.i < FIXBPERO && work > 0; frame.i++ )
+                {
+                    work -= FramePeak( frame.i );
+                }
+                if( frame.i == FIXBPERO )
+                {
+                    frame.stage = FRAME_COMBINE;
+                    frame.i = 0;
+                    frame.j = 0;
+                }
+                break;
             }
-
-            //We need to combine the notes.  We need to move the new note freq
-            //towards the stronger of the two notes.
-            int16_t amp1 = note_peak_amps[into];
-            int16_t amp2 = note_peak_amps[from];
-
-            //0 to 32768 porportional to how much of amp1 we want.
-            uint32_t porp = 0;
-            if(amp1 || amp2)
+            case FRAME_COMBINE:
             {
-                porp = (amp1 << 15) / (amp1 + amp2);
+                //Now we need to handle combining notes.
+                while( frame.i < MAXNOTES && work > 0 )
+                {
+                    if( frame.j < frame.i )
+                    {
+                        FrameCombine( frame.i, frame.j );
+                        frame.j++;
+                        work--;
+                    }
+                    else
+                    {
+                        frame.i++;
+                        frame.j = 0;
+                    }
+                }
+                if( frame.i == MAXNOTES )
+                {
+                    frame.stage = FRAME_DECAY;
+                }
+                break;
             }
-            uint16_t newnote = (nf1 * porp + nf2 * (32768 - porp)) >> 15;
-
-            //When combining notes, we have to use the stronger amplitude note.
-            //trying to average or combine the power of the notes looks awful.
-            note_peak_freqs[into] = newnote;
-            note_peak_amps[into] = (note_peak_amps[into] > note_peak_amps[from]) ?
-                                   note_peak_amps[into] : note_peak_amps[j];
-            note_peak_amps2[into] = (note_peak_amps2[into] > note_peak_amps2[from]) ?
-                                    note_peak_amps2[into] : note_peak_amps2[j];
-
-            note_peak_freqs[from] = 255;
-            note_peak_amps[from] = 0;
-            note_jumped_to[from] = i;
-        }
-
-    //For al lof the notes that have not been hit, we have to allow them to
-    //to decay.  We only do this for notes that have not found a peak.
-    for( i = 0; i < MAXNOTES; i++ )
-    {
-        if( note_peak_freqs[i] == 255 || hitnotes[i] )
-        {
-            continue;
-        }
+            case FRAME_DECAY:
+            {
+                //For al lof the notes that have not been hit, we have to allow them to
+                //to decay.  We only do this for notes that have not found a peak.
+                for( i = 0; i < MAXNOTES; i++ )
+                {
+                    if( note_peak_freqs[i] == 255 || frame.hitnotes[i] )
+                    {
+                        continue;
+                    }
 
-        note_peak_amps[i] -= note_peak_amps[i] >> AMP_1_IIR_BITS;
-        note_peak_amps2[i] -= note_peak_amps2[i] >> AMP_2_IIR_BITS;
+                    note_peak_amps[i] -= note_peak_amps[i] >> AMP_1_IIR_BITS;
+                    note_peak_amps2[i] -= note_peak_amps2[i] >> AMP_2_IIR_BITS;
 
-        //In the event a note is not strong enough anymore, it is to be
-        //returned back into the great pool of unused notes.
-        if( note_peak_amps[i] < MINIMUM_AMP_FOR_NOTE_TO_DISAPPEAR )
-        {
-            note_peak_freqs[i] = 255;
-            note_peak_amps[i] = 0;
-            note_peak_amps2[i] = 0;
-        }
-    }
+                    //In the event a note is not strong enough anymore, it is to be
+                    //returned back into the great pool of unused notes.
+                    if( note_peak_amps[i] < MINIMUM_AMP_FOR_NOTE_TO_DISAPPEAR )
+                    {
+                        note_peak_freqs[i] = 255;
+                        note_peak_amps[i] = 0;
+                        note_peak_amps2[i] = 0;
+                    }
+                }
 
-    //We now have notes!!!
-#if 0
-    for( i = 0; i < MAXNOTES; i++ )
-    {
-        if( note_peak_freqs[i] == 255 )
-        {
-            continue;
-        }
-        printf( "(%3d %4d %4d) ", note_peak_freqs[i], note_peak_amps[i], note_peak_amps2[i] );
-    }
-    printf( "\n") ;
+                //We now have notes!!!
+                frame.stage = FRAME_IDLE;
+#if defined(EMU)
+                emuCostAdd( EMU_COST_FRAME_UNIT, budget - work + MAXNOTES );
 #endif
-
-#if 0
-    for( i = 0; i < FIXBPERO; i++ )
-    {
-        printf( "%4d ", folded_bins[i] );
+                return true;
+            }
+        }
     }
-    printf( "\n" );
+#if defined(EMU)
+    emuCostAdd( EMU_COST_FRAME_UNIT, budget - work );
 #endif
-
-
+    return false;
 }
-
-
@@ -82,6 +82,19 @@
     #define MINIMUM_AMP_FOR_NOTE_TO_DISAPPEAR 64
 #endif
 
+//How many samples go into each frame, for PushFrameSamples().
+#ifndef SAMPLES_PER_FRAME
+    #define SAMPLES_PER_FRAME 128
+#endif
+
+//The least of HandleFrameInfo()'s work StepFrameInfo() is given per call.  A
+//whole frame is around FRAME_INFO_WORK.
+#ifndef FRAME_INFO_BUDGET
+    #define FRAME_INFO_BUDGET 64
+#endif
+#define FRAME_INFO_WORK 400
+#define FRAME_INFO_ALL 0xFFFF
+
 //This prevents compilation of any floating-point code, but it does come with
 //an added restriction: Both DFREQ and BASE_FREQ must be #defined to be
 //constants.
@@ -101,6 +114,20 @@ extern uint8_t  note_jumped_to[MAXNOTES]; // When a note combines into another o
 void ICACHE_FLASH_ATTR UpdateFreqs(void);        //Not user-useful on most systems.
 void ICACHE_FLASH_ATTR HandleFrameInfo(void);    //Not user-useful on most systems
 
+//HandleFrameInfo(), spread over several calls so it doesn't hold up anything
+//else.  StartFrameInfo() takes the DFT's bins, or returns false and skips this
+//frame if the last one isn't done yet.  StepFrameInfo() does up to budget of
+//the work on them, and returns true when the notes are ready.
+bool ICACHE_FLASH_ATTR StartFrameInfo(void);
+bool ICACHE_FLASH_ATTR StepFrameInfo(uint16_t budget);
+
+//PushFrameSamples() pushes samples into the DFT, and if startFrames is set
+//calls StartFrameInfo() every SAMPLES_PER_FRAME of them.  CatchUpFrameInfo()
+//is StepFrameInfo() with a budget that keeps up with the samples pushed since
+//it was last called.
+void ICACHE_FLASH_ATTR PushFrameSamples(const int16_t* samples, uint16_t numSamples, bool startFrames);
+bool ICACHE_FLASH_ATTR CatchUpFrameInfo(void);
+
 
 
 //Call this when starting.
@@ -37,7 +37,8 @@
 
 void ICACHE_FLASH_ATTR colorchordEnterMode(void);
 void ICACHE_FLASH_ATTR colorchordExitMode(void);
-void ICACHE_FLASH_ATTR colorchordSampleHandler(int32_t samp);
+void ICACHE_FLASH_ATTR colorchordSampleHandler(const int16_t* samples, uint16_t numSamples);
+void ICACHE_FLASH_ATTR colorchordProcTask(void);
 void ICACHE_FLASH_ATTR colorchordButtonCallback(uint8_t state, int button, int down);
 bool ICACHE_FLASH_ATTR ccRenderTask(void);
 void ICACHE_FLASH_ATTR ccExitTimerFn(void* arg);
@@ -52,8 +53,9 @@ swadgeMode colorchordMode =
     .fnEnterMode = colorchordEnterMode,
     .fnExitMode = colorchordExitMode,
     .fnButtonCallback = colorchordButtonCallback,
-    .fnAudioCallback = colorchordSampleHandler,
+    .fnAudioBlockCallback = colorchordSampleHandler,
     .fnRenderTask = ccRenderTask,
+    .fnProcTask = colorchordProcTask,
     .wifiMode = NO_WIFI,
     .fnEspNowRecvCb = NULL,
     .fnEspNowSendCb = NULL,
@@ -62,7 +64,6 @@ swadgeMode colorchordMode =
 
 struct
 {
-    int samplesProcessed;
     uint16_t maxValue;
     timer_t exitTimer;
     uint32_t exitTimeAccumulatedUs;
@@ -105,7 +106,6 @@ void ICACHE_FLASH_ATTR colorchordEnterMode(void)
     InitColorChord();
 
     ets_memset(&cc, 0, sizeof(cc));
-    cc.samplesProcessed = 0;
     cc.maxValue = 1;
 
     cc.exitTimeAccumulatedUs = 0;
@@ -192,7 +192,7 @@ bool ICACHE_FLASH_ATTR ccRenderTask(void)
     if(cc.exitTimeAccumulatedUs > 0)
     {
         // Draw a bar
-        plotLine(0, OLED_HEIGHT - 1, (OLED_WIDTH * cc.exitTimeAccumulatedUs) / US_TO_QUIT, OLED_HEIGHT - 1, WHITE);
+        drawHLine(0, (OLED_WIDTH * cc.exitTimeAccumulatedUs) / US_TO_QUIT, OLED_HEIGHT - 1, WHITE);
     }
     return true;
 }
@@ -209,51 +209,48 @@ void ICACHE_FLASH_ATTR colorchordExitMode(void)
 }
 
 /**
- * This is called every time an audio sample is read from the ADC
- * This processes the sample and will display update the LEDs every
+ * This is called with blocks of audio samples read from the ADC
+ * This processes the samples and will display update the LEDs every
  * 128 samples
  *
- * @param samp A 32 bit audio sample read from the ADC (microphone)
+ * @param samples    Filtered audio samples read from the ADC (microphone)
+ * @param numSamples The number of samples
  */
-void ICACHE_FLASH_ATTR colorchordSampleHandler(int32_t samp)
+void ICACHE_FLASH_ATTR colorchordSampleHandler(const int16_t* samples, uint16_t numSamples)
 {
-    PushSample32( samp );
-    cc.samplesProcessed++;
+    // Colorchord does a frame every SAMPLES_PER_FRAME samples, when it's active
+    PushFrameSamples(samples, numSamples, COLORCHORD_ACTIVE);
+}
+
+/**
+ * Do some of the current colorchord frame, and update the LEDs when it's done.
+ * Spreading the frame out keeps any one pass of procTask short
+ */
+void ICACHE_FLASH_ATTR colorchordProcTask(void)
+{
+    if( !CatchUpFrameInfo() )
+    {
+        return;
+    }
 
-    // If at least 128 samples have been processed
-    if( cc.samplesProcessed >= 128 )
+    // Update the LEDs as necessary
+    switch( COLORCHORD_OUTPUT_DRIVER )
     {
-        // Don't bother if colorchord is inactive
-        if( !COLORCHORD_ACTIVE )
+        default:
+        case 0:
         {
-            return;
+            UpdateLinearLEDs();
+            break;
         }
-
-        // Colorchord magic
-        HandleFrameInfo();
-
-        // Update the LEDs as necessary
-        switch( COLORCHORD_OUTPUT_DRIVER )
+        case 1:
         {
-            default:
-            case 0:
-            {
-                UpdateLinearLEDs();
-                break;
-            }
-            case 1:
-            {
-                UpdateAllSameLEDs();
-                break;
-            }
-        };
-
-        // Push out the LED data
-        setLeds( (led_t*)ledOut, NUM_LIN_LEDS * 3 );
+            UpdateAllSameLEDs();
+            break;
+        }
+    };
 
-        // Reset the sample count
-        cc.samplesProcessed = 0;
-    }
+    // Push out the LED data
+    setLeds( (led_t*)ledOut, NUM_LIN_LEDS * 3 );
 }
 
 /**
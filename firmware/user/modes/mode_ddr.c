@@ -21,6 +21,7 @@
 #include "sprite.h"
 #include "font.h"
 #include "bresenham.h"
+#include "cndraw.h"
 #include "buttons.h"
 #include "hpatimer.h"
 #include "menu2d.h"
@@ -88,6 +89,7 @@ static void ICACHE_FLASH_ATTR ddrAnimateSuccessMeter(void* arg __attribute((unus
 
 static void ICACHE_FLASH_ATTR ddrSongDurationFunc(void* arg __attribute((unused)));
 static void ICACHE_FLASH_ATTR ddrMakeScoreString(ddrWinResult_t curWin, char* scoreText, unsigned int size);
+static void ICACHE_FLASH_ATTR ddrLayoutScores(void);
 //static void ICACHE_FLASH_ATTR ddrAnimateSprite(void* arg __attribute__((unused)));
 //static void ICACHE_FLASH_ATTR ddrUpdateButtons(void* arg __attribute__((unused)));
 
@@ -207,6 +209,13 @@ typedef struct
 
     ddrHighScores_t highScores;
 
+    // The high score screen, formatted and measured once per difficulty rather than every frame
+    bool scoresLayoutValid;
+    ddrDifficultyType scoresLayoutDifficulty;
+    const char* scoresTitle;
+    int16_t scoresTitleX;
+    char scoresText[DDR_HIGHSCORE_LEN][24];
+
 } ddr_t;
 
 ddr_t* ddr;
@@ -703,6 +712,49 @@ static void ICACHE_FLASH_ATTR ddrMakeScoreString(ddrWinResult_t curWin, char* sc
     }
 }
 
+/**
+ * @brief Format and lay out the high score screen for the current difficulty.
+ * This is only redone when the difficulty or the scores change
+ */
+static void ICACHE_FLASH_ATTR ddrLayoutScores(void)
+{
+    ddrWinResult_t* currentDiffScores;
+    const char* diffName;
+
+    switch(ddr->currentDifficultyType)
+    {
+        default:
+        case DDR_HARD:
+            currentDiffScores = ddr->highScores.hardWins;
+            diffName = str_v_hard;
+            break;
+        case DDR_MEDIUM:
+            currentDiffScores = ddr->highScores.mediumWins;
+            diffName = str_hard;
+            break;
+        case DDR_EASY:
+            currentDiffScores = ddr->highScores.easyWins;
+            diffName = str_medium;
+            break;
+        case DDR_VERY_EASY:
+            currentDiffScores = ddr->highScores.veryEasyWins;
+            diffName = str_easy;
+            break;
+    }
+
+    ddr->scoresTitle = diffName;
+    ddr->scoresTitleX = (OLED_WIDTH - textWidth(diffName, IBM_VGA_8)) / 2;
+
+    for (int i = 0; i < DDR_HIGHSCORE_LEN; i++)
+    {
+        ddr->scoresText[i][0] = '\0';
+        ddrMakeScoreString(currentDiffScores[i], ddr->scoresText[i], sizeof(ddr->scoresText[i]));
+    }
+
+    ddr->scoresLayoutDifficulty = ddr->currentDifficultyType;
+    ddr->scoresLayoutValid = true;
+}
+
 static void ICACHE_FLASH_ATTR ddrUpdateDisplay(void* arg __attribute__((unused)))
 {
     switch(ddr->mode)
@@ -717,43 +769,18 @@ static void ICACHE_FLASH_ATTR ddrUpdateDisplay(void* arg __attribute__((unused))
         {
             clearDisplay();
 
-            ddrWinResult_t* currentDiffScores;
-            const char* diffName;
-
-            switch(ddr->currentDifficultyType)
+            if (!ddr->scoresLayoutValid || ddr->scoresLayoutDifficulty != ddr->currentDifficultyType)
             {
-                default:
-                case DDR_HARD:
-                    currentDiffScores = ddr->highScores.hardWins;
-                    diffName = str_v_hard;
-                    break;
-                case DDR_MEDIUM:
-                    currentDiffScores = ddr->highScores.mediumWins;
-                    diffName = str_hard;
-                    break;
-                case DDR_EASY:
-                    currentDiffScores = ddr->highScores.easyWins;
-                    diffName = str_medium;
-                    break;
-                case DDR_VERY_EASY:
-                    currentDiffScores = ddr->highScores.veryEasyWins;
-                    diffName = str_easy;
-                    break;
+                ddrLayoutScores();
             }
 
-            char scoresTitle[16];
-            ets_snprintf(scoresTitle, sizeof(scoresTitle),   "%s", diffName);
-            int titleXPos = (OLED_WIDTH - textWidth(scoresTitle, IBM_VGA_8)) / 2;
-            plotText(titleXPos, 5, scoresTitle, IBM_VGA_8, WHITE);
+            plotText(ddr->scoresTitleX, 5, ddr->scoresTitle, IBM_VGA_8, WHITE);
 
             for (int i = 0; i < DDR_HIGHSCORE_LEN && i < 8; i++)
             {
-                ddrWinResult_t curWin = currentDiffScores[i];
                 int yPos = 26 + (i % 4) * 10;
                 int xPos = 5 + (i / 4) * 60;
-                char scoreText[24] = {0};
-                ddrMakeScoreString(curWin, scoreText, sizeof(scoreText));
-                plotText(xPos, yPos, scoreText, TOM_THUMB, WHITE);
+                plotText(xPos, yPos, ddr->scoresText[i], TOM_THUMB, WHITE);
             }
 
             plotText(0, 56, "<", TOM_THUMB, WHITE);
@@ -865,7 +892,7 @@ static void ICACHE_FLASH_ATTR ddrUpdateDisplay(void* arg __attribute__((unused))
 
             if ( ddr->successMeter == 100 )
             {
-                plotLine(OLED_WIDTH - 1, 0, OLED_WIDTH - 1, OLED_HEIGHT - 1, WHITE);
+                drawVLine(OLED_WIDTH - 1, 0, OLED_HEIGHT - 1, WHITE);
                 for (int y = OLED_HEIGHT - 1 - ddr->successMeterShineStart; y > 1 ; y -= 5 )
                 {
                     drawPixel(OLED_WIDTH - 1, y, BLACK);
@@ -874,8 +901,8 @@ static void ICACHE_FLASH_ATTR ddrUpdateDisplay(void* arg __attribute__((unused))
             }
             else
             {
-                plotLine(OLED_WIDTH - 1, (OLED_HEIGHT - 1) - (float)ddr->successMeter / 100.0f * (OLED_HEIGHT - 1), OLED_WIDTH - 1,
-                         OLED_HEIGHT - 1, WHITE);
+                drawVLine(OLED_WIDTH - 1, (OLED_HEIGHT - 1) - (float)ddr->successMeter / 100.0f * (OLED_HEIGHT - 1),
+                          OLED_HEIGHT - 1, WHITE);
             }
 
             if (ddr->currentCombo > 3)
@@ -1129,6 +1156,7 @@ static void ICACHE_FLASH_ATTR ddrCheckAndSubmitScore()
         }
         currentDiffScores[insertIndex] = ddr->winResult;
         setDDRScores(&ddr->highScores);
+        ddr->scoresLayoutValid = false;
     }
 }
 
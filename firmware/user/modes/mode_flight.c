@@ -280,14 +280,14 @@ static void ICACHE_FLASH_ATTR flightMenuCb(const char* menuItem)
         flightSimSaveData_t * sd = getFlightSaveData();
         sd->flightInvertY = 1;
         setFlightSaveData( sd );
-        flight->invYmnu->item.name = fl_flight_invertY1_env;
+        renameMenuItem(flight->invYmnu, fl_flight_invertY1_env);
     }
     else if ( fl_flight_invertY1_env == menuItem )
     {
         flightSimSaveData_t * sd = getFlightSaveData();
         sd->flightInvertY = 0;
         setFlightSaveData( sd );
-        flight->invYmnu->item.name = fl_flight_invertY0_env;
+        renameMenuItem(flight->invYmnu, fl_flight_invertY0_env);
     }
     else if ( str_high_scores == menuItem )
     {
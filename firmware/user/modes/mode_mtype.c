@@ -311,6 +311,13 @@ typedef struct
 
     mtHighScores_t highScores;
 
+    // The high score screen, formatted and measured once per difficulty rather than every frame
+    bool scoresLayoutValid;
+    uint8_t scoresLayoutDifficulty;
+    const char* scoresTitle;
+    int16_t scoresTitleX;
+    char scoresText[MT_NUM_HIGHSCORES][24];
+
     led_t leds[NUM_LEDS];
 
     pngHandle playerUpHandle;
@@ -376,7 +383,7 @@ void ICACHE_FLASH_ATTR clearLEDs(uint8_t numLEDs);
 void ICACHE_FLASH_ATTR applyLEDBrightness(uint8_t numLEDs, float brightness);
 
 bool ICACHE_FLASH_ATTR submitMTScore(uint8_t difficulty, uint32_t timeSurvived, uint32_t score);
-uint8_t ICACHE_FLASH_ATTR getTextWidth(char* text, fonts font);
+void ICACHE_FLASH_ATTR mtLayoutScores(void);
 bool ICACHE_FLASH_ATTR AABBCollision (int ax0, int ay0, int ax1, int ay1, int bx0, int by0, int bx1, int by1, bool bounds);
 void ICACHE_FLASH_ATTR normalize (vecfloat_t * vec);
 bool ICACHE_FLASH_ATTR fireProjectile (uint8_t owner, uint8_t type, vec_t position, vec_t bounds, vecfloat_t direction, uint8_t speed, uint8_t damage);
@@ -430,27 +437,36 @@ void ICACHE_FLASH_ATTR mtEnterMode(void)
     mType = os_malloc(sizeof(mType_t));
     ets_memset(mType, 0, sizeof(mType_t));
 
-    allocPngAsset("mt-pu.png", &mType->playerUpHandle);
-    allocPngAsset("mt-pd.png", &mType->playerDownHandle);
-    allocPngAsset("mt-ps.png", &mType->playerStraightHandle);
-    allocPngAsset("mt-powerup.png", &mType->powerupHandle);
-
-    allocPngSequence(&mType->bomberSequenceHandle, 2,
-                     "mt-bomber1.png",
-                     "mt-bomber2.png");
-
-    allocPngSequence(&mType->snakeSequenceHandle, 2,
-                     "mt-snake1.png",
-                     "mt-snake2.png");
-
-    allocPngSequence(&mType->walkerSequenceHandle, 2,
-                     "mt-walker1.png",
-                     "mt-walker2.png");
-
-    allocPngSequence(&mType->explosionSequenceHandle, 3,
-                     "mt-explode1.png",
-                     "mt-explode2.png",
-                     "mt-explode3.png");
+    mapPngAsset("mt-pu.png", &mType->playerUpHandle);
+    mapPngAsset("mt-pd.png", &mType->playerDownHandle);
+    mapPngAsset("mt-ps.png", &mType->playerStraightHandle);
+    mapPngAsset("mt-powerup.png", &mType->powerupHandle);
+
+    mapPngSequence(&mType->bomberSequenceHandle, 2,
+                   "mt-bomber1.png",
+                   "mt-bomber2.png");
+
+    mapPngSequence(&mType->snakeSequenceHandle, 2,
+                   "mt-snake1.png",
+                   "mt-snake2.png");
+
+    mapPngSequence(&mType->walkerSequenceHandle, 2,
+                   "mt-walker1.png",
+                   "mt-walker2.png");
+
+    mapPngSequence(&mType->explosionSequenceHandle, 3,
+                   "mt-explode1.png",
+                   "mt-explode2.png",
+                   "mt-explode3.png");
+
+    // The player and enemies are drawn every frame, so decode them to the
+    // framebuffer's layout. Powerups and explosions are drawn from flash
+    decodePngAsset(&mType->playerUpHandle);
+    decodePngAsset(&mType->playerDownHandle);
+    decodePngAsset(&mType->playerStraightHandle);
+    decodePngSequence(&mType->bomberSequenceHandle);
+    decodePngSequence(&mType->snakeSequenceHandle);
+    decodePngSequence(&mType->walkerSequenceHandle);
 
     // Reset mode time tracking.
     mType->modeStartTime = system_get_time();
@@ -641,7 +657,7 @@ static void ICACHE_FLASH_ATTR mtUpdate(void* arg __attribute__((unused)))
     int32_t fps = (int)((float)mType->stateFrames / seconds);
     //ets_snprintf(uiStr, sizeof(uiStr), "FPS: %d", fps);
     ets_snprintf(uiStr, sizeof(uiStr), "W:%d E:%d", mType->wave, mType->enemiesInWave);
-    plotText(OLED_WIDTH - getTextWidth(uiStr, TOM_THUMB) - 1, OLED_HEIGHT - (1 * (FONT_HEIGHT_TOMTHUMB + 1)), uiStr, TOM_THUMB, WHITE);*/
+    plotText(OLED_WIDTH - textWidth(uiStr, TOM_THUMB), OLED_HEIGHT - (1 * (FONT_HEIGHT_TOMTHUMB + 1)), uiStr, TOM_THUMB, WHITE);*/
 }
 
 // helper functions.
@@ -1683,10 +1699,9 @@ void ICACHE_FLASH_ATTR mtGameDisplay(void)
 
     // reflect text
     ets_snprintf(uiStr, sizeof(uiStr), "REFLECT");
-    plotText(reflectTextX, reflectTextY, uiStr, TOM_THUMB, WHITE);
 
-    // reflect bar container
-    int reflectBarX0 = reflectTextX + getTextWidth(uiStr, TOM_THUMB) + 1;
+    // reflect bar container, starting where the text ends
+    int reflectBarX0 = plotText(reflectTextX, reflectTextY, uiStr, TOM_THUMB, WHITE);
     int reflectBarY0 = reflectTextY + 1;
     int reflectBarX1 = reflectBarX0 + 35;
     int reflectBarY1 = reflectBarY0 + 2;
@@ -1697,7 +1712,7 @@ void ICACHE_FLASH_ATTR mtGameDisplay(void)
     float charge = mType->player.abilityCountdown > 0 ? (float)mType->player.abilityCountdown / PLAYER_REFLECT_TIME : (float)mType->player.abilityChargeCounter / PLAYER_REFLECT_CHARGE_MAX;
 
     int reflectBarFillX1 = reflectBarX0 + (charge * ((reflectBarX1 - 1) - reflectBarX0));
-    plotLine(reflectBarX0, reflectBarY0 + 1, reflectBarFillX1, reflectBarY0 + 1, WHITE);
+    drawHLine(reflectBarX0, reflectBarFillX1, reflectBarY0 + 1, WHITE);
 
     // wave text
     int waveTextX = reflectBarX1 + 10;
@@ -1751,8 +1766,8 @@ void ICACHE_FLASH_ATTR mtGameDisplay(void)
     //char uiStr[32] = {0};
     //ets_snprintf(uiStr, sizeof(uiStr), "BTN: %d u:%d, d:%d, l:%d, r:%d, a:%d", button, upDown, downDown, leftDown, rightDown, actionDown);
     /*ets_snprintf(uiStr, sizeof(uiStr), "sp:%f", shotProgress);
-    fillDisplayArea(OLED_WIDTH - getTextWidth(uiStr, TOM_THUMB) - 1, OLED_HEIGHT - (1 * (FONT_HEIGHT_TOMTHUMB + 1)), OLED_WIDTH, OLED_HEIGHT, BLACK);
-    plotText(OLED_WIDTH - getTextWidth(uiStr, TOM_THUMB) - 1, OLED_HEIGHT - (1 * (FONT_HEIGHT_TOMTHUMB + 1)), uiStr, TOM_THUMB, WHITE);*/
+    fillDisplayArea(OLED_WIDTH - textWidth(uiStr, TOM_THUMB), OLED_HEIGHT - (1 * (FONT_HEIGHT_TOMTHUMB + 1)), OLED_WIDTH, OLED_HEIGHT, BLACK);
+    plotText(OLED_WIDTH - textWidth(uiStr, TOM_THUMB), OLED_HEIGHT - (1 * (FONT_HEIGHT_TOMTHUMB + 1)), uiStr, TOM_THUMB, WHITE);*/
 }
 
 void ICACHE_FLASH_ATTR mtScoresInput(void)
@@ -1784,43 +1799,17 @@ void ICACHE_FLASH_ATTR mtScoresDisplay(void)
 {
     clearDisplay();
 
-    mtScore_t* currentDiffScores;
-    char scoresTitle[16];
-
-    switch (mType->difficulty) {
-        default:
-        case DIFFICULTY_VERYHARD:
-            currentDiffScores = mType->highScores.veryhardScores;
-            ets_snprintf(scoresTitle, sizeof(scoresTitle), "%s", str_v_hard);
-            break;
-        case DIFFICULTY_HARD:
-            currentDiffScores = mType->highScores.hardScores;
-            ets_snprintf(scoresTitle, sizeof(scoresTitle), "%s", str_hard);
-            break;
-        case DIFFICULTY_MEDIUM:
-            currentDiffScores = mType->highScores.mediumScores;
-            ets_snprintf(scoresTitle, sizeof(scoresTitle), "%s", str_medium);
-            break;
-        case DIFFICULTY_EASY:
-            currentDiffScores = mType->highScores.easyScores;
-            ets_snprintf(scoresTitle, sizeof(scoresTitle), "%s", str_easy);
-            break;
+    if (!mType->scoresLayoutValid || mType->scoresLayoutDifficulty != mType->difficulty) {
+        mtLayoutScores();
     }
 
-    int titleXPos = (OLED_WIDTH - textWidth(scoresTitle, IBM_VGA_8)) / 2;
     int titleYPos = 5;
-    plotText(titleXPos, titleYPos, scoresTitle, IBM_VGA_8, WHITE);
+    plotText(mType->scoresTitleX, titleYPos, mType->scoresTitle, IBM_VGA_8, WHITE);
 
     for (int i = 0; i < MT_NUM_HIGHSCORES; i++) {
-        mtScore_t currScore = currentDiffScores[i];
-        if (currScore.score > 0 || currScore.timeSurvived > 0) {
-            int yPos = 26 + (i % 4) * 10;
-            int xPos = 5 + (i / 4) * 60;
-            char scoreText[24];
-            uint32_t secondsSurvived = currScore.timeSurvived * US_TO_MS_FACTOR * MS_TO_S_FACTOR;
-            ets_snprintf(scoreText, sizeof(scoreText), "%d. %06u (%u:%02u)", (i + 1), currScore.score, secondsSurvived / 60, secondsSurvived % 60);
-            plotText(xPos, yPos, scoreText, TOM_THUMB, WHITE);
-        }
+        int yPos = 26 + (i % 4) * 10;
+        int xPos = 5 + (i / 4) * 60;
+        plotText(xPos, yPos, mType->scoresText[i], TOM_THUMB, WHITE);
     }
 
     plotText(0, 56, "<", TOM_THUMB, WHITE);
@@ -1909,6 +1898,51 @@ static void ICACHE_FLASH_ATTR mtGameoverMenuCallback(const char* menuItem)
     }
 }
 
+// Format and lay out the high score screen for the selected difficulty.
+// This is only redone when the difficulty or the scores change.
+void ICACHE_FLASH_ATTR mtLayoutScores(void) {
+    mtScore_t* currentDiffScores;
+    const char* scoresTitle;
+
+    switch (mType->difficulty) {
+        default:
+        case DIFFICULTY_VERYHARD:
+            currentDiffScores = mType->highScores.veryhardScores;
+            scoresTitle = str_v_hard;
+            break;
+        case DIFFICULTY_HARD:
+            currentDiffScores = mType->highScores.hardScores;
+            scoresTitle = str_hard;
+            break;
+        case DIFFICULTY_MEDIUM:
+            currentDiffScores = mType->highScores.mediumScores;
+            scoresTitle = str_medium;
+            break;
+        case DIFFICULTY_EASY:
+            currentDiffScores = mType->highScores.easyScores;
+            scoresTitle = str_easy;
+            break;
+    }
+
+    mType->scoresTitle = scoresTitle;
+    mType->scoresTitleX = (OLED_WIDTH - textWidth(scoresTitle, IBM_VGA_8)) / 2;
+
+    for (int i = 0; i < MT_NUM_HIGHSCORES; i++) {
+        mtScore_t currScore = currentDiffScores[i];
+        char* scoreText = mType->scoresText[i];
+        if (currScore.score > 0 || currScore.timeSurvived > 0) {
+            uint32_t secondsSurvived = currScore.timeSurvived * US_TO_MS_FACTOR * MS_TO_S_FACTOR;
+            ets_snprintf(scoreText, sizeof(mType->scoresText[i]), "%d. %06u (%u:%02u)", (i + 1), currScore.score, secondsSurvived / 60, secondsSurvived % 60);
+        }
+        else {
+            scoreText[0] = '\0';
+        }
+    }
+
+    mType->scoresLayoutDifficulty = mType->difficulty;
+    mType->scoresLayoutValid = true;
+}
+
 bool ICACHE_FLASH_ATTR submitMTScore(uint8_t difficulty, uint32_t timeSurvived, uint32_t score) {
     bool newHighScore = false;
     if (difficulty == DIFFICULTY_EASY) {
@@ -1969,25 +2003,11 @@ bool ICACHE_FLASH_ATTR submitMTScore(uint8_t difficulty, uint32_t timeSurvived,
     
     if (newHighScore) {
         setMTScores(&mType->highScores);
+        mType->scoresLayoutValid = false;
     }
     return newHighScore;
 }
 
-uint8_t ICACHE_FLASH_ATTR getTextWidth(char* text, fonts font)
-{
-    // NOTE: The inverse, inverse is cute, but 2 draw calls, could we draw it outside of the display area but still in bounds of a uint8_t?
-
-    // We only get width info once we've drawn.
-    // So we draw the text as inverse to get the width.
-    uint8_t textWidth = plotText(0, 0, text, font,
-                                 INVERSE) - 1; // minus one accounts for the return being where the cursor is.
-
-    // Then we draw the inverse back over it to restore it.
-    plotText(0, 0, text, font, INVERSE);
-
-    return textWidth;
-}
-
 bool ICACHE_FLASH_ATTR AABBCollision (int ax0, int ay0, int ax1, int ay1, int bx0, int by0, int bx1, int by1, bool bounds) {
     // int awidth = ax1 - ax0;
     // int aheight = ay1 - ay0;
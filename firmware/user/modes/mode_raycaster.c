@@ -451,64 +451,68 @@ void ICACHE_FLASH_ATTR raycasterEnterMode(void)
 
     // Load the enemy texture to RAM
     pngHandle tmpPngHandle;
-    allocPngAsset("h8_wlk1.png", &tmpPngHandle);
+    mapPngAsset("h8_wlk1.png", &tmpPngHandle);
     drawPngToBuffer(&tmpPngHandle, rc->walk[0]);
     freePngAsset(&tmpPngHandle);
 
-    allocPngAsset("h8_wlk2.png", &tmpPngHandle);
+    mapPngAsset("h8_wlk2.png", &tmpPngHandle);
     drawPngToBuffer(&tmpPngHandle, rc->walk[1]);
     freePngAsset(&tmpPngHandle);
 
-    allocPngAsset("h8_atk1.png", &tmpPngHandle);
+    mapPngAsset("h8_atk1.png", &tmpPngHandle);
     drawPngToBuffer(&tmpPngHandle, rc->shooting[0]);
     freePngAsset(&tmpPngHandle);
 
-    allocPngAsset("h8_atk2.png", &tmpPngHandle);
+    mapPngAsset("h8_atk2.png", &tmpPngHandle);
     drawPngToBuffer(&tmpPngHandle, rc->shooting[1]);
     freePngAsset(&tmpPngHandle);
 
-    allocPngAsset("h8_hrt1.png", &tmpPngHandle);
+    mapPngAsset("h8_hrt1.png", &tmpPngHandle);
     drawPngToBuffer(&tmpPngHandle, rc->hurt[0]);
     freePngAsset(&tmpPngHandle);
 
-    allocPngAsset("h8_hrt2.png", &tmpPngHandle);
+    mapPngAsset("h8_hrt2.png", &tmpPngHandle);
     drawPngToBuffer(&tmpPngHandle, rc->hurt[1]);
     freePngAsset(&tmpPngHandle);
 
-    allocPngAsset("h8_ded.png", &tmpPngHandle);
+    mapPngAsset("h8_ded.png", &tmpPngHandle);
     drawPngToBuffer(&tmpPngHandle, rc->dead);
     freePngAsset(&tmpPngHandle);
 
     // Load the wall textures to RAM
-    allocPngAsset("txstone.png", &tmpPngHandle);
+    mapPngAsset("txstone.png", &tmpPngHandle);
     drawPngToBuffer(&tmpPngHandle, rc->stoneTex);
     freePngAsset(&tmpPngHandle);
 
-    allocPngAsset("txstripe.png", &tmpPngHandle);
+    mapPngAsset("txstripe.png", &tmpPngHandle);
     drawPngToBuffer(&tmpPngHandle, rc->stripeTex);
     freePngAsset(&tmpPngHandle);
 
-    allocPngAsset("txbrick.png", &tmpPngHandle);
+    mapPngAsset("txbrick.png", &tmpPngHandle);
     drawPngToBuffer(&tmpPngHandle, rc->brickTex);
     freePngAsset(&tmpPngHandle);
 
-    allocPngAsset("txsinw.png", &tmpPngHandle);
+    mapPngAsset("txsinw.png", &tmpPngHandle);
     drawPngToBuffer(&tmpPngHandle, rc->sinTex);
     freePngAsset(&tmpPngHandle);
 
     // Load the HUD assets
-    allocPngAsset("heart.png", &(rc->heart));
-    allocPngAsset("mnote.png", &(rc->mnote));
-    allocPngSequence(&(rc->gtr), 5,
-                     "gtr1.png",
-                     "gtr2.png",
-                     "gtr3.png",
-                     "gtr4.png",
-                     "gtr5.png");
-    allocPngSequence(&(rc->boot), 3,
-                     "boot1.png",
-                     "boot2.png",
-                     "boot3.png");
+    mapPngAsset("heart.png", &(rc->heart));
+    mapPngAsset("mnote.png", &(rc->mnote));
+    mapPngSequence(&(rc->gtr), 5,
+                   "gtr1.png",
+                   "gtr2.png",
+                   "gtr3.png",
+                   "gtr4.png",
+                   "gtr5.png");
+    mapPngSequence(&(rc->boot), 3,
+                   "boot1.png",
+                   "boot2.png",
+                   "boot3.png");
+    // The heart and note are drawn every frame, so decode them to the
+    // framebuffer's layout. The rest are drawn from flash
+    decodePngAsset(&(rc->heart));
+    decodePngAsset(&(rc->mnote));
 
     // Set up the LED timer
     rc->closestDist = 0xFFFFFFFF;
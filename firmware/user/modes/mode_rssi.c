@@ -20,6 +20,7 @@
 #include "user_main.h"
 #include "embeddednf.h"
 #include "oled.h"
+#include "oled_dirty.h"
 #include "bresenham.h"
 #include "cndraw.h"
 #include "assets.h"
@@ -539,6 +540,7 @@ static void ICACHE_FLASH_ATTR RSSIRecvPIXELFLUTData(void* pArg, char* pData, uns
                     //currentFb[0] = 0;
                     extern bool fbChanges;
                     fbChanges = true;
+                    markOledDirtyAll();
 
                     //Reply with button states
                     char cts[16];
@@ -947,7 +949,7 @@ static void ICACHE_FLASH_ATTR rssiUpdate(void* arg __attribute__((unused)))
                             {
                                 y = OLED_HEIGHT - 1;
                             }
-                            plotLine(x, OLED_HEIGHT - 1, x, y, WHITE);
+                            drawVLine(x, OLED_HEIGHT - 1, y, WHITE);
                         }
                         plotText(0, OLED_HEIGHT - FONT_HEIGHT_TOMTHUMB, "<", TOM_THUMB, INVERSE);
                         plotText(OLED_WIDTH - 3, OLED_HEIGHT - FONT_HEIGHT_TOMTHUMB, ">", TOM_THUMB, INVERSE);
@@ -32,6 +32,7 @@
 
 #include "embeddednf.h"
 #include "embeddedout.h"
+#include "goertzel.h"
 
 /*============================================================================
  * Defines, Structs, Enums
@@ -61,6 +62,11 @@
 
 #define US_TO_QUIT 1048576 // 2^20, makes division easy
 
+// Instruments are tuned with Goertzel filters at their strings instead of colorchord
+#define TUNER_BLOCK_LEN       2048 // Samples per reading, 128ms. Long enough to resolve a few cents on low E
+#define TUNER_IIR_SHIFT       1    // How much readings are smoothed, in blocks
+#define TUNER_IN_TUNE_CENTS   3    // How far off a string can be and still be in tune
+
 /// Helper macro to return an integer clamped within a range (MIN to MAX)
 #define CLAMP(X, MIN, MAX) ( ((X) > (MAX)) ? (MAX) : ( ((X) < (MIN)) ? (MIN) : (X)) )
 /// Helper macro to return the absolute value of an integer
@@ -107,9 +113,10 @@ typedef struct
     int lastBpmButton;
     uint32_t bpmButtonTimerUs;
 
-    int audioSamplesProcessed;
     uint32_t intensities_filt[NUM_LIN_LEDS];
     int32_t diffs_filt[NUM_LIN_LEDS];
+    goertzel_t goertzel;
+    tuner_mode_t goertzelMode; // The instrument the filters are set up for
 
     uint8_t tSigIdx;
     uint8_t beatCtr;
@@ -149,19 +156,18 @@ void ICACHE_FLASH_ATTR switchToSubmode(tnMode);
 void ICACHE_FLASH_ATTR tunernomeButtonCallback(uint8_t state __attribute__((unused)),
         int button, int down);
 void ICACHE_FLASH_ATTR modifyBpm(int16_t bpmMod);
-void ICACHE_FLASH_ATTR tunernomeSampleHandler(int32_t samp);
+void ICACHE_FLASH_ATTR tunernomeSampleHandler(const int16_t* samples, uint16_t numSamples);
+void ICACHE_FLASH_ATTR tunernomeProcTask(void);
+void ICACHE_FLASH_ATTR instrumentTunerSamples(const int16_t* samples, uint16_t numSamples);
 void ICACHE_FLASH_ATTR recalcMetronome(void);
 void ICACHE_FLASH_ATTR plotInstrumentNameAndNotes(const char* instrumentName, const char** instrumentNotes,
         uint16_t numNotes);
 void ICACHE_FLASH_ATTR plotTopSemiCircle(int xm, int ym, int r, color col);
-void ICACHE_FLASH_ATTR instrumentTunerMagic(const uint16_t freqBinIdxs[], uint16_t numStrings, led_t colors[],
-        const uint16_t stringIdxToLedIdx[]);
+void ICACHE_FLASH_ATTR instrumentTunerMagic(uint16_t numStrings, led_t colors[], const uint16_t stringIdxToLedIdx[]);
 bool ICACHE_FLASH_ATTR tunernomeRenderTask(void);
 void ICACHE_FLASH_ATTR ledReset(void* timer_arg __attribute__((unused)));
 void ICACHE_FLASH_ATTR fasterBpmChange(void* timer_arg __attribute__((unused)));
 
-static inline int16_t getMagnitude(uint16_t idx);
-static inline int16_t getDiffAround(uint16_t idx);
 static inline int16_t getSemiMagnitude(int16_t idx);
 static inline int16_t getSemiDiffAround(uint16_t idx);
 void ICACHE_FLASH_ATTR tnExitTimerFn(void* arg);
@@ -181,7 +187,8 @@ swadgeMode tunernomeMode =
     .fnEspNowRecvCb = NULL,
     .fnEspNowSendCb = NULL,
     .fnAccelerometerCallback = NULL,
-    .fnAudioCallback = tunernomeSampleHandler,
+    .fnAudioBlockCallback = tunernomeSampleHandler,
+    .fnProcTask = tunernomeProcTask,
     .menuImg = "tn-menu.gif"
 };
 
@@ -360,6 +367,8 @@ void ICACHE_FLASH_ATTR switchToSubmode(tnMode newMode)
         case TN_TUNER:
         {
             tunernome->mode = newMode;
+            // The filters missed the samples while away, so set them up again
+            tunernome->goertzelMode = MAX_GUITAR_MODES;
 
             led_t leds[NUM_LIN_LEDS] = {{0}};
             setLeds(leds, sizeof(leds));
@@ -416,29 +425,6 @@ void ICACHE_FLASH_ATTR tunernomeExitMode(void)
     os_free(tunernome);
 }
 
-/**
- * Inline helper function to get the magnitude of a frequency bin from fuzzed_bins[]
- *
- * @param idx The index to get a magnitude from
- * @return A signed magnitude, even though fuzzed_bins[] is unsigned
- */
-static inline int16_t getMagnitude(uint16_t idx)
-{
-    return fuzzed_bins[idx];
-}
-
-/**
- * Inline helper function to get the difference in magnitudes around a given
- * frequency bin from fuzzed_bins[]
- *
- * @param idx The index to get a difference in magnitudes around
- * @return The difference in magnitudes of the bins before and after the given index
- */
-static inline int16_t getDiffAround(uint16_t idx)
-{
-    return getMagnitude(idx + 1) - getMagnitude(idx - 1);
-}
-
 /**
  * Inline helper function to get the magnitude of a frequency bin from folded_bins[]
  *
@@ -554,32 +540,33 @@ void ICACHE_FLASH_ATTR plotTopSemiCircle(int xm, int ym, int r, color col)
 }
 
 /**
- * Instrument-agnostic tuner magic. Updates LEDs
- * @param freqBinIdxs An array of the indices of notes for the instrument's strings. See freqBinIdxsGuitar for an example.
- * @param numStrings The number of strings on the instrument, also the number of elements in freqBinIdxs and stringIdxToLedIdx, if applicable
+ * Instrument-agnostic tuner magic. Updates LEDs from the Goertzel filters' last block
+ * @param numStrings The number of strings on the instrument, also the number of elements in stringIdxToLedIdx, if applicable
  * @param colors The RGB colors of the LEDs to set
- * @param stringIdxToLedIdx A remapping from each index into freqBinIdxs (same index into stringIdxToLedIdx), to the index of an LED to map that string/freqBinIdx to. Set to NULL to skip remapping.
+ * @param stringIdxToLedIdx A remapping from each string's index to the index of an LED to map that string to. Set to NULL to skip remapping.
  */
-void ICACHE_FLASH_ATTR instrumentTunerMagic(const uint16_t freqBinIdxs[], uint16_t numStrings, led_t colors[],
-        const uint16_t stringIdxToLedIdx[])
+void ICACHE_FLASH_ATTR instrumentTunerMagic(uint16_t numStrings, led_t colors[], const uint16_t stringIdxToLedIdx[])
 {
+    goertzel_t* g = &(tunernome->goertzel);
     uint32_t i;
     for( i = 0; i < numStrings; i++ )
     {
         // Pick out the current magnitude and filter it
-        tunernome->intensities_filt[i] = (getMagnitude(freqBinIdxs[i] + GUITAR_OFFSET) + tunernome->intensities_filt[i]) -
-                                         (tunernome->intensities_filt[i] >> 5);
+        tunernome->intensities_filt[i] = (g->mags[GOERTZEL_STRING(i)] + tunernome->intensities_filt[i]) -
+                                         (tunernome->intensities_filt[i] >> TUNER_IIR_SHIFT);
 
         // Pick out the difference around current magnitude and filter it too
-        tunernome->diffs_filt[i] = (getDiffAround(freqBinIdxs[i] + GUITAR_OFFSET) + tunernome->diffs_filt[i]) -
-                                   (tunernome->diffs_filt[i] >> 5);
+        tunernome->diffs_filt[i] = ((g->mags[GOERTZEL_STRING_HIGH(i)] - g->mags[GOERTZEL_STRING_LOW(i)]) +
+                                    tunernome->diffs_filt[i]) - (tunernome->diffs_filt[i] >> TUNER_IIR_SHIFT);
 
-        // This is the magnitude of the target frequency bin, cleaned up
-        int16_t intensity = (tunernome->intensities_filt[i] >> SENSITIVITY) - 40; // drop a baseline.
+        // This is the magnitude of the target frequency, cleaned up. Goertzel
+        // magnitudes are on about the same scale as colorchord's bins
+        int16_t intensity = (tunernome->intensities_filt[i] >> TUNER_IIR_SHIFT) - 40; // drop a baseline.
         intensity = CLAMP(intensity, 0, 255);
 
-        // This is the tonal difference. You "calibrate" out the intensity.
-        int16_t tonalDiff = (tunernome->diffs_filt[i] >> SENSITIVITY) * 200 / (intensity + 1);
+        // This is the tonal difference, scaled so TONAL_DIFF_IN_TUNE_DEVIATION is TUNER_IN_TUNE_CENTS
+        int32_t cents = goertzelCents(g, i, tunernome->intensities_filt[i], tunernome->diffs_filt[i]);
+        int16_t tonalDiff = CLAMP(cents * TONAL_DIFF_IN_TUNE_DEVIATION / TUNER_IN_TUNE_CENTS, INT16_MIN, INT16_MAX);
 
         int32_t red, grn, blu;
         // Is the note in tune, i.e. is the magnitude difference in surrounding bins small?
@@ -916,7 +903,7 @@ bool ICACHE_FLASH_ATTR tunernomeRenderTask(void)
     if(tunernome->exitTimeAccumulatedUs > 0)
     {
         // Draw a bar
-        plotLine(0, OLED_HEIGHT - 1, (OLED_WIDTH * tunernome->exitTimeAccumulatedUs) / US_TO_QUIT, OLED_HEIGHT - 1, WHITE);
+        drawHLine(0, (OLED_WIDTH * tunernome->exitTimeAccumulatedUs) / US_TO_QUIT, OLED_HEIGHT - 1, WHITE);
     }
     return true;
 }
@@ -994,6 +981,12 @@ void ICACHE_FLASH_ATTR tunernomeButtonCallback( uint8_t state __attribute__((unu
                         break;
                     }
                 } // switch(button)
+
+                // Colorchord has the mic in the other modes, so start the filters over on coming back
+                if(tunernome->curTunerMode > UKULELE_TUNER)
+                {
+                    tunernome->goertzelMode = MAX_GUITAR_MODES;
+                }
             } // if(down)
             break;
         } // case TN_TUNER:
@@ -1104,153 +1097,226 @@ void ICACHE_FLASH_ATTR modifyBpm(int16_t bpmMod)
 }
 
 /**
- * This is called every time an audio sample is read from the ADC
- * This processes the sample and will display update the LEDs every
+ * This is called with blocks of audio samples read from the ADC
+ * This processes the samples and will display update the LEDs every
  * 128 samples
  *
- * @param samp A 32 bit audio sample read from the ADC (microphone)
+ * @param samples    Filtered audio samples read from the ADC (microphone)
+ * @param numSamples The number of samples
+ */
+void ICACHE_FLASH_ATTR tunernomeSampleHandler(const int16_t* samples, uint16_t numSamples)
+{
+    if(tunernome->mode != TN_TUNER)
+    {
+        return;
+    }
+
+    if(tunernome->curTunerMode <= UKULELE_TUNER)
+    {
+        instrumentTunerSamples(samples, numSamples);
+        return;
+    }
+
+    // Colorchord does a frame every SAMPLES_PER_FRAME samples, when it's active
+    PushFrameSamples(samples, numSamples, COLORCHORD_ACTIVE);
+}
+
+/**
+ * Do some of the current colorchord frame, and update the tuner's LEDs when
+ * it's done
  */
-void ICACHE_FLASH_ATTR tunernomeSampleHandler(int32_t samp)
+void ICACHE_FLASH_ATTR tunernomeProcTask(void)
 {
-    if(tunernome->mode == TN_TUNER)
+    if(!CatchUpFrameInfo())
     {
-        PushSample32( samp );
-        tunernome->audioSamplesProcessed++;
+        return;
+    }
 
-        // If at least 128 samples have been processed
-        if( tunernome->audioSamplesProcessed >= 128 )
+    // The frame may have finished after leaving the tuner
+    if(tunernome->mode != TN_TUNER)
+    {
+        return;
+    }
+
+    led_t colors[NUM_LIN_LEDS] = {{0}};
+
+    switch(tunernome->curTunerMode)
+    {
+        case GUITAR_TUNER:
+        case VIOLIN_TUNER:
+        case UKULELE_TUNER:
+        case MAX_GUITAR_MODES:
         {
-            // Don't bother if colorchord is inactive
-            if( !COLORCHORD_ACTIVE )
+            // Instruments are tuned by instrumentTunerSamples()
+            return;
+        }
+        case SEMITONE_0:
+        case SEMITONE_1:
+        case SEMITONE_2:
+        case SEMITONE_3:
+        case SEMITONE_4:
+        case SEMITONE_5:
+        case SEMITONE_6:
+        case SEMITONE_7:
+        case SEMITONE_8:
+        case SEMITONE_9:
+        case SEMITONE_10:
+        case SEMITONE_11:
+        case LISTENING:
+        default:
+        {
+            for(uint8_t semitone = 0; semitone < NUM_SEMITONES; semitone++)
             {
-                return;
+                // uint8_t semitoneIdx = (tunernome->curTunerMode - SEMITONE_0) * 2;
+                uint8_t semitoneIdx = semitone * 2;
+                // Pick out the current magnitude and filter it
+                tunernome->semitone_intensitiy_filt[semitone] = (getSemiMagnitude(semitoneIdx + CHROMATIC_OFFSET) +
+                        tunernome->semitone_intensitiy_filt[semitone]) -
+                        (tunernome->semitone_intensitiy_filt[semitone] >> 5);
+
+                // Pick out the difference around current magnitude and filter it too
+                tunernome->semitone_diff_filt[semitone] = (getSemiDiffAround(semitoneIdx + CHROMATIC_OFFSET) +
+                        tunernome->semitone_diff_filt[semitone]) -
+                        (tunernome->semitone_diff_filt[semitone] >> 5);
+
+
+                // This is the magnitude of the target frequency bin, cleaned up
+                tunernome->intensity[semitone] = (tunernome->semitone_intensitiy_filt[semitone] >> SENSITIVITY) -
+                                                 40; // drop a baseline.
+                tunernome->intensity[semitone] = CLAMP(tunernome->intensity[semitone], 0, 255);
+
+                //This is the tonal difference. You "calibrate" out the intensity.
+                tunernome->tonalDiff[semitone] = (tunernome->semitone_diff_filt[semitone] >> SENSITIVITY) * 200 /
+                                                 (tunernome->intensity[semitone] + 1);
             }
 
-            // Colorchord magic
-            HandleFrameInfo();
-
-            led_t colors[NUM_LIN_LEDS] = {{0}};
-
-            switch(tunernome->curTunerMode)
+            // tonal diff is -32768 to 32767. if its within -10 to 10 (now defined as TONAL_DIFF_IN_TUNE_DEVIATION), it's in tune.
+            // positive means too sharp, negative means too flat
+            // intensity is how 'loud' that frequency is, 0 to 255. you'll have to play around with values
+            int32_t red, grn, blu;
+            // Is the note in tune, i.e. is the magnitude difference in surrounding bins small?
+            if( (ABS(tunernome->tonalDiff[tunernome->curTunerMode - SEMITONE_0]) < TONAL_DIFF_IN_TUNE_DEVIATION) )
             {
-                case GUITAR_TUNER:
-                {
-                    instrumentTunerMagic(freqBinIdxsGuitar, NUM_GUITAR_STRINGS, colors, NULL);
-                    break;
-                }
-                case VIOLIN_TUNER:
+                // Note is in tune, make it white
+                red = 255;
+                grn = 255;
+                blu = 255;
+            }
+            else
+            {
+                // Check if the note is sharp or flat
+                if( tunernome->tonalDiff[tunernome->curTunerMode - SEMITONE_0] > 0 )
                 {
-                    instrumentTunerMagic(freqBinIdxsViolin, NUM_VIOLIN_STRINGS, colors, fourNoteStringIdxToLedIdx);
-                    break;
+                    // Note too sharp, make it red
+                    red = 255;
+                    grn = blu = 255 - (tunernome->tonalDiff[tunernome->curTunerMode - SEMITONE_0] - TONAL_DIFF_IN_TUNE_DEVIATION) * 15;
                 }
-                case UKULELE_TUNER:
+                else
                 {
-                    instrumentTunerMagic(freqBinIdxsUkulele, NUM_UKULELE_STRINGS, colors, fourNoteStringIdxToLedIdx);
-                    break;
+                    // Note too flat, make it blue
+                    blu = 255;
+                    grn = red = 255 - (-(tunernome->tonalDiff[tunernome->curTunerMode - SEMITONE_0] + TONAL_DIFF_IN_TUNE_DEVIATION)) * 15;
                 }
-                case MAX_GUITAR_MODES:
-                    break;
-                case SEMITONE_0:
-                case SEMITONE_1:
-                case SEMITONE_2:
-                case SEMITONE_3:
-                case SEMITONE_4:
-                case SEMITONE_5:
-                case SEMITONE_6:
-                case SEMITONE_7:
-                case SEMITONE_8:
-                case SEMITONE_9:
-                case SEMITONE_10:
-                case SEMITONE_11:
-                case LISTENING:
-                default:
-                {
-                    for(uint8_t semitone = 0; semitone < NUM_SEMITONES; semitone++)
-                    {
-                        // uint8_t semitoneIdx = (tunernome->curTunerMode - SEMITONE_0) * 2;
-                        uint8_t semitoneIdx = semitone * 2;
-                        // Pick out the current magnitude and filter it
-                        tunernome->semitone_intensitiy_filt[semitone] = (getSemiMagnitude(semitoneIdx + CHROMATIC_OFFSET) +
-                                tunernome->semitone_intensitiy_filt[semitone]) -
-                                (tunernome->semitone_intensitiy_filt[semitone] >> 5);
-
-                        // Pick out the difference around current magnitude and filter it too
-                        tunernome->semitone_diff_filt[semitone] = (getSemiDiffAround(semitoneIdx + CHROMATIC_OFFSET) +
-                                tunernome->semitone_diff_filt[semitone]) -
-                                (tunernome->semitone_diff_filt[semitone] >> 5);
-
-
-                        // This is the magnitude of the target frequency bin, cleaned up
-                        tunernome->intensity[semitone] = (tunernome->semitone_intensitiy_filt[semitone] >> SENSITIVITY) -
-                                                         40; // drop a baseline.
-                        tunernome->intensity[semitone] = CLAMP(tunernome->intensity[semitone], 0, 255);
-
-                        //This is the tonal difference. You "calibrate" out the intensity.
-                        tunernome->tonalDiff[semitone] = (tunernome->semitone_diff_filt[semitone] >> SENSITIVITY) * 200 /
-                                                         (tunernome->intensity[semitone] + 1);
-                    }
 
-                    // tonal diff is -32768 to 32767. if its within -10 to 10 (now defined as TONAL_DIFF_IN_TUNE_DEVIATION), it's in tune.
-                    // positive means too sharp, negative means too flat
-                    // intensity is how 'loud' that frequency is, 0 to 255. you'll have to play around with values
-                    int32_t red, grn, blu;
-                    // Is the note in tune, i.e. is the magnitude difference in surrounding bins small?
-                    if( (ABS(tunernome->tonalDiff[tunernome->curTunerMode - SEMITONE_0]) < TONAL_DIFF_IN_TUNE_DEVIATION) )
-                    {
-                        // Note is in tune, make it white
-                        red = 255;
-                        grn = 255;
-                        blu = 255;
-                    }
-                    else
-                    {
-                        // Check if the note is sharp or flat
-                        if( tunernome->tonalDiff[tunernome->curTunerMode - SEMITONE_0] > 0 )
-                        {
-                            // Note too sharp, make it red
-                            red = 255;
-                            grn = blu = 255 - (tunernome->tonalDiff[tunernome->curTunerMode - SEMITONE_0] - TONAL_DIFF_IN_TUNE_DEVIATION) * 15;
-                        }
-                        else
-                        {
-                            // Note too flat, make it blue
-                            blu = 255;
-                            grn = red = 255 - (-(tunernome->tonalDiff[tunernome->curTunerMode - SEMITONE_0] + TONAL_DIFF_IN_TUNE_DEVIATION)) * 15;
-                        }
+                // Make sure LED output isn't more than 255
+                red = CLAMP(red, INT_MIN, 255);
+                grn = CLAMP(grn, INT_MIN, 255);
+                blu = CLAMP(blu, INT_MIN, 255);
+            }
 
-                        // Make sure LED output isn't more than 255
-                        red = CLAMP(red, INT_MIN, 255);
-                        grn = CLAMP(grn, INT_MIN, 255);
-                        blu = CLAMP(blu, INT_MIN, 255);
-                    }
+            // Scale each LED's brightness by the filtered intensity for that bin
+            red = (red >> 3 ) * ( tunernome->intensity[tunernome->curTunerMode - SEMITONE_0] >> 3);
+            grn = (grn >> 3 ) * ( tunernome->intensity[tunernome->curTunerMode - SEMITONE_0] >> 3);
+            blu = (blu >> 3 ) * ( tunernome->intensity[tunernome->curTunerMode - SEMITONE_0] >> 3);
 
-                    // Scale each LED's brightness by the filtered intensity for that bin
-                    red = (red >> 3 ) * ( tunernome->intensity[tunernome->curTunerMode - SEMITONE_0] >> 3);
-                    grn = (grn >> 3 ) * ( tunernome->intensity[tunernome->curTunerMode - SEMITONE_0] >> 3);
-                    blu = (blu >> 3 ) * ( tunernome->intensity[tunernome->curTunerMode - SEMITONE_0] >> 3);
+            // Set the LED, ensure each channel is between 0 and 255
+            uint32_t i;
+            for (i = 0; i < NUM_GUITAR_STRINGS; i++)
+            {
+                colors[i].r = CLAMP(red, 0, 255);
+                colors[i].g = CLAMP(grn, 0, 255);
+                colors[i].b = CLAMP(blu, 0, 255);
+            }
 
-                    // Set the LED, ensure each channel is between 0 and 255
-                    uint32_t i;
-                    for (i = 0; i < NUM_GUITAR_STRINGS; i++)
-                    {
-                        colors[i].r = CLAMP(red, 0, 255);
-                        colors[i].g = CLAMP(grn, 0, 255);
-                        colors[i].b = CLAMP(blu, 0, 255);
-                    }
+            break;
+        } // default:
+    } // switch(tunernome->curTunerMode)
 
-                    break;
-                } // default:
-            } // switch(tunernome->curTunerMode)
+    if(LISTENING != tunernome->curTunerMode)
+    {
+        // Draw the LEDs
+        setLeds( colors, sizeof(colors) );
+    }
+}
 
-            if(LISTENING != tunernome->curTunerMode)
-            {
-                // Draw the LEDs
-                setLeds( colors, sizeof(colors) );
-            }
-            // Reset the sample count
-            tunernome->audioSamplesProcessed = 0;
+/**
+ * Tune an instrument with Goertzel filters at its strings and their neighbours,
+ * instead of colorchord, which is far more work and slower to settle. The
+ * LEDs are updated every TUNER_BLOCK_LEN samples
+ *
+ * @param samples    Filtered audio samples read from the ADC (microphone)
+ * @param numSamples The number of samples
+ */
+void ICACHE_FLASH_ATTR instrumentTunerSamples(const int16_t* samples, uint16_t numSamples)
+{
+    const uint16_t* freqBinIdxs;
+    const uint16_t* stringIdxToLedIdx;
+    uint16_t numStrings;
+    switch(tunernome->curTunerMode)
+    {
+        default:
+        case GUITAR_TUNER:
+        {
+            freqBinIdxs = freqBinIdxsGuitar;
+            stringIdxToLedIdx = NULL;
+            numStrings = NUM_GUITAR_STRINGS;
+            break;
+        }
+        case VIOLIN_TUNER:
+        {
+            freqBinIdxs = freqBinIdxsViolin;
+            stringIdxToLedIdx = fourNoteStringIdxToLedIdx;
+            numStrings = NUM_VIOLIN_STRINGS;
+            break;
         }
-    } // if(tunernome-> mode == TN_TUNER)
+        case UKULELE_TUNER:
+        {
+            freqBinIdxs = freqBinIdxsUkulele;
+            stringIdxToLedIdx = fourNoteStringIdxToLedIdx;
+            numStrings = NUM_UKULELE_STRINGS;
+            break;
+        }
+    }
+
+    // Set the filters up for a new instrument
+    if(tunernome->goertzelMode != tunernome->curTunerMode)
+    {
+        float freqs[NUM_GUITAR_STRINGS];
+        for(uint16_t i = 0; i < numStrings; i++)
+        {
+            // The frequency of fuzzed_bins[idx]
+            freqs[i] = BASE_FREQ * powf(2, (float)(freqBinIdxs[i] + GUITAR_OFFSET) / FIXBPERO);
+        }
+        goertzelInitStrings(&(tunernome->goertzel), freqs, numStrings, TUNER_BLOCK_LEN);
+        ets_memset(tunernome->intensities_filt, 0, sizeof(tunernome->intensities_filt));
+        ets_memset(tunernome->diffs_filt, 0, sizeof(tunernome->diffs_filt));
+        tunernome->goertzelMode = tunernome->curTunerMode;
+    }
+
+    while(numSamples > 0)
+    {
+        uint16_t pushed = goertzelPush(&(tunernome->goertzel), samples, numSamples);
+        samples += pushed;
+        numSamples -= pushed;
+
+        // Don't bother if colorchord is inactive
+        if(tunernome->goertzel.blockDone && COLORCHORD_ACTIVE)
+        {
+            led_t colors[NUM_LIN_LEDS] = {{0}};
+            instrumentTunerMagic(numStrings, colors, stringIdxToLedIdx);
+            setLeds(colors, sizeof(colors));
+        }
+    }
 }
 
 /**
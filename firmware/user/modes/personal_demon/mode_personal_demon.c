@@ -353,42 +353,47 @@ void ICACHE_FLASH_ATTR personalDemonEnterMode(void)
     addItemToRow(pd->menu, menuRecords);
     addItemToRow(pd->menu, str_quit);
 
-    allocPngSequence(&(pd->pizza), 3,
-                     "pizza1.png",
-                     "pizza2.png",
-                     "pizza3.png");
-    allocPngSequence(&(pd->burger), 3,
-                     "burger1.png",
-                     "burger2.png",
-                     "burger3.png");
-    allocPngSequence(&(pd->syringe), 11,
-                     "syringe01.png",
-                     "syringe02.png",
-                     "syringe03.png",
-                     "syringe04.png",
-                     "syringe05.png",
-                     "syringe06.png",
-                     "syringe07.png",
-                     "syringe08.png",
-                     "syringe09.png",
-                     "syringe10.png",
-                     "syringe11.png");
+    mapPngSequence(&(pd->pizza), 3,
+                   "pizza1.png",
+                   "pizza2.png",
+                   "pizza3.png");
+    mapPngSequence(&(pd->burger), 3,
+                   "burger1.png",
+                   "burger2.png",
+                   "burger3.png");
+    mapPngSequence(&(pd->syringe), 11,
+                   "syringe01.png",
+                   "syringe02.png",
+                   "syringe03.png",
+                   "syringe04.png",
+                   "syringe05.png",
+                   "syringe06.png",
+                   "syringe07.png",
+                   "syringe08.png",
+                   "syringe09.png",
+                   "syringe10.png",
+                   "syringe11.png");
     allocDemonPngs(pd->demon.species);
-    allocPngAsset("scold.png", &(pd->hand));
-    allocPngAsset("poop.png", &(pd->poop));
-    allocPngAsset("archL.png", &(pd->archL));
-    allocPngAsset("archR.png", &(pd->archR));
-    allocPngAsset("cake.png", &(pd->cake));
-    allocPngAsset("ball.png", &(pd->ball));
-    allocPngAsset("water.png", &(pd->water));
-    allocPngAsset("heart.png", &(pd->heart));
-    allocPngAsset("happy.png", &(pd->happy));
-    allocPngAsset("sad.png", &(pd->sad));
-    allocPngAsset("cross.png", &(pd->cross));
-    allocPngAsset("angry.png", &(pd->angry));
-    allocPngAsset("wof.png", &(pd->wheel));
-    allocPngAsset("wof_pin.png", &(pd->wheelPin));
-    allocPngAsset("chalice.png", &(pd->chalice));
+    mapPngAsset("scold.png", &(pd->hand));
+    mapPngAsset("poop.png", &(pd->poop));
+    mapPngAsset("archL.png", &(pd->archL));
+    mapPngAsset("archR.png", &(pd->archR));
+    mapPngAsset("cake.png", &(pd->cake));
+    mapPngAsset("ball.png", &(pd->ball));
+    mapPngAsset("water.png", &(pd->water));
+    mapPngAsset("heart.png", &(pd->heart));
+    mapPngAsset("happy.png", &(pd->happy));
+    mapPngAsset("sad.png", &(pd->sad));
+    mapPngAsset("cross.png", &(pd->cross));
+    mapPngAsset("angry.png", &(pd->angry));
+    mapPngAsset("wof.png", &(pd->wheel));
+    mapPngAsset("wof_pin.png", &(pd->wheelPin));
+    mapPngAsset("chalice.png", &(pd->chalice));
+
+    // Hearts and poop are drawn several times a frame, so decode them to the
+    // framebuffer's layout. Everything else is drawn from flash
+    decodePngAsset(&(pd->poop));
+    decodePngAsset(&(pd->heart));
 
     pd->demonX = (OLED_WIDTH / 2) - (pd->demonSprite.width / 2);
     pd->demonDirLR = false;
@@ -407,7 +412,8 @@ void ICACHE_FLASH_ATTR personalDemonEnterMode(void)
 }
 
 /**
- * Load all the PNG assets for a given species
+ * Load all the PNG assets for a given species. Only one is drawn at a time, so
+ * they are drawn from flash
  *
  * @param species The 0-indexed species
  */
@@ -416,19 +422,19 @@ void ICACHE_FLASH_ATTR allocDemonPngs(uint8_t species)
     // The png names are 1-indexed
     char normFname[] = "pd-0-norm.png";
     normFname[3] = '1' + species;
-    allocPngAsset(normFname, &(pd->demonSprite));
+    mapPngAsset(normFname, &(pd->demonSprite));
 
     char fatFname[] = "pd-0-fat.png";
     fatFname[3] = '1' + species;
-    allocPngAsset(fatFname,  &(pd->demonSpriteFat));
+    mapPngAsset(fatFname,  &(pd->demonSpriteFat));
 
     char thinFname [] = "pd-0-thin.png";
     thinFname[3] = '1' + species;
-    allocPngAsset(thinFname, &(pd->demonSpriteThin));
+    mapPngAsset(thinFname, &(pd->demonSpriteThin));
 
     char sickFname[] = "pd-0-sick.png";
     sickFname[3] = '1' + species;
-    allocPngAsset(sickFname, &(pd->demonSpriteSick));
+    mapPngAsset(sickFname, &(pd->demonSpriteSick));
 }
 
 /**
@@ -31,6 +31,7 @@
 // #define TIME_PRINTF(fmt, ...) os_printf("%s::%d " fmt, __func__, __LINE__, ##__VA_ARGS__)
 // #define RAY_PRINTF(fmt, ...)  os_printf("%s::%d " fmt, __func__, __LINE__, ##__VA_ARGS__)
 // #define RSSI_PRINTF(fmt, ...) os_printf("%s::%d " fmt, __func__, __LINE__, ##__VA_ARGS__)
+// #define MIC_PRINTF(fmt, ...)  os_printf("%s::%d " fmt, __func__, __LINE__, ##__VA_ARGS__)
 
 /*==============================================================================
  * These defines turn debugging off
@@ -47,5 +48,6 @@
 #define TIME_PRINTF(fmt, ...)
 #define RAY_PRINTF(fmt, ...)
 #define RSSI_PRINTF(fmt, ...)
+#define MIC_PRINTF(fmt, ...)
 
 #endif
\ No newline at end of file
@@ -31,6 +31,9 @@
 #include "QMA6981.h"
 #include "synced_timer.h"
 #include "printControl.h"
+#if defined(EMU)
+    #include "swadgemu.h"
+#endif
 
 #include "mode_menu.h"
 #include "mode_ddr.h"
@@ -262,7 +265,8 @@ void ICACHE_FLASH_ATTR user_init(void)
 
 #if defined(FEATURE_MIC)
         // Initialize either the buzzer or the mic
-        if(NULL != swadgeModes[rtcMem.currentSwadgeMode]->fnAudioCallback)
+        if(NULL != swadgeModes[rtcMem.currentSwadgeMode]->fnAudioCallback ||
+                NULL != swadgeModes[rtcMem.currentSwadgeMode]->fnAudioBlockCallback)
         {
             initMic();
         }
@@ -316,22 +320,59 @@ static void ICACHE_FLASH_ATTR procTask(os_event_t* events __attribute__((unused)
     HandleButtonEventSynchronous();
 
 #if defined(FEATURE_MIC)
-    // While there are samples available from the ADC
+    // If the samples have piled up, this pass is late, maybe from a long OLED
+    // transfer or flash write. Drain them and don't draw, so the next pass
+    // comes sooner and the ADC doesn't overrun
+    bool micBehind = (samplesQueued() >= MIC_DRAIN_THRESHOLD);
+#if defined(EMU)
+    if(micBehind)
+    {
+        emuStats.micDrains++;
+    }
+#endif
+
+    // While there are samples available from the ADC, filter them a block at a time
     while( sampleAvailable() )
     {
-        // Get the sample
-        int32_t samp = getSample();
-        // Run the sample through an IIR filter
-        static uint32_t samp_iir = 0;
-        samp_iir = samp_iir - (samp_iir >> 10) + samp;
-        samp = (samp - (samp_iir >> 10)) * 16;
-        // Amplify the sample
-        samp = (samp * CCS.gINITIAL_AMP) >> 4;
-
-        // Pass the sample to the mode
-        if(swadgeModeInit && NULL != swadgeModes[rtcMem.currentSwadgeMode]->fnAudioCallback)
+        int16_t block[AUDIO_BLOCK_LEN];
+        uint16_t blockLen = 0;
+        while( blockLen < AUDIO_BLOCK_LEN && sampleAvailable() )
+        {
+            // Get the sample
+            int32_t samp = getSample();
+            // Run the sample through an IIR filter
+            static uint32_t samp_iir = 0;
+            samp_iir = samp_iir - (samp_iir >> 10) + samp;
+            samp = (samp - (samp_iir >> 10)) * 16;
+            // Amplify the sample
+            samp = (samp * CCS.gINITIAL_AMP) >> 4;
+            block[blockLen++] = samp;
+        }
+#if defined(EMU)
+        emuCostAdd(EMU_COST_AUDIO_SAMPLE, blockLen);
+#endif
+
+        // Pass the samples to the mode
+        if(!swadgeModeInit)
+        {
+            continue;
+        }
+        else if(NULL != swadgeModes[rtcMem.currentSwadgeMode]->fnAudioBlockCallback)
+        {
+#if defined(EMU)
+            emuCostAdd(EMU_COST_AUDIO_CALL, 1);
+#endif
+            swadgeModes[rtcMem.currentSwadgeMode]->fnAudioBlockCallback(block, blockLen);
+        }
+        else if(NULL != swadgeModes[rtcMem.currentSwadgeMode]->fnAudioCallback)
         {
-            swadgeModes[rtcMem.currentSwadgeMode]->fnAudioCallback(samp);
+#if defined(EMU)
+            emuCostAdd(EMU_COST_AUDIO_CALL, blockLen);
+#endif
+            for(uint16_t i = 0; i < blockLen; i++)
+            {
+                swadgeModes[rtcMem.currentSwadgeMode]->fnAudioCallback(block[i]);
+            }
         }
     }
 #endif
@@ -351,7 +392,11 @@ static void ICACHE_FLASH_ATTR procTask(os_event_t* events __attribute__((unused)
 
     // Cap the display updates at 30fps
     static uint32_t lastDrawTime = 0;
-    if(system_get_time() - lastDrawTime > 33333)
+    if(
+#if defined(FEATURE_MIC)
+        !micBehind &&
+#endif
+        system_get_time() - lastDrawTime > 33333)
     {
         bool forceFullUpdate = false;
 
@@ -390,6 +435,9 @@ static void ICACHE_FLASH_ATTR procTask(os_event_t* events __attribute__((unused)
                 break;
             }
         }
+#if defined(EMU)
+        emuEndFrame();
+#endif
     }
 #endif
 }
@@ -507,6 +555,17 @@ void ExitCritical(void)
             }
         }
         swadgeModeInit = false;
+
+#if defined(FEATURE_MIC)
+        micStats_t micStats;
+        getMicStats(&micStats);
+        MIC_PRINTF("%d overruns, %d underruns, at most %d samples waiting\n", micStats.overruns,
+                   micStats.underruns, micStats.highWater);
+#endif
+
+#if defined(EMU)
+        emuReportModeStats(swadgeModes[rtcMem.currentSwadgeMode]->modeName);
+#endif
     }
 
     // Switch to the next mode, or start from the beginning if we're at the end
@@ -540,6 +599,7 @@ void ICACHE_FLASH_ATTR exitCurrentSwadgeMode(void)
     timerDisarm(&timerHandlePollAccel);
 #endif
     timersCheck();
+    emuReportModeStats(swadgeModes[rtcMem.currentSwadgeMode]->modeName);
 }
 #endif
 
@@ -29,6 +29,9 @@
 
 #define lengthof(x) (sizeof(x) / sizeof(x[0]))
 
+// The most filtered mic samples passed to fnAudioBlockCallback() at once
+#define AUDIO_BLOCK_LEN 32
+
 /*============================================================================
  * Includes
  *==========================================================================*/
@@ -129,6 +132,17 @@ typedef struct _swadgeMode
      * @param audoSample A 32 bit audio sample
      */
     void (*fnAudioCallback)(int32_t audoSample);
+    /**
+     * This function is called with blocks of audio samples which were read
+     * from the microphone (ADC) and filtered, in order, up to AUDIO_BLOCK_LEN
+     * at a time. It replaces fnAudioCallback(), which isn't called if this is
+     * set, and saves a call per sample. The samples are in the same range
+     * PushSample32() takes
+     *
+     * @param samples    The filtered samples
+     * @param numSamples The number of samples, 1 to AUDIO_BLOCK_LEN
+     */
+    void (*fnAudioBlockCallback)(const int16_t* samples, uint16_t numSamples);
     /**
      * This is a setting, not a function pointer. Set it to one of these
      * values to have the system configure the swadge's WiFi
@@ -205,6 +219,8 @@ uint8_t ICACHE_FLASH_ATTR getSwadgeModes(swadgeMode***  modePtr);
 void ICACHE_FLASH_ATTR switchToSwadgeMode(uint8_t newMode);
 #if defined(EMU)
     void ICACHE_FLASH_ATTR exitCurrentSwadgeMode(void);
+    void emuReportModeStats(const char* modeName);
+    void emuEndFrame(void);
 #endif
 
 #if defined(FEATURE_ACCEL)
@@ -3,11 +3,19 @@
 #include <mem.h>
 #include "assets.h"
 #include "oled.h"
+#include "oled_dirty.h"
 #include "fastlz.h"
 #include "user_main.h"
 #include "printControl.h"
 #if defined(EMU)
     #include <stdio.h>
+    #include "swadgemu.h"
+    #if defined(__linux__) && !defined(ANDROID)
+        #include <fcntl.h>
+        #include <unistd.h>
+        #include <sys/mman.h>
+        #include <sys/stat.h>
+    #endif
     #ifdef ANDROID
         #include <asset_manager.h>
         #include <asset_manager_jni.h>
@@ -15,10 +23,26 @@
         struct android_app* gapp;
     #endif
     uint32_t* assets = NULL;
+    static size_t assetsSize = 0;
+    static bool ICACHE_FLASH_ATTR validateAssets(const uint32_t* data, size_t size);
 #endif
 
 #if defined(FEATURE_OLED)
 
+/// The longest line, in bytes of eight pixels, which the packed PNG blitter
+/// will draw. Larger images fall back to drawing a pixel at a time
+#define PNG_MAX_LINE_BYTES 32
+
+/// The number of slots in the asset name hash table, must be a power of two
+#define ASSET_HASH_SLOTS 256
+/// Each index entry is a 16 byte name, an address and a length
+#define ASSET_INDEX_WORDS 6
+
+/// Open addressed hash table of (index item + 1), or 0 for an empty slot.
+/// Only item numbers are stored, names are compared against the index in ROM
+static uint16_t assetHashSlots[ASSET_HASH_SLOTS] = {0};
+static bool assetHashBuilt = false;
+
 const uint32_t sin1024[] RODATA_ATTR =
 {
     0, 18, 36, 54, 71, 89, 107, 125, 143, 160, 178, 195, 213,
@@ -83,9 +107,22 @@ const uint32_t tan1024[] RODATA_ATTR =
 };
 
 void ICACHE_FLASH_ATTR gifTimerFn(void* arg);
+static uint32_t ICACHE_FLASH_ATTR hashAssetName(const char* name);
+static void ICACHE_FLASH_ATTR buildAssetHash(uint32_t* assets);
 void ICACHE_FLASH_ATTR transformPixel(int16_t* x, int16_t* y, int16_t transX,
                                       int16_t transY, bool flipLR, bool flipUD,
                                       int16_t rotateDeg, int16_t width, int16_t height);
+static color getPackedPngPixel(pngHandle* handle, int16_t x, int16_t y);
+static void ICACHE_FLASH_ATTR drawPackedPng(pngHandle* handle, int16_t xp,
+        int16_t yp, bool flipLR, bool flipUD,
+        int16_t rotateDeg, bool inv, bool solid);
+static void blitPngLine(int16_t x, int16_t yStart, const uint8_t* white,
+                        const uint8_t* opaque, uint8_t numBytes, bool inv);
+static void shearPackedPng(pngHandle* handle, int16_t xp, int16_t yp, bool flipLR,
+                           bool flipUD, int16_t rotateDeg, bool inv, bool solid);
+static bool ICACHE_FLASH_ATTR loadPngAsset(const char* name, pngHandle* handle, bool inFlash);
+static bool ICACHE_FLASH_ATTR loadPngSequence(pngSequenceHandle* handle, uint16_t count,
+        bool inFlash, va_list ap);
 
 /**
  * @brief Get a pointer to an asset
@@ -118,6 +155,40 @@ uint32_t* ICACHE_FLASH_ATTR getAsset(const char* name, uint32_t* retLen)
             return NULL;
         }
     }
+#elif defined(__linux__)
+    /* When emulating a swadge on Linux, assets.bin is mapped read-only so
+     * emulator instances share the page cache instead of each reading a copy
+     */
+    if(NULL == assets)
+    {
+        int fd = open( "assets.bin", O_RDONLY );
+        if( -1 == fd )
+        {
+            fprintf( stderr, "EMU Error: Could not open assets.bin\n" );
+            return NULL;
+        }
+        struct stat st;
+        if( 0 != fstat( fd, &st ) || 0 == st.st_size )
+        {
+            fprintf( stderr, "EMU Error: Could not stat assets.bin\n" );
+            close( fd );
+            return NULL;
+        }
+        void* mapped = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+        close( fd );
+        if( MAP_FAILED == mapped )
+        {
+            fprintf( stderr, "EMU Error: Could not map assets.bin\n" );
+            return NULL;
+        }
+        if( !validateAssets( mapped, st.st_size ) )
+        {
+            munmap( mapped, st.st_size );
+            return NULL;
+        }
+        assets = (uint32_t*)mapped;
+        assetsSize = st.st_size;
+    }
 #else
     /* When emulating a swadge, assets are read directly from a file */
     if(NULL == assets)
@@ -130,17 +201,56 @@ uint32_t* ICACHE_FLASH_ATTR getAsset(const char* name, uint32_t* retLen)
         }
         fseek(fp, 0L, SEEK_END);
         long sz = ftell(fp);
-        assets = (uint32_t*)malloc(sz);
+        uint32_t* data = (uint32_t*)malloc(sz);
         fseek(fp, 0L, SEEK_SET);
-        int r = fread(assets, sz, 1, fp);
+        int r = fread(data, sz, 1, fp);
+        fclose(fp);
         if( r != 1 )
         {
             fprintf( stderr, "EMU Error: read error with assets.bin\n" );
+            free( data );
             return NULL;
         }
-        fclose(fp);
+        if( !validateAssets( data, sz ) )
+        {
+            free( data );
+            return NULL;
+        }
+        assets = data;
+        assetsSize = sz;
     }
 #endif
+    // Build the hash table the first time an asset is looked up
+    if(false == assetHashBuilt)
+    {
+        buildAssetHash(assets);
+    }
+
+    if(assetHashBuilt)
+    {
+        for(uint32_t slot = hashAssetName(name); ; slot++)
+        {
+            uint16_t item = assetHashSlots[slot & (ASSET_HASH_SLOTS - 1)];
+            if(0 == item)
+            {
+                break;
+            }
+
+            // Read the entry for this item from the index and compare names
+            uint32_t* entry = &assets[1 + ((item - 1) * ASSET_INDEX_WORDS)];
+            char assetName[16] = {0};
+            ets_memcpy(assetName, entry, sizeof(uint32_t) * 4);
+            if(0 == ets_strcmp(name, assetName))
+            {
+                AST_PRINTF("Found asset %s, addr: %d, len: %d\n", assetName, entry[4], entry[5]);
+                *retLen = entry[5];
+                return &assets[entry[4] / sizeof(uint32_t)];
+            }
+        }
+        *retLen = 0;
+        return NULL;
+    }
+
     uint32_t idx = 0;
     uint32_t numIndexItems = assets[idx++];
     AST_PRINTF("Scanning %d items\n", numIndexItems);
@@ -173,14 +283,114 @@ uint32_t* ICACHE_FLASH_ATTR getAsset(const char* name, uint32_t* retLen)
 }
 
 #if defined(EMU)
+/**
+ * @brief Make sure the index at the start of assets.bin and every asset it
+ * points to are inside the file, so a truncated or corrupt file is rejected
+ * up front instead of crashing on a later read
+ *
+ * @param data A pointer to the contents of assets.bin
+ * @param size The size of assets.bin, in bytes
+ * @return true if the index is sane, false if it is not
+ */
+static bool ICACHE_FLASH_ATTR validateAssets(const uint32_t* data, size_t size)
+{
+    if(size < sizeof(uint32_t))
+    {
+        fprintf( stderr, "EMU Error: assets.bin is empty\n" );
+        return false;
+    }
+
+    uint64_t numIndexItems = data[0];
+    if((1 + (numIndexItems * ASSET_INDEX_WORDS)) * sizeof(uint32_t) > size)
+    {
+        fprintf( stderr, "EMU Error: assets.bin index of %u items is truncated\n", (uint32_t)numIndexItems );
+        return false;
+    }
+
+    for(uint32_t ni = 0; ni < numIndexItems; ni++)
+    {
+        const uint32_t* entry = &data[1 + (ni * ASSET_INDEX_WORDS)];
+        uint64_t assetAddress = entry[4];
+        uint64_t assetLen = entry[5];
+        if(0 != (assetAddress % sizeof(uint32_t)) || assetAddress + assetLen > size)
+        {
+            fprintf( stderr, "EMU Error: assets.bin item %u (%.16s) is out of bounds\n", ni, (const char*)entry );
+            return false;
+        }
+    }
+    return true;
+}
+
 void ICACHE_FLASH_ATTR freeAssets(void)
 {
+#if defined(__linux__) && !defined(ANDROID)
+    if(NULL != assets)
+    {
+        munmap(assets, assetsSize);
+    }
+#elif !defined(ANDROID)
+    free(assets);
+#endif
 #ifndef ANDROID
-    os_free(assets);
+    assets = NULL;
+    assetsSize = 0;
 #endif
+    assetHashBuilt = false;
 }
 #endif
 
+/**
+ * @brief FNV-1a hash of an asset name, up to the 16 characters stored in the
+ * index
+ *
+ * @param name The name to hash
+ * @return The hash
+ */
+static uint32_t ICACHE_FLASH_ATTR hashAssetName(const char* name)
+{
+    uint32_t hash = 2166136261u;
+    for(uint8_t i = 0; i < 16 && 0 != name[i]; i++)
+    {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief Build the hash table of asset names from the index at the start of
+ * assets.bin. If there are too many assets for the table, it isn't built and
+ * getAsset() falls back to scanning the index
+ *
+ * @param assets A pointer to the start of assets.bin
+ */
+static void ICACHE_FLASH_ATTR buildAssetHash(uint32_t* assets)
+{
+    uint32_t numIndexItems = assets[0];
+    if(numIndexItems >= ASSET_HASH_SLOTS)
+    {
+        AST_PRINTF("Too many assets to hash (%d)\n", numIndexItems);
+        return;
+    }
+
+    ets_memset(assetHashSlots, 0, sizeof(assetHashSlots));
+    for(uint32_t ni = 0; ni < numIndexItems; ni++)
+    {
+        char assetName[16] = {0};
+        ets_memcpy(assetName, &assets[1 + (ni * ASSET_INDEX_WORDS)], sizeof(uint32_t) * 4);
+
+        // Linear probing. If there are duplicate names, the first one wins,
+        // same as scanning the index
+        uint32_t slot = hashAssetName(assetName);
+        while(0 != assetHashSlots[slot & (ASSET_HASH_SLOTS - 1)])
+        {
+            slot++;
+        }
+        assetHashSlots[slot & (ASSET_HASH_SLOTS - 1)] = ni + 1;
+    }
+    assetHashBuilt = true;
+}
+
 /**
  * Transform a pixel's coordinates by rotation around the sprite's center point,
  * then reflection over Y axis, then reflection over X axis, then translation
@@ -281,10 +491,40 @@ void transformPixel(int16_t* x, int16_t* y, int16_t transX,
  * @return true if the asset was allocated, false if it was not
  */
 bool ICACHE_FLASH_ATTR allocPngAsset(const char* name, pngHandle* handle)
+{
+    return loadPngAsset(name, handle, false);
+}
+
+/**
+ * Point a PNG handle at an asset in ROM without copying it to RAM. Drawing
+ * only reads the data 32 bits at a time, which is safe for the flash mapping,
+ * so this uses no heap at all. It's slower to draw than a PNG in RAM, so keep
+ * allocPngAsset() and decodePngAsset() for images which are drawn every frame
+ *
+ * @param name   The name of the asset to draw
+ * @param handle A handle to load the asset into
+ * @return true if the asset was found, false if it was not
+ */
+bool ICACHE_FLASH_ATTR mapPngAsset(const char* name, pngHandle* handle)
+{
+    return loadPngAsset(name, handle, true);
+}
+
+/**
+ * Load a PNG asset, either copying it from ROM to RAM or pointing at it in ROM
+ *
+ * @param name    The name of the asset to draw
+ * @param handle  A handle to load the asset into
+ * @param inFlash true to leave the data in ROM, false to copy it to RAM
+ * @return true if the asset was loaded, false if it was not
+ */
+static bool ICACHE_FLASH_ATTR loadPngAsset(const char* name, pngHandle* handle, bool inFlash)
 {
     // Get the image from the packed assets
     uint32_t assetLen = 0;
     uint32_t* assetPtr = getAsset(name, &assetLen);
+    handle->packed = NULL;
+    handle->inFlash = inFlash;
 
     // If the asset was found
     if(NULL != assetPtr)
@@ -302,6 +542,18 @@ bool ICACHE_FLASH_ATTR allocPngAsset(const char* name, pngHandle* handle)
         {
             paddedLen++;
         }
+        handle->dataLen = paddedLen / sizeof(uint32_t);
+
+        if(inFlash)
+        {
+            // Assets are 32 bit aligned, so this can be read a word at a time
+            handle->data = &assetPtr[idx];
+#if defined(EMU)
+            emuStats.pngFlashBytes += paddedLen;
+#endif
+            return true;
+        }
+
         // Allocate RAM, then copy the memory from ROM to RAM
         handle->data = (uint32_t*)os_malloc(paddedLen);
         if(NULL == handle->data)
@@ -310,11 +562,16 @@ bool ICACHE_FLASH_ATTR allocPngAsset(const char* name, pngHandle* handle)
             return false;
         }
         os_memcpy(handle->data, &assetPtr[idx], paddedLen);
-        handle->dataLen = paddedLen / sizeof(uint32_t);
+#if defined(EMU)
+        emuStats.pngRamBytes += paddedLen;
+        emuCostAdd(EMU_COST_FLASH_WORD, handle->dataLen);
+#endif
         return true;
     }
     else
     {
+        handle->data = NULL;
+        handle->dataLen = 0;
         return false;
     }
 }
@@ -326,16 +583,132 @@ bool ICACHE_FLASH_ATTR allocPngAsset(const char* name, pngHandle* handle)
  */
 void ICACHE_FLASH_ATTR freePngAsset(pngHandle* handle)
 {
-    if(NULL != handle->data)
+    if(NULL != handle->data && false == handle->inFlash)
     {
         os_free(handle->data);
     }
+    if(NULL != handle->packed)
+    {
+        os_free(handle->packed);
+    }
     handle->data = NULL;
+    handle->packed = NULL;
+    handle->inFlash = false;
     handle->width = 0;
     handle->height = 0;
     handle->dataLen = 0;
 }
 
+/**
+ * Decode a loaded PNG asset once into a column-major, page-aligned image which
+ * matches the framebuffer's layout, so it can be drawn a byte at a time.
+ * The prefix coded data is freed afterwards.
+ *
+ * handle->packed holds two planes of width * ((height + 7) / 8) bytes. Byte
+ * (x * pages + page) of each plane holds rows (page * 8) to (page * 8 + 7) of
+ * column x, least significant bit on top. The first plane has a bit set for
+ * each white pixel, the second has a bit set for each opaque pixel.
+ *
+ * @param handle A handle which was loaded with allocPngAsset() or mapPngAsset()
+ * @return true if the asset was decoded, false if there was no memory for it
+ */
+bool ICACHE_FLASH_ATTR decodePngAsset(pngHandle* handle)
+{
+    if(NULL != handle->packed)
+    {
+        return true;
+    }
+    else if(NULL == handle->data)
+    {
+        return false;
+    }
+
+    uint16_t pages = (handle->height + 7) / 8;
+    uint32_t planeLen = handle->width * pages;
+    uint8_t* white = (uint8_t*)os_zalloc(planeLen * 2);
+    if(NULL == white)
+    {
+        return false;
+    }
+
+    uint32_t idx = 0;
+    uint32_t chunk = handle->data[idx++];
+    uint32_t bitIdx = 0;
+    bool moreData = true;
+    for(int16_t y = 0; moreData && y < handle->height; y++)
+    {
+        uint8_t bit = 1 << (y & 7);
+        uint8_t* dst = &white[y / 8];
+        for(int16_t x = 0; moreData && x < handle->width; x++, dst += pages)
+        {
+            // 'Traverse' the huffman tree, same as drawPngInv()
+            bool isZero = (0 == (chunk & (0x80000000 >> (bitIdx++))));
+            if(!isZero)
+            {
+                // One is black, opaque but not white
+                dst[planeLen] |= bit;
+            }
+
+            if(bitIdx == 32)
+            {
+                if(idx >= handle->dataLen)
+                {
+                    moreData = false;
+                    break;
+                }
+                chunk = handle->data[idx++];
+                bitIdx = 0;
+            }
+
+            if(isZero)
+            {
+                if(0 == (chunk & (0x80000000 >> (bitIdx++))))
+                {
+                    // Zero-zero is white
+                    dst[0] |= bit;
+                    dst[planeLen] |= bit;
+                }
+                // Zero-one is transparent, nothing to set
+
+                if(bitIdx == 32)
+                {
+                    if(idx >= handle->dataLen)
+                    {
+                        moreData = false;
+                    }
+                    else
+                    {
+                        chunk = handle->data[idx++];
+                        bitIdx = 0;
+                    }
+                }
+            }
+        }
+    }
+
+#if defined(EMU)
+    emuStats.pngRamBytes += planeLen * 2;
+    emuCostAdd(EMU_COST_PNG_PIXEL, handle->width * handle->height);
+    if(handle->inFlash)
+    {
+        emuCostAdd(EMU_COST_FLASH_WORD, idx);
+    }
+#endif
+    // Only free the prefix coded data if it was copied to RAM
+    if(false == handle->inFlash)
+    {
+        os_free(handle->data);
+#if defined(EMU)
+        emuStats.pngRamBytes -= handle->dataLen * sizeof(uint32_t);
+#endif
+    }
+    handle->data = NULL;
+    handle->dataLen = 0;
+    handle->inFlash = false;
+    handle->packed = white;
+    return true;
+}
+
 /**
  * @brief Draw a PNG asset to the OLED
  *
@@ -367,6 +740,20 @@ void ICACHE_FLASH_ATTR drawPngInv(pngHandle* handle, int16_t xp,
                                   int16_t yp, bool flipLR, bool flipUD,
                                   int16_t rotateDeg, bool inv)
 {
+    if(NULL != handle->packed)
+    {
+        drawPackedPng(handle, xp, yp, flipLR, flipUD, rotateDeg, inv, false);
+        return;
+    }
+
+#if defined(EMU)
+    if(handle->inFlash)
+    {
+        // A mapped image is read from flash again every time it's drawn
+        emuCostAdd(EMU_COST_FLASH_WORD, handle->dataLen);
+    }
+#endif
+
     uint32_t idx = 0;
 
     // Read 32 bits at a time
@@ -446,6 +833,336 @@ void ICACHE_FLASH_ATTR drawPngInv(pngHandle* handle, int16_t xp,
     }
 }
 
+/**
+ * Get a single pixel from a PNG which was decoded with decodePngAsset()
+ *
+ * This intentionally does not have ICACHE_FLASH_ATTR because it may be called often
+ *
+ * @param handle The decoded PNG
+ * @param x The column to read
+ * @param y The row to read
+ * @return WHITE, BLACK or TRANSPARENT_COLOR
+ */
+static color getPackedPngPixel(pngHandle* handle, int16_t x, int16_t y)
+{
+    uint16_t pages = (handle->height + 7) / 8;
+    uint32_t byteIdx = (x * pages) + (y / 8);
+    uint8_t bit = 1 << (y & 7);
+    if(0 == (handle->packed[(handle->width * pages) + byteIdx] & bit))
+    {
+        return TRANSPARENT_COLOR;
+    }
+    return (handle->packed[byteIdx] & bit) ? WHITE : BLACK;
+}
+
+/**
+ * Draw a vertical line of packed pixels to one column of the framebuffer.
+ * Each byte is shifted to the line's offset within the page and written over
+ * the one or two pages it covers, only where the opaque mask is set
+ *
+ * This intentionally does not have ICACHE_FLASH_ATTR because it may be called often
+ *
+ * @param x        The column to draw in, must be on screen
+ * @param yStart   The row of the least significant bit of the first byte
+ * @param white    The white plane of the line
+ * @param opaque   The opaque mask of the line
+ * @param numBytes The number of bytes in the line
+ * @param inv      true to swap white and black
+ */
+static void blitPngLine(int16_t x, int16_t yStart, const uint8_t* white,
+                        const uint8_t* opaque, uint8_t numBytes, bool inv)
+{
+    uint8_t* column = &currentFb[x * (OLED_HEIGHT / 8)];
+    int16_t y = yStart;
+#if defined(EMU)
+    uint8_t bytesWritten = 0;
+#endif
+    for(uint8_t b = 0; b < numBytes; b++, y += 8)
+    {
+        if(0 == opaque[b] || y <= -8)
+        {
+            continue;
+        }
+        else if(y >= OLED_HEIGHT)
+        {
+            break;
+        }
+
+        int16_t page = y >> 3;
+        uint8_t shift = y & 7;
+        uint16_t mask = opaque[b] << shift;
+        uint16_t val = ((inv ? ~white[b] : white[b]) & opaque[b]) << shift;
+
+        if(page >= 0)
+        {
+            column[page] = (column[page] & ~mask) | val;
+            OLED_MARK_DIRTY(x, page * 8);
+#if defined(EMU)
+            bytesWritten++;
+#endif
+        }
+        if((mask >> 8) && (page + 1 < (OLED_HEIGHT / 8)))
+        {
+            column[page + 1] = (column[page + 1] & ~(mask >> 8)) | (val >> 8);
+            OLED_MARK_DIRTY(x, (page + 1) * 8);
+#if defined(EMU)
+            bytesWritten++;
+#endif
+        }
+    }
+
+#if defined(EMU)
+    emuCostAdd(EMU_COST_FB_COLUMN, 1);
+    emuCostAdd(EMU_COST_FB_BYTE, bytesWritten);
+#endif
+}
+
+/**
+ * @brief Draw a PNG which was decoded with decodePngAsset() to the OLED
+ *
+ * Flips and rotations by multiples of 90 degrees move whole lines of the image
+ * to columns of the display, so they are drawn a byte at a time with
+ * blitPngLine(). Source columns are used as-is for no transform and flipLR,
+ * bit-reversed for flipUD and 180 degrees, and gathered from source rows for 90
+ * and 270 degrees. Other angles need the shears in transformPixel() and are
+ * drawn a pixel at a time by shearPackedPng().
+ *
+ * @param handle A handle of a decoded PNG to draw
+ * @param xp The x coordinate to draw the asset at
+ * @param yp The y coordinate to draw the asset at
+ * @param flipLR true to flip over the Y axis, false to do nothing
+ * @param flipUD true to flip over the X axis, false to do nothing
+ * @param rotateDeg The number of degrees to rotate clockwise, must be 0-359
+ * @param inv true to invert all colors, false to draw it normally
+ * @param solid true if the image is only a white plane, like a gif frame, and
+ *              every pixel is opaque
+ */
+static void ICACHE_FLASH_ATTR drawPackedPng(pngHandle* handle, int16_t xp,
+        int16_t yp, bool flipLR, bool flipUD,
+        int16_t rotateDeg, bool inv, bool solid)
+{
+    uint16_t pages = (handle->height + 7) / 8;
+    uint32_t planeLen = handle->width * pages;
+    bool rotated = (0 < rotateDeg && rotateDeg < 360);
+
+    if((rotated && 0 != (rotateDeg % 90)) ||
+            handle->width > (PNG_MAX_LINE_BYTES * 8) || pages > PNG_MAX_LINE_BYTES)
+    {
+        // Arbitrary angle or too big for a line, a pixel at a time
+        shearPackedPng(handle, xp, yp, flipLR, flipUD, rotateDeg, inv, solid);
+        return;
+    }
+
+    // Every other transform is affine, so find where the origin goes and
+    // which way the image's x and y axes point on the display
+    int16_t ox = 0, oy = 0;
+    transformPixel(&ox, &oy, xp, yp, flipLR, flipUD, rotateDeg, handle->width, handle->height);
+    int16_t ax = 1, ay = 0;
+    transformPixel(&ax, &ay, xp, yp, flipLR, flipUD, rotateDeg, handle->width, handle->height);
+    int16_t bx = 0, by = 1;
+    transformPixel(&bx, &by, xp, yp, flipLR, flipUD, rotateDeg, handle->width, handle->height);
+
+    // If the image's x axis points down the display, image rows become
+    // display columns
+    bool transposed = (0 != (ay - oy));
+    int8_t colStep = transposed ? (bx - ox) : (ax - ox);
+    int8_t lineStep = transposed ? (ay - oy) : (by - oy);
+    uint16_t numLines = transposed ? handle->height : handle->width;
+    uint16_t lineLen = transposed ? handle->width : handle->height;
+    uint8_t lineBytes = transposed ? ((lineLen + 7) / 8) : pages;
+
+    uint8_t white[PNG_MAX_LINE_BYTES];
+    uint8_t opaque[PNG_MAX_LINE_BYTES];
+
+    // A solid image's columns are opaque down to the padding at the bottom of
+    // the last page
+    uint8_t solidOpaque[PNG_MAX_LINE_BYTES];
+    if(solid)
+    {
+        ets_memset(solidOpaque, 0xFF, pages);
+        if(handle->height % 8)
+        {
+            solidOpaque[pages - 1] = (1 << (handle->height % 8)) - 1;
+        }
+    }
+
+    for(uint16_t line = 0; line < numLines; line++)
+    {
+        int16_t x = ox + (colStep * line);
+        if(x < 0 || x >= OLED_WIDTH)
+        {
+            continue;
+        }
+
+        const uint8_t* srcWhite;
+        const uint8_t* srcOpaque;
+        int16_t yStart;
+        if(transposed)
+        {
+            // Gather a row of the image, one bit per column
+            ets_memset(white, 0, lineBytes);
+            ets_memset(opaque, 0, lineBytes);
+            const uint8_t* src = &handle->packed[line / 8];
+            uint8_t srcBit = 1 << (line & 7);
+            for(uint16_t i = 0; i < lineLen; i++, src += pages)
+            {
+                if(solid || (src[planeLen] & srcBit))
+                {
+                    uint16_t dst = (lineStep > 0) ? i : (lineLen - 1 - i);
+                    opaque[dst / 8] |= 1 << (dst & 7);
+                    if(src[0] & srcBit)
+                    {
+                        white[dst / 8] |= 1 << (dst & 7);
+                    }
+                }
+            }
+#if defined(EMU)
+            emuCostAdd(EMU_COST_PNG_PIXEL, lineLen);
+#endif
+            yStart = (lineStep > 0) ? oy : (oy - lineLen + 1);
+            srcWhite = white;
+            srcOpaque = opaque;
+        }
+        else if(lineStep > 0)
+        {
+            // The column can be drawn as-is
+            srcWhite = &handle->packed[line * pages];
+            srcOpaque = solid ? solidOpaque : &handle->packed[planeLen + (line * pages)];
+            yStart = oy;
+        }
+        else
+        {
+            // Upside down, reverse the bytes and the bits in them. The
+            // padding bits at the bottom of the last page end up on top
+            const uint8_t* src = &handle->packed[line * pages];
+            for(uint8_t b = 0; b < pages; b++)
+            {
+                uint8_t w = src[pages - 1 - b];
+                uint8_t o = solid ? solidOpaque[pages - 1 - b] : src[planeLen + pages - 1 - b];
+                uint8_t rw = 0, ro = 0;
+                for(uint8_t i = 0; i < 8; i++)
+                {
+                    rw = (rw << 1) | ((w >> i) & 1);
+                    ro = (ro << 1) | ((o >> i) & 1);
+                }
+                white[b] = rw;
+                opaque[b] = ro;
+            }
+#if defined(EMU)
+            emuCostAdd(EMU_COST_PNG_PIXEL, pages * 8);
+#endif
+            yStart = oy - (pages * 8) + 1;
+            srcWhite = white;
+            srcOpaque = opaque;
+        }
+
+        blitPngLine(x, yStart, srcWhite, srcOpaque, lineBytes, inv);
+    }
+    fbChanges = true;
+}
+
+/**
+ * @brief Draw a decoded PNG a pixel at a time, for rotations which aren't a
+ * multiple of 90 degrees and images too big for blitPngLine()
+ *
+ * The pixels land in the same places as transformPixel() puts them, but the
+ * quarter turn and the shear factors are worked out once per image instead of
+ * per pixel, and the packed planes are read a byte at a time so only opaque
+ * pixels are visited at all
+ *
+ * This intentionally does not have ICACHE_FLASH_ATTR because it may be called often
+ *
+ * @param handle A handle of a decoded PNG to draw
+ * @param xp The x coordinate to draw the asset at
+ * @param yp The y coordinate to draw the asset at
+ * @param flipLR true to flip over the Y axis, false to do nothing
+ * @param flipUD true to flip over the X axis, false to do nothing
+ * @param rotateDeg The number of degrees to rotate clockwise, must be 0-359
+ * @param inv true to invert all colors, false to draw it normally
+ * @param solid true if every pixel is opaque, see drawPackedPng()
+ */
+static void shearPackedPng(pngHandle* handle, int16_t xp, int16_t yp, bool flipLR,
+                           bool flipUD, int16_t rotateDeg, bool inv, bool solid)
+{
+    uint16_t pages = (handle->height + 7) / 8;
+    uint32_t planeLen = handle->width * pages;
+    int16_t halfWidth = handle->width / 2;
+    int16_t halfHeight = handle->height / 2;
+    bool rotated = (0 < rotateDeg && rotateDeg < 360);
+    uint8_t quarterTurns = rotated ? (rotateDeg / 90) : 0;
+    bool shear = rotated && (0 != (rotateDeg % 90));
+    uint32_t tanHalf = shear ? tan1024[(rotateDeg % 90) / 2] : 0;
+    uint32_t sinAngle = shear ? sin1024[rotateDeg % 90] : 0;
+    color onColor = inv ? BLACK : WHITE;
+    color offColor = inv ? WHITE : BLACK;
+
+    const uint8_t* column = handle->packed;
+    for(int16_t w = 0; w < handle->width; w++, column += pages)
+    {
+        for(uint16_t page = 0; page < pages; page++)
+        {
+            uint8_t opaque = solid ? 0xFF : column[planeLen + page];
+            if(solid && page == pages - 1 && (handle->height % 8))
+            {
+                opaque = (1 << (handle->height % 8)) - 1;
+            }
+            while(opaque)
+            {
+                uint8_t bit = __builtin_ctz(opaque);
+                opaque &= (opaque - 1);
+
+                // The same steps as transformPixel(), centered around (0, 0)
+                int16_t x = w - halfWidth;
+                int16_t y = (page * 8) + bit - halfHeight;
+                int16_t tmp = x;
+                switch(quarterTurns)
+                {
+                    case 3:
+                    {
+                        x = y;
+                        y = -tmp;
+                        break;
+                    }
+                    case 2:
+                    {
+                        x = -x;
+                        y = -y;
+                        break;
+                    }
+                    case 1:
+                    {
+                        x = -y;
+                        y = tmp;
+                        break;
+                    }
+                    default:
+                    {
+                        break;
+                    }
+                }
+                if(shear)
+                {
+                    x = x - ((y * tanHalf) + 512) / 1024;
+                    y = ((x * sinAngle) + 512) / 1024 + y;
+                    x = x - ((y * tanHalf) + 512) / 1024;
+                }
+                x += halfWidth;
+                y += halfHeight;
+                if(flipLR)
+                {
+                    x = handle->width - 1 - x;
+                }
+                if(flipUD)
+                {
+                    y = handle->height - 1 - y;
+                }
+
+                drawPixel(x + xp, y + yp, (column[page] & (1 << bit)) ? onColor : offColor);
+            }
+        }
+    }
+}
+
 /**
  * Draw a png asset directly to memory, not the OLED, without transformations
  * This is useful for loading raycast sprites
@@ -457,6 +1174,18 @@ void ICACHE_FLASH_ATTR drawPngInv(pngHandle* handle, int16_t xp,
  */
 void ICACHE_FLASH_ATTR drawPngToBuffer(pngHandle* handle, color* buf)
 {
+    if(NULL != handle->packed)
+    {
+        for(int16_t x = 0; x < handle->width; x++)
+        {
+            for(int16_t y = 0; y < handle->height; y++)
+            {
+                buf[(x * handle->height) + y] = getPackedPngPixel(handle, x, y);
+            }
+        }
+        return;
+    }
+
     uint32_t idx = 0;
 
     // Read 32 bits at a time
@@ -518,6 +1247,43 @@ void ICACHE_FLASH_ATTR drawPngToBuffer(pngHandle* handle, color* buf)
  * @return true if all PNGs were loaded, false if they were not
  */
 bool ICACHE_FLASH_ATTR allocPngSequence(pngSequenceHandle* handle, uint16_t count, ...)
+{
+    va_list ap;
+    va_start(ap, count);
+    bool loaded = loadPngSequence(handle, count, false, ap);
+    va_end(ap);
+    return loaded;
+}
+
+/**
+ * Load a sequence of PNGs with mapPngAsset(), leaving the image data in ROM.
+ * Only the handles are allocated in RAM
+ *
+ * @param handle A handle to load PNGs into
+ * @param count  The number of PNGs to load
+ * @param ...    A list of PNG names
+ * @return true if all PNGs were found, false if they were not
+ */
+bool ICACHE_FLASH_ATTR mapPngSequence(pngSequenceHandle* handle, uint16_t count, ...)
+{
+    va_list ap;
+    va_start(ap, count);
+    bool loaded = loadPngSequence(handle, count, true, ap);
+    va_end(ap);
+    return loaded;
+}
+
+/**
+ * Allocate handles for a sequence of PNGs and load each of them
+ *
+ * @param handle  A handle to load PNGs into
+ * @param count   The number of PNGs to load
+ * @param inFlash true to leave the image data in ROM, false to copy it to RAM
+ * @param ap      A list of PNG names
+ * @return true if all PNGs were loaded, false if they were not
+ */
+static bool ICACHE_FLASH_ATTR loadPngSequence(pngSequenceHandle* handle, uint16_t count,
+        bool inFlash, va_list ap)
 {
     // Allocate handles for each png
     handle->handles = os_malloc(sizeof(pngHandle) * count);
@@ -527,26 +1293,37 @@ bool ICACHE_FLASH_ATTR allocPngSequence(pngSequenceHandle* handle, uint16_t coun
     }
     handle->count = count;
 
-    /* Initialize the argument list. */
-    va_list ap;
-    va_start(ap, count);
     for (uint16_t i = 0; i < count; i++)
     {
         /* Get the next argument value. */
-        if(false == allocPngAsset(va_arg(ap, const char*), &(handle->handles[i])))
+        if(false == loadPngAsset(va_arg(ap, const char*), &(handle->handles[i]), inFlash))
         {
+            // Only free the handles which were loaded
+            handle->count = i + 1;
             freePngSequence(handle);
-            va_end(ap);
             return false;
         }
     }
 
-    /* Clean up. */
-    va_end(ap);
-
     return true;
 }
 
+/**
+ * Decode every PNG in a sequence with decodePngAsset()
+ *
+ * @param handle The handle whose PNGs to decode
+ * @return true if all PNGs were decoded, false if they were not
+ */
+bool ICACHE_FLASH_ATTR decodePngSequence(pngSequenceHandle* handle)
+{
+    bool decoded = true;
+    for(uint16_t i = 0; i < handle->count; i++)
+    {
+        decoded &= decodePngAsset(&handle->handles[i]);
+    }
+    return decoded;
+}
+
 /**
  * Free the memory from a sequence of PNGs
  *
@@ -619,16 +1396,38 @@ void ICACHE_FLASH_ATTR drawPngSequenceInv(pngSequenceHandle* handle, int16_t xp,
     }
 }
 
+/**
+ * Read a byte from a little endian stream of 32 bit words. Flash may only be
+ * read a word at a time, so compressed data is read in place this way
+ *
+ * @param src The stream of words
+ * @param i   The index of the byte to read
+ * @return The byte
+ */
+static inline uint8_t gifSrcByte(const uint32_t* src, uint32_t i)
+{
+    return (uint8_t)(src[i >> 2] >> ((i & 3) * 8));
+}
+
+/// The width, height, number of frames and duration words before the frames
+#define GIF_HEADER_WORDS 4
+
 /**
  * Load a gif from assets to a handle
  *
+ * Two buffers are allocated. decompressed holds the row-major XOR delta of the
+ * current frame, which fastlz back-references point into. frame holds the
+ * image in the framebuffer's column-major page layout, like the white plane of
+ * a PNG from decodePngAsset(). Every pixel of a gif is opaque, so there is no
+ * opaque plane
+ *
  * @param name The name of the asset to draw
  * @param handle A handle to load the gif to
  */
 void ICACHE_FLASH_ATTR loadGifFromAsset(const char* name, gifHandle* handle)
 {
     // Only do anything if the handle is uninitialized
-    if(NULL == handle->compressed)
+    if(NULL == handle->frame)
     {
         // Get the image from the packed assets
         uint32_t assetLen = 0;
@@ -649,13 +1448,14 @@ void ICACHE_FLASH_ATTR loadGifFromAsset(const char* name, gifHandle* handle)
                        handle->nFrames,
                        handle->duration);
 
-            // Allocate enough space for the compressed data, decompressed data
-            // and the actual gif
+            // Allocate enough space for one decompressed delta and the frame
+            uint16_t pages = (handle->height + 7) / 8;
+            uint32_t planeLen = handle->width * pages;
             handle->allocedSize = ((handle->width * handle->height) + 8) / 8;
-            handle->compressed = (uint8_t*)os_malloc(handle->allocedSize);
             handle->decompressed = (uint8_t*)os_malloc(handle->allocedSize);
-            handle->frame = (uint8_t*)os_malloc(handle->allocedSize);
+            handle->frame = (uint8_t*)os_zalloc(planeLen);
 
+            handle->cFrame = 0;
             handle->firstFrameLoaded = false;
         }
     }
@@ -668,113 +1468,244 @@ void ICACHE_FLASH_ATTR loadGifFromAsset(const char* name, gifHandle* handle)
  */
 void ICACHE_FLASH_ATTR freeGifAsset(gifHandle* handle)
 {
-    os_free(handle->compressed);
     os_free(handle->decompressed);
     os_free(handle->frame);
-    handle->compressed = NULL;
     handle->decompressed = NULL;
     handle->frame = NULL;
 }
 
 /**
- * Draw a frame of a gif to the screen
+ * XOR a range of a decompressed, row-major delta into the column-major frame
  *
- * @param handle A handle to the gif to draw
- * @param xp The x coordinate to draw the asset at
- * @param yp The y coordinate to draw the asset at
- * @param flipLR true to flip over the Y axis, false to do nothing
- * @param flipUD true to flip over the X axis, false to do nothing
- * @param rotateDeg The number of degrees to rotate clockwise, must be 0-359
- * @param drawNext true to draw the next frame, false to draw the same frame again
+ * This intentionally does not have ICACHE_FLASH_ATTR because it may be called often
+ *
+ * @param handle The gif being decoded
+ * @param start  The first byte of the delta to apply
+ * @param end    One past the last byte of the delta to apply
  */
-void ICACHE_FLASH_ATTR drawGifFromAsset(gifHandle* handle, int16_t xp, int16_t yp,
-                                        bool flipLR, bool flipUD, int16_t rotateDeg,
-                                        bool drawNext)
+static void applyGifDelta(gifHandle* handle, uint32_t start, uint32_t end)
 {
-    if(drawNext || false == handle->firstFrameLoaded)
-    {
-        // Read the compressed length of this frame
-        uint32_t compressedLen = handle->assetPtr[handle->idx++];
+    uint16_t pages = (handle->height + 7) / 8;
+    uint32_t pixel = start * 8;
+    uint16_t w = pixel % handle->width;
+    uint16_t h = pixel / handle->width;
 
-        // Pad the length to a 32 bit boundary for memcpy
-        uint32_t paddedLen = compressedLen;
-        while(paddedLen % 4 != 0)
-        {
-            paddedLen++;
-        }
-        AST_PRINTF("%s\n  frame: %d\n  cLen: %d\n  pLen: %d\n", __func__,
-                   handle->cFrame, compressedLen, paddedLen);
-
-        // Copy the compressed data from flash to RAM
-        os_memcpy(handle->compressed, &handle->assetPtr[handle->idx], paddedLen);
-        handle->idx += (paddedLen / 4);
-
-        // If this is the first frame
-        if(handle->cFrame == 0)
-        {
-            // Decompress it straight to the frame data
-            fastlz_decompress(handle->compressed, compressedLen,
-                              handle->frame, handle->allocedSize);
-        }
-        else
+    for(uint32_t i = start; i < end; i++)
+    {
+        uint8_t delta = handle->decompressed[i];
+        if(0 == delta)
         {
-            // Otherwise decompress it to decompressed
-            fastlz_decompress(handle->compressed, compressedLen,
-                              handle->decompressed, handle->allocedSize);
-            // Then apply the changes to the current frame
-            uint16_t i;
-            for(i = 0; i < handle->allocedSize; i++)
+            // Nothing changed in these eight pixels, skip over them
+            w += 8;
+            while(w >= handle->width)
             {
-                handle->frame[i] ^= handle->decompressed[i];
+                w -= handle->width;
+                h++;
             }
+            continue;
         }
 
-        if(drawNext)
+        // Eight pixels per byte, most significant bit first
+        for(uint8_t bit = 0x80; bit; bit >>= 1)
         {
-            // Increment the frame count, mod the number of frames
-            handle->cFrame = (handle->cFrame + 1) % handle->nFrames;
-            if(handle->cFrame == 0)
+            if((delta & bit) && h < handle->height)
+            {
+                handle->frame[(w * pages) + (h / 8)] ^= (1 << (h & 7));
+            }
+            if(++w == handle->width)
             {
-                // Reset the index if we're starting again
-                handle->idx = 4;
+                w = 0;
+                h++;
             }
         }
-        handle->firstFrameLoaded = true;
     }
+}
 
-    // Draw the current frame to the OLED
-    int16_t h, w;
-    for(h = 0; h < handle->height; h++)
+/**
+ * Decompress the next frame of a gif straight from the assets, XORing the
+ * delta into the frame as it comes out. This is fastlz_decompress() for both
+ * compression levels, reading the compressed stream a word at a time
+ *
+ * @param handle        The gif to decode the next frame of
+ * @param compressedLen The number of bytes of compressed data
+ * @return true if the frame was decoded, false if it was corrupt
+ */
+static bool ICACHE_FLASH_ATTR decodeGifFrame(gifHandle* handle, uint32_t compressedLen)
+{
+    const uint32_t* src = &handle->assetPtr[handle->idx];
+    uint8_t* out = handle->decompressed;
+    uint32_t maxout = handle->allocedSize;
+    uint32_t ip = 0;
+    uint32_t op = 0;
+
+    if(0 == compressedLen)
     {
-        for(w = 0; w < handle->width; w++)
+        return false;
+    }
+
+    uint8_t level = (gifSrcByte(src, 0) >> 5) + 1;
+    uint32_t ctrl = gifSrcByte(src, ip++) & 31;
+    bool loop = true;
+    do
+    {
+        uint32_t chunkStart = op;
+        if(ctrl >= 32)
         {
-            int16_t x = w;
-            int16_t y = h;
-            if(yp || flipLR || flipUD || rotateDeg)
-            {
-                transformPixel(&x, &y, xp, yp, flipLR, flipUD, rotateDeg,
-                               handle->width, handle->height);
-            }
-            else if(xp)
+            // Back-reference into the delta decompressed so far
+            uint32_t len = (ctrl >> 5) - 1;
+            uint32_t ofs = (ctrl & 31) << 8;
+            int32_t ref = op - ofs;
+            if(1 == level)
             {
-                x += xp;
+                if(len == 7 - 1)
+                {
+                    len += gifSrcByte(src, ip++);
+                }
+                ref -= gifSrcByte(src, ip++);
             }
-
-            if(0 <= x && x < OLED_WIDTH)
+            else
             {
-                int16_t byteIdx = (w + (h * handle->width)) / 8;
-                int16_t bitIdx  = (w + (h * handle->width)) % 8;
-                if(handle->frame[byteIdx] & (0x80 >> bitIdx))
+                uint8_t code;
+                if(len == 7 - 1)
                 {
-                    drawPixel(x, y, WHITE);
+                    do
+                    {
+                        code = gifSrcByte(src, ip++);
+                        len += code;
+                    } while (code == 255);
                 }
-                else
+                code = gifSrcByte(src, ip++);
+                ref -= code;
+
+                // Match from a 16 bit distance
+                if(code == 255 && ofs == (31 << 8))
                 {
-                    drawPixel(x, y, BLACK);
+                    ofs = gifSrcByte(src, ip++) << 8;
+                    ofs += gifSrcByte(src, ip++);
+                    ref = op - ofs - 8191;
                 }
             }
+
+            if(op + len + 3 > maxout || ref - 1 < 0)
+            {
+                return false;
+            }
+
+            if(ip < compressedLen)
+            {
+                ctrl = gifSrcByte(src, ip++);
+            }
+            else
+            {
+                loop = false;
+            }
+
+            // Byte by byte, so runs which overlap the output work
+            ref--;
+            for(len += 3; len; len--)
+            {
+                out[op++] = out[ref++];
+            }
+        }
+        else
+        {
+            // Literal run
+            ctrl++;
+            if(op + ctrl > maxout || ip + ctrl > compressedLen)
+            {
+                return false;
+            }
+            for(; ctrl; ctrl--)
+            {
+                out[op++] = gifSrcByte(src, ip++);
+            }
+
+            loop = (ip < compressedLen);
+            if(loop)
+            {
+                ctrl = gifSrcByte(src, ip++);
+            }
         }
+
+        applyGifDelta(handle, chunkStart, op);
+    } while(loop);
+
+#if defined(EMU)
+    emuCostAdd(EMU_COST_GIF_BYTE, op);
+    emuCostAdd(EMU_COST_FLASH_WORD, (ip + 3) / 4);
+#endif
+    return true;
+}
+
+/**
+ * Decode the next frame of a gif into handle->frame, or the first frame if
+ * none was loaded yet
+ *
+ * @param handle The gif to decode the next frame of
+ */
+static void ICACHE_FLASH_ATTR loadNextGifFrame(gifHandle* handle)
+{
+    uint16_t nextFrame = handle->firstFrameLoaded ? ((handle->cFrame + 1) % handle->nFrames) : 0;
+    if(0 == nextFrame)
+    {
+        // The first frame is a whole image rather than a delta, so XOR it
+        // onto a blank frame
+        handle->idx = GIF_HEADER_WORDS;
+        ets_memset(handle->frame, 0, handle->width * ((handle->height + 7) / 8));
+    }
+
+    // Read the compressed length of this frame
+    uint32_t compressedLen = handle->assetPtr[handle->idx++];
+
+    // Pad the length to a 32 bit boundary
+    uint32_t paddedLen = compressedLen;
+    while(paddedLen % 4 != 0)
+    {
+        paddedLen++;
+    }
+    AST_PRINTF("%s\n  frame: %d\n  cLen: %d\n  pLen: %d\n", __func__,
+               nextFrame, compressedLen, paddedLen);
+
+    decodeGifFrame(handle, compressedLen);
+    handle->idx += (paddedLen / 4);
+
+    handle->cFrame = nextFrame;
+    handle->firstFrameLoaded = true;
+}
+
+/**
+ * Draw a frame of a gif to the screen
+ *
+ * @param handle A handle to the gif to draw
+ * @param xp The x coordinate to draw the asset at
+ * @param yp The y coordinate to draw the asset at
+ * @param flipLR true to flip over the Y axis, false to do nothing
+ * @param flipUD true to flip over the X axis, false to do nothing
+ * @param rotateDeg The number of degrees to rotate clockwise, must be 0-359
+ * @param drawNext true to draw the next frame, false to draw the same frame again
+ */
+void ICACHE_FLASH_ATTR drawGifFromAsset(gifHandle* handle, int16_t xp, int16_t yp,
+                                        bool flipLR, bool flipUD, int16_t rotateDeg,
+                                        bool drawNext)
+{
+    if(NULL == handle->frame || NULL == handle->decompressed || 0 == handle->nFrames)
+    {
+        return;
     }
+
+    if(drawNext || false == handle->firstFrameLoaded)
+    {
+        loadNextGifFrame(handle);
+    }
+
+    // The frame is in the same layout as a decoded PNG, so draw it like one
+    pngHandle framePng =
+    {
+        .width = handle->width,
+        .height = handle->height,
+        .packed = handle->frame,
+    };
+    drawPackedPng(&framePng, xp, yp, flipLR, flipUD, rotateDeg, false, true);
 }
 
 #endif
@@ -19,9 +19,13 @@ typedef struct
     uint16_t height;
     uint32_t dataLen;
     uint32_t* data;
+    uint8_t* packed; // Set by decodePngAsset(), NULL for prefix coded data
+    bool inFlash;    // true if data points into the assets in flash, not RAM
 } pngHandle;
 
 bool ICACHE_FLASH_ATTR allocPngAsset(const char* name, pngHandle* handle);
+bool ICACHE_FLASH_ATTR mapPngAsset(const char* name, pngHandle* handle);
+bool ICACHE_FLASH_ATTR decodePngAsset(pngHandle* handle);
 void ICACHE_FLASH_ATTR freePngAsset(pngHandle* handle);
 void ICACHE_FLASH_ATTR drawPng(pngHandle* handle, int16_t xp,
                                int16_t yp, bool flipLR, bool flipUD, int16_t rotateDeg);
@@ -37,6 +41,8 @@ typedef struct
 } pngSequenceHandle;
 
 bool ICACHE_FLASH_ATTR allocPngSequence(pngSequenceHandle* handle, uint16_t count, ...);
+bool ICACHE_FLASH_ATTR mapPngSequence(pngSequenceHandle* handle, uint16_t count, ...);
+bool ICACHE_FLASH_ATTR decodePngSequence(pngSequenceHandle* handle);
 void ICACHE_FLASH_ATTR freePngSequence(pngSequenceHandle* handle);
 void ICACHE_FLASH_ATTR drawPngSequence(pngSequenceHandle* handle, int16_t xp,
                                        int16_t yp, bool flipLR, bool flipUD, int16_t rotateDeg, int16_t frame);
@@ -49,9 +55,8 @@ typedef struct
     uint32_t* assetPtr;
     uint32_t idx;
 
-    uint8_t* compressed;
-    uint8_t* decompressed;
-    uint8_t* frame;
+    uint8_t* decompressed; // The row-major XOR delta of the current frame
+    uint8_t* frame;        // The current frame, column-major, see loadGifFromAsset()
     uint32_t allocedSize;
 
     uint16_t width;
@@ -0,0 +1,233 @@
+/*
+*   goertzel.c
+*
+*   Each filter is a two pole resonator, s[n] = x[n] + 2cos(w)s[n-1] - s[n-2],
+*   run for a block of samples. The magnitude at w comes from the last two
+*   states at the end of the block. That is one multiply per filter per
+*   sample, where DFT32 does two for every bin.
+*
+*   Samples are windowed, so a strong tone a few blocks' widths away, like a
+*   string's other harmonics, doesn't leak into a filter's magnitude.
+*
+*   When every frequency is low, the samples are summed in groups first, so
+*   the filters run at a fraction of DFREQ. The sums are a crude low pass
+*   filter, but the filters sit well below where it starts to roll off.
+*/
+
+#include <osapi.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "embeddednf.h"
+#include "goertzel.h"
+
+/*============================================================================
+ * Defines
+ *==========================================================================*/
+
+#define GOERTZEL_COEFF_BITS 14
+// Summed samples are scaled down this much before filtering
+#define GOERTZEL_INPUT_SHIFT 2
+// The most samples summed for each filter input
+#define GOERTZEL_MAX_DECIMATION 4
+// How many summed samples are run through the filters at once
+#define GOERTZEL_CHUNK 32
+// The window is a Hann window, kept as half of it, in Q15
+#define GOERTZEL_WINDOW_BITS 15
+#define GOERTZEL_WINDOW_HALF 256
+// For a tone near a string, (high - low) / mag is about this many times the
+// tone's offset in block widths, DFREQ / blockLen
+#define GOERTZEL_STRING_SLOPE 1.5f
+
+/*============================================================================
+ * Variables
+ *==========================================================================*/
+
+// Shared by every bank, filled in by the first goertzelInit()
+static uint16_t goertzelWindow[GOERTZEL_WINDOW_HALF + 1];
+
+/*============================================================================
+ * Functions
+ *==========================================================================*/
+
+/**
+ * Set up a bank of filters and start the first block
+ *
+ * @param g          The filter bank
+ * @param freqsHz    The frequency of each filter
+ * @param numFilters The number of filters, up to GOERTZEL_MAX_FILTERS
+ * @param blockLen   The number of samples per measurement. Longer blocks
+ *                   separate closer frequencies, but take longer to measure
+ */
+void ICACHE_FLASH_ATTR goertzelInit(goertzel_t* g, const float* freqsHz, uint8_t numFilters, uint16_t blockLen)
+{
+    ets_memset(g, 0, sizeof(goertzel_t));
+    g->numFilters = (numFilters < GOERTZEL_MAX_FILTERS) ? numFilters : GOERTZEL_MAX_FILTERS;
+    g->blockLen = (blockLen > 0) ? blockLen : 1;
+
+    // Sum as many samples as possible while keeping every frequency under an
+    // eighth of the filters' rate, and whole sums in a block
+    float maxFreq = 0;
+    for(uint8_t i = 0; i < g->numFilters; i++)
+    {
+        maxFreq = (freqsHz[i] > maxFreq) ? freqsHz[i] : maxFreq;
+    }
+    g->decimation = GOERTZEL_MAX_DECIMATION;
+    while(g->decimation > 1 && (maxFreq * 8 * g->decimation > DFREQ || 0 != g->blockLen % g->decimation))
+    {
+        g->decimation /= 2;
+    }
+
+    // Warning: This does floating point, so only do it when the frequencies change
+    if(0 == goertzelWindow[GOERTZEL_WINDOW_HALF])
+    {
+        for(uint16_t i = 0; i <= GOERTZEL_WINDOW_HALF; i++)
+        {
+            goertzelWindow[i] = (0.5f - 0.5f * cosf(M_PI * i / GOERTZEL_WINDOW_HALF)) *
+                                ((1 << GOERTZEL_WINDOW_BITS) - 1) + 0.5f;
+        }
+    }
+    for(uint8_t i = 0; i < g->numFilters; i++)
+    {
+        g->filters[i].coeff = 2 * cosf(2 * M_PI * freqsHz[i] * g->decimation / DFREQ) *
+                              (1 << GOERTZEL_COEFF_BITS) + 0.5f;
+    }
+}
+
+/**
+ * Set up a bank of filters to tune strings. Each string gets three filters,
+ * at its frequency and a block's width, DFREQ / blockLen, either side of it,
+ * halfway down the slopes of its filter's response. A tone which is off makes the
+ * outer two differ in proportion to how far off it is, which goertzelCents()
+ * turns into cents
+ *
+ * @param g          The filter bank
+ * @param freqsHz    The frequency of each string
+ * @param numStrings The number of strings, up to GOERTZEL_MAX_STRINGS
+ * @param blockLen   The number of samples per measurement
+ */
+void ICACHE_FLASH_ATTR goertzelInitStrings(goertzel_t* g, const float* freqsHz, uint8_t numStrings,
+        uint16_t blockLen)
+{
+    float freqs[GOERTZEL_MAX_FILTERS] = {0};
+    numStrings = (numStrings < GOERTZEL_MAX_STRINGS) ? numStrings : GOERTZEL_MAX_STRINGS;
+    blockLen = (blockLen > 0) ? blockLen : 1;
+    float width = (float)DFREQ / blockLen;
+    for(uint8_t s = 0; s < numStrings; s++)
+    {
+        freqs[GOERTZEL_STRING_LOW(s)] = freqsHz[s] - width;
+        freqs[GOERTZEL_STRING(s)] = freqsHz[s];
+        freqs[GOERTZEL_STRING_HIGH(s)] = freqsHz[s] + width;
+    }
+    goertzelInit(g, freqs, numStrings * 3, blockLen);
+
+    for(uint8_t s = 0; s < numStrings; s++)
+    {
+        // Offset in block widths to Hz to cents, close enough to linear for
+        // the few tens of cents that matter
+        g->centsScale[s] = (1200 / M_LN2) * width / (GOERTZEL_STRING_SLOPE * freqsHz[s]) * 256 + 0.5f;
+    }
+}
+
+/**
+ * Run samples through every filter, up to the end of the current block. When
+ * the block ends, the magnitudes are updated and g->blockDone is set
+ *
+ * @param g          The filter bank
+ * @param samples    The samples, in the range PushSample32() takes
+ * @param numSamples The number of samples
+ * @return The number of samples used, which is less than numSamples if the
+ *         block ended first
+ */
+uint16_t ICACHE_FLASH_ATTR goertzelPush(goertzel_t* g, const int16_t* samples, uint16_t numSamples)
+{
+    uint16_t toPush = g->blockLen - g->samplesInBlock;
+    toPush = (toPush < numSamples) ? toPush : numSamples;
+
+    uint16_t sumsPerBlock = g->blockLen / g->decimation;
+    uint16_t pushed = 0;
+    while(pushed < toPush)
+    {
+        // Sum the samples, keeping a partial sum for the next call
+        int16_t in[GOERTZEL_CHUNK];
+        uint16_t numIn = 0;
+        while(pushed < toPush && numIn < GOERTZEL_CHUNK)
+        {
+            g->sum += samples[pushed++];
+            if(++(g->numSummed) == g->decimation)
+            {
+                // A full scale tone can't overflow the states, even at low
+                // frequencies over long blocks
+                uint32_t pos = (((g->samplesInBlock + pushed) / g->decimation - 1) * 2 * GOERTZEL_WINDOW_HALF) /
+                               sumsPerBlock;
+                pos = (pos <= GOERTZEL_WINDOW_HALF) ? pos : (2 * GOERTZEL_WINDOW_HALF - pos);
+                in[numIn++] = ((g->sum >> GOERTZEL_INPUT_SHIFT) * goertzelWindow[pos]) >> GOERTZEL_WINDOW_BITS;
+                g->sum = 0;
+                g->numSummed = 0;
+            }
+        }
+
+        for(uint8_t i = 0; i < g->numFilters; i++)
+        {
+            goertzelFilter_t* f = &g->filters[i];
+            int32_t coeff = f->coeff;
+            int32_t s1 = f->s1;
+            int32_t s2 = f->s2;
+            for(uint16_t n = 0; n < numIn; n++)
+            {
+                // coeff * s1 in Q14 without a 64 bit multiply, which the ESP
+                // has to do in software. Splitting s1 at bit 14 gives exactly
+                // the same result, as long as the states stay under 2^29
+                int32_t s0 = in[n] + coeff * (s1 >> GOERTZEL_COEFF_BITS) +
+                             ((coeff * (s1 & ((1 << GOERTZEL_COEFF_BITS) - 1))) >> GOERTZEL_COEFF_BITS) - s2;
+                s2 = s1;
+                s1 = s0;
+            }
+            f->s1 = s1;
+            f->s2 = s2;
+        }
+    }
+
+    g->samplesInBlock += toPush;
+    g->blockDone = (g->samplesInBlock == g->blockLen);
+    if(g->blockDone)
+    {
+        for(uint8_t i = 0; i < g->numFilters; i++)
+        {
+            goertzelFilter_t* f = &g->filters[i];
+            float s1 = f->s1;
+            float s2 = f->s2;
+            float power = (s1 * s1) + (s2 * s2) - (s1 * s2 * f->coeff) / (1 << GOERTZEL_COEFF_BITS);
+            // |X| is a quarter of the block, with the window, times the
+            // amplitude of a tone at exactly this frequency, and each sum is
+            // decimation samples
+            float amp = (power > 0) ? (4 * sqrtf(power) * (1 << GOERTZEL_INPUT_SHIFT) / g->blockLen) : 0;
+            g->mags[i] = (amp < 0xFFFF) ? (uint16_t)amp : 0xFFFF;
+            f->s1 = 0;
+            f->s2 = 0;
+        }
+        g->samplesInBlock = 0;
+    }
+    return toPush;
+}
+
+/**
+ * Estimate how far a string is out of tune from its filters' magnitudes. These
+ * may be averaged over several blocks, as long as both are averaged the same
+ *
+ * @param g      The filter bank, set up by goertzelInitStrings()
+ * @param string The string
+ * @param mag    The magnitude of the string's filter
+ * @param diff   The magnitude of its high filter minus its low filter
+ * @return The estimate in cents, positive when sharp, or 0 for no magnitude
+ */
+int16_t ICACHE_FLASH_ATTR goertzelCents(const goertzel_t* g, uint8_t string, uint32_t mag, int32_t diff)
+{
+    if(0 == mag)
+    {
+        return 0;
+    }
+    // Only done once per string per block, so the 64 bit math is fine
+    int64_t cents = ((int64_t)diff * g->centsScale[string]) / ((int64_t)mag << 8);
+    return (cents > INT16_MAX) ? INT16_MAX : ((cents < INT16_MIN) ? INT16_MIN : cents);
+}
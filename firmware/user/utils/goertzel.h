@@ -0,0 +1,52 @@
+/*
+*   goertzel.h
+*
+*   A bank of Goertzel filters, each measuring the magnitude of one frequency
+*   in the mic's samples over a block of samples. Much cheaper than a full DFT
+*   when only a few frequencies matter, like the strings of an instrument.
+*/
+
+#ifndef _GOERTZEL_H
+#define _GOERTZEL_H
+
+#include <c_types.h>
+
+#define GOERTZEL_MAX_FILTERS 24
+/// goertzelInitStrings() uses three filters per string
+#define GOERTZEL_MAX_STRINGS (GOERTZEL_MAX_FILTERS / 3)
+
+/// The filter a block's width below a string
+#define GOERTZEL_STRING_LOW(s)  ((s) * 3)
+/// The filter at a string's frequency
+#define GOERTZEL_STRING(s)      ((s) * 3 + 1)
+/// The filter a block's width above a string
+#define GOERTZEL_STRING_HIGH(s) ((s) * 3 + 2)
+
+typedef struct
+{
+    int32_t coeff; // 2cos(w), Q14
+    int32_t s1;
+    int32_t s2;
+} goertzelFilter_t;
+
+typedef struct
+{
+    goertzelFilter_t filters[GOERTZEL_MAX_FILTERS];
+    uint16_t mags[GOERTZEL_MAX_FILTERS]; // Amplitude at each frequency, from the last block
+    uint32_t centsScale[GOERTZEL_MAX_STRINGS]; // Cents per unit of (high - low) / mag, Q8
+    uint8_t numFilters;
+    uint8_t decimation; // Samples summed for each filter input
+    uint16_t blockLen;
+    uint16_t samplesInBlock;
+    int32_t sum;
+    uint8_t numSummed;
+    bool blockDone; // Set by goertzelPush() when it finishes a block
+} goertzel_t;
+
+void ICACHE_FLASH_ATTR goertzelInit(goertzel_t* g, const float* freqsHz, uint8_t numFilters, uint16_t blockLen);
+void ICACHE_FLASH_ATTR goertzelInitStrings(goertzel_t* g, const float* freqsHz, uint8_t numStrings,
+        uint16_t blockLen);
+uint16_t ICACHE_FLASH_ATTR goertzelPush(goertzel_t* g, const int16_t* samples, uint16_t numSamples);
+int16_t ICACHE_FLASH_ATTR goertzelCents(const goertzel_t* g, uint8_t string, uint32_t mag, int32_t diff);
+
+#endif
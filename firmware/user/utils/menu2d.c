@@ -60,6 +60,8 @@ menu_t* ICACHE_FLASH_ATTR initMenu(const char* title, menuCb cbFunc)
 
     // Initialize all values
     menu->title = title;
+    // Menus with one row have no title drawn, and may not have one
+    menu->titleWidth = (NULL == title) ? 0 : textWidth(title, RADIOSTARS);
     menu->rows = NULL;
     menu->numRows = 0;
     menu->cbFunc = cbFunc;
@@ -198,6 +200,7 @@ linkedInfo_t* ICACHE_FLASH_ATTR addItemToRow(menu_t* menu, const char* name)
     // Make a new item
     linkedInfo_t newItem;
     newItem.item.name = name;
+    newItem.item.width = textWidth(name, IBM_VGA_8);
 
     // Link the new item and return a pointer to it
     linkedInfo_t* linkedItem = linkNewNode(&(row->d.row.items), row->d.row.numItems, newItem);
@@ -205,6 +208,19 @@ linkedInfo_t* ICACHE_FLASH_ATTR addItemToRow(menu_t* menu, const char* name)
     return linkedItem;
 }
 
+/**
+ * Change the name of an item which is already in a menu
+ *
+ * @param item The item to rename, as returned by addItemToRow()
+ * @param name The new name of this item. This must be a pointer to static
+ *             memory. New memory is NOT allocated for this string
+ */
+void ICACHE_FLASH_ATTR renameMenuItem(linkedInfo_t* item, const char* name)
+{
+    item->item.name = name;
+    item->item.width = textWidth(name, IBM_VGA_8);
+}
+
 /**
  * Remove an item from the menu. This will iterate through all rows and all
  * items and remove the first item whose name matches the given pointer
@@ -270,7 +286,7 @@ void ICACHE_FLASH_ATTR drawRow(cLinkedNode_t* row, int16_t yPos, bool shouldDraw
     {
         row->d.row.tAccumulatedUs += tElapsedUs;
         // Get the X position for the selected item, centering it
-        int16_t xPos = row->d.row.xOffset + ((OLED_WIDTH - textWidth((char*)items->d.item.name, IBM_VGA_8)) / 2);
+        int16_t xPos = row->d.row.xOffset + ((OLED_WIDTH - items->d.item.width) / 2);
 
         // Then work backwards to make sure the entire row is drawn
         while(xPos > 0)
@@ -278,7 +294,7 @@ void ICACHE_FLASH_ATTR drawRow(cLinkedNode_t* row, int16_t yPos, bool shouldDraw
             // Iterate backwards
             items = items->prev;
             // Adjust the x pos
-            xPos -= (textWidth((char*)items->d.item.name, IBM_VGA_8) + ITEM_SPACING);
+            xPos -= (items->d.item.width + ITEM_SPACING);
         }
 
         // Then draw items until we're off the OLED
@@ -323,7 +339,7 @@ void ICACHE_FLASH_ATTR drawRow(cLinkedNode_t* row, int16_t yPos, bool shouldDraw
     else
     {
         // If there's only one item, just plot it
-        int16_t xPosS = (OLED_WIDTH - textWidth((char*)items->d.item.name, IBM_VGA_8)) / 2;
+        int16_t xPosS = (OLED_WIDTH - items->d.item.width) / 2;
         int16_t xPosF = plotText(xPosS, yPos,
                                  (char*)items->d.item.name,
                                  IBM_VGA_8, WHITE);
@@ -410,8 +426,7 @@ void ICACHE_FLASH_ATTR drawMenu(menu_t* menu)
         fillDisplayArea(0, 0, OLED_WIDTH, BLANK_SPACE_Y, BLACK);
 
         // Draw the title, centered
-        int16_t titleOffset = (OLED_WIDTH - textWidth((char*)menu->title, RADIOSTARS)) / 2;
-        plotText(titleOffset, 8, (char*)menu->title, RADIOSTARS, WHITE);
+        plotText((OLED_WIDTH - menu->titleWidth) / 2, 8, menu->title, RADIOSTARS, WHITE);
     }
 }
 
@@ -460,10 +475,10 @@ void ICACHE_FLASH_ATTR menuButton(menu_t* menu, int btn)
             if(menu->rows->d.row.numItems > 1)
             {
                 // To properly center the word, measure both old and new centered words
-                uint8_t oldWordWidth = textWidth((char*)menu->rows->d.row.items->d.item.name, IBM_VGA_8);
+                uint8_t oldWordWidth = menu->rows->d.row.items->d.item.width;
                 // Move to the previous item
                 menu->rows->d.row.items = menu->rows->d.row.items->prev;
-                uint8_t newWordWidth = textWidth((char*)menu->rows->d.row.items->d.item.name, IBM_VGA_8);
+                uint8_t newWordWidth = menu->rows->d.row.items->d.item.width;
                 // Set the offset to smootly animate from the old, centered word to the new centered word
                 menu->rows->d.row.xOffset = -(newWordWidth + ITEM_SPACING + ((oldWordWidth - newWordWidth - 1) / 2));
             }
@@ -475,10 +490,10 @@ void ICACHE_FLASH_ATTR menuButton(menu_t* menu, int btn)
             if(menu->rows->d.row.numItems > 1)
             {
                 // To properly center the word, measure both old and new centered words
-                uint8_t oldWordWidth = textWidth((char*)menu->rows->d.row.items->d.item.name, IBM_VGA_8);
+                uint8_t oldWordWidth = menu->rows->d.row.items->d.item.width;
                 // Move to the next item
                 menu->rows->d.row.items = menu->rows->d.row.items->next;
-                uint8_t newWordWidth = textWidth((char*)menu->rows->d.row.items->d.item.name, IBM_VGA_8);
+                uint8_t newWordWidth = menu->rows->d.row.items->d.item.width;
                 // Set the offset to smootly animate from the old, centered word to the new centered word
                 menu->rows->d.row.xOffset = oldWordWidth + ITEM_SPACING + ((newWordWidth - oldWordWidth - 1) / 2);
             }
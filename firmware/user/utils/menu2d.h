@@ -14,6 +14,7 @@
 
 #include <osapi.h>
 #include "user_config.h"
+#include "font.h"
 
 #if defined(FEATURE_OLED)
 
@@ -36,6 +37,7 @@ typedef struct
 typedef struct
 {
     const char* name;
+    int16_t width; ///< textWidth() of name in IBM_VGA_8, measured when set
 } itemInfo_t;
 
 typedef union
@@ -54,6 +56,7 @@ typedef struct cLinkedNode
 typedef struct
 {
     const char* title;
+    int16_t titleWidth; ///< textWidth() of title in RADIOSTARS, measured once
     cLinkedNode_t* rows;
     uint8_t numRows;
     menuCb cbFunc;
@@ -70,6 +73,7 @@ menu_t* initMenu(const char* title, menuCb cbFunc);
 void deinitMenu(menu_t* menu);
 void addRowToMenu(menu_t* menu);
 linkedInfo_t* addItemToRow(menu_t* menu, const char* name);
+void renameMenuItem(linkedInfo_t* item, const char* name);
 void removeItemFromMenu(menu_t* menu, const char* name);
 void drawMenu(menu_t* menu);
 void menuButton(menu_t* menu, int btn);
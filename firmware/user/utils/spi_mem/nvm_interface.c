@@ -107,7 +107,8 @@ void ICACHE_FLASH_ATTR SaveSettings(void)
 {
     EnterCritical();
     spi_flash_erase_sector( USER_SETTINGS_ADDR / SPI_FLASH_SEC_SIZE );
-    spi_flash_write( USER_SETTINGS_ADDR, (uint32*)&settings, ((sizeof( settings ) - 1) & (~0xf)) + 0x10 );
+    // settings_t is 4 byte aligned, so its size is a multiple of 4 as required
+    spi_flash_write( USER_SETTINGS_ADDR, (uint32*)&settings, sizeof( settings ) );
     ExitCritical();
 }
 
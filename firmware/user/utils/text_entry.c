@@ -5,6 +5,7 @@
 #include "text_entry.h"
 #include "oled.h"
 #include "bresenham.h"
+#include "cndraw.h"
 #include "font.h"
 
 /*============================================================================
@@ -132,14 +133,14 @@ bool ICACHE_FLASH_ATTR textEntryDraw(void)
         // Underline capital chars
         if( c >= 'A' && c <= 'Z' )
         {
-            plotLine( startPos, 13, endPos - 2, 13, WHITE );
+            drawHLine( startPos, endPos - 2, 13, WHITE );
         }
     }
 
     // If the blinky cursor should be shown, draw it
     if(showCursor)
     {
-        plotLine(endPos + 1, 2, endPos + 1, 2 + FONT_HEIGHT_IBMVGA8 - 1, WHITE);
+        drawVLine(endPos + 1, 2, 2 + FONT_HEIGHT_IBMVGA8 - 1, WHITE);
     }
 
     // Draw an indicator for the current key modifier
@@ -150,7 +151,7 @@ bool ICACHE_FLASH_ATTR textEntryDraw(void)
             int8_t width = textWidth("Typing: Upper", TOM_THUMB);
             int8_t typingWidth = textWidth("Typing: ", TOM_THUMB);
             plotText(OLED_WIDTH - width, OLED_HEIGHT - FONT_HEIGHT_TOMTHUMB - 2, "Typing: Upper", TOM_THUMB, WHITE);
-            plotLine(OLED_WIDTH - width + typingWidth, OLED_HEIGHT - 1, OLED_WIDTH - 1, OLED_HEIGHT - 1, WHITE);
+            drawHLine(OLED_WIDTH - width + typingWidth, OLED_WIDTH - 1, OLED_HEIGHT - 1, WHITE);
             break;
         }
         case NO_SHIFT:
@@ -164,7 +165,7 @@ bool ICACHE_FLASH_ATTR textEntryDraw(void)
             int8_t width = textWidth("Typing: CAPS LOCK", TOM_THUMB);
             int8_t typingWidth = textWidth("Typing: ", TOM_THUMB);
             plotText(OLED_WIDTH - width, OLED_HEIGHT - FONT_HEIGHT_TOMTHUMB - 2, "Typing: CAPS LOCK", TOM_THUMB, WHITE);
-            plotLine(OLED_WIDTH - width + typingWidth, OLED_HEIGHT - 1, OLED_WIDTH - 1, OLED_HEIGHT - 1, WHITE);
+            drawHLine(OLED_WIDTH - width + typingWidth, OLED_WIDTH - 1, OLED_HEIGHT - 1, WHITE);
             break;
         }
         default: